@@ -0,0 +1,101 @@
+#ifndef ANALYSIS_CACHE_HPP
+#define ANALYSIS_CACHE_HPP
+
+#include "move.hpp"
+#include "transposition_table.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Search results kept on disk from one session to the next. The file is a log: a
+// 64 byte header (magic, version, key of the start position) followed by one 24 byte
+// record per stored result, appended as the search finds them. Every record holds a
+// checksum, so the records of a write torn by a crash are recognised and cut off when
+// the file is opened again. Opening maps the file and replays it into an in-memory
+// table of bounded size, which the search threads probe and update without locking
+// like the transposition table. Once the log holds many records that were replaced,
+// it is compacted by writing the live entries to a temporary file which is renamed
+// over the log, so a crash during compaction leaves the old log intact.
+//
+// Several processes can share a cache file; the log is only compacted or repaired
+// by a process which is the only one to have it open.
+//
+// Keys do not cover the game history, so the search does not store the results of
+// subtrees in which it found a draw by repetition or the fifty-move rule. A result
+// built on a transposition table entry whose own subtree held such a draw can still
+// be stored, and then carries that draw score into later sessions.
+
+class AnalysisCache {
+    public:
+        // Results searched less deep than this are not worth keeping across sessions
+        static constexpr int default_min_depth = 6;
+
+        AnalysisCache() = default;
+        ~AnalysisCache();
+        AnalysisCache(const AnalysisCache&) = delete;
+        AnalysisCache& operator=(const AnalysisCache&) = delete;
+
+        // Method used to open a cache file, creating it if needed, keeping at most megabytes
+        // of entries in memory. Not to be called while other threads use the cache, errors are printed
+        bool open(const std::string& path, std::size_t megabytes = 64, int min_depth = default_min_depth);
+        // Method used to compact the log if needed and close the file
+        void close();
+        bool isOpen() const { return log != nullptr; }
+        int minDepth() const { return min_depth; }
+        // Number of entries in memory and the most there is room for
+        std::size_t size() const { return entry_count.load(std::memory_order_relaxed); }
+        std::size_t capacity() const { return slot_count; }
+
+        // Returns true and fills entry if the key is found, safe to call from any thread
+        bool probe(std::uint64_t key, TTEntry& entry) const;
+        // Method used to store a search result of at least minDepth() plies, safe to call from
+        // any thread. A result replacing a shallower one or taking a free slot is appended to
+        // the log. When the table is full the shallowest and oldest entry of the bucket gives way
+        void store(std::uint64_t key, int depth, int score, Bound bound, const Move& move);
+        // Method used to rewrite the log with only the entries in memory, returns false if
+        // another process has the file open or it cannot be written. Errors are printed
+        bool compact();
+
+    private:
+        struct Slot {
+            std::atomic<std::uint64_t> key{0};
+            std::atomic<std::uint64_t> data{0};
+        };
+        struct Record;
+
+        // Slots probed for a key, consecutive so that they share a cache line
+        static constexpr std::size_t bucket_size = 4;
+
+        // Method used to put a data word in the table, returns true if it was kept
+        bool insert(std::uint64_t key, std::uint64_t data);
+        // Method used to replay the records of a log, returns the number of bytes of valid records
+        std::size_t replay(const std::uint8_t* contents, std::size_t file_size);
+        // Method used to take the file lock alone (exclusive) or shared with other processes,
+        // returns false if the lock is held by another process
+        bool lock(bool exclusive);
+        // Method used to rewrite the log, the file mutex must be held
+        bool compactLocked();
+        // Returns true if the log has grown well past the entries it holds
+        bool needsCompaction() const;
+
+        std::unique_ptr<Slot[]> slots;
+        std::size_t slot_count = 0;
+        std::atomic<std::size_t> entry_count{0};
+        int min_depth = default_min_depth;
+        // Session number stored with every entry, newer sessions replace older entries first
+        std::uint16_t generation = 0;
+
+        std::string path;
+        // Log opened for appending, guarded by file_mutex
+        std::FILE* log = nullptr;
+        std::mutex file_mutex;
+        std::uint64_t log_records = 0;
+        // Number of records after which the log is compacted during a session
+        std::uint64_t compaction_limit = 0;
+};
+
+#endif
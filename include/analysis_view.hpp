@@ -0,0 +1,60 @@
+#ifndef ANALYSIS_VIEW_HPP
+#define ANALYSIS_VIEW_HPP
+
+#include <SFML/Graphics.hpp>
+#include "move.hpp"
+#include <array>
+#include <cstdint>
+#include <string>
+
+// One line of a multi-PV search
+struct AnalysisLine {
+    int depth = 0;
+    // Score in centipawns from white's point of view
+    int score = 0;
+    Move move;
+};
+
+// Lines of the analysis of a position. The search thread always sends all of them,
+// so the render thread only needs the newest update and may skip the others.
+struct AnalysisUpdate {
+    static constexpr int max_lines = 8;
+    // Hash of the analysed position, updates for another position are stale
+    std::uint64_t key = 0;
+    int line_count = 0;
+    std::array<AnalysisLine, max_lines> lines;
+};
+
+// Arrows for the first move of every line, drawn over a board whose top left corner is
+// at the origin, and an evaluation bar of the best line to the right of the board. All
+// shapes are rebuilt when an update is set, drawing only submits them.
+class AnalysisView : public sf::Drawable {
+    public:
+        // Constructor which takes the size of the board and the width of the bar beside it
+        AnalysisView(float board_size, float bar_width);
+
+        // Method used to show the lines of an update
+        void setUpdate(const AnalysisUpdate& update);
+        // Method used to stop showing lines, e.g. once the position has changed
+        void clear();
+        // Method used to describe the lines as text, e.g. "depth 12  +0.35 e2e4  +0.20 d2d4"
+        std::string summary() const;
+
+    private:
+        // Method used to append the triangles of an arrow between the centers of two squares
+        void appendArrow(const Move& move, float width, const sf::Color& color);
+        // Overridden draw method to draw the arrows and the bar to the RenderTarget
+        virtual void draw(sf::RenderTarget& renderTarget, sf::RenderStates renderStates) const;
+
+        float board_size;
+        float square_size;
+        AnalysisUpdate shown;
+        // Triangles of all arrows, the best line last so that it is drawn on top
+        sf::VertexArray arrows;
+        // Evaluation bar, white's share of the bar grows from the bottom
+        sf::RectangleShape bar_background;
+        sf::RectangleShape bar_white;
+        sf::RectangleShape bar_middle;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef ATTACK_TABLES_HPP
+#define ATTACK_TABLES_HPP
+
+#include "piece.hpp"
+#include <array>
+#include <cstdint>
+
+// Lookup tables of the squares attacked by knights, kings and pawns from every square,
+// generated at compile time. A square is indexed as file * 8 + rank like the board.
+
+inline constexpr int squareIndex(int file, int rank) { return file * 8 + rank; }
+inline constexpr int squareFile(int square) { return square / 8; }
+inline constexpr int squareRank(int square) { return square % 8; }
+inline constexpr std::uint64_t squareBit(int file, int rank) { return 1ULL << squareIndex(file, rank); }
+
+// Squares attacked from one square, at most 8 for a leaper
+struct AttackSet {
+    std::array<std::uint8_t, 8> squares{};
+    std::uint8_t count = 0;
+
+    constexpr const std::uint8_t* begin() const { return squares.data(); }
+    constexpr const std::uint8_t* end() const { return squares.data() + count; }
+};
+
+namespace attack_tables {
+    using Offsets = std::array<std::array<int, 2>, 8>;
+
+    inline constexpr Offsets knight_offsets = {{
+        {{2, 1}}, {{2, -1}}, {{-2, 1}}, {{-2, -1}}, {{1, 2}}, {{1, -2}}, {{-1, 2}}, {{-1, -2}}
+    }};
+    inline constexpr Offsets king_offsets = {{
+        {{-1, -1}}, {{-1, 0}}, {{-1, 1}}, {{0, -1}}, {{0, 1}}, {{1, -1}}, {{1, 0}}, {{1, 1}}
+    }};
+
+    // Function used to build the attack sets of a piece moving by the first count offsets
+    constexpr std::array<AttackSet, 64> makeAttacks(const Offsets& offsets, int count) {
+        std::array<AttackSet, 64> attacks{};
+        for (int square = 0; square < 64; square++) {
+            for (int i = 0; i < count; i++) {
+                int file = squareFile(square) + offsets[i][0];
+                int rank = squareRank(square) + offsets[i][1];
+                if (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+                    AttackSet& set = attacks[square];
+                    set.squares[set.count++] = static_cast<std::uint8_t>(squareIndex(file, rank));
+                }
+            }
+        }
+        return attacks;
+    }
+
+    // White pawns move towards rank index 0, black pawns towards rank index 7
+    constexpr std::array<AttackSet, 64> makePawnAttacks(int direction) {
+        return makeAttacks(Offsets{{{{-1, direction}}, {{1, direction}}}}, 2);
+    }
+}
+
+inline constexpr std::array<AttackSet, 64> knight_attacks = attack_tables::makeAttacks(attack_tables::knight_offsets, 8);
+inline constexpr std::array<AttackSet, 64> king_attacks = attack_tables::makeAttacks(attack_tables::king_offsets, 8);
+// Squares attacked by a pawn indexed by [color == White][square]
+inline constexpr std::array<std::array<AttackSet, 64>, 2> pawn_attacks = {{
+    attack_tables::makePawnAttacks(1), attack_tables::makePawnAttacks(-1)
+}};
+
+static_assert(knight_attacks[squareIndex(0, 0)].count == 2 && knight_attacks[squareIndex(3, 3)].count == 8);
+static_assert(king_attacks[squareIndex(0, 7)].count == 3 && king_attacks[squareIndex(4, 4)].count == 8);
+
+// Function used to get the squares attacked by a pawn of the given color
+inline constexpr const AttackSet& pawnAttacks(Piece::Color color, int square) {
+    return pawn_attacks[color == Piece::Color::White][square];
+}
+
+#endif
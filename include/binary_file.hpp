@@ -0,0 +1,57 @@
+#ifndef BINARY_FILE_HPP
+#define BINARY_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Helpers shared by the binary file formats (packed positions, tablebases, game
+// indexes, opening explorers and analysis caches). Header fields are stored little
+// endian; formats whose records are read in place as structs can only be used on
+// little-endian machines.
+
+// Returns true if the machine stores integers little endian
+bool isLittleEndian();
+// Function used to store the size lowest bytes of a value, least significant first
+void writeLittleEndian(std::uint8_t* bytes, std::uint64_t value, int size);
+// Function used to read a value stored by writeLittleEndian
+std::uint64_t readLittleEndian(const std::uint8_t* bytes, int size);
+
+// Read-only contents of a whole file. On POSIX systems the file is memory-mapped, so
+// large files are paged in on demand and shared between processes, elsewhere it is
+// read into memory. The contents are aligned for 64 bit words either way.
+class MappedFile {
+    public:
+        // How the contents will be read, passed on to the kernel for its read-ahead
+        enum class Access {
+            Sequential,
+            Random
+        };
+
+        MappedFile() = default;
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // Method used to map a file or else read it, returns false if it cannot be opened.
+        // Errors are printed
+        bool open(const std::string& path, Access access);
+        // Method used to only map a file, returns false without printing if it cannot be mapped
+        // so that the caller can fall back to reading it piece by piece
+        bool map(const std::string& path, Access access);
+        void close();
+
+        // Contents and length of the file, null for an empty or closed file
+        const std::uint8_t* data() const { return contents; }
+        std::size_t size() const { return file_size; }
+
+    private:
+        const std::uint8_t* contents = nullptr;
+        std::size_t file_size = 0;
+        void* mapping = nullptr;
+        // Contents read without mapping, as words so that they are aligned like a mapping
+        std::vector<std::uint64_t> buffer;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef BOARD_ASSETS_HPP
+#define BOARD_ASSETS_HPP
+
+#include <SFML/Graphics.hpp>
+#include <SFML/Audio.hpp>
+#include "piece.hpp"
+#include <array>
+#include <memory>
+
+// Immutable resources used to draw and play boards. They are loaded once and shared by
+// every board on screen (flyweight), so a board only adds its own position state.
+class BoardAssets {
+    public:
+        // Size of a single piece sprite in the sprite sheet in pixels
+        static constexpr int sprite_size = 189;
+
+        // Method used to get the assets shared by all boards, they are loaded by the first
+        // call and released once no board uses them anymore
+        static std::shared_ptr<const BoardAssets> shared();
+        // Method used to get the area of a piece's sprite in the piece texture
+        static sf::IntRect pieceRect(const Piece& piece);
+
+        const sf::Texture& pieceTexture() const { return piece_texture; }
+        const sf::SoundBuffer& moveSound() const { return sound_buffers[0]; }
+        const sf::SoundBuffer& captureSound() const { return sound_buffers[1]; }
+
+    private:
+        BoardAssets();
+
+        // Texture to hold piece set sprite sheet
+        sf::Texture piece_texture;
+        // Move and capture sounds
+        std::array<sf::SoundBuffer, 2> sound_buffers;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef BOARD_DIAGRAM_HPP
+#define BOARD_DIAGRAM_HPP
+
+#include "position.hpp"
+#include "move.hpp"
+#include <string>
+
+// Options shared by the SVG writer and the offscreen PNG renderer
+struct DiagramOptions {
+    // Width and height of the diagram in pixels
+    int size = 400;
+    // Draw the board from black's side
+    bool flipped = false;
+    // Move highlighted like the last move on the interactive board, none if null
+    Move last_move;
+    // Highlight the king of the side to move when it is in check
+    bool show_check = true;
+    // Image the SVG takes the pieces from, a path or a data URI of the piece sprite sheet
+    std::string piece_atlas = "../res/pieces/maestro/maestro_pieces.png";
+};
+
+// Colors of the diagram in the same order as the interactive board: light, dark,
+// last move highlight and check highlight as RGBA
+struct DiagramColors {
+    static constexpr unsigned char light[4] = {240, 217, 181, 255};
+    static constexpr unsigned char dark[4] = {148, 111, 81, 255};
+    static constexpr unsigned char highlight[4] = {155, 199, 0, 104};
+    static constexpr unsigned char check[4] = {255, 0, 0, 178};
+};
+
+// Function used to get the column and row of a piece in the piece sprite sheet,
+// 6 columns of 189 pixel sprites with the black pieces in the first row
+void diagramAtlasCell(const Piece& piece, int& column, int& row);
+
+// Function used to write a diagram of the position as a standalone SVG document. It only
+// formats text, so it needs neither SFML nor a graphics context and is safe to call from
+// any number of threads.
+std::string renderSvg(const Position& position, const DiagramOptions& options);
+
+// Function used to read a file into a data URI usable as DiagramOptions::piece_atlas,
+// making the SVG self-contained. Returns an empty string if the file cannot be read
+std::string fileDataUri(const std::string& path, const std::string& mime_type = "image/png");
+
+#endif
@@ -5,11 +5,16 @@
 #include <SFML/Audio.hpp>
 #include "piece.hpp"
 #include "move.hpp"
+#include "position.hpp"
+#include "board_assets.hpp"
+#include "legal_move_cache.hpp"
+#include "opening_explorer.hpp"
 #include <array>
+#include <memory>
 #include <vector>
 #include <string>
 
-class ChessBoard : public sf::Drawable {
+class ChessBoard : public sf::Drawable, public Position {
     public:
         // Constructor which takes the desired size and position of the board
         ChessBoard(float board_size, float x = 0, float y = 0);
@@ -20,8 +25,6 @@ class ChessBoard : public sf::Drawable {
         static inline const sf::Color light{240, 217, 181};
         static inline const sf::Color dark{148, 111, 81};
         static inline const sf::Color highlight{155, 199, 0, 104};
-        // Method load a board position using FEN
-        void loadPositionFromFEN(const std::string& fen);
         // Method used to find and select piece under the mouse
         void selectPiece(const sf::Vector2f& mouse_position);
         // Method used to update position of selected piece to mouse position
@@ -31,9 +34,10 @@ class ChessBoard : public sf::Drawable {
         // Method used to find the indices of a piece's corresponding
         // sprite in the pieces array
         sf::Vector2i findPieceSprite(int file, int rank) const;
-        // Method used to move a piece and update their corresponding sprite's position
-        // on the board
-        void movePiece(int file, int rank, int new_file, int new_rank);
+        // Method used to play a legal move and update the sprites, highlights and sounds
+        void playMove(const Move& move);
+        // Method used to recreate the piece sprites from the pieces on the board
+        void updateSprites();
         // Method used to update the board for the next move
         void nextMove();
         // Overloaded method used to update a piece's sprite position on the board
@@ -41,51 +45,48 @@ class ChessBoard : public sf::Drawable {
         void updateSpritePosition(int file, int rank, const sf::Vector2f& new_position);
         // Method used to toggle the pawn promotion menu for the given color and file
         void togglePawnPromotionMenu(Piece::Color color, int file);
-        // Method used to generate all legal moves for the given color
+        // Method used to generate all legal moves for the given color, the moves of the
+        // side to move are maintained incrementally from the previous position
+        using Position::generateMoves;
         void generateMoves(Piece::Color color);
-        // Helper methods to generate legal moves for each piece type
-        void generatePawnMoves(int file, int rank);
-        void generateRookMoves(int start_file, int start_rank);
-        void generateBishopMoves(int start_file, int start_rank);
-        void generateKnightMoves(int start_file, int start_rank);
-        void generateKingMoves(int start_file, int start_rank);
+        // Method used to compare every incremental move update against a full generation
+        void setMoveVerification(bool enabled) { legal_move_cache.setVerification(enabled); }
         // Method used to check if a move is legal
         bool isLegalMove(const Move& move) const;
-        // Method used to validate and add a move to the list of legal moves
-        void addMove(int start_file, int start_rank, int target_file, int target_rank);
-        // Helper method used validate psuedo-legal moves
-        bool isValidLegalMove(int start_file, int start_rank, int target_file, int target_rank);
-        // Method used to determine if a color is currently in check
-        bool inCheck(Piece::Color color) const;
+        // Method used to find the legal move matching the squares of a move made with the mouse,
+        // with a queen promotion for pawn moves to the last rank. Returns a null move if illegal
+        Move findLegalMove(const Move& move) const;
+        // Number of half-moves played on the board and the last of them
+        int moveCount() const { return move_count; }
+        const Move& lastMove() const { return last_played_move; }
+        // Returns true once the side to move has no legal moves
+        bool isGameOver() const { return legalMoves.empty(); }
+        // Returns true while the pawn promotion menu waits for a piece to be chosen
+        bool isPromoting() const { return pawn_promotion; }
+        // Method used to show on the target squares of a selected piece how often its moves
+        // were played in the games of the explorer, null to stop showing them
+        void setExplorer(std::shared_ptr<const OpeningExplorer> opening_explorer);
 
     private:
+        // Sprite sheet and sounds shared with every other board
+        std::shared_ptr<const BoardAssets> assets;
         // 2D array containing the RectangleShapes for each board square
         std::array<std::array<sf::RectangleShape, 8>, 8> square_rectangles;
         float board_size;
         // Coordinates of the top left corner of the board
         sf::Vector2f board_origin;
         sf::Vector2f square_size;
-        // Logical chess board structured as [file][rank]
-        // with the rank going in decending order i.e. 8 to 1
-        Piece square[8][8];
-        // Current color to move
-        Piece::Color active_color = Piece::Color::White;
         // Keeps track of number of half-moves made since starting position
         int move_count = 0;
         // Boolean to keep track of checks
         bool check = false;
-        // Booleans to keep track of castling availability;
-        bool white_king_side_castle = false;
-        bool white_queen_side_castle = false;
-        bool black_king_side_castle = false;
-        bool black_queen_side_castle = false;
-        // Contains the file and rank of an en passant target square
-        // (-1, -1) if there is none
-        sf::Vector2i en_passant;
         // Boolean to activate pawn promotion menu
         bool pawn_promotion = false;
         // Keeps track of the file of the pawn to be promoted
         int pawn_promotion_file;
+        // Pawn move waiting for the promotion piece to be chosen
+        Move promotion_move;
+        Move last_played_move;
         // Contains the file and rank of currently selected piece
         // (-1, -1) if no piece has been selected
         sf::Vector2i selected_piece;
@@ -99,10 +100,13 @@ class ChessBoard : public sf::Drawable {
         sf::RectangleShape selected_square;
         // RectangleShape used to highlight the king's square during check
         sf::RectangleShape check_square;
-        // Texture to hold piece set sprite sheet
-        sf::Texture piece_textures;
+        // Opening explorer and the circles showing the share of games of each move of the
+        // selected piece, larger for more frequent moves
+        std::shared_ptr<const OpeningExplorer> explorer;
+        std::vector<ExplorerMove> explorer_moves;
+        std::vector<sf::CircleShape> move_frequencies;
         // Size of a single piece sprite in pixels
-        int sprite_size = 189;
+        static constexpr int sprite_size = BoardAssets::sprite_size;
         // Array of vectors containing the Sprites for every other type of piece
         // Structure is:
         //      pieces[0] : white pawns
@@ -121,12 +125,14 @@ class ChessBoard : public sf::Drawable {
         // RectangleShape and sprites for the pawn promotion menu
         sf::RectangleShape pawn_promotion_menu_box;
         std::array<sf::Sprite, 4> pawn_promotion_menu_sprites;
-        // Array to store SoundBuffers for all in game sounds
-        std::array<sf::SoundBuffer, 2> sound_buffers;
         sf::Sound move_sound;
         sf::Sound capture_sound;
         // Vector to store all legal moves from current position
         std::vector<Move> legalMoves;
+        MoveList generated_moves;
+        LegalMoveCache legal_move_cache;
+        // Method used to place the move frequency circles of the selected piece
+        void updateMoveFrequencies();
         // Overridden draw method to draw ChessBoard to the RenderTarget
         virtual void draw(sf::RenderTarget &renderTarget, sf::RenderStates renderStates) const;
 };
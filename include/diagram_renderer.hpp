@@ -0,0 +1,67 @@
+#ifndef DIAGRAM_RENDERER_HPP
+#define DIAGRAM_RENDERER_HPP
+
+#include <SFML/Graphics.hpp>
+#include "board_assets.hpp"
+#include "board_diagram.hpp"
+#include "position.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Offscreen renderer of board diagrams. The render texture is created once and reused
+// for every diagram of the same size, and a diagram is drawn in two batched draw calls
+// (squares and pieces) with the piece sprite sheet shared with every other board.
+// Must be used from a single thread as it owns a graphics context.
+class DiagramRenderer {
+    public:
+        DiagramRenderer();
+
+        // Method used to render a diagram of the position into the image,
+        // returns false if the render texture could not be created
+        bool render(const Position& position, const DiagramOptions& options, sf::Image& image);
+
+    private:
+        std::shared_ptr<const BoardAssets> assets;
+        sf::RenderTexture texture;
+        unsigned int texture_size = 0;
+        sf::VertexArray squares;
+        sf::VertexArray pieces;
+};
+
+// Pool of threads encoding rendered diagrams to image files, so that PNG compression
+// overlaps with rendering the next diagrams on the thread owning the renderer
+class DiagramEncoder {
+    public:
+        // Constructor which starts the given number of encoding threads
+        explicit DiagramEncoder(int threads);
+        ~DiagramEncoder();
+        DiagramEncoder(const DiagramEncoder&) = delete;
+        DiagramEncoder& operator=(const DiagramEncoder&) = delete;
+
+        // Method used to queue an image to be saved, blocks while too many images are waiting
+        void save(sf::Image image, std::string path);
+        // Method used to wait until every queued image is saved, returns the number of failed saves
+        std::size_t finish();
+
+    private:
+        void work();
+
+        std::mutex mutex;
+        std::condition_variable job_available;
+        std::condition_variable space_available;
+        std::deque<std::pair<sf::Image, std::string>> jobs;
+        std::vector<std::thread> workers;
+        std::size_t window;
+        std::size_t busy = 0;
+        std::size_t failures = 0;
+        bool closed = false;
+};
+
+#endif
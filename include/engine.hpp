@@ -0,0 +1,62 @@
+#ifndef ENGINE_HPP
+#define ENGINE_HPP
+
+#include "analysis_cache.hpp"
+#include "position.hpp"
+#include "search.hpp"
+#include "transposition_table.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Runs searches in the background on a pool of threads sharing one
+// transposition table (lazy SMP). Used by the UCI front end.
+class Engine {
+    public:
+        using BestMoveCallback = std::function<void(const SearchInfo&)>;
+
+        Engine();
+        ~Engine();
+
+        // Methods used to configure the engine, these wait for a running search to finish
+        void setHashSize(std::size_t megabytes);
+        void setThreads(int count);
+        // Method used to open the analysis cache file that the searches consult and update,
+        // an empty path closes it. Returns false if the file cannot be used, errors are printed
+        bool openAnalysisCache(const std::string& path, std::size_t megabytes);
+        // Method used to forget what was learned from previous searches, the analysis cache is kept
+        void clear();
+        // Method used to start searching the position in the background. on_info is called
+        // from the search thread after every iteration and on_bestmove once the search is done.
+        void go(const Position& position, const SearchLimits& limits,
+                const Search::InfoCallback& on_info, const BestMoveCallback& on_bestmove);
+        // Method used to stop the running search, on_bestmove is still called
+        void stop();
+        // Method used to tell a ponder search that the expected move was played, the search
+        // continues as a regular search of the same position with its time limits
+        void ponderHit();
+        // Method used to block until the running search has finished
+        void wait();
+
+        int threads() const { return thread_count; }
+        TranspositionTable& transpositionTable() { return tt; }
+
+    private:
+        TranspositionTable tt;
+        AnalysisCache cache;
+        int thread_count = 1;
+        std::atomic<bool> stop_flag{false};
+        // Set while a ponder search waits for ponderHit
+        std::atomic<bool> ponder_flag{false};
+        std::thread search_thread;
+        // Used to keep an infinite or ponder search from returning before it is stopped
+        // (or the ponder move is played)
+        std::mutex stop_mutex;
+        std::condition_variable stop_condition;
+};
+
+#endif
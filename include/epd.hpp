@@ -0,0 +1,19 @@
+#ifndef EPD_HPP
+#define EPD_HPP
+
+#include <map>
+#include <string>
+
+// A line of a FEN or EPD file
+struct EpdRecord {
+    // Full FEN, EPD lines get a halfmove clock and fullmove number added
+    std::string fen;
+    // EPD operations e.g. "bm" -> "Nf3", "id" -> "position 1"
+    std::map<std::string, std::string> operations;
+};
+
+// Function used to parse a line holding either a FEN or an EPD record.
+// Returns false for blank lines and comments starting with '#'.
+bool parseEpdLine(const std::string& line, EpdRecord& record);
+
+#endif
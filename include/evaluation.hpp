@@ -0,0 +1,31 @@
+#ifndef EVALUATION_HPP
+#define EVALUATION_HPP
+
+#include "position.hpp"
+#include "piece.hpp"
+#include <array>
+
+// Material values in centipawns indexed by Piece::Type
+inline constexpr std::array<int, 7> piece_values = {0, 0, 100, 320, 330, 500, 900};
+
+// Returns the static evaluation of the position in centipawns from the
+// perspective of the side to move
+int evaluate(const Position& position);
+
+// The evaluation is a sum of weights, the material value of every piece type followed
+// by the piece-square tables of every type from White's point of view. Tools such as
+// the tuner evaluate a position from White's point of view as the sum over the pieces
+// of piece_values[type] + weights[pieceSquareWeight(...)], negated for black pieces.
+inline constexpr int piece_square_weights_offset = 7;
+inline constexpr int evaluation_weight_count = piece_square_weights_offset + 7 * 64;
+
+// Returns the index of the piece-square weight of a piece, black pieces use the tables mirrored vertically
+inline int pieceSquareWeight(const Piece& piece, int file, int rank) {
+    int table_rank = (piece.color == Piece::Color::White) ? rank : 7 - rank;
+    return piece_square_weights_offset + piece.type * 64 + table_rank * 8 + file;
+}
+
+// Function used to get the weights used by evaluate
+std::array<int, evaluation_weight_count> evaluationWeights();
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef FRAME_PROFILER_HPP
+#define FRAME_PROFILER_HPP
+
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Frame-time and input-latency measurement of the GUI main loop, for tuning it on
+// slow hardware. Every frame records its duration, the time spent in each phase, the
+// draw calls submitted and, for a frame in which a mouse release was handled, the
+// latency until the move was handled and until the frame showing it was displayed
+// (click to pixel, from the moment the event was read). The results go to an optional
+// CSV log with one row per frame and to an overlay, toggled with F3, showing the
+// percentiles of the recent frames and a graph of their durations. The overlay is
+// drawn with a built-in 3 x 5 pixel font as no font ships with the game.
+//
+// Only meant for the render thread; phases and draw calls are recorded into the
+// profiler whose frame is running, so that drawables need no reference to it.
+class FrameProfiler : public sf::Drawable {
+    public:
+        // Phases of a frame, the moves of the human are handled by nextMove during event handling
+        enum class Phase {
+            Events,
+            NextMove,
+            Draw,
+            Display,
+            Count
+        };
+
+        // Timer adding its lifetime to a phase of the running frame, if there is one
+        class ScopedPhase {
+            public:
+                explicit ScopedPhase(Phase phase);
+                ~ScopedPhase();
+                ScopedPhase(const ScopedPhase&) = delete;
+                ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+            private:
+                Phase phase;
+                std::chrono::steady_clock::time_point start;
+        };
+
+        FrameProfiler();
+        ~FrameProfiler();
+        FrameProfiler(const FrameProfiler&) = delete;
+        FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+        // Method used to log every frame as a CSV row to a file, returns false if it cannot be created
+        bool openLog(const std::string& path);
+        void toggleOverlay() { overlay_visible = !overlay_visible; }
+        bool overlayVisible() const { return overlay_visible; }
+
+        // Methods used to mark the start and end (after display) of a frame
+        void beginFrame();
+        void endFrame();
+        // Methods used to mark when a mouse release was read and when the move it made was handled
+        void inputReceived();
+        void inputHandled();
+        // Method used to count draw calls submitted to the GPU during the running frame
+        static void countDrawCalls(std::size_t count = 1);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        // Measurements of one frame, in milliseconds, with negative latencies for no input
+        struct FrameRecord {
+            float frame_ms = 0;
+            std::array<float, static_cast<std::size_t>(Phase::Count)> phase_ms{};
+            std::uint32_t draw_calls = 0;
+            float input_ms = -1;
+            float pixel_ms = -1;
+        };
+
+        // Number of recent frames the percentiles are taken over, 10 seconds at 60 FPS
+        static constexpr std::size_t history_size = 600;
+        // Number of frames shown in the graph and between updates of the overlay text
+        static constexpr std::size_t graph_frames = 120;
+        static constexpr std::size_t text_interval = 30;
+
+        // Method used to rewrite the overlay text from the recent frames
+        void updateText();
+        // Method used to rebuild the graph of the recent frame times
+        void updateGraph();
+        // Overridden draw method to draw the overlay to the RenderTarget
+        virtual void draw(sf::RenderTarget& renderTarget, sf::RenderStates renderStates) const;
+
+        // Profiler whose frame is running, null between frames
+        static FrameProfiler* running;
+
+        FrameRecord current;
+        Clock::time_point frame_start;
+        // Time the pending mouse release was read, valid while input_pending is set
+        Clock::time_point input_start;
+        bool input_pending = false;
+        // Ring of the recent frames, frame_count in total so far
+        std::vector<FrameRecord> history;
+        std::uint64_t frame_count = 0;
+        std::ofstream log;
+
+        bool overlay_visible = false;
+        sf::RectangleShape background;
+        sf::VertexArray text;
+        sf::VertexArray graph;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef GAME_INDEX_HPP
+#define GAME_INDEX_HPP
+
+#include "binary_file.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Index of the positions reached in a collection of games, answering which games
+// reached a position from its Zobrist key. An index file has a 64 byte header (magic,
+// version, entry count, game count, block count) followed by the entries sorted by
+// key and game, only the first time a game reaches a position being kept, and then a
+// search tree over the first key of every block of entries in Eytzinger (breadth-first)
+// order. Entries and tree nodes are stored as the little-endian layout of the structs,
+// so a mapped file is searched in place.
+
+struct GameIndexEntry {
+    std::uint64_t key = 0;
+    // Number of the game in input order starting at 0
+    std::uint32_t game = 0;
+    // Half-moves played before the position was reached
+    std::uint16_t ply = 0;
+    std::uint16_t reserved = 0;
+};
+
+// Memory-mapped index file
+class GameIndex {
+    public:
+        // Entries of one key, pointing into the index
+        struct Range {
+            const GameIndexEntry* first = nullptr;
+            const GameIndexEntry* last = nullptr;
+
+            const GameIndexEntry* begin() const { return first; }
+            const GameIndexEntry* end() const { return last; }
+            std::size_t size() const { return static_cast<std::size_t>(last - first); }
+            bool empty() const { return first == last; }
+        };
+
+        // Entries per block of the search tree
+        static constexpr std::size_t block_size = 64;
+
+        GameIndex() = default;
+        GameIndex(const GameIndex&) = delete;
+        GameIndex& operator=(const GameIndex&) = delete;
+
+        // Method used to open an index file, errors are printed
+        bool open(const std::string& path);
+        std::uint64_t size() const { return entry_count; }
+        std::uint64_t games() const { return game_count; }
+        // Method used to find the games which reached the position with the given key,
+        // searching the tree and then the entries of at most two blocks without allocating
+        Range find(std::uint64_t key) const;
+
+        // Function used to sort runs of entries on a pool of threads, then merge them and
+        // write them as an index file. The runs are emptied, errors are printed
+        static bool write(const std::string& path, std::vector<std::vector<GameIndexEntry>>& runs,
+                          std::uint64_t games, int threads);
+
+    private:
+        struct Node {
+            std::uint64_t key;
+            std::uint64_t block;
+        };
+
+        void close();
+
+        const GameIndexEntry* entries = nullptr;
+        std::uint64_t entry_count = 0;
+        std::uint64_t game_count = 0;
+        // Nodes 1 to block_count, node k has the children 2k and 2k + 1
+        const Node* tree = nullptr;
+        std::uint64_t block_count = 0;
+        MappedFile file;
+};
+
+#endif
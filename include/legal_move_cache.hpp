@@ -0,0 +1,71 @@
+#ifndef LEGAL_MOVE_CACHE_HPP
+#define LEGAL_MOVE_CACHE_HPP
+
+#include "piece.hpp"
+#include "move.hpp"
+#include "position.hpp"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Legal moves of the side to move maintained incrementally from one position to
+// the next. The moves of every piece are cached per color together with the
+// squares the piece can reach, and after a move only the pieces whose reach
+// touches a changed square or which stand on a line of their king crossing a
+// changed square are regenerated. Everything is regenerated while in check or
+// after a king move. The changed squares are the ones the position records in
+// makeMove and undoMove, and loading a position changes every square, so a cache
+// must follow a single position and be the only caller of takeChangedSquares.
+// The king is always regenerated as its moves and castling depend on the attacks
+// of every enemy piece.
+class LegalMoveCache {
+    public:
+        // Method used to bring the legal moves of the side to move up to date with the position
+        void update(Position& position);
+        // Method used to drop the cached moves so that the next update regenerates everything
+        void clear();
+        // Legal moves of the side to move in the same order as Position::generateMoves
+        const std::vector<Move>& moves() const { return legal_moves; }
+        // In verification mode every update is compared against a full regeneration,
+        // a mismatch is reported on std::cerr and the regenerated moves are used
+        void setVerification(bool enabled) { verification = enabled; }
+        bool verifying() const { return verification; }
+        // Number of pieces whose moves were regenerated by the last update
+        int regeneratedPieces() const { return regenerated_pieces; }
+        // Number of mismatches found in verification mode so far
+        int mismatches() const { return mismatch_count; }
+
+    private:
+        // Most legal moves of a single piece, those of a queen in the middle of an empty board
+        static constexpr int max_piece_moves = 27;
+
+        // Cached moves of one color and the state of the position they were generated in
+        struct SideCache {
+            bool valid = false;
+            bool in_check = false;
+            int king_square = -1;
+            // Squares changed since the moves of this color were last brought up to date
+            std::uint64_t changed = 0;
+            // Squares (bit file * 8 + rank) of the pieces with cached moves
+            std::uint64_t pieces = 0;
+            // Moves of the piece on every square, max_piece_moves slots per square
+            std::vector<Move> piece_moves = std::vector<Move>(64 * max_piece_moves);
+            std::array<std::uint8_t, 64> move_counts{};
+            // Squares the piece on every square can reach
+            std::array<std::uint64_t, 64> reach{};
+        };
+
+        // Method used to regenerate the moves of the piece on the square of the side cache
+        void regenerate(Position& position, SideCache& cache, int square_index);
+        // Method used to compare the cached moves with a full regeneration
+        void verify(Position& position);
+
+        std::array<SideCache, 2> caches;
+        std::vector<Move> legal_moves;
+        MoveList generated_moves;
+        bool verification = false;
+        int regenerated_pieces = 0;
+        int mismatch_count = 0;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef MATE_SOLVER_HPP
+#define MATE_SOLVER_HPP
+
+#include "position.hpp"
+#include "move.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Limits for a mate search, a node limit of 0 means no limit
+struct MateLimits {
+    // Longest mate searched for, in moves of the side to move
+    int moves = 5;
+    std::uint64_t nodes = 0;
+};
+
+enum class MateStatus {
+    // A mate was proven
+    Mate,
+    // It was proven that there is no mate within the move limit
+    NoMate,
+    // The node limit was reached first
+    Unknown
+};
+
+// Result of a mate search
+struct MateResult {
+    MateStatus status = MateStatus::Unknown;
+    // Number of moves until mate, the shortest mate for the side to move
+    int moves = 0;
+    // Mating line, the fastest mating moves against the longest defence
+    std::vector<Move> line;
+    // Other moves of the side to move which mate as fast as the key move
+    std::vector<Move> alternatives;
+    // False if the node limit was reached while looking for alternatives
+    bool alternatives_complete = false;
+    std::uint64_t nodes = 0;
+
+    Move keyMove() const { return line.empty() ? Move() : line.front(); }
+    // Returns true for a mate whose key move is the only one mating as fast
+    bool unique() const { return status == MateStatus::Mate && alternatives_complete && alternatives.empty(); }
+};
+
+// Depth-first proof-number (df-pn) search for forced mates by the side to move.
+// Nodes where the attacker moves are OR nodes and nodes where the defender moves
+// are AND nodes; every node is bounded by the number of half-moves left so that
+// the search proves mates within a given length and cannot loop. Proof and
+// disproof numbers are kept in a fixed size hash table, where a proof holds for
+// any larger bound and a disproof for any smaller one. The shortest mate is found
+// by raising the bound one move at a time. Owned by a single thread.
+class MateSolver {
+    public:
+        explicit MateSolver(std::size_t megabytes = 16);
+
+        // Method used to resize the table, clearing all entries
+        void resize(std::size_t megabytes);
+        // Method used to search for the shortest forced mate by the side to move and
+        // check whether the key move is the only one mating as fast
+        MateResult solve(const Position& root, const MateLimits& limits);
+
+    private:
+        struct Entry {
+            std::uint64_t key = 0;
+            std::uint32_t proof = 0;
+            std::uint32_t disproof = 0;
+            // Nodes searched below the entry, entries with less work are replaced first
+            std::uint32_t work = 0;
+            std::uint16_t generation = 0;
+            std::uint8_t depth = 0;
+        };
+
+        // Proof and disproof numbers of a node
+        struct Numbers {
+            std::uint32_t proof;
+            std::uint32_t disproof;
+        };
+
+        static constexpr std::size_t bucket_size = 4;
+
+        // Method used to run df-pn on the current position until its numbers reach the
+        // thresholds, which are given from the side to move's perspective (phi is the
+        // proof number at OR nodes and the disproof number at AND nodes)
+        void search(int depth, std::uint32_t phi_threshold, std::uint32_t delta_threshold);
+        // Method used to generate the moves of a node and evaluate it if it is terminal,
+        // returns false if it must be searched
+        bool evaluateTerminal(int depth, MoveList& moves, Numbers& numbers);
+        // Returns true if the current position is proven to be a mate within depth half-moves
+        bool prove(int depth);
+        // Returns the smallest number of half-moves proven to mate from the current position,
+        // trying the bounds of the right parity up to depth, or -1 if none is proven
+        int mateDepth(int depth);
+        // Method used to follow the fastest mate against the longest defence from the current position
+        std::vector<Move> mainLine(int depth);
+        Numbers lookup(std::uint64_t key, int depth) const;
+        void store(std::uint64_t key, int depth, const Numbers& numbers, std::uint64_t work);
+        bool attackerToMove() const { return position.activeColor() == attacker; }
+
+        Position position;
+        Piece::Color attacker = Piece::Color::White;
+        std::unique_ptr<Entry[]> table;
+        std::size_t bucket_count = 0;
+        // Entries from earlier solves are treated as empty
+        std::uint16_t generation = 0;
+        std::uint64_t node_count = 0;
+        std::uint64_t node_limit = 0;
+        bool aborted = false;
+};
+
+#endif
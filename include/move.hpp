@@ -1,25 +1,86 @@
 #ifndef MOVE_HPP
 #define MOVE_HPP
 
+#include "piece.hpp"
+#include <array>
+#include <cstddef>
+#include <string>
+
 struct Move {
-    int start_file;
-    int start_rank;
-    int target_file;
-    int target_rank;
+    int start_file = -1;
+    int start_rank = -1;
+    int target_file = -1;
+    int target_rank = -1;
+    // Piece a pawn is promoted to, None for every other move
+    Piece::Type promotion = Piece::Type::None;
+
+    Move() = default;
 
-    Move (int start_file, int start_rank, int target_file, int target_rank) :
+    Move (int start_file, int start_rank, int target_file, int target_rank,
+          Piece::Type promotion = Piece::Type::None) :
         start_file(start_file),
         start_rank(start_rank),
         target_file(target_file),
-        target_rank(target_rank)
+        target_rank(target_rank),
+        promotion(promotion)
     {}
 
     bool operator==(const Move& rhs) const {
         return (this->start_file == rhs.start_file
                 && this->start_rank == rhs.start_rank
                 && this->target_file == rhs.target_file
-                && this->target_rank == rhs.target_rank);
+                && this->target_rank == rhs.target_rank
+                && this->promotion == rhs.promotion);
+    }
+
+    bool operator!=(const Move& rhs) const {
+        return !(*this == rhs);
     }
+
+    // Returns false for a default constructed (null) move
+    bool isValid() const {
+        return start_file != -1;
+    }
+
+    // Returns the move in long algebraic notation as used by UCI e.g. "e2e4", "e7e8q"
+    // Ranks are stored in decending order so rank index 0 is the 8th rank
+    std::string toString() const {
+        if (!isValid()) {
+            return "0000";
+        }
+        std::string result{static_cast<char>('a' + start_file),
+                           static_cast<char>('8' - start_rank),
+                           static_cast<char>('a' + target_file),
+                           static_cast<char>('8' - target_rank)};
+        switch (promotion) {
+            case Piece::Type::Queen:  result += 'q'; break;
+            case Piece::Type::Rook:   result += 'r'; break;
+            case Piece::Type::Bishop: result += 'b'; break;
+            case Piece::Type::Knight: result += 'n'; break;
+            default: break;
+        }
+        return result;
+    }
+};
+
+// Fixed capacity list of moves used by move generation so that searching
+// never has to allocate. 256 is above the maximum of 218 legal moves in any position.
+struct MoveList {
+    std::array<Move, 256> moves;
+    std::size_t count = 0;
+
+    void push_back(const Move& move) { moves[count++] = move; }
+    void clear() { count = 0; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    Move& operator[](std::size_t i) { return moves[i]; }
+    const Move& operator[](std::size_t i) const { return moves[i]; }
+
+    Move* begin() { return moves.data(); }
+    Move* end() { return moves.data() + count; }
+    const Move* begin() const { return moves.data(); }
+    const Move* end() const { return moves.data() + count; }
 };
 
 #endif
@@ -0,0 +1,55 @@
+#ifndef MOVE_COUNTER_HPP
+#define MOVE_COUNTER_HPP
+
+#include "packed_position.hpp"
+#include "position.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Legal move counting for many positions at once, for dataset statistics and
+// perft-style jobs which only need the number of moves and not the moves. The
+// positions of a batch are stored as bitboards (bit file * 8 + rank like the
+// board) in structure-of-arrays layout, and every count is worked out set-wise
+// for all the pieces of a kind at once: attack maps by shifting and Kogge-Stone
+// fills, pins and check evasions as masks and the moves as population counts.
+// Without any branches on the position, the same code runs on one position per
+// 64 bit word or, with AVX2, on four positions per instruction.
+
+// Positions in structure-of-arrays layout. Every position is stored from the side
+// to move's perspective: the board of a position with black to move is mirrored
+// vertically so that the side to move always moves towards rank index 0.
+class PositionBatch {
+    public:
+        // Bitboards of the pieces of the side to move and of the other side, indexed by type - 1
+        std::array<std::vector<std::uint64_t>, 6> ours;
+        std::array<std::vector<std::uint64_t>, 6> theirs;
+        // Bit 0 black to move, bits 1-2 castling rights of the side to move (king side,
+        // queen side), bits 3-4 those of the other side, bits 8-11 en passant file + 1
+        std::vector<std::uint64_t> state;
+
+        std::size_t size() const { return state.size(); }
+        void clear();
+        void reserve(std::size_t count);
+        // Methods used to append a position, returns false if a packed position is invalid
+        void add(const Position& position);
+        bool add(const PackedPosition& packed);
+};
+
+// Results of a batch, one entry per position
+struct MoveCounts {
+    std::vector<std::uint16_t> legal_moves;
+    std::vector<std::uint8_t> in_check;
+    // Squares attacked by the side not to move, on the board as it is (not mirrored). The
+    // king of the side to move does not block the lines of sliders, as for its own moves
+    std::vector<std::uint64_t> attacked;
+};
+
+// Returns true if the processor runs the AVX2 version
+bool simdMoveCountingAvailable();
+// Function used to count the legal moves of every position of the batch, with AVX2
+// if available unless use_simd is false
+void countMoves(const PositionBatch& batch, MoveCounts& counts, bool use_simd = true);
+
+#endif
@@ -0,0 +1,269 @@
+#ifndef MOVE_COUNTER_KERNEL_HPP
+#define MOVE_COUNTER_KERNEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Set-wise legal move counting shared by the translation units of the move counter,
+// written once for any type of lanes with the bitwise operators, +, - and the
+// functions shiftLeft, shiftRight, isZero, bitCounts and totalCount. The scalar
+// lanes are 64 bit words, the AVX2 translation unit defines 4 x 64 bit lanes before
+// including this header. As the translation units are compiled for different
+// instruction sets, everything except the plain structure below has internal
+// linkage so that the linker never mixes their copies. Only for the move counter.
+
+// A range of a batch and its results as raw pointers, so that no standard library
+// code is instantiated in the AVX2 translation unit
+struct MoveCounterLanes {
+    const std::uint64_t* ours[6];
+    const std::uint64_t* theirs[6];
+    const std::uint64_t* state;
+    std::uint16_t* legal_moves;
+    std::uint8_t* in_check;
+    std::uint64_t* attacked;
+};
+
+// Function used to count the moves of the positions of the lanes in blocks of four with AVX2,
+// returns the number of positions counted (a multiple of four)
+std::size_t countMovesAvx2(const MoveCounterLanes& lanes, std::size_t count);
+
+namespace {
+    constexpr std::uint64_t rank_0 = 0x0101010101010101ULL;
+
+    template <int N>
+    std::uint64_t shiftLeft(std::uint64_t bits) {
+        return bits << N;
+    }
+
+    template <int N>
+    std::uint64_t shiftRight(std::uint64_t bits) {
+        return bits >> N;
+    }
+
+    // Returns all bits set if there are none and no bits otherwise
+    inline std::uint64_t isZero(std::uint64_t bits) {
+        return (bits == 0) ? ~0ULL : 0;
+    }
+
+    // Returns the number of bits set in every byte, partial counts are added up to
+    // 255 per byte before totalCount adds the bytes together
+    inline std::uint64_t bitCounts(std::uint64_t bits) {
+        bits = bits - ((bits >> 1) & 0x5555555555555555ULL);
+        bits = (bits & 0x3333333333333333ULL) + ((bits >> 2) & 0x3333333333333333ULL);
+        return (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    }
+
+    inline std::uint64_t totalCount(std::uint64_t counts) {
+        counts = (counts & 0x00ff00ff00ff00ffULL) + ((counts >> 8) & 0x00ff00ff00ff00ffULL);
+        counts = counts + (counts >> 16);
+        return (counts + (counts >> 32)) & 0xffff;
+    }
+
+    template <typename V>
+    struct LaneTraits;
+
+    template <>
+    struct LaneTraits<std::uint64_t> {
+        static constexpr std::size_t width = 1;
+
+        static std::uint64_t load(const std::uint64_t* words) { return *words; }
+        static void store(std::uint64_t lanes, std::uint64_t* words) { *words = lanes; }
+    };
+
+    // Squares a step changing the rank by rank_step may land on, those reached by
+    // wrapping around from one file to the next are excluded
+    constexpr std::uint64_t landingSquares(int rank_step) {
+        std::uint64_t squares = ~0ULL;
+        for (int rank = 0; rank < rank_step; rank++) {
+            squares &= ~(rank_0 << rank);
+        }
+        for (int rank = 7; rank > 7 + rank_step; rank--) {
+            squares &= ~(rank_0 << rank);
+        }
+        return squares;
+    }
+
+    template <int Offset, typename V>
+    V shiftBy(V bits) {
+        if constexpr (Offset >= 0) {
+            return shiftLeft<Offset>(bits);
+        } else {
+            return shiftRight<-Offset>(bits);
+        }
+    }
+
+    // Function used to move every bit by File files and Rank ranks
+    template <int File, int Rank, typename V>
+    V step(V bits) {
+        V moved = shiftBy<8 * File + Rank>(bits);
+        if constexpr (Rank == 0) {
+            return moved;
+        } else {
+            return moved & landingSquares(Rank);
+        }
+    }
+
+    // Function used to get the squares attacked by the sliders in one direction, up to
+    // and including the first occupied square (Kogge-Stone occluded fill)
+    template <int File, int Rank, typename V>
+    V slide(V sliders, V empty) {
+        constexpr int offset = 8 * File + Rank;
+        V propagators = empty & landingSquares(Rank);
+        sliders = sliders | (propagators & shiftBy<offset>(sliders));
+        propagators = propagators & shiftBy<offset>(propagators);
+        sliders = sliders | (propagators & shiftBy<2 * offset>(sliders));
+        propagators = propagators & shiftBy<2 * offset>(propagators);
+        sliders = sliders | (propagators & shiftBy<4 * offset>(sliders));
+        return step<File, Rank>(sliders);
+    }
+
+    template <typename V>
+    V kingAttacks(V kings) {
+        return step<1, 0>(kings) | step<-1, 0>(kings) | step<0, 1>(kings) | step<0, -1>(kings)
+               | step<1, 1>(kings) | step<1, -1>(kings) | step<-1, 1>(kings) | step<-1, -1>(kings);
+    }
+
+    template <typename V>
+    V knightAttacks(V knights) {
+        return step<1, 2>(knights) | step<1, -2>(knights) | step<-1, 2>(knights) | step<-1, -2>(knights)
+               | step<2, 1>(knights) | step<2, -1>(knights) | step<-2, 1>(knights) | step<-2, -1>(knights);
+    }
+
+    // Squares attacked by the sliders of the other side in all directions
+    template <typename V>
+    V sliderAttacks(V straight, V diagonal, V empty) {
+        return slide<0, 1>(straight, empty) | slide<0, -1>(straight, empty)
+               | slide<1, 0>(straight, empty) | slide<-1, 0>(straight, empty)
+               | slide<1, 1>(diagonal, empty) | slide<-1, -1>(diagonal, empty)
+               | slide<1, -1>(diagonal, empty) | slide<-1, 1>(diagonal, empty);
+    }
+
+    // Function used to mirror the board vertically, reversing the ranks of every file
+    template <typename V>
+    V mirrorRanks(V bits) {
+        bits = (shiftRight<1>(bits) & 0x5555555555555555ULL) | shiftLeft<1>(bits & 0x5555555555555555ULL);
+        bits = (shiftRight<2>(bits) & 0x3333333333333333ULL) | shiftLeft<2>(bits & 0x3333333333333333ULL);
+        return (shiftRight<4>(bits) & 0x0f0f0f0f0f0f0f0fULL) | shiftLeft<4>(bits & 0x0f0f0f0f0f0f0f0fULL);
+    }
+
+    // Checks and pins along the two directions of a line through the king
+    template <int File, int Rank, typename V>
+    void checkLine(V king, V empty, V us, V sliders, V& checkers, V& check_lines, V& pinned) {
+        V ray = slide<File, Rank>(king, empty);
+        V opposite_ray = slide<-File, -Rank>(king, empty);
+        V checker = ray & sliders;
+        V opposite_checker = opposite_ray & sliders;
+        checkers = checkers | checker | opposite_checker;
+        check_lines = check_lines | (ray & ~isZero(checker)) | (opposite_ray & ~isZero(opposite_checker));
+        // A piece of ours is pinned if it is the first piece seen both from the king and from a slider
+        pinned = (ray & us & slide<-File, -Rank>(sliders, empty)) | (opposite_ray & us & slide<File, Rank>(sliders, empty));
+    }
+
+    // Function used to add the moves of the sliders that may move along a line, in both directions
+    template <int File, int Rank, typename V>
+    V lineMoves(V sliders, V empty, V targets) {
+        return bitCounts(slide<File, Rank>(sliders, empty) & targets)
+               + bitCounts(slide<-File, -Rank>(sliders, empty) & targets);
+    }
+
+    // Function used to count the legal moves of the side to move, which moves towards rank
+    // index 0 and castles on rank index 7. En passant captures are not counted
+    template <typename V>
+    void countLegalMoves(const V (&ours)[6], const V (&theirs)[6], V state, V& legal_moves, V& in_check,
+                         V& attacked) {
+        V king = ours[0];
+        V pawns = ours[1];
+        V knights = ours[2];
+        V our_straight = ours[4] | ours[5];
+        V our_diagonal = ours[3] | ours[5];
+        V their_straight = theirs[4] | theirs[5];
+        V their_diagonal = theirs[3] | theirs[5];
+        V us = king | pawns | knights | ours[3] | our_straight;
+        V them = theirs[0] | theirs[1] | theirs[2] | theirs[3] | their_straight;
+        V occupied = us | them;
+        V empty = ~occupied;
+
+        // The king does not block the lines of the sliders so that it cannot step back along a checking line
+        attacked = kingAttacks(theirs[0]) | knightAttacks(theirs[2])
+                   | step<1, 1>(theirs[1]) | step<-1, 1>(theirs[1])
+                   | sliderAttacks(their_straight, their_diagonal, empty | king);
+
+        V checkers = (knightAttacks(king) & theirs[2]) | ((step<1, -1>(king) | step<-1, -1>(king)) & theirs[1]);
+        V check_lines = checkers & 0;
+        V pinned_file, pinned_rank, pinned_rising, pinned_falling;
+        checkLine<0, 1>(king, empty, us, their_straight, checkers, check_lines, pinned_file);
+        checkLine<1, 0>(king, empty, us, their_straight, checkers, check_lines, pinned_rank);
+        checkLine<1, 1>(king, empty, us, their_diagonal, checkers, check_lines, pinned_rising);
+        checkLine<1, -1>(king, empty, us, their_diagonal, checkers, check_lines, pinned_falling);
+        V pinned = pinned_file | pinned_rank | pinned_rising | pinned_falling;
+        V not_in_check = isZero(checkers);
+        in_check = ~not_in_check;
+        // Without check every square not of ours is a target, in check only blocking or
+        // capturing the checker and in double check nothing but king moves
+        V targets = ~us & (not_in_check | check_lines | checkers) & isZero(checkers & (checkers - 1));
+
+        // Pinned pieces may only move along the line of their pin
+        V counts = lineMoves<0, 1>(our_straight & (~pinned | pinned_file), empty, targets)
+                   + lineMoves<1, 0>(our_straight & (~pinned | pinned_rank), empty, targets)
+                   + lineMoves<1, 1>(our_diagonal & (~pinned | pinned_rising), empty, targets)
+                   + lineMoves<1, -1>(our_diagonal & (~pinned | pinned_falling), empty, targets);
+
+        V free_knights = knights & ~pinned;
+        counts = counts + bitCounts(step<1, 2>(free_knights) & targets) + bitCounts(step<1, -2>(free_knights) & targets)
+                 + bitCounts(step<-1, 2>(free_knights) & targets) + bitCounts(step<-1, -2>(free_knights) & targets)
+                 + bitCounts(step<2, 1>(free_knights) & targets) + bitCounts(step<2, -1>(free_knights) & targets)
+                 + bitCounts(step<-2, 1>(free_knights) & targets) + bitCounts(step<-2, -1>(free_knights) & targets);
+
+        // Pawns, a move to rank index 0 counts once for every promotion piece
+        V pushed = step<0, -1>(pawns & (~pinned | pinned_file)) & empty;
+        V double_pushed = step<0, -1>(pushed & (rank_0 << 5)) & empty & targets;
+        pushed = pushed & targets;
+        V left = step<-1, -1>(pawns & (~pinned | pinned_rising)) & them & targets;
+        V right = step<1, -1>(pawns & (~pinned | pinned_falling)) & them & targets;
+        counts = counts + bitCounts(pushed & ~rank_0) + bitCounts(double_pushed)
+                 + bitCounts(left & ~rank_0) + bitCounts(right & ~rank_0)
+                 + shiftLeft<2>(bitCounts(pushed & rank_0) + bitCounts(left & rank_0) + bitCounts(right & rank_0));
+
+        // King moves and castling, the king may not leave, pass or land on an attacked square
+        counts = counts + bitCounts(kingAttacks(king) & ~us & ~attacked);
+        constexpr std::uint64_t e_square = 1ULL << 39;
+        V castling_king = ~isZero(king & e_square) & isZero(attacked & e_square);
+        V king_side = ~isZero(state & 2) & castling_king & ~isZero(ours[4] & (1ULL << 63))
+                      & isZero(occupied & ((1ULL << 47) | (1ULL << 55))) & isZero(attacked & ((1ULL << 47) | (1ULL << 55)));
+        V queen_side = ~isZero(state & 4) & castling_king & ~isZero(ours[4] & (1ULL << 7))
+                       & isZero(occupied & ((1ULL << 15) | (1ULL << 23) | (1ULL << 31)))
+                       & isZero(attacked & ((1ULL << 23) | (1ULL << 31)));
+        legal_moves = totalCount(counts + (king_side & 1) + (queen_side & 1));
+
+        // The attacks of a position with black to move are returned on the board as it is
+        V black = ~isZero(state & 1);
+        attacked = (black & mirrorRanks(attacked)) | (~black & attacked);
+    }
+
+    // Function used to count the moves of the positions from begin to end, width at a time
+    template <typename V>
+    std::size_t countLanes(const MoveCounterLanes& lanes, std::size_t begin, std::size_t end) {
+        constexpr std::size_t width = LaneTraits<V>::width;
+        std::size_t index = begin;
+        for (; index + width <= end; index += width) {
+            V ours[6], theirs[6];
+            for (int type = 0; type < 6; type++) {
+                ours[type] = LaneTraits<V>::load(lanes.ours[type] + index);
+                theirs[type] = LaneTraits<V>::load(lanes.theirs[type] + index);
+            }
+            V legal_moves, in_check, attacked;
+            countLegalMoves(ours, theirs, LaneTraits<V>::load(lanes.state + index), legal_moves, in_check, attacked);
+            std::uint64_t moves[width], checks[width];
+            LaneTraits<V>::store(legal_moves, moves);
+            LaneTraits<V>::store(in_check, checks);
+            LaneTraits<V>::store(attacked, lanes.attacked + index);
+            for (std::size_t lane = 0; lane < width; lane++) {
+                lanes.legal_moves[index + lane] = static_cast<std::uint16_t>(moves[lane]);
+                lanes.in_check[index + lane] = static_cast<std::uint8_t>(checks[lane] & 1);
+            }
+        }
+        return index;
+    }
+}
+
+#endif
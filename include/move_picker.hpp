@@ -0,0 +1,54 @@
+#ifndef MOVE_PICKER_HPP
+#define MOVE_PICKER_HPP
+
+#include "position.hpp"
+#include "move.hpp"
+#include <array>
+
+// Scores of quiet moves that caused a beta cutoff indexed by [color][from square][to square]
+// where a square is file * 8 + rank
+using HistoryTable = std::array<std::array<std::array<int, 64>, 64>, 2>;
+// Quiet moves that caused a beta cutoff at a ply
+using KillerMoves = std::array<Move, 2>;
+
+// Hands out the legal moves of a position one at a time in the order most likely to
+// cause a cutoff: the hash move, captures and promotions by MVV-LVA, the killer moves
+// and then the remaining quiet moves by history score. Every stage is only generated
+// once the previous one is exhausted, so a cutoff skips generating the later stages.
+class MovePicker {
+    public:
+        MovePicker(Position& position, const Move& hash_move, const KillerMoves& killers,
+                   const HistoryTable& history);
+        // Constructor used by the quiescence search, only hands out captures and promotions
+        explicit MovePicker(Position& position);
+
+        // Method used to get the next move, returns a null move once every move was picked
+        Move next();
+
+    private:
+        enum class Stage {
+            HashMove, GenerateNoisy, Noisy, Killers, GenerateQuiet, Quiet, Done
+        };
+
+        // Method used to score the generated moves of the current stage
+        void scoreNoisy();
+        void scoreQuiet();
+        // Method used to move the best scored remaining move to the front and return it
+        Move pickBest();
+        // Returns true if the move was already handed out by an earlier stage
+        bool alreadyPicked(const Move& move) const;
+
+        Position& position;
+        Move hash_move;
+        // Null for a picker of noisy moves only
+        const KillerMoves* killers = nullptr;
+        const HistoryTable* history = nullptr;
+        Stage stage = Stage::HashMove;
+        // Moves and scores of the current stage, the moves before index were already picked
+        MoveList moves;
+        std::array<int, 256> scores;
+        std::size_t index = 0;
+        std::size_t killer_index = 0;
+};
+
+#endif
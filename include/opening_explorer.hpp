@@ -0,0 +1,107 @@
+#ifndef OPENING_EXPLORER_HPP
+#define OPENING_EXPLORER_HPP
+
+#include "binary_file.hpp"
+#include "move.hpp"
+#include "pgn.hpp"
+#include "position.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Opening tree of a game collection: for every position reached in the first plies
+// of the games, the moves played from it with their game counts, results and the
+// average rating of the players. An explorer file has a 64 byte header (magic,
+// version, entry count, game count) followed by one 32 byte entry per position and
+// move, sorted by the position's Zobrist key and then by decreasing game count, so
+// the moves of a position are contiguous and most played first. Entries are stored
+// as the little-endian layout of the struct, so a mapped file is searched in place.
+
+// Statistics of a move played from a position
+struct ExplorerMove {
+    Move move;
+    std::uint32_t games = 0;
+    // Results from White's perspective, games without a result are only counted in games
+    std::uint32_t white_wins = 0;
+    std::uint32_t draws = 0;
+    std::uint32_t black_wins = 0;
+    // Average rating of the players of the games where both are rated, 0 if there are none
+    int average_rating = 0;
+};
+
+// Memory-mapped explorer file
+class OpeningExplorer {
+    public:
+        OpeningExplorer() = default;
+        OpeningExplorer(const OpeningExplorer&) = delete;
+        OpeningExplorer& operator=(const OpeningExplorer&) = delete;
+
+        // Method used to open an explorer file, errors are printed
+        bool open(const std::string& path);
+        std::uint64_t size() const { return entry_count; }
+        std::uint64_t games() const { return game_count; }
+        // Method used to get the moves played from the position with the given key, most
+        // played first. The list is cleared first and keeps its capacity between lookups
+        void lookup(std::uint64_t key, std::vector<ExplorerMove>& moves) const;
+
+    private:
+        friend class OpeningExplorerBuilder;
+        struct Entry;
+
+        void close();
+
+        const Entry* entries = nullptr;
+        std::uint64_t entry_count = 0;
+        std::uint64_t game_count = 0;
+        MappedFile file;
+};
+
+// Accumulator of the moves of games. Every thread of a build adds its games to its
+// own builder, without locking, and the builders are merged before writing.
+class OpeningExplorerBuilder {
+    public:
+        // Constructor, only the first max_plies half-moves of every game are counted
+        explicit OpeningExplorerBuilder(int max_plies) : max_plies(max_plies) {}
+
+        // Method used to count the moves of a game, returns false if the start position or a
+        // move is invalid, the moves before it are counted
+        bool addGame(const PgnGame& game, Position& position);
+        // Method used to add the counts of another builder, which is emptied
+        void merge(OpeningExplorerBuilder& other);
+        // Method used to write the moves played in at least min_games games, errors are printed
+        bool write(const std::string& path, std::uint32_t min_games) const;
+        // Number of games added and of distinct position and move pairs
+        std::uint64_t games() const { return game_count; }
+        std::size_t size() const { return stats.size(); }
+
+    private:
+        struct Key {
+            std::uint64_t position;
+            std::uint16_t move;
+
+            bool operator==(const Key& rhs) const { return position == rhs.position && move == rhs.move; }
+        };
+
+        struct KeyHash {
+            std::size_t operator()(const Key& key) const {
+                return static_cast<std::size_t>(key.position ^ (std::uint64_t(key.move) * 0x9e3779b97f4a7c15ULL));
+            }
+        };
+
+        struct Stats {
+            std::uint32_t games = 0;
+            std::uint32_t white_wins = 0;
+            std::uint32_t draws = 0;
+            std::uint32_t black_wins = 0;
+            std::uint32_t rated_games = 0;
+            std::uint64_t rating_sum = 0;
+        };
+
+        int max_plies;
+        std::uint64_t game_count = 0;
+        std::unordered_map<Key, Stats, KeyHash> stats;
+};
+
+#endif
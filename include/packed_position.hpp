@@ -0,0 +1,106 @@
+#ifndef PACKED_POSITION_HPP
+#define PACKED_POSITION_HPP
+
+#include "binary_file.hpp"
+#include "move.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Fixed size binary encoding of a position for large datasets, 32 bytes instead of
+// the 60-90 bytes of a FEN. All multi-byte fields are little-endian.
+//
+//     bytes  0-7   occupancy, bit file * 8 + rank set for every occupied square
+//     bytes  8-23  4 bits per piece in occupancy order, low nibble first,
+//                  the piece type with bit 3 set for black pieces
+//     byte   24    bit 0 black to move, bits 1-4 castling rights KQkq
+//     byte   25    en passant file + 1, 0 if there is no en passant target square
+//     byte   26    halfmove clock (at most 255)
+//     bytes 27-28  fullmove number (at most 65535)
+//     bytes 29-31  reserved, zero
+struct PackedPosition {
+    std::array<std::uint8_t, 32> bytes{};
+};
+
+// A packed position with the optional annotations of a dataset record
+struct PackedRecord {
+    // Score and result values meaning the annotation is missing
+    static constexpr std::int16_t no_score = INT16_MIN;
+    static constexpr std::int8_t no_result = INT8_MIN;
+
+    PackedPosition position;
+    // Score in centipawns from the side to move's perspective
+    std::int16_t score = no_score;
+    // Game result from white's perspective: 1 white won, 0 draw, -1 black won
+    std::int8_t result = no_result;
+    Move best_move;
+};
+
+// Size of a record in a file without and with annotations. An annotation is stored
+// after the position as the score (2 bytes), the best move (2 bytes: start square,
+// target square and promotion type in bits 0-5, 6-11 and 12-14, 0 for none),
+// the result (1 byte) and 3 reserved bytes.
+inline constexpr std::size_t packed_position_size = 32;
+inline constexpr std::size_t packed_record_size = 40;
+
+// Files start with a 16 byte header: the magic, the format version (2 bytes)
+// and the record size (2 bytes), followed by 4 reserved bytes
+inline constexpr std::array<char, 8> packed_file_magic = {{'C', 'H', 'E', 'S', 'S', 'P', 'O', 'S'}};
+inline constexpr std::uint16_t packed_file_version = 1;
+inline constexpr std::size_t packed_header_size = 16;
+
+// Streaming writer of packed position files
+class PackedPositionWriter {
+    public:
+        // Constructor which creates the file, annotated files store a PackedRecord per position
+        PackedPositionWriter(const std::string& path, bool annotated);
+
+        // Returns false if the file could not be created or a write failed
+        bool isOpen() const { return static_cast<bool>(file); }
+        // Methods used to append a record, the annotations are dropped in a file without them
+        bool write(const PackedRecord& record);
+        bool write(const PackedPosition& position);
+        // Method used to flush and close the file, returns false if a write failed
+        bool close();
+        std::size_t count() const { return record_count; }
+
+    private:
+        std::ofstream file;
+        bool annotated;
+        std::size_t record_count = 0;
+};
+
+// Reader of packed position files. On POSIX systems the file is memory-mapped, so
+// multi-gigabyte files are paged in on demand and records can be read in any order,
+// elsewhere the records are read from a stream.
+class PackedPositionReader {
+    public:
+        // Constructor which opens the file and validates the header, errors are printed
+        explicit PackedPositionReader(const std::string& path);
+        PackedPositionReader(const PackedPositionReader&) = delete;
+        PackedPositionReader& operator=(const PackedPositionReader&) = delete;
+
+        bool isOpen() const { return open; }
+        bool annotated() const { return record_size == packed_record_size; }
+        // Number of records in the file
+        std::size_t size() const { return record_count; }
+        // Method used to read the record at the given index, returns false if out of range
+        bool read(std::size_t index, PackedRecord& record);
+        // Method used to read the records in order, returns false at the end of the file
+        bool next(PackedRecord& record) { return read(next_index++, record); }
+
+    private:
+        bool open = false;
+        std::size_t record_size = 0;
+        std::size_t record_count = 0;
+        std::size_t next_index = 0;
+        // Mapped file, closed if the file is read as a stream
+        MappedFile mapping;
+        std::ifstream stream;
+        std::vector<std::uint8_t> buffer;
+};
+
+#endif
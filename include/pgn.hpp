@@ -0,0 +1,38 @@
+#ifndef PGN_HPP
+#define PGN_HPP
+
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+// A game of a PGN file
+struct PgnGame {
+    // Tag pairs e.g. "White" -> "Morphy, Paul", "FEN" -> the start position
+    std::map<std::string, std::string> tags;
+    // Moves of the main line in SAN, without move numbers, comments, variations and NAGs
+    std::vector<std::string> moves;
+    // Game termination marker: "1-0", "0-1", "1/2-1/2" or "*", empty if missing
+    std::string result;
+};
+
+// Reader splitting a PGN stream into the text of its games. A game ends where the
+// tag section of the next one starts, outside of comments.
+class PgnReader {
+    public:
+        explicit PgnReader(std::istream& input) : input(input) {}
+
+        // Method used to read the text of the next game, returns false at the end of the input
+        bool next(std::string& text);
+
+    private:
+        std::istream& input;
+        // First line of the next game, read while looking for the end of the previous one
+        std::string pending_line;
+        bool has_pending_line = false;
+};
+
+// Function used to parse the text of one game, returns false if it has neither tags nor moves
+bool parsePgnGame(const std::string& text, PgnGame& game);
+
+#endif
@@ -9,7 +9,8 @@ struct Piece {
         White = true, Black = false
     };
 
-    Piece() : type(None) {};
+    Piece() : type(None), color(White) {};
+    Piece(Type type, Color color) : type(type), color(color) {};
 
     Type type;
     Color color;
@@ -0,0 +1,175 @@
+#ifndef POSITION_HPP
+#define POSITION_HPP
+
+#include "piece.hpp"
+#include "move.hpp"
+#include "packed_position.hpp"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Logical chess position and the rules of the game. Has no dependency on SFML
+// so that it can be shared by the GUI, the engine and headless tools.
+class Position {
+    public:
+        // FEN of the standard starting position
+        static inline const std::string start_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+        // State needed to undo a move made with makeMove
+        struct UndoInfo {
+            Piece captured;
+            bool white_king_side_castle;
+            bool white_queen_side_castle;
+            bool black_king_side_castle;
+            bool black_queen_side_castle;
+            std::array<int, 2> en_passant;
+            int halfmove_clock;
+            std::uint64_t hash;
+        };
+
+        // Subset of the legal moves to generate, noisy moves are captures
+        // (including en passant) and promotions
+        enum class MoveFilter {
+            All, Noisy, Quiet
+        };
+
+        Position();
+
+        // Method load a board position using FEN, returns false if the FEN is invalid
+        bool loadPositionFromFEN(const std::string& fen);
+        // Method used to get the FEN of the current position
+        std::string toFEN() const;
+        // Method used to load a position from the packed binary format, returns false if it is invalid
+        bool loadPackedPosition(const PackedPosition& packed);
+        // Method used to get the position in the packed binary format, returns false
+        // if it cannot be packed because there are more than 32 pieces on the board
+        bool pack(PackedPosition& packed) const;
+        // Method used to generate the legal moves for the given color, all of them by default
+        void generateMoves(Piece::Color color, MoveList& moves, MoveFilter filter = MoveFilter::All);
+        // Method used to generate the legal moves of the piece on the given square
+        void generatePieceMoves(int file, int rank, MoveList& moves);
+        // Helper methods to generate legal moves for each piece type
+        void generatePawnMoves(int file, int rank, MoveList& moves);
+        void generateRookMoves(int start_file, int start_rank, MoveList& moves);
+        void generateBishopMoves(int start_file, int start_rank, MoveList& moves);
+        void generateKnightMoves(int start_file, int start_rank, MoveList& moves);
+        void generateKingMoves(int start_file, int start_rank, MoveList& moves);
+        // Method used to validate and add a move to the list of legal moves
+        void addMove(int start_file, int start_rank, int target_file, int target_rank, MoveList& moves);
+        // Method used to validate and add a pawn move to the last rank once for every promotion piece
+        void addPromotionMoves(int start_file, int start_rank, int target_file, int target_rank, MoveList& moves);
+        // Helper method used validate psuedo-legal moves
+        bool isValidLegalMove(int start_file, int start_rank, int target_file, int target_rank);
+        // Method used to determine if a color is currently in check
+        bool inCheck(Piece::Color color) const;
+        // Method used to determine if a square is attacked by a piece of the given color
+        bool isAttacked(int file, int rank, Piece::Color color) const;
+        // Method used to statically evaluate the exchange on the target square started by a
+        // capture, in centipawns from the moving side's perspective. Includes attackers
+        // behind other attackers (x-rays) but ignores pins and checks. A negative value
+        // means the move loses material, e.g. a piece on a square attacked by the
+        // opponent returns -(piece value) for a quiet move of the piece to that square.
+        int see(const Move& move) const;
+        // Methods used to make and undo a legal move, keeping the hash and history up to date
+        void makeMove(const Move& move, UndoInfo& undo);
+        void undoMove(const Move& move, const UndoInfo& undo);
+        // Method used to find the legal move matching a move in UCI notation
+        // Returns a null move if there is no such legal move
+        Move parseMove(const std::string& uci);
+        // Method used to get a legal move in standard algebraic notation e.g. "Nbd7", "exd6", "O-O", "e8=Q+"
+        std::string toSAN(const Move& move);
+        // Method used to find the legal move matching a move in standard algebraic notation,
+        // check and annotation symbols are ignored. Returns a null move if there is no such
+        // legal move or the notation matches more than one
+        Move parseSAN(const std::string& san);
+        // Returns true if the move is legal for the side to move, used to validate
+        // moves from other positions such as hash moves and killer moves
+        bool isLegal(const Move& move);
+        // Returns true if the move captures a piece (including en passant)
+        bool isCapture(const Move& move) const;
+        // Returns true if the move is a capture or a promotion
+        bool isNoisy(const Move& move) const { return move.promotion != Piece::Type::None || isCapture(move); }
+        // Returns true if the current position already occurred since the last irreversible move
+        bool isRepetition() const;
+        // Returns the number of earlier occurrences of the current position
+        int repetitionCount() const;
+        // Returns true if the game is drawn by the fifty-move rule
+        bool isFiftyMoveDraw() const { return halfmove_clock >= 100; }
+        // Returns true if neither side has enough material left to checkmate
+        bool isInsufficientMaterial() const;
+
+        const Piece& pieceAt(int file, int rank) const { return square[file][rank]; }
+        Piece::Color activeColor() const { return active_color; }
+        const std::array<int, 2>& enPassant() const { return en_passant; }
+        int halfmoveClock() const { return halfmove_clock; }
+        int fullmoveNumber() const { return fullmove_number; }
+        bool canCastle(Piece::Color color, bool king_side) const;
+        // Zobrist hash of the position
+        std::uint64_t hash() const { return zobrist_hash; }
+        // Method used to get the squares (bit file * 8 + rank) whose contents or en passant
+        // status changed since the last call, every square after a position is loaded
+        std::uint64_t takeChangedSquares() { return std::exchange(changed_squares, 0); }
+        // Method used to recompute the Zobrist hash from scratch
+        std::uint64_t computeHash() const;
+
+    protected:
+        // Method used to find the least valuable piece of the given color attacking a square,
+        // ignoring the pieces on the squares set in removed (bit file * 8 + rank).
+        // Returns its type and square or None if the square is not attacked
+        Piece::Type leastValuableAttacker(int file, int rank, Piece::Color color, std::uint64_t removed,
+                                          int& attacker_file, int& attacker_rank) const;
+
+        // Versions of the hot methods specialized for the side Us, the public methods
+        // dispatch on the runtime color once so pawn directions, ranks and castling
+        // squares are compile-time constants inside the loops
+        template <Piece::Color Us>
+        void generateMovesFor(MoveList& moves);
+        template <Piece::Color Us>
+        void generatePawnMovesFor(int file, int rank, MoveList& moves);
+        template <Piece::Color Us>
+        void generateKingMovesFor(int start_file, int start_rank, MoveList& moves);
+        template <Piece::Color Us>
+        bool isValidLegalMoveFor(int start_file, int start_rank, int target_file, int target_rank);
+        template <Piece::Color Us>
+        bool inCheckFor() const;
+        // Us is the side making the move, the side that made it for undoMoveFor
+        template <Piece::Color Us>
+        void makeMoveFor(const Move& move, UndoInfo& undo);
+        template <Piece::Color Us>
+        void undoMoveFor(const Move& move, const UndoInfo& undo);
+        // Returns true if the en passant target square is part of the hash, which is only
+        // when a pawn of the capturing side stands next to the pawn that moved two squares,
+        // so that the same position reached by other moves or loaded from a FEN without
+        // the target square has the same hash
+        bool hashesEnPassant(Piece::Color capturer) const;
+
+        // Number of files and ranks, as an int to compare with board coordinates
+        static constexpr int board_width = 8;
+        // Logical chess board structured as [file][rank]
+        // with the rank going in decending order i.e. 8 to 1
+        Piece square[board_width][board_width];
+        // Current color to move
+        Piece::Color active_color = Piece::Color::White;
+        // Booleans to keep track of castling availability;
+        bool white_king_side_castle = false;
+        bool white_queen_side_castle = false;
+        bool black_king_side_castle = false;
+        bool black_queen_side_castle = false;
+        // Contains the file and rank of an en passant target square
+        // (-1, -1) if there is none
+        std::array<int, 2> en_passant{{-1, -1}};
+        // Number of half-moves since the last capture or pawn move
+        int halfmove_clock = 0;
+        int fullmove_number = 1;
+        std::uint64_t zobrist_hash = 0;
+        // Squares changed by the moves made and undone since takeChangedSquares was last called
+        std::uint64_t changed_squares = ~0ULL;
+        // Hashes of every position since the position was loaded, used for repetition detection
+        std::vector<std::uint64_t> hash_history;
+        // Subset of moves accepted by addMove and addPromotionMoves during generation
+        MoveFilter move_filter = MoveFilter::All;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+
+#include "analysis_cache.hpp"
+#include "position.hpp"
+#include "move.hpp"
+#include "move_picker.hpp"
+#include "transposition_table.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Scores above mate_bound are mates, mate_score - ply for a mate in ply half-moves
+inline constexpr int mate_score = 32000;
+inline constexpr int mate_bound = mate_score - 1000;
+inline constexpr int infinite_score = mate_score + 1;
+inline constexpr int max_ply = 128;
+
+inline bool isMateScore(int score) {
+    return score > mate_bound || score < -mate_bound;
+}
+
+// Returns the number of moves until mate, negative if the side to move is getting mated
+inline int mateInMoves(int score) {
+    return (score > 0) ? (mate_score - score + 1) / 2 : -(mate_score + score) / 2;
+}
+
+// Limits for a search, a value of 0 (or -1 for clocks) means no limit
+struct SearchLimits {
+    int depth = 0;
+    std::uint64_t nodes = 0;
+    // Time limits in milliseconds
+    int movetime = 0;
+    int wtime = -1;
+    int btime = -1;
+    int winc = 0;
+    int binc = 0;
+    int movestogo = 0;
+    // Search until stopped
+    bool infinite = false;
+    // Search the position after the expected opponent move, the time limits only
+    // start counting once the ponder flag is cleared (ponderhit)
+    bool ponder = false;
+    // Number of best moves searched each with its own principal variation (multi-PV)
+    int multipv = 1;
+};
+
+// Result of a completed search iteration
+struct SearchInfo {
+    int depth = 0;
+    int score = 0;
+    std::uint64_t nodes = 0;
+    std::int64_t time_ms = 0;
+    std::vector<Move> pv;
+    // Rank of the line in a multi-PV search, 1 for the best move
+    int multipv = 1;
+
+    Move bestMove() const { return pv.empty() ? Move() : pv.front(); }
+    // Expected reply to the best move, a null move if the principal variation is too short
+    Move ponderMove() const { return (pv.size() > 1) ? pv[1] : Move(); }
+};
+
+// Iterative deepening alpha-beta search owned by a single thread. Several
+// searches can run in parallel on copies of the same position by sharing the
+// transposition table and stop flag.
+class Search {
+    public:
+        using InfoCallback = std::function<void(const SearchInfo&)>;
+
+        // ponder_flag is cleared by another thread once the expected move was played,
+        // it is only needed for ponder searches
+        Search(TranspositionTable& tt, std::atomic<bool>& stop_flag,
+               const std::atomic<bool>* ponder_flag = nullptr);
+
+        // Method used to search the position within the limits, calling on_info
+        // after every completed iteration, or every line of an iteration with multi-PV.
+        // Returns the last completed iteration of the best line, which stays valid
+        // until the next run and reuses its memory from run to run.
+        const SearchInfo& run(const Position& root, const SearchLimits& limits, const InfoCallback& on_info = {});
+        // Method used to consult and update an analysis cache kept across sessions, nullptr for none
+        void setAnalysisCache(AnalysisCache* cache) { this->cache = cache; }
+        // Number of nodes searched so far, safe to read from other threads
+        std::uint64_t nodes() const { return node_count.load(std::memory_order_relaxed); }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        // Method used to search a node, returning its score from the side to move's perspective
+        int alphaBeta(int depth, int ply, int alpha, int beta);
+        // Method used to resolve captures at the horizon so that only quiet positions are evaluated
+        int quiescence(int ply, int alpha, int beta);
+        // Method used to fill the principal variation of a node cut off by a stored exact score
+        // with the stored best moves, following them for at most depth plies
+        void storedPv(int ply, Move move, int depth);
+        // Method used to count a node and check the limits, returns true if the search must stop
+        bool visitNode();
+        // Method used to remember a quiet move that caused a beta cutoff
+        void updateQuietStats(const Move& move, int depth, int ply);
+        // Method used to set the stop flag once a node or time limit is reached
+        void checkLimits();
+        // Method used to work out the time budget for this move from the limits
+        void allocateTime(const SearchLimits& limits);
+        std::int64_t elapsed() const;
+        // Milliseconds since the time limits started counting
+        std::int64_t limitElapsed() const;
+        // Returns true while the search is pondering and its time limits do not apply
+        bool pondering();
+
+        Position position;
+        TranspositionTable& tt;
+        AnalysisCache* cache = nullptr;
+        std::atomic<bool>& stop_flag;
+        const std::atomic<bool>* ponder_flag;
+        // Whether the last check still found the search pondering
+        bool was_pondering = false;
+        std::atomic<std::uint64_t> node_count{0};
+        std::uint64_t node_limit = 0;
+        Clock::time_point start_time;
+        // Time from which the time limits count, the ponderhit for a ponder search
+        Clock::time_point limit_start;
+        // Hard limit after which the search is stopped and soft limit after which
+        // no new iteration is started, in milliseconds (0 for none) since limit_start
+        std::int64_t hard_limit = 0;
+        std::int64_t soft_limit = 0;
+        // Triangular principal variation table
+        std::array<std::array<Move, max_ply>, max_ply> pv_table;
+        std::array<int, max_ply> pv_length;
+        // Undo information of the moves played while following stored best moves
+        std::array<Position::UndoInfo, max_ply> pv_undo;
+        // Number of draws by repetition or the fifty-move rule found so far, scores of subtrees
+        // with such draws depend on the game history
+        std::uint64_t history_draws = 0;
+        // Move ordering statistics, cleared at the start of every search
+        std::array<KillerMoves, max_ply> killers;
+        HistoryTable history;
+        // Root moves of the better lines, skipped while searching the next line of a multi-PV search
+        std::vector<Move> excluded_root_moves;
+        SearchInfo result;
+        // Last completed iteration of a line other than the best one
+        SearchInfo line_result;
+};
+
+#endif
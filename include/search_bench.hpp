@@ -0,0 +1,15 @@
+#ifndef SEARCH_BENCH_HPP
+#define SEARCH_BENCH_HPP
+
+#include <cstdint>
+#include <ostream>
+
+inline constexpr int bench_default_depth = 4;
+
+// Function used to search a fixed set of positions to a fixed depth on one thread,
+// printing the node count of every position followed by the total and the speed.
+// The total node count is deterministic and changes only when the search or the
+// move generator behaves differently. Returns the total node count.
+std::uint64_t runSearchBench(int depth, std::ostream& output);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef SIMUL_VIEW_HPP
+#define SIMUL_VIEW_HPP
+
+#include <SFML/Graphics.hpp>
+#include "board_assets.hpp"
+#include "position.hpp"
+#include "move.hpp"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Grid of read-only boards, e.g. every game of a tournament on one screen. The boards
+// share their assets and are drawn in a single batched pass: one vertex array for all
+// squares and one for all pieces, rebuilt only when a position changes.
+class SimulView : public sf::Drawable {
+    public:
+        // Constructor which takes the number of boards and the size of the area to lay them out in
+        SimulView(std::size_t board_count, const sf::Vector2f& size);
+
+        // Method used to update the position shown on a board and highlight its last move
+        void setPosition(std::size_t index, const Position& position, const Move& last_move = Move());
+        const Position& position(std::size_t index) const { return boards[index].position; }
+        std::size_t size() const { return boards.size(); }
+
+    private:
+        // Position state, the only memory a board adds
+        struct Board {
+            Position position;
+            Move last_move;
+        };
+
+        // Method used to get the top left corner of a board in view coordinates
+        sf::Vector2f boardOrigin(std::size_t index) const;
+        // Method used to rebuild the vertex arrays from the positions
+        void rebuild() const;
+        // Overridden draw method to draw every board to the RenderTarget
+        virtual void draw(sf::RenderTarget& renderTarget, sf::RenderStates renderStates) const;
+
+        std::shared_ptr<const BoardAssets> assets;
+        std::vector<Board> boards;
+        sf::Vector2f view_size;
+        std::size_t columns;
+        std::size_t rows;
+        // Size of a board and the space around it
+        float board_size;
+        float margin;
+        mutable sf::VertexArray squares;
+        mutable sf::VertexArray pieces;
+        mutable bool dirty = true;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded queue passing values from one producer thread to one consumer thread
+// without locks, e.g. search results to the render thread. The producer only
+// writes the tail index and the consumer only the head index, each on its own
+// cache line, so neither side ever waits for the other: a push to a full queue
+// fails instead. Capacity must be a power of two.
+template <typename T, std::size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        // Method used by the producer to add a value, returns false if the queue is full
+        bool push(const T& value) {
+            std::size_t tail = tail_index.load(std::memory_order_relaxed);
+            if (tail - head_index.load(std::memory_order_acquire) == Capacity) {
+                return false;
+            }
+            slots[tail & (Capacity - 1)] = value;
+            tail_index.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Method used by the consumer to take the oldest value, returns false if the queue is empty
+        bool pop(T& value) {
+            std::size_t head = head_index.load(std::memory_order_relaxed);
+            if (head == tail_index.load(std::memory_order_acquire)) {
+                return false;
+            }
+            value = slots[head & (Capacity - 1)];
+            head_index.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        std::array<T, Capacity> slots{};
+        // Number of values taken and added so far
+        alignas(64) std::atomic<std::size_t> head_index{0};
+        alignas(64) std::atomic<std::size_t> tail_index{0};
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef TABLEBASE_HPP
+#define TABLEBASE_HPP
+
+#include "binary_file.hpp"
+#include "position.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Endgame tables of pawnless material sets with up to 5 pieces, holding the distance
+// to mate of every position with either side to move. Materials are written as the
+// pieces of each side with the king first e.g. "KQvKR", the stronger side first.
+//
+// Positions are indexed by the squares of the pieces in the order of the material,
+// kings first, after mirroring the board so that the first king is in the a8-d8-d5
+// triangle. Every entry of a file holds a code of a fixed number of bits: 0 for a
+// draw, 1 for an impossible or non-canonical index and otherwise the number of
+// half-moves until mate plus 2, odd numbers of half-moves being wins for the side
+// to move. A file has a 64 byte header (magic, version, bits per entry, piece count,
+// material, entries per side) followed by the entries with white to move and then
+// those with black to move, packed little-endian without gaps.
+
+enum class TablebaseOutcome {
+    Loss, Draw, Win
+};
+
+// Result of a probe from the side to move's perspective
+struct TablebaseResult {
+    TablebaseOutcome outcome = TablebaseOutcome::Draw;
+    // Half-moves until mate, 0 for a draw
+    int plies = 0;
+};
+
+// Statistics of a generated table
+struct TablebaseStats {
+    std::string material;
+    // Legal positions counted with either side to move
+    std::uint64_t positions = 0;
+    std::uint64_t wins = 0;
+    std::uint64_t losses = 0;
+    std::uint64_t draws = 0;
+    // Longest mate in half-moves
+    int longest_mate = 0;
+    int iterations = 0;
+    double seconds = 0;
+    // Memory used by the generation arrays and peak resident memory of the process, in bytes
+    std::size_t working_memory = 0;
+    std::size_t peak_memory = 0;
+    std::size_t file_size = 0;
+};
+
+// Collection of memory-mapped table files
+class Tablebase {
+    public:
+        Tablebase() = default;
+        Tablebase(const Tablebase&) = delete;
+        Tablebase& operator=(const Tablebase&) = delete;
+
+        // Method used to open a table file, errors are printed
+        bool load(const std::string& path);
+        // Method used to open every table file of a directory, returns the number of tables opened
+        int loadDirectory(const std::string& directory);
+        // Returns true if the table of the material is open, the material is normalized first
+        bool has(const std::string& material) const;
+        // Method used to look up the position, returns false if there is no table for its
+        // material or if it cannot be in a table (castling rights, pawns, more than 5 pieces).
+        // Bare kings are a draw without a table.
+        bool probe(const Position& position, TablebaseResult& result) const;
+
+        // Function used to normalize a material e.g. "KRvKQ" to "KQvKR", "KQKR" is accepted
+        // too. Returns an empty string for materials which cannot have a table
+        static std::string normalizeMaterial(const std::string& material);
+        // Function used to get the materials reached from a material by one capture
+        static std::vector<std::string> subMaterials(const std::string& material);
+        // File name of the table of a normalized material
+        static std::string fileName(const std::string& material) { return material + ".ctb"; }
+
+    private:
+        struct Table {
+            std::string material;
+            unsigned int bits = 0;
+            std::uint64_t entries = 0;
+            // Packed entries, pointing into the file contents
+            const std::uint8_t* data = nullptr;
+            MappedFile file;
+        };
+
+        std::map<std::string, std::unique_ptr<Table>> tables;
+};
+
+// Generator of tables by retrograde analysis. Every legal position is first scored
+// from its captures, which lead to smaller tables, and its mates and stalemates.
+// Then iteration n finds the positions lost in n half-moves and marks their
+// predecessors, found by un-making the moves of the other side, as wins in n + 1;
+// the predecessors of those wins whose every move now loses are losses in n + 2.
+// Each iteration scans the table in chunks on a pool of threads.
+class TablebaseGenerator {
+    public:
+        // Constructor, the smaller tables reached by captures are probed in tablebase
+        TablebaseGenerator(Tablebase& tablebase, int threads);
+
+        // Method used to generate the table of a material, write it to path and open it
+        // in the tablebase. The tables of the sub-materials must be open. Errors are printed
+        bool generate(const std::string& material, const std::string& path, TablebaseStats& stats);
+
+    private:
+        Tablebase& tablebase;
+        int threads;
+};
+
+#endif
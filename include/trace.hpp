@@ -0,0 +1,134 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// Instrumentation of the hot paths, compiled in only with the CHESS_TRACE definition
+// (cmake -DCHESS_TRACE=ON); without it the macros at the end expand to nothing.
+//
+// CHESS_TRACE_COUNT(GenerateMoves) counts a call and CHESS_TRACE_SCOPE("name") times
+// the enclosing scope, the name must be a string literal. Every thread records into
+// counters and a ring of its last timed scopes of its own, so recording never takes a
+// lock or writes to a cache line shared with another thread: a count is one increment
+// and a scope two clock reads. Counts are cheap enough for functions called millions
+// of times per second, scopes are meant for frames, iterations and searches.
+//
+// The counters of a thread are reported from its first timed scope on, which also gives
+// it a buffer. The buffer of a thread that exits is taken over by the next new thread,
+// keeping memory bounded by the number of threads alive at once. A dump reads the
+// buffers as they are, so recordings made during the dump may be missing or torn.
+
+namespace trace {
+    enum class Counter {
+        GenerateMoves,
+        IsValidLegalMove,
+        InCheck,
+        FindPieceSprite,
+        Draw,
+        Count
+    };
+
+    // Returns true if the instrumentation is compiled in
+    bool enabled();
+    // Function used to write the recorded scopes and the counters of every thread as Chrome
+    // trace JSON, to be opened in chrome://tracing or ui.perfetto.dev. Errors are printed
+    bool writeChromeTrace(const std::string& path);
+    // Function used to print the counters of every thread and the number, total and longest
+    // duration of every timed scope
+    void printSummary(std::ostream& output);
+    // Function used to forget everything recorded so far, meant for when no thread is recording
+    void reset();
+
+#ifdef CHESS_TRACE
+    namespace detail {
+        constexpr std::size_t counter_count = static_cast<std::size_t>(Counter::Count);
+        // Number of the last timed scopes kept per thread
+        constexpr std::size_t ring_size = 1 << 14;
+
+        struct Event {
+            const char* name;
+            std::uint64_t start_ns;
+            std::uint64_t duration_ns;
+            std::uint32_t thread;
+        };
+
+        using Counters = std::array<std::atomic<std::uint64_t>, counter_count>;
+
+        struct ThreadBuffer {
+            // Counts of the exited threads which used the buffer
+            Counters counters{};
+            // Counters of the thread using the buffer, null once it has exited
+            Counters* thread_counters = nullptr;
+            std::array<Event, ring_size> events{};
+            // Number of events recorded so far, the newest ring_size of them are kept
+            std::atomic<std::uint64_t> event_count{0};
+            // Number of the thread using the buffer, in order of their first recording
+            std::uint32_t thread = 0;
+            std::atomic<bool> in_use{false};
+        };
+
+        // Counters of the calling thread. They need no initialization at run time, so a
+        // count is an increment at a fixed offset from the thread pointer, without a check
+        inline thread_local Counters counters{};
+        // Buffer of the calling thread, null until its first timed scope
+        inline thread_local ThreadBuffer* current = nullptr;
+
+        // Function used to give the calling thread a buffer
+        ThreadBuffer& attach();
+
+        inline ThreadBuffer& buffer() {
+            ThreadBuffer* thread_buffer = current;
+            return (thread_buffer != nullptr) ? *thread_buffer : attach();
+        }
+
+        inline std::uint64_t now() {
+            return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+    }
+
+    // Function used to count a call on the calling thread, only that thread writes the counter
+    inline void count(Counter counter) {
+        std::atomic<std::uint64_t>& value = detail::counters[static_cast<std::size_t>(counter)];
+        value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Timer recording the duration of its lifetime into the ring of the calling thread
+    class Scope {
+        public:
+            explicit Scope(const char* name) : name(name), start_ns(detail::now()) {}
+            ~Scope() {
+                std::uint64_t end_ns = detail::now();
+                detail::ThreadBuffer& thread_buffer = detail::buffer();
+                std::uint64_t index = thread_buffer.event_count.load(std::memory_order_relaxed);
+                thread_buffer.events[index % detail::ring_size] = {name, start_ns, end_ns - start_ns,
+                                                                   thread_buffer.thread};
+                thread_buffer.event_count.store(index + 1, std::memory_order_release);
+            }
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            const char* name;
+            std::uint64_t start_ns;
+    };
+#endif
+}
+
+#ifdef CHESS_TRACE
+#define CHESS_TRACE_JOIN(a, b) a##b
+#define CHESS_TRACE_NAME(a, b) CHESS_TRACE_JOIN(a, b)
+#define CHESS_TRACE_COUNT(counter) ::trace::count(::trace::Counter::counter)
+#define CHESS_TRACE_SCOPE(name) ::trace::Scope CHESS_TRACE_NAME(trace_scope_, __LINE__)(name)
+#else
+#define CHESS_TRACE_COUNT(counter) ((void)0)
+#define CHESS_TRACE_SCOPE(name) ((void)0)
+#endif
+
+#endif
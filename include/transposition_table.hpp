@@ -0,0 +1,56 @@
+#ifndef TRANSPOSITION_TABLE_HPP
+#define TRANSPOSITION_TABLE_HPP
+
+#include "move.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Type of bound stored with a score
+enum class Bound : std::uint8_t {
+    None = 0, Exact, Lower, Upper
+};
+
+// Search result for a position as stored in the transposition table
+struct TTEntry {
+    Move move;
+    int score = 0;
+    int depth = 0;
+    Bound bound = Bound::None;
+};
+
+// Hash table of search results shared by all search threads. Every slot holds
+// the key xor'ed with its data so that torn writes from concurrent threads are
+// detected on probe instead of needing a lock.
+class TranspositionTable {
+    public:
+        explicit TranspositionTable(std::size_t megabytes = 16);
+
+        // Method used to resize the table, clearing all entries
+        void resize(std::size_t megabytes);
+        // Method used to clear all entries
+        void clear();
+        // Returns true and fills entry if the key is found
+        bool probe(std::uint64_t key, TTEntry& entry) const;
+        // Method used to store a search result, replacing shallower entries
+        void store(std::uint64_t key, int depth, int score, Bound bound, const Move& move);
+        // Returns the number of used slots per mille, sampled from the first thousand slots
+        int hashfull() const;
+        std::size_t size() const { return slot_count; }
+
+        // Methods used to pack a move into 16 bits and back
+        static std::uint16_t packMove(const Move& move);
+        static Move unpackMove(std::uint16_t packed);
+
+    private:
+        struct Slot {
+            std::atomic<std::uint64_t> key{0};
+            std::atomic<std::uint64_t> data{0};
+        };
+
+        std::unique_ptr<Slot[]> slots;
+        std::size_t slot_count = 0;
+};
+
+#endif
@@ -1,16 +1,121 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/Audio.hpp>
 #include "chess_board.hpp"
+#include "simul_view.hpp"
+#include "analysis_view.hpp"
+#include "frame_profiler.hpp"
+#include "spsc_queue.hpp"
 #include "piece.hpp"
+#include "move.hpp"
+#include "position.hpp"
+#include "engine.hpp"
+#include "opening_explorer.hpp"
+#include "search.hpp"
+#include "transposition_table.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
+// Usage: chess [--engine white|black] [--movetime MS] [--no-ponder] [--simul N] [--verify-moves]
+//              [--explorer FILE] [--cache FILE] [--analysis N] [--trace FILE] [--profile FILE]
+//
+// Without options two players share the board. With --engine the engine plays one
+// side and, unless disabled, ponders on the expected reply while the human thinks.
+// With --simul the window shows N boards on which the engine plays against itself.
+// With --verify-moves the incrementally maintained legal moves of the board are
+// checked against a full generation after every move. With --explorer the target
+// squares of a selected piece show how often its moves were played in the games of
+// an opening explorer file built by chess_explorer. With --cache the engine keeps its
+// deep search results in an analysis cache file from one game to the next. With
+// --analysis the engine searches the N best moves of the position on the board in the
+// background, shown as arrows with an evaluation bar beside the board. With --trace
+// (in a build with CHESS_TRACE) the recorded counters and timings are printed on exit
+// and written to FILE as Chrome trace JSON. F3 toggles an overlay with the frame times,
+// the time spent in each phase of a frame, the draw calls and the latency of the last
+// move made with the mouse; with --profile these are also logged to FILE as CSV.
+
+// Options given on the command line
+struct Options {
+    bool engine = false;
+    Piece::Color engine_color = Piece::Color::Black;
+    // Time the engine spends on a move in milliseconds
+    int movetime = 1000;
+    bool ponder = true;
+    // Number of boards in the simul view, 0 for a single interactive board
+    int simul = 0;
+    bool verify_moves = false;
+    // Opening explorer file whose move frequencies are shown, empty for none
+    std::string explorer;
+    // Analysis cache file of the engine, empty for none
+    std::string cache;
+    // Number of lines of the analysis, 0 without analysis
+    int analysis = 0;
+    // Chrome trace file written on exit, empty for none
+    std::string trace;
+    // CSV file the frame profiler logs every frame to, empty for none
+    std::string profile;
+};
+
+// Best move reported from the engine thread, picked up by the main loop
+struct EngineReply {
+    std::mutex mutex;
+    bool ready = false;
+    Move best_move;
+    Move ponder_move;
+};
+
+// Analysis lines passed from the engine thread to the main loop without locking. Every
+// line reported by the search changes the lines gathered so far, which are sent as a whole
+struct AnalysisFeed {
+    SpscQueue<AnalysisUpdate, 64> queue;
+    // Only used by the engine thread while an analysis runs
+    AnalysisUpdate lines;
+};
+
+// Games shown in the simul view, written by the thread playing them and read by the main loop
+struct SimulGames {
+    std::mutex mutex;
+    std::vector<Position> positions;
+    std::vector<Move> last_moves;
+    std::vector<bool> changed;
+};
+
+// Function used to parse the command line options, returns false if they are invalid
+bool parseOptions(int argc, char* argv[], Options& options);
+// Function used to find the expected reply in the position after the engine's move, from the
+// principal variation or else the transposition table. Returns a null move if there is none
+Move expectedReply(Engine& engine, Position& position, const Move& ponder_move);
+// Function used to play engine games on every board of the simul until quit is set
+void playSimulGames(SimulGames& games, int movetime, const std::atomic<bool>& quit);
+// Function used to show the simul view until the window is closed
+void runSimul(sf::RenderWindow& window, sf::View view, const Options& options, FrameProfiler& profiler);
+// Function used to print the recorded counters and timings and write them as a Chrome trace
+void writeTrace(const std::string& path);
 // Function used to maintain the view aspect ratio as the window size changes
 sf::View getLetterboxView(sf::View view, int windowWidth, int windowHeight);
 
-int main() {
-    // Create window
-    int res_x = 800;
-    int res_y = 800;
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: chess [--engine white|black] [--movetime MS] [--no-ponder] [--simul N] [--verify-moves]\n"
+                     "             [--explorer FILE] [--cache FILE] [--analysis N] [--trace FILE] [--profile FILE]\n";
+        return 1;
+    }
+
+    // Create window, with room for the evaluation bar to the right of the board in analysis mode
+    int board_size = 800;
+    int bar_width = (options.analysis > 0) ? 40 : 0;
+    int res_x = board_size + bar_width;
+    int res_y = board_size;
     sf::RenderWindow window(sf::VideoMode(res_x, res_y), "Chess", (sf::Style::Resize + sf::Style::Close));
     window.setVerticalSyncEnabled(true);
     window.setFramerateLimit(60);
@@ -20,50 +125,393 @@ int main() {
     view.setSize(res_x, res_y);
     view.setCenter(view.getSize().x / 2, view.getSize().y / 2);
 
+    FrameProfiler profiler;
+    if (!options.profile.empty() && !profiler.openLog(options.profile)) {
+        return 1;
+    }
+
+    if (options.simul > 0) {
+        runSimul(window, view, options, profiler);
+        if (!options.trace.empty()) {
+            writeTrace(options.trace);
+        }
+        return 0;
+    }
+
     // Create chess board
-    ChessBoard board(res_x);
+    ChessBoard board(board_size);
+    board.setMoveVerification(options.verify_moves);
+    if (!options.explorer.empty()) {
+        auto explorer = std::make_shared<OpeningExplorer>();
+        if (!explorer->open(options.explorer)) {
+            return 1;
+        }
+        board.setExplorer(explorer);
+    }
     bool mouse_pressed = false;
 
+    // Engine opponent, searches run on the engine's threads so the frame rate is not affected.
+    // The search callbacks hold references to reply and feed, so they are declared before
+    // the engine and outlive its thread
+    EngineReply reply;
+    // Analysis of the position on the board, restarted whenever a move is played
+    AnalysisFeed feed;
+    Engine engine;
+    if (!options.cache.empty() && !engine.openAnalysisCache(options.cache, 64)) {
+        return 1;
+    }
+    SearchLimits limits;
+    limits.movetime = options.movetime;
+    auto no_info = [](const SearchInfo&) {};
+    auto on_bestmove = [&reply](const SearchInfo& result) {
+        std::lock_guard<std::mutex> lock(reply.mutex);
+        reply.ready = true;
+        reply.best_move = result.bestMove();
+        reply.ponder_move = result.ponderMove();
+    };
+    // Move expected from the human while pondering, null when not pondering
+    Move ponder_move;
+    int handled_move_count = -1;
+
+    AnalysisView analysis_view(board_size, bar_width);
+    int analysed_move_count = -1;
+
     while (window.isOpen()) {
+        CHESS_TRACE_SCOPE("frame");
+        profiler.beginFrame();
         sf::Event event;
+        bool human_turn = !options.engine || board.activeColor() != options.engine_color;
 
-        while (window.pollEvent(event)) {
-            switch (event.type) {
-                case sf::Event::Closed:
-                    window.close();
-                    break;
-                case sf::Event::Resized:
-                    view = getLetterboxView(view, event.size.width, event.size.height);
-                    break;
-                case sf::Event::MouseButtonPressed:
-                    if (event.mouseButton.button == sf::Mouse::Button::Left) {
-                        mouse_pressed = true;
-                        board.selectPiece(window.mapPixelToCoords(sf::Mouse::getPosition(window)));
-                    }
-                    break;
-                case sf::Event::MouseButtonReleased:
-                    if (event.mouseButton.button == sf::Mouse::Button::Left) {
-                        board.dropPiece(window.mapPixelToCoords(sf::Mouse::getPosition(window)));
-                        mouse_pressed = false;
-                    }
-                    break;
-                default:
-                    break;
+        {
+            FrameProfiler::ScopedPhase phase(FrameProfiler::Phase::Events);
+            while (window.pollEvent(event)) {
+                switch (event.type) {
+                    case sf::Event::Closed:
+                        window.close();
+                        break;
+                    case sf::Event::Resized:
+                        view = getLetterboxView(view, event.size.width, event.size.height);
+                        break;
+                    case sf::Event::KeyPressed:
+                        if (event.key.code == sf::Keyboard::F3) {
+                            profiler.toggleOverlay();
+                        }
+                        break;
+                    case sf::Event::MouseButtonPressed:
+                        if (event.mouseButton.button == sf::Mouse::Button::Left && human_turn) {
+                            mouse_pressed = true;
+                            board.selectPiece(window.mapPixelToCoords(sf::Mouse::getPosition(window)));
+                        }
+                        break;
+                    case sf::Event::MouseButtonReleased:
+                        if (event.mouseButton.button == sf::Mouse::Button::Left && mouse_pressed) {
+                            profiler.inputReceived();
+                            board.dropPiece(window.mapPixelToCoords(sf::Mouse::getPosition(window)));
+                            profiler.inputHandled();
+                            mouse_pressed = false;
+                        }
+                        break;
+                    default:
+                        break;
+                }
             }
-         }
+        }
 
          if (mouse_pressed) {
              board.updateSelectedPiecePosition(window.mapPixelToCoords(sf::Mouse::getPosition(window)));
          }
 
-         window.clear();
-         window.setView(view);
-         window.draw(board);
-         window.display();
+         if (options.engine) {
+             // Play the engine's move once its search is done
+             Move best_move;
+             Move expected_move;
+             {
+                 std::lock_guard<std::mutex> lock(reply.mutex);
+                 if (reply.ready) {
+                     reply.ready = false;
+                     best_move = reply.best_move;
+                     expected_move = reply.ponder_move;
+                 }
+             }
+             if (best_move.isValid()) {
+                 board.playMove(best_move);
+                 handled_move_count = board.moveCount();
+                 // Ponder on the expected reply while the human thinks
+                 Position ponder_position = board;
+                 expected_move = expectedReply(engine, ponder_position, expected_move);
+                 if (options.ponder && !board.isGameOver() && expected_move.isValid()) {
+                     Position::UndoInfo undo;
+                     ponder_position.makeMove(expected_move, undo);
+                     SearchLimits ponder_limits = limits;
+                     ponder_limits.ponder = true;
+                     engine.go(ponder_position, ponder_limits, no_info, on_bestmove);
+                     ponder_move = expected_move;
+                 }
+             }
+             // Start searching once it is the engine's turn
+             if (board.moveCount() != handled_move_count) {
+                 handled_move_count = board.moveCount();
+                 if (board.activeColor() == options.engine_color && !board.isGameOver()) {
+                     if (ponder_move.isValid() && board.lastMove() == ponder_move) {
+                         // Ponder hit, the running search already searches this position
+                         engine.ponderHit();
+                     }
+                     else {
+                         // Ponder miss, the transposition table stays warm for the new search
+                         engine.stop();
+                         engine.wait();
+                         {
+                             std::lock_guard<std::mutex> lock(reply.mutex);
+                             reply.ready = false;
+                         }
+                         engine.go(board, limits, no_info, on_bestmove);
+                     }
+                 }
+                 ponder_move = Move();
+             }
+         }
+
+         if (options.analysis > 0) {
+             if (board.moveCount() != analysed_move_count) {
+                 analysed_move_count = board.moveCount();
+                 engine.stop();
+                 engine.wait();
+                 analysis_view.clear();
+                 window.setTitle("Chess");
+                 if (!board.isGameOver()) {
+                     feed.lines = AnalysisUpdate();
+                     feed.lines.key = board.hash();
+                     bool white = board.activeColor() == Piece::Color::White;
+                     SearchLimits analysis_limits;
+                     analysis_limits.infinite = true;
+                     analysis_limits.multipv = options.analysis;
+                     auto on_line = [&feed, white](const SearchInfo& info) {
+                         AnalysisLine& line = feed.lines.lines[info.multipv - 1];
+                         line.depth = info.depth;
+                         line.score = white ? info.score : -info.score;
+                         line.move = info.bestMove();
+                         feed.lines.line_count = std::max(feed.lines.line_count, info.multipv);
+                         // The queue is only full if the window stopped drawing, the next update
+                         // holds every line again
+                         feed.queue.push(feed.lines);
+                     };
+                     engine.go(board, analysis_limits, on_line, no_info);
+                 }
+             }
+             // However many updates arrived since the last frame, only the newest one is shown
+             AnalysisUpdate update;
+             bool updated = false;
+             while (feed.queue.pop(update)) {
+                 updated = true;
+             }
+             if (updated && update.key == board.hash()) {
+                 analysis_view.setUpdate(update);
+                 window.setTitle("Chess - " + analysis_view.summary());
+             }
+         }
+
+         {
+             FrameProfiler::ScopedPhase phase(FrameProfiler::Phase::Draw);
+             window.clear();
+             window.setView(view);
+             window.draw(board);
+             if (options.analysis > 0) {
+                 window.draw(analysis_view);
+             }
+             window.draw(profiler);
+         }
+         {
+             FrameProfiler::ScopedPhase phase(FrameProfiler::Phase::Display);
+             window.display();
+         }
+         profiler.endFrame();
+    }
+    // The search thread may still be inside a callback writing to feed or reply, and it
+    // records traces too, so it has to finish first
+    engine.stop();
+    engine.wait();
+    if (!options.trace.empty()) {
+        writeTrace(options.trace);
     }
     return 0;
 }
 
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--no-ponder") {
+            options.ponder = false;
+            continue;
+        }
+        if (arg == "--verify-moves") {
+            options.verify_moves = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--engine" && (value == "white" || value == "black")) {
+            options.engine = true;
+            options.engine_color = (value == "white") ? Piece::Color::White : Piece::Color::Black;
+        }
+        else if (arg == "--explorer") {
+            options.explorer = value;
+        }
+        else if (arg == "--cache") {
+            options.cache = value;
+        }
+        else if (arg == "--trace") {
+            options.trace = value;
+        }
+        else if (arg == "--profile") {
+            options.profile = value;
+        }
+        else if (arg == "--movetime" || arg == "--simul") {
+            try {
+                (arg == "--movetime" ? options.movetime : options.simul) = std::max(1, std::stoi(value));
+            } catch (std::exception& e) {
+                return false;
+            }
+        }
+        else if (arg == "--analysis") {
+            try {
+                options.analysis = std::clamp(std::stoi(value), 1, AnalysisUpdate::max_lines);
+            } catch (std::exception& e) {
+                return false;
+            }
+        }
+        else {
+            return false;
+        }
+    }
+    // The analysis uses the engine and is shown on the single interactive board
+    return options.analysis == 0 || (!options.engine && options.simul == 0);
+}
+
+void runSimul(sf::RenderWindow& window, sf::View view, const Options& options, FrameProfiler& profiler) {
+    SimulView simul(options.simul, view.getSize());
+    SimulGames games;
+    games.positions.resize(simul.size());
+    games.last_moves.resize(simul.size());
+    games.changed.assign(simul.size(), false);
+    std::atomic<bool> quit{false};
+    std::thread player(playSimulGames, std::ref(games), options.movetime, std::cref(quit));
+
+    while (window.isOpen()) {
+        CHESS_TRACE_SCOPE("frame");
+        profiler.beginFrame();
+        sf::Event event;
+        {
+            FrameProfiler::ScopedPhase phase(FrameProfiler::Phase::Events);
+            while (window.pollEvent(event)) {
+                if (event.type == sf::Event::Closed) {
+                    window.close();
+                }
+                else if (event.type == sf::Event::Resized) {
+                    view = getLetterboxView(view, event.size.width, event.size.height);
+                }
+                else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F3) {
+                    profiler.toggleOverlay();
+                }
+            }
+        }
+        // Only boards whose game moved on are updated
+        {
+            std::lock_guard<std::mutex> lock(games.mutex);
+            for (std::size_t i = 0; i < simul.size(); i++) {
+                if (games.changed[i]) {
+                    simul.setPosition(i, games.positions[i], games.last_moves[i]);
+                    games.changed[i] = false;
+                }
+            }
+        }
+        {
+            FrameProfiler::ScopedPhase phase(FrameProfiler::Phase::Draw);
+            window.clear();
+            window.setView(view);
+            window.draw(simul);
+            window.draw(profiler);
+        }
+        {
+            FrameProfiler::ScopedPhase phase(FrameProfiler::Phase::Display);
+            window.display();
+        }
+        profiler.endFrame();
+    }
+    quit.store(true);
+    player.join();
+}
+
+void playSimulGames(SimulGames& games, int movetime, const std::atomic<bool>& quit) {
+    // Number of random moves at the start of a game so that the boards show different games
+    const int random_plies = 4;
+    std::size_t board_count = games.positions.size();
+    std::vector<Position> positions(board_count);
+    for (Position& position : positions) {
+        position.loadPositionFromFEN(Position::start_fen);
+    }
+    TranspositionTable tt(16);
+    std::atomic<bool> stop_flag{false};
+    auto search = std::make_unique<Search>(tt, stop_flag);
+    SearchLimits limits;
+    // Every board moves about once per movetime
+    limits.movetime = std::max(1, movetime / static_cast<int>(board_count));
+    std::mt19937 random(std::random_device{}());
+
+    while (!quit.load()) {
+        for (std::size_t i = 0; i < board_count && !quit.load(); i++) {
+            Position& position = positions[i];
+            MoveList moves;
+            position.generateMoves(position.activeColor(), moves);
+            Move move;
+            if (moves.empty() || position.isFiftyMoveDraw() || position.repetitionCount() >= 2
+                || position.isInsufficientMaterial()) {
+                // Game over, start a new one
+                position.loadPositionFromFEN(Position::start_fen);
+            }
+            else if (position.fullmoveNumber() * 2 <= random_plies) {
+                move = moves[random() % moves.size()];
+            }
+            else {
+                stop_flag.store(false);
+                move = search->run(position, limits).bestMove();
+            }
+            if (move.isValid()) {
+                Position::UndoInfo undo;
+                position.makeMove(move, undo);
+            }
+            else {
+                // Without a move the pause keeps an idle simul from spinning
+                std::this_thread::sleep_for(std::chrono::milliseconds(limits.movetime));
+            }
+            std::lock_guard<std::mutex> lock(games.mutex);
+            games.positions[i] = position;
+            games.last_moves[i] = move;
+            games.changed[i] = true;
+        }
+    }
+}
+
+void writeTrace(const std::string& path) {
+    trace::printSummary(std::cout);
+    if (trace::writeChromeTrace(path)) {
+        std::cout << "Trace written to " << path << std::endl;
+    }
+}
+
+Move expectedReply(Engine& engine, Position& position, const Move& ponder_move) {
+    if (ponder_move.isValid()) {
+        return ponder_move;
+    }
+    // The principal variation can be cut short by a transposition table cutoff
+    TTEntry entry;
+    if (engine.transpositionTable().probe(position.hash(), entry) && position.isLegal(entry.move)) {
+        return entry.move;
+    }
+    return Move();
+}
+
 // https://github.com/SFML/SFML/wiki/Source%3A-Letterbox-effect-using-a-view
 sf::View getLetterboxView(sf::View view, int windowWidth, int windowHeight) {
 
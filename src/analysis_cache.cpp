@@ -0,0 +1,348 @@
+#include "analysis_cache.hpp"
+#include "binary_file.hpp"
+#include "position.hpp"
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <filesystem>
+#include <iostream>
+#if defined(__unix__) || defined(__APPLE__)
+#define ANALYSIS_CACHE_FILE_LOCKS
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+// Layout of the 64 bit data word, the transposition table's with the generation added:
+//      bits  0-15 : packed move
+//      bits 16-31 : score
+//      bits 32-39 : depth
+//      bits 40-41 : bound
+//      bits 48-63 : generation
+
+struct AnalysisCache::Record {
+    std::uint64_t key;
+    std::uint64_t data;
+    std::uint64_t check;
+};
+
+namespace {
+    constexpr std::array<char, 8> cache_magic = {{'C', 'H', 'E', 'S', 'S', 'A', 'N', 'A'}};
+    constexpr std::uint16_t cache_version = 1;
+    constexpr std::size_t cache_header_size = 64;
+
+    std::uint64_t mix(std::uint64_t value) {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    std::uint64_t checksum(std::uint64_t key, std::uint64_t data) {
+        return mix(key ^ mix(data ^ 0x9e3779b97f4a7c15ULL));
+    }
+
+    int depthOf(std::uint64_t data) {
+        return static_cast<std::uint8_t>(data >> 32);
+    }
+
+    Bound boundOf(std::uint64_t data) {
+        return static_cast<Bound>((data >> 40) & 3);
+    }
+
+    std::uint16_t generationOf(std::uint64_t data) {
+        return static_cast<std::uint16_t>(data >> 48);
+    }
+
+    // Function used to get the key of the start position, which differs between builds
+    // hashing positions differently so that their files are not mixed up
+    std::uint64_t startKey() {
+        Position position;
+        return position.hash();
+    }
+
+    std::array<std::uint8_t, cache_header_size> header() {
+        std::array<std::uint8_t, cache_header_size> bytes{};
+        std::copy(cache_magic.begin(), cache_magic.end(), bytes.begin());
+        writeLittleEndian(&bytes[8], cache_version, 2);
+        writeLittleEndian(&bytes[16], startKey(), 8);
+        return bytes;
+    }
+}
+
+AnalysisCache::~AnalysisCache() {
+    close();
+}
+
+bool AnalysisCache::open(const std::string& path, std::size_t megabytes, int min_depth) {
+    close();
+    if (!isLittleEndian()) {
+        std::cerr << "Analysis caches can only be used on little-endian machines" << std::endl;
+        return false;
+    }
+    std::size_t count = std::max<std::size_t>(1, megabytes) * 1024 * 1024 / sizeof(Slot);
+    // Round down to a power of two so that the bucket is a mask of the key
+    std::size_t power = bucket_size;
+    while (power * 2 <= count) {
+        power *= 2;
+    }
+    slots.reset(new Slot[power]);
+    slot_count = power;
+    this->min_depth = std::max(1, min_depth);
+    this->path = path;
+
+    log = std::fopen(path.c_str(), "ab");
+    if (log == nullptr) {
+        std::cerr << "Could not open " << path << std::endl;
+        close();
+        return false;
+    }
+    // Only a process alone with the file may repair or rewrite it
+    bool alone = lock(true);
+    if (!alone) {
+        lock(false);
+    }
+    std::error_code error;
+    if (alone && std::filesystem::file_size(path, error) == 0) {
+        auto bytes = header();
+        std::fwrite(bytes.data(), 1, bytes.size(), log);
+        std::fflush(log);
+    }
+
+    // The log is replayed once from start to end
+    MappedFile file;
+    file.open(path, MappedFile::Access::Sequential);
+    const std::uint8_t* contents = file.data();
+    std::size_t file_size = file.size();
+
+    bool valid = file_size >= cache_header_size
+                 && std::equal(cache_magic.begin(), cache_magic.end(), contents)
+                 && readLittleEndian(contents + 8, 2) == cache_version;
+    bool same_keys = valid && readLittleEndian(contents + 16, 8) == startKey();
+    std::size_t valid_size = same_keys ? cache_header_size + replay(contents + cache_header_size,
+                                                                    file_size - cache_header_size) : 0;
+    file.close();
+    if (!same_keys) {
+        std::cerr << path << (valid ? " was written by a build hashing positions differently"
+                                    : " is not an analysis cache file") << std::endl;
+        close();
+        return false;
+    }
+    log_records = (valid_size - cache_header_size) / sizeof(Record);
+
+    if (alone) {
+        // Records after a torn write would be misaligned, so the tail is cut off before appending
+        if (valid_size < file_size) {
+            std::filesystem::resize_file(path, valid_size, error);
+            if (error) {
+                std::cerr << "Could not repair " << path << ": " << error.message() << std::endl;
+                close();
+                return false;
+            }
+        }
+        if (needsCompaction()) {
+            compactLocked();
+        }
+        lock(false);
+    }
+    compaction_limit = log_records + 4 * slot_count;
+    return true;
+}
+
+std::size_t AnalysisCache::replay(const std::uint8_t* contents, std::size_t size) {
+    // The records are checked and the newest generation found first, so that the
+    // replacement policy ages the entries relative to this session
+    const Record* records = reinterpret_cast<const Record*>(contents);
+    std::size_t count = 0;
+    std::uint16_t newest = 0;
+    for (; count < size / sizeof(Record); count++) {
+        const Record& record = records[count];
+        if (record.data == 0 || record.check != checksum(record.key, record.data)) {
+            break;
+        }
+        newest = std::max(newest, generationOf(record.data));
+    }
+    generation = static_cast<std::uint16_t>(newest + 1);
+    for (std::size_t i = 0; i < count; i++) {
+        insert(records[i].key, records[i].data);
+    }
+    return count * sizeof(Record);
+}
+
+void AnalysisCache::close() {
+    std::lock_guard<std::mutex> file_lock(file_mutex);
+    if (log != nullptr) {
+        if (needsCompaction()) {
+            compactLocked();
+        }
+        std::fclose(log);
+        log = nullptr;
+    }
+    slots.reset();
+    slot_count = 0;
+    entry_count = 0;
+    log_records = 0;
+}
+
+bool AnalysisCache::probe(std::uint64_t key, TTEntry& entry) const {
+    const Slot* bucket = &slots[key & (slot_count - 1) & ~(bucket_size - 1)];
+    for (std::size_t i = 0; i < bucket_size; i++) {
+        std::uint64_t data = bucket[i].data.load(std::memory_order_relaxed);
+        if (data != 0 && (bucket[i].key.load(std::memory_order_relaxed) ^ data) == key) {
+            entry.move = TranspositionTable::unpackMove(static_cast<std::uint16_t>(data));
+            entry.score = static_cast<std::int16_t>(data >> 16);
+            entry.depth = depthOf(data);
+            entry.bound = boundOf(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void AnalysisCache::store(std::uint64_t key, int depth, int score, Bound bound, const Move& move) {
+    if (log == nullptr || depth < min_depth) {
+        return;
+    }
+    std::uint64_t data = TranspositionTable::packMove(move)
+                         | static_cast<std::uint64_t>(static_cast<std::uint16_t>(score)) << 16
+                         | static_cast<std::uint64_t>(std::clamp(depth, 0, 255)) << 32
+                         | static_cast<std::uint64_t>(bound) << 40
+                         | static_cast<std::uint64_t>(generation) << 48;
+    if (!insert(key, data)) {
+        return;
+    }
+    Record record{key, data, checksum(key, data)};
+    std::lock_guard<std::mutex> file_lock(file_mutex);
+    if (log == nullptr) {
+        return;
+    }
+    // Flushed right away so that the record survives a crash of the process
+    std::fwrite(&record, sizeof(Record), 1, log);
+    std::fflush(log);
+    log_records++;
+    if (log_records >= compaction_limit) {
+        compactLocked();
+        compaction_limit = log_records + 4 * slot_count;
+    }
+}
+
+bool AnalysisCache::insert(std::uint64_t key, std::uint64_t data) {
+    Slot* bucket = &slots[key & (slot_count - 1) & ~(bucket_size - 1)];
+    int depth = depthOf(data);
+    Slot* victim = nullptr;
+    int victim_value = INT_MAX;
+    for (std::size_t i = 0; i < bucket_size; i++) {
+        Slot& slot = bucket[i];
+        std::uint64_t old_data = slot.data.load(std::memory_order_relaxed);
+        if (old_data == 0) {
+            if (victim_value > INT_MIN) {
+                victim = &slot;
+                victim_value = INT_MIN;
+            }
+            continue;
+        }
+        if ((slot.key.load(std::memory_order_relaxed) ^ old_data) == key) {
+            // Keep deeper results, and exact ones over bounds of the same depth
+            int old_depth = depthOf(old_data);
+            if (depth < old_depth || (depth == old_depth && boundOf(data) != Bound::Exact
+                                      && boundOf(old_data) == Bound::Exact)) {
+                return false;
+            }
+            // Keep the old best move if the new result has none
+            if (static_cast<std::uint16_t>(data) == 0) {
+                data |= static_cast<std::uint16_t>(old_data);
+            }
+            if ((data & ~(0xffffULL << 48)) == (old_data & ~(0xffffULL << 48))) {
+                return false;
+            }
+            slot.key.store(key ^ data, std::memory_order_relaxed);
+            slot.data.store(data, std::memory_order_relaxed);
+            return true;
+        }
+        // Entries lose a ply of worth for every session they have not been searched again
+        int age = static_cast<std::uint16_t>(generation - generationOf(old_data));
+        int value = depthOf(old_data) - std::min(age, 255);
+        if (value < victim_value) {
+            victim = &slot;
+            victim_value = value;
+        }
+    }
+    if (victim_value > depth) {
+        return false;
+    }
+    if (victim_value == INT_MIN) {
+        entry_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    victim->key.store(key ^ data, std::memory_order_relaxed);
+    victim->data.store(data, std::memory_order_relaxed);
+    return true;
+}
+
+bool AnalysisCache::compact() {
+    std::lock_guard<std::mutex> file_lock(file_mutex);
+    return log != nullptr && compactLocked();
+}
+
+bool AnalysisCache::needsCompaction() const {
+    return log_records > 2 * size() + 1024;
+}
+
+bool AnalysisCache::lock(bool exclusive) {
+#ifdef ANALYSIS_CACHE_FILE_LOCKS
+    return ::flock(fileno(log), exclusive ? (LOCK_EX | LOCK_NB) : LOCK_SH) == 0;
+#else
+    (void)exclusive;
+    return true;
+#endif
+}
+
+bool AnalysisCache::compactLocked() {
+    if (!lock(true)) {
+        // Converting the lock may have released it
+        lock(false);
+        return false;
+    }
+    std::string temporary = path + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    bool written = file != nullptr;
+    std::uint64_t records = 0;
+    if (written) {
+        auto bytes = header();
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        for (std::size_t i = 0; i < slot_count; i++) {
+            std::uint64_t data = slots[i].data.load(std::memory_order_relaxed);
+            if (data == 0) {
+                continue;
+            }
+            std::uint64_t key = slots[i].key.load(std::memory_order_relaxed) ^ data;
+            Record record{key, data, checksum(key, data)};
+            std::fwrite(&record, sizeof(Record), 1, file);
+            records++;
+        }
+        written = std::fflush(file) == 0 && !std::ferror(file);
+#ifdef ANALYSIS_CACHE_FILE_LOCKS
+        // The new log must be on disk before it replaces the old one
+        written = written && ::fsync(fileno(file)) == 0;
+#endif
+        written = std::fclose(file) == 0 && written;
+    }
+    std::error_code error;
+    if (written) {
+        std::filesystem::rename(temporary, path, error);
+    }
+    if (!written || error) {
+        std::cerr << "Could not compact " << path << std::endl;
+        std::filesystem::remove(temporary, error);
+        lock(false);
+        return false;
+    }
+    // The old log is only closed once renamed over, so no process opens it in between
+    std::FILE* old_log = log;
+    log = std::fopen(path.c_str(), "ab");
+    std::fclose(old_log);
+    if (log == nullptr) {
+        std::cerr << "Could not open " << path << std::endl;
+        return false;
+    }
+    lock(false);
+    log_records = records;
+    return true;
+}
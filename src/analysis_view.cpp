@@ -0,0 +1,121 @@
+#include "analysis_view.hpp"
+#include "search.hpp"
+#include "trace.hpp"
+#include "frame_profiler.hpp"
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+    // Function used to format a score from white's point of view as "+0.35" or "#-3"
+    std::string formatScore(int score) {
+        std::ostringstream text;
+        if (isMateScore(score)) {
+            text << '#' << mateInMoves(score);
+        }
+        else {
+            text << std::showpos << std::fixed << std::setprecision(2) << score / 100.0;
+        }
+        return text.str();
+    }
+
+    // Function used to get white's share of the evaluation bar, the expected score of a
+    // player that many Elo points stronger so that equal positions fill half the bar
+    float whiteShare(int score) {
+        if (isMateScore(score)) {
+            return (score > 0) ? 1.0f : 0.0f;
+        }
+        return static_cast<float>(1.0 / (1.0 + std::pow(10.0, -score / 400.0)));
+    }
+}
+
+AnalysisView::AnalysisView(float board_size, float bar_width) :
+    board_size(board_size),
+    square_size(board_size / 8),
+    arrows(sf::Triangles)
+{
+    bar_background.setSize(sf::Vector2f(bar_width, board_size));
+    bar_background.setPosition(board_size, 0);
+    bar_background.setFillColor(sf::Color(64, 61, 57));
+    bar_white.setFillColor(sf::Color(240, 240, 240));
+    bar_middle.setSize(sf::Vector2f(bar_width, 2));
+    bar_middle.setPosition(board_size, board_size / 2 - 1);
+    bar_middle.setFillColor(sf::Color(128, 128, 128));
+    clear();
+}
+
+void AnalysisView::clear() {
+    shown = AnalysisUpdate();
+    arrows.clear();
+    // An even bar until the first line arrives
+    bar_white.setSize(sf::Vector2f(bar_background.getSize().x, board_size / 2));
+    bar_white.setPosition(board_size, board_size / 2);
+}
+
+void AnalysisView::setUpdate(const AnalysisUpdate& update) {
+    shown = update;
+    shown.line_count = std::clamp(update.line_count, 0, AnalysisUpdate::max_lines);
+    arrows.clear();
+    for (int i = shown.line_count - 1; i >= 0; i--) {
+        const AnalysisLine& line = shown.lines[i];
+        if (!line.move.isValid()) {
+            continue;
+        }
+        // Weaker lines are thinner and fainter
+        float width = square_size * (0.2f - 0.015f * i);
+        sf::Uint8 alpha = static_cast<sf::Uint8>(std::max(60, 200 - 25 * i));
+        appendArrow(line.move, width, (i == 0) ? sf::Color(20, 120, 40, alpha) : sf::Color(40, 90, 160, alpha));
+    }
+    if (shown.line_count > 0) {
+        float white_height = board_size * whiteShare(shown.lines[0].score);
+        bar_white.setSize(sf::Vector2f(bar_background.getSize().x, white_height));
+        bar_white.setPosition(board_size, board_size - white_height);
+    }
+}
+
+std::string AnalysisView::summary() const {
+    if (shown.line_count == 0) {
+        return "";
+    }
+    std::string text = "depth " + std::to_string(shown.lines[0].depth);
+    for (int i = 0; i < shown.line_count; i++) {
+        text += "  " + formatScore(shown.lines[i].score) + ' ' + shown.lines[i].move.toString();
+    }
+    return text;
+}
+
+void AnalysisView::appendArrow(const Move& move, float width, const sf::Color& color) {
+    sf::Vector2f start(square_size * (move.start_file + 0.5f), square_size * (move.start_rank + 0.5f));
+    sf::Vector2f end(square_size * (move.target_file + 0.5f), square_size * (move.target_rank + 0.5f));
+    sf::Vector2f delta = end - start;
+    float length = std::sqrt(delta.x * delta.x + delta.y * delta.y);
+    if (length <= 0) {
+        return;
+    }
+    sf::Vector2f direction = delta / length;
+    sf::Vector2f normal(-direction.y, direction.x);
+    float head_length = std::min(square_size * 0.45f, length / 2);
+    sf::Vector2f neck = end - direction * head_length;
+    sf::Vector2f shaft = normal * (width / 2);
+    sf::Vector2f head = normal * (width * 1.3f);
+    // Shaft as two triangles and the head as a third
+    const sf::Vector2f points[] = {
+        start + shaft, start - shaft, neck - shaft,
+        start + shaft, neck - shaft, neck + shaft,
+        neck + head, neck - head, end
+    };
+    for (const sf::Vector2f& point : points) {
+        arrows.append(sf::Vertex(point, color));
+    }
+}
+
+void AnalysisView::draw(sf::RenderTarget& renderTarget, sf::RenderStates renderStates) const {
+    CHESS_TRACE_COUNT(Draw);
+    renderTarget.draw(bar_background, renderStates);
+    renderTarget.draw(bar_white, renderStates);
+    renderTarget.draw(bar_middle, renderStates);
+    renderTarget.draw(arrows, renderStates);
+    FrameProfiler::countDrawCalls(4);
+}
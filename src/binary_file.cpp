@@ -0,0 +1,97 @@
+#include "binary_file.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#if defined(__unix__) || defined(__APPLE__)
+#define BINARY_FILE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool isLittleEndian() {
+    const std::uint16_t value = 1;
+    std::uint8_t first;
+    std::memcpy(&first, &value, 1);
+    return first == 1;
+}
+
+void writeLittleEndian(std::uint8_t* bytes, std::uint64_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        bytes[i] = static_cast<std::uint8_t>(value >> (8 * i));
+    }
+}
+
+std::uint64_t readLittleEndian(const std::uint8_t* bytes, int size) {
+    std::uint64_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value |= static_cast<std::uint64_t>(bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+void MappedFile::close() {
+#ifdef BINARY_FILE_MMAP
+    if (mapping != nullptr) {
+        ::munmap(mapping, file_size);
+    }
+#endif
+    mapping = nullptr;
+    contents = nullptr;
+    file_size = 0;
+    buffer.clear();
+    buffer.shrink_to_fit();
+}
+
+bool MappedFile::map(const std::string& path, Access access) {
+    close();
+#ifdef BINARY_FILE_MMAP
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if (descriptor != -1 && ::fstat(descriptor, &status) != -1 && status.st_size > 0) {
+        std::size_t length = static_cast<std::size_t>(status.st_size);
+        void* address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (address != MAP_FAILED) {
+            mapping = address;
+            contents = static_cast<const std::uint8_t*>(address);
+            file_size = length;
+            ::madvise(address, length, (access == Access::Sequential) ? MADV_SEQUENTIAL : MADV_RANDOM);
+        }
+    }
+    // The mapping stays valid after the descriptor is closed
+    if (descriptor != -1) {
+        ::close(descriptor);
+    }
+#else
+    (void)path;
+    (void)access;
+#endif
+    return mapping != nullptr;
+}
+
+bool MappedFile::open(const std::string& path, Access access) {
+    if (map(path, access)) {
+        return true;
+    }
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        std::cerr << "Could not open " << path << std::endl;
+        return false;
+    }
+    file_size = static_cast<std::size_t>(file.tellg());
+    buffer.resize((file_size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(file_size));
+    if (!file) {
+        std::cerr << "Could not read " << path << std::endl;
+        close();
+        return false;
+    }
+    contents = (file_size > 0) ? reinterpret_cast<const std::uint8_t*>(buffer.data()) : nullptr;
+    return true;
+}
@@ -0,0 +1,41 @@
+#include "board_assets.hpp"
+#include <SFML/Graphics.hpp>
+#include <SFML/Audio.hpp>
+#include "piece.hpp"
+#include "board_diagram.hpp"
+#include <iostream>
+#include <memory>
+
+BoardAssets::BoardAssets() {
+    // Load piece textures
+    if (!piece_texture.loadFromFile("../res/pieces/maestro/maestro_pieces.png")) {
+        std::cout << "Load failed" << std::endl;
+        system("pause");
+    }
+    piece_texture.setSmooth(true);
+    // Load sound files
+    if (!sound_buffers[0].loadFromFile("../res/sounds/move.ogg")) {
+        std::cout << "Load failed" << std::endl;
+        system("pause");
+    }
+    if (!sound_buffers[1].loadFromFile("../res/sounds/capture.ogg")) {
+        std::cout << "Load failed" << std::endl;
+        system("pause");
+    }
+}
+
+std::shared_ptr<const BoardAssets> BoardAssets::shared() {
+    static std::weak_ptr<const BoardAssets> cache;
+    std::shared_ptr<const BoardAssets> assets = cache.lock();
+    if (!assets) {
+        assets.reset(new BoardAssets());
+        cache = assets;
+    }
+    return assets;
+}
+
+sf::IntRect BoardAssets::pieceRect(const Piece& piece) {
+    int column, row;
+    diagramAtlasCell(piece, column, row);
+    return sf::IntRect(sprite_size * column, sprite_size * row, sprite_size, sprite_size);
+}
@@ -0,0 +1,134 @@
+#include "board_diagram.hpp"
+#include "position.hpp"
+#include "piece.hpp"
+#include "move.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+    // Size of a piece sprite and of the whole sprite sheet in pixels
+    const int sprite_size = 189;
+    const int atlas_width = sprite_size * 6;
+    const int atlas_height = sprite_size * 2;
+
+    void appendColor(std::string& svg, const char* attribute, const unsigned char (&rgba)[4]) {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), " %s=\"#%02x%02x%02x\"", attribute, rgba[0], rgba[1], rgba[2]);
+        svg += buffer;
+        if (rgba[3] != 255) {
+            std::snprintf(buffer, sizeof(buffer), " %s-opacity=\"%.3g\"", attribute, rgba[3] / 255.0);
+            svg += buffer;
+        }
+    }
+
+    // Function used to append a one unit square at the board coordinates of a square
+    void appendSquare(std::string& svg, int column, int row, const unsigned char (&rgba)[4]) {
+        svg += "<rect x=\"" + std::to_string(column) + "\" y=\"" + std::to_string(row)
+               + "\" width=\"1\" height=\"1\"";
+        appendColor(svg, "fill", rgba);
+        svg += "/>";
+    }
+
+    std::string xmlEscape(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            switch (c) {
+                case '&': escaped += "&amp;"; break;
+                case '<': escaped += "&lt;"; break;
+                case '>': escaped += "&gt;"; break;
+                case '"': escaped += "&quot;"; break;
+                default: escaped += c;
+            }
+        }
+        return escaped;
+    }
+}
+
+void diagramAtlasCell(const Piece& piece, int& column, int& row) {
+    // Column of every piece type in the sprite sheet indexed by Piece::Type
+    const int columns[] = {0, 1, 3, 2, 0, 5, 4};
+    column = columns[piece.type];
+    row = (piece.color == Piece::Color::White) ? 1 : 0;
+}
+
+std::string renderSvg(const Position& position, const DiagramOptions& options) {
+    std::string svg;
+    svg.reserve(4096);
+    // The view box is 8 units wide so every square is one unit
+    svg += "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\""
+           + std::to_string(options.size) + "\" height=\"" + std::to_string(options.size)
+           + "\" viewBox=\"0 0 8 8\" shape-rendering=\"crispEdges\">";
+    svg += "<defs><image id=\"atlas\" width=\"" + std::to_string(atlas_width) + "\" height=\""
+           + std::to_string(atlas_height) + "\" xlink:href=\"" + xmlEscape(options.piece_atlas) + "\"/></defs>";
+
+    // Dark board with the light squares drawn on top
+    svg += "<rect width=\"8\" height=\"8\"";
+    appendColor(svg, "fill", DiagramColors::dark);
+    svg += "/>";
+    for (int row = 0; row < 8; row++) {
+        for (int column = row % 2; column < 8; column += 2) {
+            appendSquare(svg, column, row, DiagramColors::light);
+        }
+    }
+
+    auto column_of = [&](int file) { return options.flipped ? 7 - file : file; };
+    auto row_of = [&](int rank) { return options.flipped ? 7 - rank : rank; };
+    const Move& last_move = options.last_move;
+    if (last_move.isValid()) {
+        appendSquare(svg, column_of(last_move.start_file), row_of(last_move.start_rank), DiagramColors::highlight);
+        appendSquare(svg, column_of(last_move.target_file), row_of(last_move.target_rank), DiagramColors::highlight);
+    }
+    Piece::Color side = position.activeColor();
+    if (options.show_check && position.inCheck(side)) {
+        for (int file = 0; file < 8; file++) {
+            for (int rank = 0; rank < 8; rank++) {
+                const Piece& piece = position.pieceAt(file, rank);
+                if (piece.type == Piece::Type::King && piece.color == side) {
+                    appendSquare(svg, column_of(file), row_of(rank), DiagramColors::check);
+                }
+            }
+        }
+    }
+
+    // Every piece is a one unit viewport onto its cell of the sprite sheet
+    for (int file = 0; file < 8; file++) {
+        for (int rank = 0; rank < 8; rank++) {
+            const Piece& piece = position.pieceAt(file, rank);
+            if (piece.type == Piece::Type::None) {
+                continue;
+            }
+            int atlas_column, atlas_row;
+            diagramAtlasCell(piece, atlas_column, atlas_row);
+            svg += "<svg x=\"" + std::to_string(column_of(file)) + "\" y=\"" + std::to_string(row_of(rank))
+                   + "\" width=\"1\" height=\"1\" viewBox=\"" + std::to_string(atlas_column * sprite_size) + ' '
+                   + std::to_string(atlas_row * sprite_size) + ' ' + std::to_string(sprite_size) + ' '
+                   + std::to_string(sprite_size) + "\"><use xlink:href=\"#atlas\"/></svg>";
+        }
+    }
+    svg += "</svg>\n";
+    return svg;
+}
+
+std::string fileDataUri(const std::string& path, const std::string& mime_type) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return "";
+    }
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::string uri = "data:" + mime_type + ";base64,";
+    uri.reserve(uri.size() + (bytes.size() + 2) / 3 * 4);
+    for (std::size_t i = 0; i < bytes.size(); i += 3) {
+        unsigned int chunk = bytes[i] << 16;
+        if (i + 1 < bytes.size()) chunk |= bytes[i + 1] << 8;
+        if (i + 2 < bytes.size()) chunk |= bytes[i + 2];
+        uri += alphabet[(chunk >> 18) & 63];
+        uri += alphabet[(chunk >> 12) & 63];
+        uri += (i + 1 < bytes.size()) ? alphabet[(chunk >> 6) & 63] : '=';
+        uri += (i + 2 < bytes.size()) ? alphabet[chunk & 63] : '=';
+    }
+    return uri;
+}
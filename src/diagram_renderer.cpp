@@ -0,0 +1,140 @@
+#include "diagram_renderer.hpp"
+#include "board_assets.hpp"
+#include "board_diagram.hpp"
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    sf::Color toColor(const unsigned char (&rgba)[4]) {
+        return sf::Color(rgba[0], rgba[1], rgba[2], rgba[3]);
+    }
+
+    // Function used to append a quad to a vertex array of quads
+    void appendQuad(sf::VertexArray& vertices, const sf::FloatRect& area, const sf::Color& color,
+                    const sf::IntRect& texture_rect = sf::IntRect()) {
+        float left = static_cast<float>(texture_rect.left);
+        float top = static_cast<float>(texture_rect.top);
+        float right = left + texture_rect.width;
+        float bottom = top + texture_rect.height;
+        vertices.append(sf::Vertex(sf::Vector2f(area.left, area.top), color, sf::Vector2f(left, top)));
+        vertices.append(sf::Vertex(sf::Vector2f(area.left + area.width, area.top), color, sf::Vector2f(right, top)));
+        vertices.append(sf::Vertex(sf::Vector2f(area.left + area.width, area.top + area.height), color,
+                                   sf::Vector2f(right, bottom)));
+        vertices.append(sf::Vertex(sf::Vector2f(area.left, area.top + area.height), color, sf::Vector2f(left, bottom)));
+    }
+}
+
+DiagramRenderer::DiagramRenderer() :
+    assets(BoardAssets::shared()),
+    squares(sf::Quads),
+    pieces(sf::Quads)
+{
+}
+
+bool DiagramRenderer::render(const Position& position, const DiagramOptions& options, sf::Image& image) {
+    unsigned int size = static_cast<unsigned int>(std::max(8, options.size));
+    // The texture is only recreated when the size changes
+    if (size != texture_size) {
+        if (!texture.create(size, size)) {
+            std::cerr << "Could not create a " << size << "x" << size << " render texture" << std::endl;
+            texture_size = 0;
+            return false;
+        }
+        texture.setSmooth(true);
+        texture_size = size;
+    }
+
+    squares.clear();
+    pieces.clear();
+    float square_size = static_cast<float>(size) / 8;
+    auto area = [&](int file, int rank) {
+        int column = options.flipped ? 7 - file : file;
+        int row = options.flipped ? 7 - rank : rank;
+        return sf::FloatRect(square_size * column, square_size * row, square_size, square_size);
+    };
+    const Move& last_move = options.last_move;
+    Piece::Color side = position.activeColor();
+    bool check = options.show_check && position.inCheck(side);
+    for (int file = 0; file < 8; file++) {
+        for (int rank = 0; rank < 8; rank++) {
+            bool is_light_square = (file + rank) % 2 == 0;
+            appendQuad(squares, area(file, rank), toColor(is_light_square ? DiagramColors::light : DiagramColors::dark));
+            // Highlights are blended over the square
+            if (last_move.isValid()
+                && ((file == last_move.start_file && rank == last_move.start_rank)
+                    || (file == last_move.target_file && rank == last_move.target_rank))) {
+                appendQuad(squares, area(file, rank), toColor(DiagramColors::highlight));
+            }
+            const Piece& piece = position.pieceAt(file, rank);
+            if (check && piece.type == Piece::Type::King && piece.color == side) {
+                appendQuad(squares, area(file, rank), toColor(DiagramColors::check));
+            }
+            if (piece.type != Piece::Type::None) {
+                appendQuad(pieces, area(file, rank), sf::Color::White, BoardAssets::pieceRect(piece));
+            }
+        }
+    }
+
+    texture.clear();
+    texture.draw(squares);
+    texture.draw(pieces, sf::RenderStates(&assets->pieceTexture()));
+    texture.display();
+    image = texture.getTexture().copyToImage();
+    return true;
+}
+
+DiagramEncoder::DiagramEncoder(int threads) :
+    window(static_cast<std::size_t>(std::max(1, threads)) * 4)
+{
+    for (int i = 0; i < std::max(1, threads); i++) {
+        workers.emplace_back(&DiagramEncoder::work, this);
+    }
+}
+
+DiagramEncoder::~DiagramEncoder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    job_available.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void DiagramEncoder::save(sf::Image image, std::string path) {
+    std::unique_lock<std::mutex> lock(mutex);
+    space_available.wait(lock, [this] { return jobs.size() < window; });
+    jobs.emplace_back(std::move(image), std::move(path));
+    job_available.notify_one();
+}
+
+std::size_t DiagramEncoder::finish() {
+    std::unique_lock<std::mutex> lock(mutex);
+    space_available.wait(lock, [this] { return jobs.empty() && busy == 0; });
+    return failures;
+}
+
+void DiagramEncoder::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        job_available.wait(lock, [this] { return closed || !jobs.empty(); });
+        if (jobs.empty()) {
+            return;
+        }
+        std::pair<sf::Image, std::string> job = std::move(jobs.front());
+        jobs.pop_front();
+        busy++;
+        space_available.notify_all();
+        // Encode without holding the lock
+        lock.unlock();
+        bool saved = job.first.saveToFile(job.second);
+        lock.lock();
+        busy--;
+        if (!saved) {
+            failures++;
+        }
+        space_available.notify_all();
+    }
+}
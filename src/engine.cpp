@@ -0,0 +1,113 @@
+#include "engine.hpp"
+#include "position.hpp"
+#include "search.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+Engine::Engine() {
+}
+
+Engine::~Engine() {
+    stop();
+    wait();
+}
+
+void Engine::setHashSize(std::size_t megabytes) {
+    wait();
+    tt.resize(megabytes);
+}
+
+void Engine::setThreads(int count) {
+    wait();
+    thread_count = std::max(1, count);
+}
+
+bool Engine::openAnalysisCache(const std::string& path, std::size_t megabytes) {
+    wait();
+    if (path.empty()) {
+        cache.close();
+        return true;
+    }
+    return cache.open(path, megabytes);
+}
+
+void Engine::clear() {
+    wait();
+    tt.clear();
+}
+
+void Engine::go(const Position& position, const SearchLimits& limits,
+                const Search::InfoCallback& on_info, const BestMoveCallback& on_bestmove) {
+    wait();
+    stop_flag.store(false);
+    ponder_flag.store(limits.ponder);
+    search_thread = std::thread([this, position, limits, on_info, on_bestmove] {
+        CHESS_TRACE_SCOPE("search");
+        // Helper threads search the same position without limits of their own
+        // and are only there to fill the shared transposition table
+        SearchLimits helper_limits;
+        helper_limits.depth = limits.depth;
+        helper_limits.infinite = true;
+        std::vector<std::unique_ptr<Search>> helpers;
+        std::vector<std::thread> helper_threads;
+        for (int i = 1; i < thread_count; i++) {
+            helpers.push_back(std::make_unique<Search>(tt, stop_flag));
+            Search* helper = helpers.back().get();
+            helper->setAnalysisCache(cache.isOpen() ? &cache : nullptr);
+            helper_threads.emplace_back([helper, &position, &helper_limits] {
+                helper->run(position, helper_limits);
+            });
+        }
+
+        Search main_search(tt, stop_flag, &ponder_flag);
+        main_search.setAnalysisCache(cache.isOpen() ? &cache : nullptr);
+        SearchInfo result = main_search.run(position, limits, [&](const SearchInfo& info) {
+            SearchInfo total = info;
+            for (const auto& helper : helpers) {
+                total.nodes += helper->nodes();
+            }
+            on_info(total);
+        });
+        // An infinite search may only report its best move once it has been stopped
+        // and a ponder search once the ponder move was played
+        if (limits.infinite || limits.ponder) {
+            std::unique_lock<std::mutex> lock(stop_mutex);
+            stop_condition.wait(lock, [this, &limits] {
+                return stop_flag.load() || (!limits.infinite && !ponder_flag.load());
+            });
+        }
+        stop_flag.store(true);
+        for (std::thread& helper_thread : helper_threads) {
+            helper_thread.join();
+        }
+        for (const auto& helper : helpers) {
+            result.nodes += helper->nodes();
+        }
+        on_bestmove(result);
+    });
+}
+
+void Engine::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex);
+        stop_flag.store(true);
+    }
+    stop_condition.notify_all();
+}
+
+void Engine::ponderHit() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex);
+        ponder_flag.store(false);
+    }
+    stop_condition.notify_all();
+}
+
+void Engine::wait() {
+    if (search_thread.joinable()) {
+        search_thread.join();
+    }
+}
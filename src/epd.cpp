@@ -0,0 +1,86 @@
+#include "epd.hpp"
+#include <cctype>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+    bool isNumber(const std::string& token) {
+        if (token.empty()) {
+            return false;
+        }
+        for (char c : token) {
+            if (!std::isdigit(static_cast<unsigned char>(c))) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+bool parseEpdLine(const std::string& line, EpdRecord& record) {
+    record.fen.clear();
+    record.operations.clear();
+
+    std::istringstream input(line);
+    std::vector<std::string> fields;
+    std::string token;
+    // Piece placement, active color, castling availability and en passant target square
+    while (fields.size() < 4 && input >> token) {
+        fields.push_back(token);
+    }
+    if (fields.empty() || fields[0][0] == '#') {
+        return false;
+    }
+    for (const std::string& field : fields) {
+        record.fen += (record.fen.empty() ? "" : " ") + field;
+    }
+    // A FEN has the clocks next, an EPD record has operations instead
+    std::string clocks = " 0 1";
+    std::streampos operations_start = input.tellg();
+    std::string halfmove, fullmove;
+    if (input >> halfmove >> fullmove && isNumber(halfmove) && isNumber(fullmove)) {
+        clocks = " " + halfmove + " " + fullmove;
+    } else {
+        input.clear();
+        input.seekg(operations_start);
+    }
+    record.fen += clocks;
+
+    // Operations are "<opcode> <operand>...;" with operands optionally quoted
+    std::string rest;
+    std::getline(input, rest);
+    std::size_t i = 0;
+    while (i < rest.size()) {
+        while (i < rest.size() && std::isspace(static_cast<unsigned char>(rest[i]))) {
+            i++;
+        }
+        std::size_t opcode_end = i;
+        while (opcode_end < rest.size() && !std::isspace(static_cast<unsigned char>(rest[opcode_end]))
+               && rest[opcode_end] != ';') {
+            opcode_end++;
+        }
+        if (opcode_end == i) {
+            i++;
+            continue;
+        }
+        std::string opcode = rest.substr(i, opcode_end - i);
+        std::string operand;
+        bool quoted = false;
+        for (i = opcode_end; i < rest.size() && (quoted || rest[i] != ';'); i++) {
+            if (rest[i] == '"') {
+                quoted = !quoted;
+                continue;
+            }
+            if (!operand.empty() || !std::isspace(static_cast<unsigned char>(rest[i]))) {
+                operand += rest[i];
+            }
+        }
+        while (!operand.empty() && std::isspace(static_cast<unsigned char>(operand.back()))) {
+            operand.pop_back();
+        }
+        record.operations[opcode] = operand;
+        i++;
+    }
+    return true;
+}
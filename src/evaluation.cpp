@@ -0,0 +1,116 @@
+#include "evaluation.hpp"
+#include "position.hpp"
+#include "piece.hpp"
+#include <array>
+
+namespace {
+    // Piece-square tables from White's point of view structured as [rank][file]
+    // with the rank going in decending order i.e. 8 to 1, the same as the board
+    using Table = std::array<std::array<int, 8>, 8>;
+
+    constexpr Table pawn_table = {{
+        {{  0,   0,   0,   0,   0,   0,   0,   0}},
+        {{ 50,  50,  50,  50,  50,  50,  50,  50}},
+        {{ 10,  10,  20,  30,  30,  20,  10,  10}},
+        {{  5,   5,  10,  25,  25,  10,   5,   5}},
+        {{  0,   0,   0,  20,  20,   0,   0,   0}},
+        {{  5,  -5, -10,   0,   0, -10,  -5,   5}},
+        {{  5,  10,  10, -20, -20,  10,  10,   5}},
+        {{  0,   0,   0,   0,   0,   0,   0,   0}}
+    }};
+
+    constexpr Table knight_table = {{
+        {{-50, -40, -30, -30, -30, -30, -40, -50}},
+        {{-40, -20,   0,   0,   0,   0, -20, -40}},
+        {{-30,   0,  10,  15,  15,  10,   0, -30}},
+        {{-30,   5,  15,  20,  20,  15,   5, -30}},
+        {{-30,   0,  15,  20,  20,  15,   0, -30}},
+        {{-30,   5,  10,  15,  15,  10,   5, -30}},
+        {{-40, -20,   0,   5,   5,   0, -20, -40}},
+        {{-50, -40, -30, -30, -30, -30, -40, -50}}
+    }};
+
+    constexpr Table bishop_table = {{
+        {{-20, -10, -10, -10, -10, -10, -10, -20}},
+        {{-10,   0,   0,   0,   0,   0,   0, -10}},
+        {{-10,   0,   5,  10,  10,   5,   0, -10}},
+        {{-10,   5,   5,  10,  10,   5,   5, -10}},
+        {{-10,   0,  10,  10,  10,  10,   0, -10}},
+        {{-10,  10,  10,  10,  10,  10,  10, -10}},
+        {{-10,   5,   0,   0,   0,   0,   5, -10}},
+        {{-20, -10, -10, -10, -10, -10, -10, -20}}
+    }};
+
+    constexpr Table rook_table = {{
+        {{  0,   0,   0,   0,   0,   0,   0,   0}},
+        {{  5,  10,  10,  10,  10,  10,  10,   5}},
+        {{ -5,   0,   0,   0,   0,   0,   0,  -5}},
+        {{ -5,   0,   0,   0,   0,   0,   0,  -5}},
+        {{ -5,   0,   0,   0,   0,   0,   0,  -5}},
+        {{ -5,   0,   0,   0,   0,   0,   0,  -5}},
+        {{ -5,   0,   0,   0,   0,   0,   0,  -5}},
+        {{  0,   0,   0,   5,   5,   0,   0,   0}}
+    }};
+
+    constexpr Table queen_table = {{
+        {{-20, -10, -10,  -5,  -5, -10, -10, -20}},
+        {{-10,   0,   0,   0,   0,   0,   0, -10}},
+        {{-10,   0,   5,   5,   5,   5,   0, -10}},
+        {{ -5,   0,   5,   5,   5,   5,   0,  -5}},
+        {{  0,   0,   5,   5,   5,   5,   0,  -5}},
+        {{-10,   5,   5,   5,   5,   5,   0, -10}},
+        {{-10,   0,   5,   0,   0,   0,   0, -10}},
+        {{-20, -10, -10,  -5,  -5, -10, -10, -20}}
+    }};
+
+    constexpr Table king_table = {{
+        {{-30, -40, -40, -50, -50, -40, -40, -30}},
+        {{-30, -40, -40, -50, -50, -40, -40, -30}},
+        {{-30, -40, -40, -50, -50, -40, -40, -30}},
+        {{-30, -40, -40, -50, -50, -40, -40, -30}},
+        {{-20, -30, -30, -40, -40, -30, -30, -20}},
+        {{-10, -20, -20, -20, -20, -20, -20, -10}},
+        {{ 20,  20,   0,   0,   0,   0,  20,  20}},
+        {{ 20,  30,  10,   0,   0,  10,  30,  20}}
+    }};
+
+    // Tables indexed by Piece::Type
+    constexpr std::array<const Table*, 7> tables = {
+        nullptr, &king_table, &pawn_table, &knight_table, &bishop_table, &rook_table, &queen_table
+    };
+}
+
+int evaluate(const Position& position) {
+    int score = 0;
+    for (int file = 0; file < 8; file++) {
+        for (int rank = 0; rank < 8; rank++) {
+            const Piece& piece = position.pieceAt(file, rank);
+            if (piece.type == Piece::Type::None) {
+                continue;
+            }
+            // Black uses the tables mirrored vertically
+            if (piece.color == Piece::Color::White) {
+                score += piece_values[piece.type] + (*tables[piece.type])[rank][file];
+            } else {
+                score -= piece_values[piece.type] + (*tables[piece.type])[7 - rank][file];
+            }
+        }
+    }
+    return (position.activeColor() == Piece::Color::White) ? score : -score;
+}
+
+std::array<int, evaluation_weight_count> evaluationWeights() {
+    std::array<int, evaluation_weight_count> weights{};
+    for (int type = 0; type < 7; type++) {
+        weights[type] = piece_values[type];
+        if (tables[type] == nullptr) {
+            continue;
+        }
+        for (int rank = 0; rank < 8; rank++) {
+            for (int file = 0; file < 8; file++) {
+                weights[piece_square_weights_offset + type * 64 + rank * 8 + file] = (*tables[type])[rank][file];
+            }
+        }
+    }
+    return weights;
+}
@@ -0,0 +1,263 @@
+#include "frame_profiler.hpp"
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+FrameProfiler* FrameProfiler::running = nullptr;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Glyph {
+        char character;
+        // Three bits per row from the top row down, the left pixel in the highest bit
+        std::uint16_t rows;
+    };
+
+    constexpr Glyph glyphs[] = {
+        {'0', 0b111'101'101'101'111}, {'1', 0b010'110'010'010'111}, {'2', 0b111'001'111'100'111},
+        {'3', 0b111'001'111'001'111}, {'4', 0b101'101'111'001'001}, {'5', 0b111'100'111'001'111},
+        {'6', 0b111'100'111'101'111}, {'7', 0b111'001'001'001'001}, {'8', 0b111'101'111'101'111},
+        {'9', 0b111'101'111'001'111}, {'A', 0b010'101'111'101'101}, {'B', 0b110'101'110'101'110},
+        {'C', 0b011'100'100'100'011}, {'D', 0b110'101'101'101'110}, {'E', 0b111'100'110'100'111},
+        {'F', 0b111'100'110'100'100}, {'G', 0b011'100'101'101'011}, {'H', 0b101'101'111'101'101},
+        {'I', 0b111'010'010'010'111}, {'J', 0b001'001'001'101'010}, {'K', 0b101'101'110'101'101},
+        {'L', 0b100'100'100'100'111}, {'M', 0b101'111'111'101'101}, {'N', 0b110'101'101'101'101},
+        {'O', 0b010'101'101'101'010}, {'P', 0b110'101'110'100'100}, {'Q', 0b010'101'101'110'011},
+        {'R', 0b110'101'110'101'101}, {'S', 0b011'100'010'001'110}, {'T', 0b111'010'010'010'010},
+        {'U', 0b101'101'101'101'111}, {'V', 0b101'101'101'101'010}, {'W', 0b101'101'111'111'101},
+        {'X', 0b101'101'010'101'101}, {'Y', 0b101'101'010'010'010}, {'Z', 0b111'001'010'100'111},
+        {'.', 0b000'000'000'000'010}, {':', 0b000'010'000'010'000}, {'-', 0b000'000'111'000'000},
+        {'/', 0b001'001'010'100'100}
+    };
+
+    // Layout of the overlay in view coordinates
+    constexpr float margin = 8;
+    constexpr float padding = 4;
+    constexpr float pixel = 3;
+    constexpr float line_height = 6 * pixel;
+    constexpr int text_lines = 5;
+    constexpr float bar_width = 3;
+    constexpr float graph_height = 60;
+    // Frame time of 60 FPS, drawn as a line halfway up the graph
+    constexpr float frame_budget_ms = 1000.0f / 60;
+
+    float milliseconds(Clock::duration duration) {
+        return std::chrono::duration<float, std::milli>(duration).count();
+    }
+
+    std::uint16_t glyphRows(char character) {
+        for (const Glyph& glyph : glyphs) {
+            if (glyph.character == character) {
+                return glyph.rows;
+            }
+        }
+        // Spaces and unknown characters are left blank
+        return 0;
+    }
+
+    void appendRectangle(sf::VertexArray& vertices, float x, float y, float width, float height, const sf::Color& color) {
+        vertices.append(sf::Vertex(sf::Vector2f(x, y), color));
+        vertices.append(sf::Vertex(sf::Vector2f(x + width, y), color));
+        vertices.append(sf::Vertex(sf::Vector2f(x + width, y + height), color));
+        vertices.append(sf::Vertex(sf::Vector2f(x, y + height), color));
+    }
+
+    // Function used to append a line of text as one quad per lit pixel
+    void appendText(sf::VertexArray& vertices, const std::string& line, float x, float y, const sf::Color& color) {
+        for (char character : line) {
+            std::uint16_t rows = glyphRows(character);
+            for (int row = 0; row < 5; row++) {
+                for (int column = 0; column < 3; column++) {
+                    if ((rows >> (14 - row * 3 - column)) & 1) {
+                        appendRectangle(vertices, x + column * pixel, y + row * pixel, pixel, pixel, color);
+                    }
+                }
+            }
+            x += 4 * pixel;
+        }
+    }
+
+    std::string formatMilliseconds(float value) {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(value < 10 ? 2 : 1) << value;
+        return text.str();
+    }
+}
+
+FrameProfiler::ScopedPhase::ScopedPhase(Phase phase) :
+    phase(phase),
+    start(Clock::now())
+{
+}
+
+FrameProfiler::ScopedPhase::~ScopedPhase() {
+    if (running != nullptr) {
+        running->current.phase_ms[static_cast<std::size_t>(phase)] += milliseconds(Clock::now() - start);
+    }
+}
+
+FrameProfiler::FrameProfiler() :
+    history(history_size),
+    text(sf::Quads),
+    graph(sf::Quads)
+{
+    background.setPosition(margin, margin);
+    background.setSize(sf::Vector2f(2 * padding + bar_width * graph_frames,
+                                    3 * padding + text_lines * line_height + graph_height));
+    background.setFillColor(sf::Color(0, 0, 0, 170));
+}
+
+FrameProfiler::~FrameProfiler() {
+    if (running == this) {
+        running = nullptr;
+    }
+}
+
+bool FrameProfiler::openLog(const std::string& path) {
+    log.open(path);
+    if (!log) {
+        std::cerr << "Could not create " << path << std::endl;
+        return false;
+    }
+    log << "frame,frame_ms,events_ms,next_move_ms,draw_ms,display_ms,draw_calls,input_ms,click_to_pixel_ms\n";
+    return true;
+}
+
+void FrameProfiler::beginFrame() {
+    current = FrameRecord();
+    frame_start = Clock::now();
+    running = this;
+}
+
+void FrameProfiler::endFrame() {
+    Clock::time_point end = Clock::now();
+    current.frame_ms = milliseconds(end - frame_start);
+    // The frame handling the input has just been displayed
+    if (input_pending) {
+        current.pixel_ms = milliseconds(end - input_start);
+        input_pending = false;
+    }
+    running = nullptr;
+    history[frame_count % history_size] = current;
+    frame_count++;
+
+    if (log.is_open()) {
+        log << frame_count << ',' << current.frame_ms;
+        for (float phase_ms : current.phase_ms) {
+            log << ',' << phase_ms;
+        }
+        log << ',' << current.draw_calls << ',';
+        if (current.input_ms >= 0) {
+            log << current.input_ms;
+        }
+        log << ',';
+        if (current.pixel_ms >= 0) {
+            log << current.pixel_ms;
+        }
+        log << '\n';
+    }
+    if (overlay_visible) {
+        updateGraph();
+        if (frame_count % text_interval == 0 || text.getVertexCount() == 0) {
+            updateText();
+        }
+    }
+}
+
+void FrameProfiler::inputReceived() {
+    input_start = Clock::now();
+    input_pending = true;
+}
+
+void FrameProfiler::inputHandled() {
+    if (input_pending) {
+        current.input_ms = milliseconds(Clock::now() - input_start);
+    }
+}
+
+void FrameProfiler::countDrawCalls(std::size_t count) {
+    if (running != nullptr) {
+        running->current.draw_calls += static_cast<std::uint32_t>(count);
+    }
+}
+
+void FrameProfiler::updateText() {
+    std::size_t frames = static_cast<std::size_t>(std::min<std::uint64_t>(frame_count, history_size));
+    if (frames == 0) {
+        return;
+    }
+    std::vector<float> frame_times;
+    frame_times.reserve(frames);
+    std::array<float, static_cast<std::size_t>(Phase::Count)> phase_totals{};
+    std::uint64_t draw_calls = 0;
+    // Latencies of the most recent input
+    float input_ms = -1, pixel_ms = -1;
+    for (std::uint64_t i = frame_count - frames; i < frame_count; i++) {
+        const FrameRecord& record = history[i % history_size];
+        frame_times.push_back(record.frame_ms);
+        for (std::size_t phase = 0; phase < phase_totals.size(); phase++) {
+            phase_totals[phase] += record.phase_ms[phase];
+        }
+        draw_calls += record.draw_calls;
+        if (record.input_ms >= 0) {
+            input_ms = record.input_ms;
+        }
+        if (record.pixel_ms >= 0) {
+            pixel_ms = record.pixel_ms;
+        }
+    }
+    auto percentile = [&frame_times](std::size_t percent) {
+        auto nth = frame_times.begin() + static_cast<std::ptrdiff_t>(std::min(frame_times.size() - 1,
+                                                                              frame_times.size() * percent / 100));
+        std::nth_element(frame_times.begin(), nth, frame_times.end());
+        return *nth;
+    };
+    auto mean = [frames](float total) { return formatMilliseconds(total / frames); };
+    float p50 = percentile(50);
+    float p99 = percentile(99);
+    float max = *std::max_element(frame_times.begin(), frame_times.end());
+
+    const std::string lines[text_lines] = {
+        "FRAME MS P50 " + formatMilliseconds(p50) + " P99 " + formatMilliseconds(p99),
+        "MAX " + formatMilliseconds(max) + " DRAW CALLS " + std::to_string(draw_calls / frames),
+        "EVENTS " + mean(phase_totals[static_cast<std::size_t>(Phase::Events)])
+            + " NEXT MOVE " + mean(phase_totals[static_cast<std::size_t>(Phase::NextMove)]),
+        "DRAW " + mean(phase_totals[static_cast<std::size_t>(Phase::Draw)])
+            + " DISPLAY " + mean(phase_totals[static_cast<std::size_t>(Phase::Display)]),
+        (input_ms < 0) ? std::string("INPUT -")
+                       : "INPUT " + formatMilliseconds(input_ms) + " PIXEL "
+                             + (pixel_ms < 0 ? std::string("-") : formatMilliseconds(pixel_ms))
+    };
+    text.clear();
+    for (int i = 0; i < text_lines; i++) {
+        appendText(text, lines[i], margin + padding, margin + padding + i * line_height, sf::Color::White);
+    }
+}
+
+void FrameProfiler::updateGraph() {
+    graph.clear();
+    float left = margin + padding;
+    float top = margin + 2 * padding + text_lines * line_height;
+    std::size_t frames = static_cast<std::size_t>(std::min<std::uint64_t>(frame_count, graph_frames));
+    // Oldest frame on the left, frames over budget in red
+    for (std::size_t i = 0; i < frames; i++) {
+        const FrameRecord& record = history[(frame_count - frames + i) % history_size];
+        float height = graph_height * std::min(1.0f, record.frame_ms / (2 * frame_budget_ms));
+        sf::Color color = (record.frame_ms > frame_budget_ms * 1.05f) ? sf::Color(220, 60, 50) : sf::Color(80, 200, 90);
+        appendRectangle(graph, left + i * bar_width, top + graph_height - height, bar_width - 1, height, color);
+    }
+    appendRectangle(graph, left, top + graph_height / 2, bar_width * graph_frames, 1, sf::Color(255, 255, 255, 160));
+}
+
+void FrameProfiler::draw(sf::RenderTarget& renderTarget, sf::RenderStates renderStates) const {
+    if (!overlay_visible) {
+        return;
+    }
+    countDrawCalls(3);
+    renderTarget.draw(background, renderStates);
+    renderTarget.draw(text, renderStates);
+    renderTarget.draw(graph, renderStates);
+}
@@ -0,0 +1,204 @@
+#include "game_index.hpp"
+#include "binary_file.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <thread>
+#include <tuple>
+
+namespace {
+    constexpr std::array<char, 8> game_index_magic = {{'C', 'H', 'E', 'S', 'S', 'I', 'D', 'X'}};
+    constexpr std::uint16_t game_index_version = 1;
+    constexpr std::size_t game_index_header_size = 64;
+
+    static_assert(sizeof(GameIndexEntry) == 16, "index entries are stored as 16 bytes");
+
+    bool lessThan(const GameIndexEntry& a, const GameIndexEntry& b) {
+        return std::tie(a.key, a.game, a.ply) < std::tie(b.key, b.game, b.ply);
+    }
+
+    // Function used to lay out sorted keys in Eytzinger order, an in-order walk of the tree visits them sorted
+    template <typename Node>
+    void fillTree(const std::vector<std::uint64_t>& keys, std::vector<Node>& tree, std::size_t& next, std::size_t node) {
+        if (node > keys.size()) {
+            return;
+        }
+        fillTree(keys, tree, next, 2 * node);
+        tree[node] = Node{keys[next], next};
+        next++;
+        fillTree(keys, tree, next, 2 * node + 1);
+    }
+}
+
+void GameIndex::close() {
+    file.close();
+    entries = nullptr;
+    tree = nullptr;
+    entry_count = game_count = block_count = 0;
+}
+
+bool GameIndex::open(const std::string& path) {
+    close();
+    if (!isLittleEndian()) {
+        std::cerr << "Index files can only be read on little-endian machines" << std::endl;
+        return false;
+    }
+    // Queries touch a few pages of the tree and of the entries
+    if (!file.open(path, MappedFile::Access::Random)) {
+        return false;
+    }
+    const std::uint8_t* contents = file.data();
+    std::size_t file_size = file.size();
+
+    bool valid = file_size >= game_index_header_size
+                 && std::equal(game_index_magic.begin(), game_index_magic.end(), contents)
+                 && readLittleEndian(contents + 8, 2) == game_index_version;
+    if (valid) {
+        entry_count = readLittleEndian(contents + 16, 8);
+        game_count = readLittleEndian(contents + 24, 8);
+        block_count = readLittleEndian(contents + 32, 8);
+        valid = block_count == (entry_count + block_size - 1) / block_size
+                && file_size == game_index_header_size + entry_count * sizeof(GameIndexEntry)
+                                + (block_count + 1) * sizeof(Node);
+    }
+    if (!valid) {
+        std::cerr << path << " is not a game index file" << std::endl;
+        close();
+        return false;
+    }
+    entries = reinterpret_cast<const GameIndexEntry*>(contents + game_index_header_size);
+    tree = reinterpret_cast<const Node*>(entries + entry_count);
+    return true;
+}
+
+GameIndex::Range GameIndex::find(std::uint64_t key) const {
+    if (entry_count == 0) {
+        return Range();
+    }
+    // Descend to the first block starting with a key not less than the key; the node
+    // index then ends in a 1 bit followed by one 1 bit per step to the right after it
+    std::uint64_t node = 1;
+    while (node <= block_count) {
+        node = 2 * node + (tree[node].key < key ? 1 : 0);
+    }
+    while (node & 1) {
+        node >>= 1;
+    }
+    node >>= 1;
+    // The first entry of the key is in the block before or at the start of the found one
+    std::uint64_t block = (node == 0) ? block_count : tree[node].block;
+    std::uint64_t low = (block == 0) ? 0 : (block - 1) * block_size;
+    std::uint64_t high = std::min(entry_count, block * block_size + 1);
+    auto compare = [](const GameIndexEntry& entry, std::uint64_t value) { return entry.key < value; };
+    const GameIndexEntry* first = std::lower_bound(entries + low, entries + high, key, compare);
+    const GameIndexEntry* end = entries + entry_count;
+    if (first == end || first->key != key) {
+        return Range();
+    }
+    // Runs are usually short, so their end is found by doubling steps before bisecting
+    std::uint64_t step = 1;
+    const GameIndexEntry* last = first + 1;
+    while (static_cast<std::uint64_t>(end - last) > step && last[step - 1].key == key) {
+        last += step;
+        step *= 2;
+    }
+    const GameIndexEntry* limit = last + std::min<std::uint64_t>(step, static_cast<std::uint64_t>(end - last));
+    last = std::upper_bound(last, limit, key, [](std::uint64_t value, const GameIndexEntry& entry) {
+        return value < entry.key;
+    });
+    return Range{first, last};
+}
+
+bool GameIndex::write(const std::string& path, std::vector<std::vector<GameIndexEntry>>& runs,
+                      std::uint64_t games, int threads) {
+    if (!isLittleEndian()) {
+        std::cerr << "Index files can only be written on little-endian machines" << std::endl;
+        return false;
+    }
+    // The runs are sorted independently and then merged while writing
+    std::atomic<std::size_t> next_run{0};
+    std::vector<std::thread> workers;
+    for (int i = 0; i < std::max(1, threads); i++) {
+        workers.emplace_back([&] {
+            for (std::size_t run = next_run++; run < runs.size(); run = next_run++) {
+                std::sort(runs[run].begin(), runs[run].end(), lessThan);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Could not create " << path << std::endl;
+        return false;
+    }
+    // The header is rewritten with the counts once they are known
+    std::array<std::uint8_t, game_index_header_size> header{};
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+    using Head = std::pair<GameIndexEntry, std::size_t>;
+    auto later = [](const Head& a, const Head& b) { return lessThan(b.first, a.first); };
+    std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+    std::vector<std::size_t> positions(runs.size(), 0);
+    for (std::size_t run = 0; run < runs.size(); run++) {
+        if (!runs[run].empty()) {
+            heads.push(Head{runs[run][0], run});
+        }
+    }
+    std::vector<GameIndexEntry> output;
+    output.reserve(1 << 16);
+    std::vector<std::uint64_t> block_keys;
+    std::uint64_t count = 0;
+    GameIndexEntry previous;
+    while (!heads.empty()) {
+        Head head = heads.top();
+        heads.pop();
+        std::size_t run = head.second;
+        if (++positions[run] < runs[run].size()) {
+            heads.push(Head{runs[run][positions[run]], run});
+        } else {
+            std::vector<GameIndexEntry>().swap(runs[run]);
+        }
+        // Only the first time a game reaches a position is kept
+        const GameIndexEntry& entry = head.first;
+        if (count > 0 && entry.key == previous.key && entry.game == previous.game) {
+            continue;
+        }
+        if (count % block_size == 0) {
+            block_keys.push_back(entry.key);
+        }
+        output.push_back(entry);
+        previous = entry;
+        count++;
+        if (output.size() == output.capacity()) {
+            file.write(reinterpret_cast<const char*>(output.data()),
+                       static_cast<std::streamsize>(output.size() * sizeof(GameIndexEntry)));
+            output.clear();
+        }
+    }
+    file.write(reinterpret_cast<const char*>(output.data()),
+               static_cast<std::streamsize>(output.size() * sizeof(GameIndexEntry)));
+
+    std::vector<Node> nodes(block_keys.size() + 1, Node{0, 0});
+    std::size_t next = 0;
+    fillTree(block_keys, nodes, next, 1);
+    file.write(reinterpret_cast<const char*>(nodes.data()), static_cast<std::streamsize>(nodes.size() * sizeof(Node)));
+
+    std::copy(game_index_magic.begin(), game_index_magic.end(), header.begin());
+    writeLittleEndian(&header[8], game_index_version, 2);
+    writeLittleEndian(&header[16], count, 8);
+    writeLittleEndian(&header[24], games, 8);
+    writeLittleEndian(&header[32], block_keys.size(), 8);
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    if (!file.flush()) {
+        std::cerr << "Could not write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
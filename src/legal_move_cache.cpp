@@ -0,0 +1,202 @@
+#include "legal_move_cache.hpp"
+#include "attack_tables.hpp"
+#include "piece.hpp"
+#include "move.hpp"
+#include "position.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    constexpr std::array<std::array<int, 2>, 8> directions = {{
+        {{-1, -1}}, {{-1, 1}}, {{1, -1}}, {{1, 1}}, {{-1, 0}}, {{1, 0}}, {{0, -1}}, {{0, 1}}
+    }};
+
+    // Full rays from every square to the edge of the board indexed by [square][direction]
+    constexpr std::array<std::array<std::uint64_t, 8>, 64> makeRays() {
+        std::array<std::array<std::uint64_t, 8>, 64> rays{};
+        for (int square = 0; square < 64; square++) {
+            for (int d = 0; d < 8; d++) {
+                int file = squareFile(square) + directions[d][0];
+                int rank = squareRank(square) + directions[d][1];
+                for ( ; file >= 0 && file < 8 && rank >= 0 && rank < 8;
+                     file += directions[d][0], rank += directions[d][1]) {
+                    rays[square][d] |= squareBit(file, rank);
+                }
+            }
+        }
+        return rays;
+    }
+
+    constexpr std::array<std::array<std::uint64_t, 8>, 64> rays = makeRays();
+
+    // Function used to find the squares whose contents can change the moves of the
+    // piece on the given square, the targets of a leaper and the rays of a slider up
+    // to and including the first blocker
+    std::uint64_t reachOf(const Position& position, int file, int rank) {
+        const Piece& piece = position.pieceAt(file, rank);
+        std::uint64_t reach = 0;
+        int first_direction = 0;
+        int last_direction = 0;
+        switch (piece.type) {
+            case Piece::Type::Pawn: {
+                int direction = (piece.color == Piece::Color::White) ? -1 : 1;
+                int start_rank = (piece.color == Piece::Color::White) ? 6 : 1;
+                if (rank + direction >= 0 && rank + direction < 8) {
+                    reach |= squareBit(file, rank + direction);
+                }
+                if (rank == start_rank) {
+                    reach |= squareBit(file, rank + 2 * direction);
+                }
+                for (int target : pawnAttacks(piece.color, squareIndex(file, rank))) {
+                    reach |= 1ULL << target;
+                }
+                return reach;
+            }
+            case Piece::Type::Knight:
+                for (int target : knight_attacks[squareIndex(file, rank)]) {
+                    reach |= 1ULL << target;
+                }
+                return reach;
+            case Piece::Type::King:
+                for (int target : king_attacks[squareIndex(file, rank)]) {
+                    reach |= 1ULL << target;
+                }
+                return reach;
+            case Piece::Type::Bishop: first_direction = 0; last_direction = 4; break;
+            case Piece::Type::Rook:   first_direction = 4; last_direction = 8; break;
+            case Piece::Type::Queen:  first_direction = 0; last_direction = 8; break;
+            default: return 0;
+        }
+        for (int d = first_direction; d < last_direction; d++) {
+            int target_file = file + directions[d][0];
+            int target_rank = rank + directions[d][1];
+            for ( ; target_file >= 0 && target_file < 8 && target_rank >= 0 && target_rank < 8;
+                 target_file += directions[d][0], target_rank += directions[d][1]) {
+                reach |= squareBit(target_file, target_rank);
+                if (position.pieceAt(target_file, target_rank).type != Piece::Type::None) {
+                    break;
+                }
+            }
+        }
+        return reach;
+    }
+}
+
+void LegalMoveCache::update(Position& position) {
+    std::uint64_t changed_now = position.takeChangedSquares();
+    for (SideCache& side_cache : caches) {
+        side_cache.changed |= changed_now;
+    }
+    const Piece::Color color = position.activeColor();
+    SideCache& cache = caches[color == Piece::Color::White];
+    const bool in_check = position.inCheck(color);
+    const std::uint64_t changed = cache.changed;
+
+    regenerated_pieces = 0;
+    // Check evasions, king moves and a missing king change the legality of every move
+    bool full = !cache.valid || in_check || cache.in_check || cache.king_square == -1
+                || (changed >> cache.king_square & 1);
+    if (full) {
+        // The king can only have moved when everything is regenerated
+        cache.king_square = -1;
+        for (int square = 0; square < 64; square++) {
+            const Piece& piece = position.pieceAt(squareFile(square), squareRank(square));
+            if (piece.type == Piece::Type::King && piece.color == color && cache.king_square == -1) {
+                cache.king_square = square;
+            }
+            regenerate(position, cache, square);
+        }
+    }
+    else {
+        // A change on a line of the king can pin or unpin the first piece on that line, or the
+        // one that was first before pieces arrived in front of it, which is the first piece
+        // on a square that did not change
+        std::uint64_t touched = changed | (1ULL << cache.king_square);
+        for (int d = 0; d < 8; d++) {
+            if (!(rays[cache.king_square][d] & changed)) {
+                continue;
+            }
+            int file = squareFile(cache.king_square) + directions[d][0];
+            int rank = squareRank(cache.king_square) + directions[d][1];
+            for ( ; file >= 0 && file < 8 && rank >= 0 && rank < 8; file += directions[d][0], rank += directions[d][1]) {
+                if (position.pieceAt(file, rank).type == Piece::Type::None) {
+                    continue;
+                }
+                touched |= squareBit(file, rank);
+                if (!(changed & squareBit(file, rank))) {
+                    break;
+                }
+            }
+        }
+        for (std::uint64_t remaining = cache.pieces; remaining != 0; remaining &= remaining - 1) {
+            int square = __builtin_ctzll(remaining);
+            if (cache.reach[square] & changed) {
+                touched |= 1ULL << square;
+            }
+        }
+        for ( ; touched != 0; touched &= touched - 1) {
+            regenerate(position, cache, __builtin_ctzll(touched));
+        }
+    }
+    cache.valid = true;
+    cache.in_check = in_check;
+    cache.changed = 0;
+
+    // Concatenating by square keeps the order of a full generation
+    legal_moves.clear();
+    for (std::uint64_t remaining = cache.pieces; remaining != 0; remaining &= remaining - 1) {
+        int square = __builtin_ctzll(remaining);
+        auto first = cache.piece_moves.begin() + square * max_piece_moves;
+        legal_moves.insert(legal_moves.end(), first, first + cache.move_counts[square]);
+    }
+    if (verification) {
+        verify(position);
+    }
+}
+
+void LegalMoveCache::clear() {
+    for (SideCache& cache : caches) {
+        cache.valid = false;
+    }
+    legal_moves.clear();
+}
+
+void LegalMoveCache::regenerate(Position& position, SideCache& cache, int square_index) {
+    int file = squareFile(square_index);
+    int rank = squareRank(square_index);
+    const Piece& piece = position.pieceAt(file, rank);
+    cache.pieces &= ~(1ULL << square_index);
+    cache.move_counts[square_index] = 0;
+    cache.reach[square_index] = 0;
+    if (piece.type == Piece::Type::None || piece.color != position.activeColor()) {
+        return;
+    }
+    regenerated_pieces++;
+    generated_moves.clear();
+    position.generatePieceMoves(file, rank, generated_moves);
+    std::copy(generated_moves.begin(), generated_moves.end(), cache.piece_moves.begin() + square_index * max_piece_moves);
+    cache.move_counts[square_index] = static_cast<std::uint8_t>(generated_moves.size());
+    cache.pieces |= 1ULL << square_index;
+    cache.reach[square_index] = reachOf(position, file, rank);
+}
+
+void LegalMoveCache::verify(Position& position) {
+    position.generateMoves(position.activeColor(), generated_moves);
+    if (std::equal(legal_moves.begin(), legal_moves.end(), generated_moves.begin(), generated_moves.end())) {
+        return;
+    }
+    mismatch_count++;
+    std::cerr << "Incremental legal moves differ from full generation in " << position.toFEN() << "\n"
+              << "    incremental:";
+    for (const Move& move : legal_moves) {
+        std::cerr << ' ' << move.toString();
+    }
+    std::cerr << "\n    generated:  ";
+    for (const Move& move : generated_moves) {
+        std::cerr << ' ' << move.toString();
+    }
+    std::cerr << std::endl;
+    legal_moves.assign(generated_moves.begin(), generated_moves.end());
+    // Start over from the regenerated moves
+    caches[position.activeColor() == Piece::Color::White].valid = false;
+}
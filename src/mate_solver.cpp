@@ -0,0 +1,289 @@
+#include "mate_solver.hpp"
+#include "move.hpp"
+#include <algorithm>
+#include <array>
+
+namespace {
+    // Proof or disproof number of a solved node, sums of numbers are capped below it
+    constexpr std::uint32_t infinite = 1000000000;
+    // Longest bound in half-moves, bounds are stored in 8 bits
+    constexpr int max_depth = 199;
+    // Depth stored with results which hold for any bound
+    constexpr int any_depth = 255;
+
+    std::uint32_t cap(std::uint64_t value) {
+        return static_cast<std::uint32_t>(std::min<std::uint64_t>(value, infinite));
+    }
+}
+
+MateSolver::MateSolver(std::size_t megabytes) {
+    resize(megabytes);
+}
+
+void MateSolver::resize(std::size_t megabytes) {
+    std::size_t count = std::max<std::size_t>(1, megabytes) * 1024 * 1024 / (sizeof(Entry) * bucket_size);
+    // Round down to a power of two so that the index is a mask of the key
+    std::size_t power = 1;
+    while (power * 2 <= count) {
+        power *= 2;
+    }
+    table.reset(new Entry[power * bucket_size]);
+    bucket_count = power;
+    generation = 0;
+}
+
+MateResult MateSolver::solve(const Position& root, const MateLimits& limits) {
+    position = root;
+    attacker = root.activeColor();
+    // Entries are tagged with the solve they belong to, as a proof only holds for the same attacker
+    if (++generation == 0) {
+        std::fill(table.get(), table.get() + bucket_count * bucket_size, Entry());
+        generation = 1;
+    }
+    node_count = 0;
+    node_limit = limits.nodes;
+    aborted = false;
+
+    MateResult result;
+    int depth_limit = std::min(2 * std::max(1, limits.moves) - 1, max_depth);
+    int depth = -1;
+    // A mate in n moves takes 2n - 1 half-moves
+    for (int bound = 1; bound <= depth_limit && !aborted; bound += 2) {
+        if (prove(bound)) {
+            depth = bound;
+            break;
+        }
+    }
+    if (depth < 0) {
+        result.status = aborted ? MateStatus::Unknown : MateStatus::NoMate;
+        result.nodes = node_count;
+        return result;
+    }
+    result.status = MateStatus::Mate;
+    result.moves = (depth + 1) / 2;
+    result.line = mainLine(depth);
+
+    // The key move is unique if no other move mates within the same bound
+    MoveList moves;
+    position.generateMoves(position.activeColor(), moves);
+    for (const Move& move : moves) {
+        if (aborted || move == result.keyMove()) {
+            continue;
+        }
+        Position::UndoInfo undo;
+        position.makeMove(move, undo);
+        bool mates = prove(depth - 1);
+        position.undoMove(move, undo);
+        if (mates) {
+            result.alternatives.push_back(move);
+        }
+    }
+    result.alternatives_complete = !aborted && !result.line.empty();
+    result.nodes = node_count;
+    return result;
+}
+
+void MateSolver::search(int depth, std::uint32_t phi_threshold, std::uint32_t delta_threshold) {
+    if (node_limit != 0 && node_count >= node_limit) {
+        aborted = true;
+        return;
+    }
+    node_count++;
+    std::uint64_t start_nodes = node_count;
+    std::uint64_t key = position.hash();
+    MoveList moves;
+    Numbers numbers;
+    if (evaluateTerminal(depth, moves, numbers)) {
+        // Mates hold for any bound and so do stalemates and mates of the attacker
+        int stored_depth = depth;
+        if (numbers.proof == 0) {
+            stored_depth = 0;
+        } else if (moves.empty() && depth > 0) {
+            stored_depth = any_depth;
+        }
+        store(key, stored_depth, numbers, 1);
+        return;
+    }
+
+    // Keys of the children are computed once, their numbers are looked up on every iteration
+    std::array<std::uint64_t, 256> child_keys;
+    for (std::size_t i = 0; i < moves.size(); i++) {
+        Position::UndoInfo undo;
+        position.makeMove(moves[i], undo);
+        child_keys[i] = position.hash();
+        // Children without half-moves left are evaluated right away instead of one search each
+        if (depth == 1) {
+            MoveList child_moves;
+            Numbers child;
+            evaluateTerminal(0, child_moves, child);
+            store(child_keys[i], 0, child, 1);
+            node_count++;
+        }
+        position.undoMove(moves[i], undo);
+    }
+
+    bool or_node = attackerToMove();
+    while (true) {
+        // phi is the smallest delta of the children and delta the sum of their phi
+        std::uint32_t phi = infinite;
+        std::uint64_t delta = 0;
+        std::uint32_t second_delta = infinite;
+        std::uint32_t best_phi = 0;
+        std::size_t best = 0;
+        bool delta_infinite = false;
+        for (std::size_t i = 0; i < moves.size(); i++) {
+            Numbers child = lookup(child_keys[i], depth - 1);
+            // The children are nodes of the other kind
+            std::uint32_t child_phi = or_node ? child.disproof : child.proof;
+            std::uint32_t child_delta = or_node ? child.proof : child.disproof;
+            delta += child_phi;
+            delta_infinite |= child_phi >= infinite;
+            if (child_delta < phi) {
+                second_delta = phi;
+                phi = child_delta;
+                best_phi = child_phi;
+                best = i;
+            } else if (child_delta < second_delta) {
+                second_delta = child_delta;
+            }
+        }
+        // A sum of unsolved children must not read as solved
+        std::uint32_t node_delta = delta_infinite ? infinite : cap(std::min<std::uint64_t>(delta, infinite - 1));
+        numbers = or_node ? Numbers{phi, node_delta} : Numbers{node_delta, phi};
+        if (phi >= phi_threshold || node_delta >= delta_threshold || aborted) {
+            break;
+        }
+        // The second best child plus a quarter bounds the best one, which reduces
+        // switching back and forth between children with close numbers
+        std::uint32_t child_phi_threshold = cap(std::uint64_t(delta_threshold) - node_delta + best_phi);
+        std::uint32_t child_delta_threshold = std::min(phi_threshold,
+                                                       cap(std::uint64_t(second_delta) + second_delta / 4 + 1));
+        Position::UndoInfo undo;
+        position.makeMove(moves[best], undo);
+        search(depth - 1, child_phi_threshold, child_delta_threshold);
+        position.undoMove(moves[best], undo);
+    }
+    store(key, depth, numbers, node_count - start_nodes + 1);
+}
+
+bool MateSolver::evaluateTerminal(int depth, MoveList& moves, Numbers& numbers) {
+    const Numbers proven{0, infinite};
+    const Numbers disproven{infinite, 0};
+    Piece::Color side = position.activeColor();
+    bool or_node = attackerToMove();
+    // Without half-moves left only a position which is already mate is proven,
+    // which needs the defender to be in check
+    if (depth <= 0 && (or_node || !position.inCheck(side))) {
+        numbers = disproven;
+        return true;
+    }
+    position.generateMoves(side, moves);
+    if (moves.empty()) {
+        numbers = (!or_node && position.inCheck(side)) ? proven : disproven;
+        return true;
+    }
+    if (depth <= 0 || position.isFiftyMoveDraw()) {
+        numbers = disproven;
+        return true;
+    }
+    return false;
+}
+
+bool MateSolver::prove(int depth) {
+    search(depth, infinite, infinite);
+    return lookup(position.hash(), depth).proof == 0;
+}
+
+int MateSolver::mateDepth(int depth) {
+    for (int bound = attackerToMove() ? 1 : 0; bound <= depth && !aborted; bound += 2) {
+        if (prove(bound)) {
+            return bound;
+        }
+    }
+    return -1;
+}
+
+std::vector<Move> MateSolver::mainLine(int depth) {
+    std::vector<Move> line;
+    std::vector<Position::UndoInfo> undos;
+    MoveList moves;
+    while (depth > 0 && !aborted) {
+        position.generateMoves(position.activeColor(), moves);
+        bool or_node = attackerToMove();
+        Move best;
+        int best_depth = -1;
+        for (const Move& move : moves) {
+            Position::UndoInfo undo;
+            position.makeMove(move, undo);
+            int mate_depth = mateDepth(depth - 1);
+            position.undoMove(move, undo);
+            if (mate_depth < 0) {
+                continue;
+            }
+            // The attacker takes the fastest mate and the defender the slowest
+            if (best_depth < 0 || (or_node ? mate_depth < best_depth : mate_depth > best_depth)) {
+                best = move;
+                best_depth = mate_depth;
+            }
+            if (or_node ? mate_depth == 0 : mate_depth == depth - 1) {
+                break;
+            }
+        }
+        if (!best.isValid()) {
+            break;
+        }
+        line.push_back(best);
+        undos.emplace_back();
+        position.makeMove(best, undos.back());
+        depth = best_depth;
+    }
+    for (std::size_t i = line.size(); i-- > 0; ) {
+        position.undoMove(line[i], undos[i]);
+    }
+    return line;
+}
+
+MateSolver::Numbers MateSolver::lookup(std::uint64_t key, int depth) const {
+    Numbers numbers{1, 1};
+    const Entry* bucket = &table[(key & (bucket_count - 1)) * bucket_size];
+    for (std::size_t i = 0; i < bucket_size; i++) {
+        const Entry& entry = bucket[i];
+        if (entry.generation != generation || entry.key != key) {
+            continue;
+        }
+        // A mate within fewer half-moves is a mate within more, and the other way around without mate
+        if (entry.proof == 0 && entry.depth <= depth) {
+            return Numbers{0, infinite};
+        }
+        if (entry.disproof == 0 && entry.depth >= depth) {
+            return Numbers{infinite, 0};
+        }
+        if (entry.depth == depth) {
+            numbers = Numbers{entry.proof, entry.disproof};
+        }
+    }
+    return numbers;
+}
+
+void MateSolver::store(std::uint64_t key, int depth, const Numbers& numbers, std::uint64_t work) {
+    Entry* bucket = &table[(key & (bucket_count - 1)) * bucket_size];
+    // Replace the same node, else an entry of an earlier solve, else the one with the least work
+    Entry* target = &bucket[0];
+    for (std::size_t i = 0; i < bucket_size; i++) {
+        Entry& entry = bucket[i];
+        if (entry.generation == generation && entry.key == key && entry.depth == depth) {
+            target = &entry;
+            break;
+        }
+        if (target->generation == generation
+            && (entry.generation != generation || entry.work < target->work)) {
+            target = &entry;
+        }
+    }
+    target->key = key;
+    target->proof = numbers.proof;
+    target->disproof = numbers.disproof;
+    target->work = cap(work);
+    target->generation = generation;
+    target->depth = static_cast<std::uint8_t>(std::clamp(depth, 0, any_depth));
+}
@@ -0,0 +1,170 @@
+#include "move_counter.hpp"
+#include "move_counter_kernel.hpp"
+#include "packed_position.hpp"
+#include "position.hpp"
+#include "piece.hpp"
+
+namespace {
+    // Function used to count the legal en passant captures of a position, each one is made
+    // on the bitboards and kept if the king is not attacked afterwards
+    int enPassantMoves(const MoveCounterLanes& lanes, std::size_t index) {
+        int file = static_cast<int>((lanes.state[index] >> 8) & 15) - 1;
+        if (file < 0) {
+            return 0;
+        }
+        std::uint64_t ours[6], theirs[6];
+        for (int type = 0; type < 6; type++) {
+            ours[type] = lanes.ours[type][index];
+            theirs[type] = lanes.theirs[type][index];
+        }
+        std::uint64_t target = 1ULL << (file * 8 + 2);
+        std::uint64_t captured = 1ULL << (file * 8 + 3);
+        std::uint64_t occupied = 0;
+        for (int type = 0; type < 6; type++) {
+            occupied |= ours[type] | theirs[type];
+        }
+        if (!(theirs[1] & captured) || (occupied & target)) {
+            return 0;
+        }
+        std::uint64_t king = ours[0];
+        std::uint64_t their_pawns = theirs[1] & ~captured;
+        std::uint64_t their_straight = theirs[4] | theirs[5];
+        std::uint64_t their_diagonal = theirs[3] | theirs[5];
+        std::uint64_t capturers = (step<1, 1>(target) | step<-1, 1>(target)) & ours[1];
+        int moves = 0;
+        while (capturers != 0) {
+            std::uint64_t capturer = capturers & (~capturers + 1);
+            capturers ^= capturer;
+            std::uint64_t empty = ~(occupied ^ capturer ^ target ^ captured);
+            std::uint64_t attackers = (kingAttacks(king) & theirs[0]) | (knightAttacks(king) & theirs[2])
+                                      | ((step<1, -1>(king) | step<-1, -1>(king)) & their_pawns)
+                                      | (sliderAttacks<std::uint64_t>(king, 0, empty) & their_straight)
+                                      | (sliderAttacks<std::uint64_t>(0, king, empty) & their_diagonal);
+            if (attackers == 0) {
+                moves++;
+            }
+        }
+        return moves;
+    }
+
+    // Function used to append the bitboards and state of a position given its pieces
+    // on the board as it is, mirroring them if black is to move
+    void addPosition(PositionBatch& batch, std::uint64_t (&white)[6], std::uint64_t (&black)[6],
+                     bool black_to_move, std::uint8_t castling, int en_passant_file) {
+        for (int type = 0; type < 6; type++) {
+            if (black_to_move) {
+                batch.ours[type].push_back(mirrorRanks(black[type]));
+                batch.theirs[type].push_back(mirrorRanks(white[type]));
+            } else {
+                batch.ours[type].push_back(white[type]);
+                batch.theirs[type].push_back(black[type]);
+            }
+        }
+        // Castling rights are given as KQkq, the side to move's come first in the state
+        std::uint64_t our_castling = black_to_move ? (castling >> 2) & 3 : castling & 3;
+        std::uint64_t their_castling = black_to_move ? castling & 3 : (castling >> 2) & 3;
+        batch.state.push_back(static_cast<std::uint64_t>(black_to_move) | our_castling << 1 | their_castling << 3
+                              | static_cast<std::uint64_t>(en_passant_file + 1) << 8);
+    }
+}
+
+void PositionBatch::clear() {
+    for (int type = 0; type < 6; type++) {
+        ours[type].clear();
+        theirs[type].clear();
+    }
+    state.clear();
+}
+
+void PositionBatch::reserve(std::size_t count) {
+    for (int type = 0; type < 6; type++) {
+        ours[type].reserve(count);
+        theirs[type].reserve(count);
+    }
+    state.reserve(count);
+}
+
+void PositionBatch::add(const Position& position) {
+    std::uint64_t white[6] = {}, black[6] = {};
+    for (int file = 0; file < 8; file++) {
+        for (int rank = 0; rank < 8; rank++) {
+            const Piece& piece = position.pieceAt(file, rank);
+            if (piece.type != Piece::Type::None) {
+                (piece.color == Piece::Color::White ? white : black)[piece.type - 1] |= 1ULL << (file * 8 + rank);
+            }
+        }
+    }
+    std::uint8_t castling = static_cast<std::uint8_t>(position.canCastle(Piece::Color::White, true)
+                                                      | position.canCastle(Piece::Color::White, false) << 1
+                                                      | position.canCastle(Piece::Color::Black, true) << 2
+                                                      | position.canCastle(Piece::Color::Black, false) << 3);
+    addPosition(*this, white, black, position.activeColor() == Piece::Color::Black, castling, position.enPassant()[0]);
+}
+
+bool PositionBatch::add(const PackedPosition& packed) {
+    const std::uint8_t* bytes = packed.bytes.data();
+    std::uint64_t occupancy = 0;
+    for (int i = 0; i < 8; i++) {
+        occupancy |= static_cast<std::uint64_t>(bytes[i]) << (8 * i);
+    }
+    std::uint64_t white[6] = {}, black[6] = {};
+    int piece_index = 0;
+    for (std::uint64_t remaining = occupancy; remaining != 0; remaining &= remaining - 1) {
+        if (piece_index == 32) {
+            return false;
+        }
+        int nibble = (bytes[8 + piece_index / 2] >> (4 * (piece_index % 2))) & 15;
+        piece_index++;
+        int type = nibble & 7;
+        if (type == Piece::Type::None || type > Piece::Type::Queen) {
+            return false;
+        }
+        ((nibble & 8) ? black : white)[type - 1] |= remaining & (~remaining + 1);
+    }
+    if (bytes[25] > 8) {
+        return false;
+    }
+    addPosition(*this, white, black, bytes[24] & 1, static_cast<std::uint8_t>((bytes[24] >> 1) & 15),
+                bytes[25] - 1);
+    return true;
+}
+
+bool simdMoveCountingAvailable() {
+#ifdef CHESS_MOVE_COUNTER_AVX2
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+void countMoves(const PositionBatch& batch, MoveCounts& counts, bool use_simd) {
+    std::size_t count = batch.size();
+    counts.legal_moves.resize(count);
+    counts.in_check.resize(count);
+    counts.attacked.resize(count);
+    MoveCounterLanes lanes;
+    for (int type = 0; type < 6; type++) {
+        lanes.ours[type] = batch.ours[type].data();
+        lanes.theirs[type] = batch.theirs[type].data();
+    }
+    lanes.state = batch.state.data();
+    lanes.legal_moves = counts.legal_moves.data();
+    lanes.in_check = counts.in_check.data();
+    lanes.attacked = counts.attacked.data();
+
+    std::size_t counted = 0;
+#ifdef CHESS_MOVE_COUNTER_AVX2
+    if (use_simd && simdMoveCountingAvailable()) {
+        counted = countMovesAvx2(lanes, count);
+    }
+#else
+    (void)use_simd;
+#endif
+    countLanes<std::uint64_t>(lanes, counted, count);
+    // En passant captures are rare and checked one position at a time
+    for (std::size_t i = 0; i < count; i++) {
+        if (batch.state[i] >> 8) {
+            counts.legal_moves[i] = static_cast<std::uint16_t>(counts.legal_moves[i] + enPassantMoves(lanes, i));
+        }
+    }
+}
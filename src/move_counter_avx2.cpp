@@ -0,0 +1,72 @@
+#include <immintrin.h>
+#include <cstddef>
+#include <cstdint>
+
+// AVX2 version of the move counter, compiled with AVX2 enabled and only called once
+// the processor was found to support it. Four positions are counted at once, one in
+// every 64 bit lane.
+
+namespace {
+    struct Lanes {
+        __m256i value;
+    };
+
+    Lanes operator&(Lanes a, Lanes b) { return {_mm256_and_si256(a.value, b.value)}; }
+    Lanes operator|(Lanes a, Lanes b) { return {_mm256_or_si256(a.value, b.value)}; }
+    Lanes operator+(Lanes a, Lanes b) { return {_mm256_add_epi64(a.value, b.value)}; }
+    Lanes operator-(Lanes a, Lanes b) { return {_mm256_sub_epi64(a.value, b.value)}; }
+    Lanes operator~(Lanes a) { return {_mm256_xor_si256(a.value, _mm256_set1_epi64x(-1))}; }
+
+    // Operations with the same constant in every lane
+    Lanes broadcast(std::uint64_t word) { return {_mm256_set1_epi64x(static_cast<long long>(word))}; }
+    Lanes operator&(Lanes a, std::uint64_t b) { return a & broadcast(b); }
+    Lanes operator-(Lanes a, std::uint64_t b) { return a - broadcast(b); }
+
+    template <int N>
+    Lanes shiftLeft(Lanes bits) {
+        return {_mm256_slli_epi64(bits.value, N)};
+    }
+
+    template <int N>
+    Lanes shiftRight(Lanes bits) {
+        return {_mm256_srli_epi64(bits.value, N)};
+    }
+
+    Lanes isZero(Lanes bits) {
+        return {_mm256_cmpeq_epi64(bits.value, _mm256_setzero_si256())};
+    }
+
+    // Population count of every byte by looking up both nibbles
+    Lanes bitCounts(Lanes bits) {
+        const __m256i nibble_counts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                       0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+        __m256i low = _mm256_and_si256(bits.value, low_nibbles);
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(bits.value, 4), low_nibbles);
+        return {_mm256_add_epi8(_mm256_shuffle_epi8(nibble_counts, low), _mm256_shuffle_epi8(nibble_counts, high))};
+    }
+
+    Lanes totalCount(Lanes counts) {
+        return {_mm256_sad_epu8(counts.value, _mm256_setzero_si256())};
+    }
+}
+
+#include "move_counter_kernel.hpp"
+
+namespace {
+    template <>
+    struct LaneTraits<Lanes> {
+        static constexpr std::size_t width = 4;
+
+        static Lanes load(const std::uint64_t* words) {
+            return {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(words))};
+        }
+        static void store(Lanes lanes, std::uint64_t* words) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(words), lanes.value);
+        }
+    };
+}
+
+std::size_t countMovesAvx2(const MoveCounterLanes& lanes, std::size_t count) {
+    return countLanes<Lanes>(lanes, 0, count);
+}
@@ -0,0 +1,127 @@
+#include "move_picker.hpp"
+#include "evaluation.hpp"
+#include <utility>
+
+MovePicker::MovePicker(Position& position, const Move& hash_move, const KillerMoves& killers,
+                       const HistoryTable& history) :
+    position(position),
+    hash_move(hash_move),
+    killers(&killers),
+    history(&history)
+{
+}
+
+MovePicker::MovePicker(Position& position) :
+    position(position),
+    stage(Stage::GenerateNoisy)
+{
+}
+
+Move MovePicker::next() {
+    switch (stage) {
+        case Stage::HashMove:
+            stage = Stage::GenerateNoisy;
+            // The hash move may come from a different position with the same hash
+            if (position.isLegal(hash_move)) {
+                return hash_move;
+            }
+            hash_move = Move();
+            [[fallthrough]];
+        case Stage::GenerateNoisy:
+            position.generateMoves(position.activeColor(), moves, Position::MoveFilter::Noisy);
+            scoreNoisy();
+            index = 0;
+            stage = Stage::Noisy;
+            [[fallthrough]];
+        case Stage::Noisy:
+            while (index < moves.size()) {
+                Move move = pickBest();
+                if (move != hash_move) {
+                    return move;
+                }
+            }
+            // Quiescence pickers stop after the noisy moves
+            if (killers == nullptr) {
+                stage = Stage::Done;
+                break;
+            }
+            stage = Stage::Killers;
+            [[fallthrough]];
+        case Stage::Killers:
+            while (killer_index < killers->size()) {
+                const Move& killer = (*killers)[killer_index++];
+                bool duplicate = killer == hash_move || (killer_index > 1 && killer == (*killers)[0]);
+                if (!duplicate && position.isLegal(killer) && !position.isNoisy(killer)) {
+                    return killer;
+                }
+            }
+            stage = Stage::GenerateQuiet;
+            [[fallthrough]];
+        case Stage::GenerateQuiet:
+            position.generateMoves(position.activeColor(), moves, Position::MoveFilter::Quiet);
+            scoreQuiet();
+            index = 0;
+            stage = Stage::Quiet;
+            [[fallthrough]];
+        case Stage::Quiet:
+            while (index < moves.size()) {
+                Move move = pickBest();
+                if (!alreadyPicked(move)) {
+                    return move;
+                }
+            }
+            stage = Stage::Done;
+            [[fallthrough]];
+        case Stage::Done:
+            break;
+    }
+    return Move();
+}
+
+void MovePicker::scoreNoisy() {
+    for (std::size_t i = 0; i < moves.size(); i++) {
+        const Move& move = moves[i];
+        Piece::Type attacker = position.pieceAt(move.start_file, move.start_rank).type;
+        Piece::Type victim = position.pieceAt(move.target_file, move.target_rank).type;
+        // En passant
+        if (victim == Piece::Type::None && move.start_file != move.target_file) {
+            victim = Piece::Type::Pawn;
+        }
+        // Most valuable victim first, then least valuable attacker with the king as the most valuable
+        int attacker_value = (attacker == Piece::Type::King) ? 1000 : piece_values[attacker];
+        scores[i] = piece_values[victim] * 10 + piece_values[move.promotion] * 10 - attacker_value;
+    }
+}
+
+void MovePicker::scoreQuiet() {
+    const auto& color_history = (*history)[position.activeColor() == Piece::Color::White];
+    for (std::size_t i = 0; i < moves.size(); i++) {
+        const Move& move = moves[i];
+        scores[i] = color_history[move.start_file * 8 + move.start_rank][move.target_file * 8 + move.target_rank];
+    }
+}
+
+Move MovePicker::pickBest() {
+    // Selection sort, only as much of the list is sorted as is picked
+    std::size_t best = index;
+    for (std::size_t i = index + 1; i < moves.size(); i++) {
+        if (scores[i] > scores[best]) {
+            best = i;
+        }
+    }
+    std::swap(moves[index], moves[best]);
+    std::swap(scores[index], scores[best]);
+    return moves[index++];
+}
+
+bool MovePicker::alreadyPicked(const Move& move) const {
+    if (move == hash_move) {
+        return true;
+    }
+    for (std::size_t i = 0; i < killer_index; i++) {
+        if (move == (*killers)[i]) {
+            return true;
+        }
+    }
+    return false;
+}
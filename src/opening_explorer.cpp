@@ -0,0 +1,185 @@
+#include "opening_explorer.hpp"
+#include "binary_file.hpp"
+#include "transposition_table.hpp"
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <tuple>
+
+struct OpeningExplorer::Entry {
+    std::uint64_t key;
+    // Move packed as in the transposition table
+    std::uint16_t move;
+    std::uint16_t average_rating;
+    std::uint32_t games;
+    std::uint32_t white_wins;
+    std::uint32_t draws;
+    std::uint32_t black_wins;
+    std::uint32_t reserved;
+};
+
+namespace {
+    constexpr std::array<char, 8> explorer_magic = {{'C', 'H', 'E', 'S', 'S', 'O', 'P', 'N'}};
+    constexpr std::uint16_t explorer_version = 1;
+    constexpr std::size_t explorer_header_size = 64;
+
+    // Function used to read a rating tag, returns 0 if it is missing or not a number
+    int rating(const PgnGame& game, const std::string& tag) {
+        auto value = game.tags.find(tag);
+        if (value == game.tags.end()) {
+            return 0;
+        }
+        try {
+            return std::max(0, std::stoi(value->second));
+        } catch (std::exception& e) {
+            return 0;
+        }
+    }
+}
+
+void OpeningExplorer::close() {
+    file.close();
+    entries = nullptr;
+    entry_count = game_count = 0;
+}
+
+bool OpeningExplorer::open(const std::string& path) {
+    close();
+    if (!isLittleEndian()) {
+        std::cerr << "Explorer files can only be read on little-endian machines" << std::endl;
+        return false;
+    }
+    if (!file.open(path, MappedFile::Access::Random)) {
+        return false;
+    }
+    const std::uint8_t* contents = file.data();
+    std::size_t file_size = file.size();
+
+    bool valid = file_size >= explorer_header_size
+                 && std::equal(explorer_magic.begin(), explorer_magic.end(), contents)
+                 && readLittleEndian(contents + 8, 2) == explorer_version;
+    if (valid) {
+        entry_count = readLittleEndian(contents + 16, 8);
+        game_count = readLittleEndian(contents + 24, 8);
+        valid = file_size == explorer_header_size + entry_count * sizeof(Entry);
+    }
+    if (!valid) {
+        std::cerr << path << " is not an opening explorer file" << std::endl;
+        close();
+        return false;
+    }
+    entries = reinterpret_cast<const Entry*>(contents + explorer_header_size);
+    return true;
+}
+
+void OpeningExplorer::lookup(std::uint64_t key, std::vector<ExplorerMove>& moves) const {
+    moves.clear();
+    const Entry* end = entries + entry_count;
+    const Entry* entry = std::lower_bound(entries, end, key, [](const Entry& entry, std::uint64_t value) {
+        return entry.key < value;
+    });
+    for (; entry != end && entry->key == key; entry++) {
+        ExplorerMove move;
+        move.move = TranspositionTable::unpackMove(entry->move);
+        move.games = entry->games;
+        move.white_wins = entry->white_wins;
+        move.draws = entry->draws;
+        move.black_wins = entry->black_wins;
+        move.average_rating = entry->average_rating;
+        moves.push_back(move);
+    }
+}
+
+bool OpeningExplorerBuilder::addGame(const PgnGame& game, Position& position) {
+    auto fen = game.tags.find("FEN");
+    if (!position.loadPositionFromFEN(fen != game.tags.end() ? fen->second : Position::start_fen)) {
+        return false;
+    }
+    game_count++;
+    int white_rating = rating(game, "WhiteElo");
+    int black_rating = rating(game, "BlackElo");
+    bool rated = white_rating > 0 && black_rating > 0;
+    std::size_t plies = std::min<std::size_t>(game.moves.size(), static_cast<std::size_t>(std::max(0, max_plies)));
+    for (std::size_t ply = 0; ply < plies; ply++) {
+        Move move = position.parseSAN(game.moves[ply]);
+        if (!move.isValid()) {
+            return false;
+        }
+        Stats& move_stats = stats[Key{position.hash(), TranspositionTable::packMove(move)}];
+        move_stats.games++;
+        if (game.result == "1-0") move_stats.white_wins++;
+        else if (game.result == "0-1") move_stats.black_wins++;
+        else if (game.result == "1/2-1/2") move_stats.draws++;
+        if (rated) {
+            move_stats.rated_games++;
+            move_stats.rating_sum += static_cast<std::uint64_t>(white_rating + black_rating) / 2;
+        }
+        Position::UndoInfo undo;
+        position.makeMove(move, undo);
+    }
+    return true;
+}
+
+void OpeningExplorerBuilder::merge(OpeningExplorerBuilder& other) {
+    game_count += other.game_count;
+    stats.reserve(stats.size() + other.stats.size());
+    for (const auto& [key, other_stats] : other.stats) {
+        Stats& merged = stats[key];
+        merged.games += other_stats.games;
+        merged.white_wins += other_stats.white_wins;
+        merged.draws += other_stats.draws;
+        merged.black_wins += other_stats.black_wins;
+        merged.rated_games += other_stats.rated_games;
+        merged.rating_sum += other_stats.rating_sum;
+    }
+    other.game_count = 0;
+    std::unordered_map<Key, Stats, KeyHash>().swap(other.stats);
+}
+
+bool OpeningExplorerBuilder::write(const std::string& path, std::uint32_t min_games) const {
+    if (!isLittleEndian()) {
+        std::cerr << "Explorer files can only be written on little-endian machines" << std::endl;
+        return false;
+    }
+    std::vector<OpeningExplorer::Entry> entries;
+    for (const auto& [key, move_stats] : stats) {
+        if (move_stats.games < min_games) {
+            continue;
+        }
+        OpeningExplorer::Entry entry{};
+        entry.key = key.position;
+        entry.move = key.move;
+        entry.average_rating = static_cast<std::uint16_t>(
+            move_stats.rated_games == 0 ? 0 : std::min<std::uint64_t>(move_stats.rating_sum / move_stats.rated_games,
+                                                                       UINT16_MAX));
+        entry.games = move_stats.games;
+        entry.white_wins = move_stats.white_wins;
+        entry.draws = move_stats.draws;
+        entry.black_wins = move_stats.black_wins;
+        entries.push_back(entry);
+    }
+    // Positions in key order, their moves most played first
+    std::sort(entries.begin(), entries.end(), [](const OpeningExplorer::Entry& a, const OpeningExplorer::Entry& b) {
+        return std::make_tuple(a.key, b.games, a.move) < std::make_tuple(b.key, a.games, b.move);
+    });
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Could not create " << path << std::endl;
+        return false;
+    }
+    std::array<std::uint8_t, explorer_header_size> header{};
+    std::copy(explorer_magic.begin(), explorer_magic.end(), header.begin());
+    writeLittleEndian(&header[8], explorer_version, 2);
+    writeLittleEndian(&header[16], entries.size(), 8);
+    writeLittleEndian(&header[24], game_count, 8);
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    file.write(reinterpret_cast<const char*>(entries.data()),
+               static_cast<std::streamsize>(entries.size() * sizeof(OpeningExplorer::Entry)));
+    if (!file.flush()) {
+        std::cerr << "Could not write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
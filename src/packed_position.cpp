@@ -0,0 +1,141 @@
+#include "packed_position.hpp"
+#include "binary_file.hpp"
+#include "move.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    std::uint16_t encodeMove(const Move& move) {
+        if (!move.isValid()) {
+            return 0;
+        }
+        return static_cast<std::uint16_t>((move.start_file * 8 + move.start_rank)
+                                          | (move.target_file * 8 + move.target_rank) << 6
+                                          | move.promotion << 12);
+    }
+
+    Move decodeMove(std::uint16_t bits) {
+        if (bits == 0) {
+            return Move();
+        }
+        int start = bits & 63;
+        int target = (bits >> 6) & 63;
+        return Move(start / 8, start % 8, target / 8, target % 8, static_cast<Piece::Type>((bits >> 12) & 7));
+    }
+
+    // Function used to encode a record as it is stored in a file of the given record size
+    void encodeRecord(const PackedRecord& record, std::size_t record_size, std::uint8_t* bytes) {
+        std::memcpy(bytes, record.position.bytes.data(), packed_position_size);
+        if (record_size == packed_record_size) {
+            std::uint8_t* annotation = bytes + packed_position_size;
+            writeLittleEndian(annotation, static_cast<std::uint16_t>(record.score), 2);
+            writeLittleEndian(annotation + 2, encodeMove(record.best_move), 2);
+            annotation[4] = static_cast<std::uint8_t>(record.result);
+            std::fill(annotation + 5, annotation + 8, 0);
+        }
+    }
+
+    void decodeRecord(const std::uint8_t* bytes, std::size_t record_size, PackedRecord& record) {
+        record = PackedRecord();
+        std::memcpy(record.position.bytes.data(), bytes, packed_position_size);
+        if (record_size == packed_record_size) {
+            const std::uint8_t* annotation = bytes + packed_position_size;
+            record.score = static_cast<std::int16_t>(readLittleEndian(annotation, 2));
+            record.best_move = decodeMove(static_cast<std::uint16_t>(readLittleEndian(annotation + 2, 2)));
+            record.result = static_cast<std::int8_t>(annotation[4]);
+        }
+    }
+}
+
+PackedPositionWriter::PackedPositionWriter(const std::string& path, bool annotated) :
+    file(path, std::ios::binary | std::ios::trunc),
+    annotated(annotated)
+{
+    if (!file) {
+        std::cerr << "Could not create " << path << std::endl;
+        return;
+    }
+    std::uint8_t header[packed_header_size] = {};
+    std::memcpy(header, packed_file_magic.data(), packed_file_magic.size());
+    writeLittleEndian(header + 8, packed_file_version, 2);
+    writeLittleEndian(header + 10, annotated ? packed_record_size : packed_position_size, 2);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+}
+
+bool PackedPositionWriter::write(const PackedRecord& record) {
+    std::uint8_t bytes[packed_record_size];
+    std::size_t record_size = annotated ? packed_record_size : packed_position_size;
+    encodeRecord(record, record_size, bytes);
+    file.write(reinterpret_cast<const char*>(bytes), record_size);
+    record_count++;
+    return static_cast<bool>(file);
+}
+
+bool PackedPositionWriter::write(const PackedPosition& position) {
+    PackedRecord record;
+    record.position = position;
+    return write(record);
+}
+
+bool PackedPositionWriter::close() {
+    file.close();
+    return !file.fail();
+}
+
+PackedPositionReader::PackedPositionReader(const std::string& path) {
+    std::uint8_t header[packed_header_size];
+    std::size_t file_size = 0;
+    // Datasets are mostly read front to back
+    if (mapping.map(path, MappedFile::Access::Sequential) && mapping.size() >= packed_header_size) {
+        file_size = mapping.size();
+        std::memcpy(header, mapping.data(), packed_header_size);
+    } else {
+        mapping.close();
+        stream.open(path, std::ios::binary);
+        if (!stream) {
+            std::cerr << "Could not open " << path << std::endl;
+            return;
+        }
+        stream.seekg(0, std::ios::end);
+        file_size = static_cast<std::size_t>(stream.tellg());
+        stream.seekg(0);
+        if (file_size < packed_header_size) {
+            std::cerr << path << " is not a packed position file" << std::endl;
+            return;
+        }
+        stream.read(reinterpret_cast<char*>(header), packed_header_size);
+    }
+
+    record_size = readLittleEndian(header + 10, 2);
+    if (!std::equal(packed_file_magic.begin(), packed_file_magic.end(), header)
+        || readLittleEndian(header + 8, 2) != packed_file_version
+        || (record_size != packed_position_size && record_size != packed_record_size)) {
+        std::cerr << path << " is not a packed position file" << std::endl;
+        return;
+    }
+    if ((file_size - packed_header_size) % record_size != 0) {
+        std::cerr << path << " ends with a truncated record, ignoring it" << std::endl;
+    }
+    record_count = (file_size - packed_header_size) / record_size;
+    buffer.resize(record_size);
+    open = true;
+}
+
+bool PackedPositionReader::read(std::size_t index, PackedRecord& record) {
+    if (!open || index >= record_count) {
+        return false;
+    }
+    std::size_t offset = packed_header_size + index * record_size;
+    if (mapping.data() != nullptr) {
+        decodeRecord(mapping.data() + offset, record_size, record);
+        return true;
+    }
+    stream.seekg(static_cast<std::streamoff>(offset));
+    if (!stream.read(reinterpret_cast<char*>(buffer.data()), record_size)) {
+        stream.clear();
+        return false;
+    }
+    decodeRecord(buffer.data(), record_size, record);
+    return true;
+}
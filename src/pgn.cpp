@@ -0,0 +1,131 @@
+#include "pgn.hpp"
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+namespace {
+    bool isResult(const std::string& token) {
+        return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+    }
+
+    // Function used to parse a tag pair line e.g. [White "Morphy, Paul"]
+    void parseTag(const std::string& line, PgnGame& game) {
+        std::size_t name_end = 1;
+        while (name_end < line.size() && !std::isspace(static_cast<unsigned char>(line[name_end]))
+               && line[name_end] != '"' && line[name_end] != ']') {
+            name_end++;
+        }
+        std::string name = line.substr(1, name_end - 1);
+        std::size_t quote = line.find('"', name_end);
+        if (name.empty() || quote == std::string::npos) {
+            return;
+        }
+        // Quotes and backslashes in the value are escaped with a backslash
+        std::string value;
+        for (std::size_t i = quote + 1; i < line.size() && line[i] != '"'; i++) {
+            if (line[i] == '\\' && i + 1 < line.size()) {
+                i++;
+            }
+            value += line[i];
+        }
+        game.tags[name] = value;
+    }
+}
+
+bool PgnReader::next(std::string& text) {
+    text.clear();
+    bool in_moves = false;
+    bool in_comment = false;
+    std::string line;
+    while (true) {
+        if (has_pending_line) {
+            line = std::move(pending_line);
+            has_pending_line = false;
+        } else if (!std::getline(input, line)) {
+            break;
+        }
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        std::size_t first = line.find_first_not_of(" \t");
+        if (!in_comment && first != std::string::npos && line[first] == '[') {
+            if (in_moves) {
+                pending_line = std::move(line);
+                has_pending_line = true;
+                return true;
+            }
+        } else if (first != std::string::npos && line[first] != '%') {
+            in_moves = true;
+            for (char c : line) {
+                if (c == '{') in_comment = true;
+                else if (c == '}') in_comment = false;
+            }
+        }
+        text += line;
+        text += '\n';
+    }
+    return text.find_first_not_of(" \t\n") != std::string::npos;
+}
+
+bool parsePgnGame(const std::string& text, PgnGame& game) {
+    game.tags.clear();
+    game.moves.clear();
+    game.result.clear();
+
+    int variation_depth = 0;
+    std::size_t i = 0;
+    while (i < text.size()) {
+        char c = text[i];
+        bool line_start = (i == 0 || text[i - 1] == '\n');
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            i++;
+        } else if (c == '{') {
+            std::size_t end = text.find('}', i);
+            i = (end == std::string::npos) ? text.size() : end + 1;
+        } else if (c == ';' || (c == '%' && line_start)) {
+            std::size_t end = text.find('\n', i);
+            i = (end == std::string::npos) ? text.size() : end + 1;
+        } else if (c == '[' && variation_depth == 0 && game.moves.empty()) {
+            std::size_t end = text.find('\n', i);
+            parseTag(text.substr(i, end - i), game);
+            i = (end == std::string::npos) ? text.size() : end + 1;
+        } else if (c == '(') {
+            variation_depth++;
+            i++;
+        } else if (c == ')') {
+            variation_depth = std::max(0, variation_depth - 1);
+            i++;
+        } else {
+            std::size_t end = i;
+            while (end < text.size() && !std::isspace(static_cast<unsigned char>(text[end]))
+                   && std::string("{}();").find(text[end]) == std::string::npos) {
+                end++;
+            }
+            std::string token = text.substr(i, end - i);
+            i = end;
+            if (variation_depth > 0 || token[0] == '$') {
+                continue;
+            }
+            if (isResult(token)) {
+                game.result = token;
+                continue;
+            }
+            // Move numbers "12." and "12..." may be written against the move
+            std::size_t move_start = 0;
+            while (move_start < token.size() && std::isdigit(static_cast<unsigned char>(token[move_start]))) {
+                move_start++;
+            }
+            if (move_start < token.size() && token[move_start] == '.') {
+                while (move_start < token.size() && token[move_start] == '.') {
+                    move_start++;
+                }
+            } else {
+                move_start = 0;
+            }
+            if (move_start < token.size()) {
+                game.moves.push_back(token.substr(move_start));
+            }
+        }
+    }
+    return !game.tags.empty() || !game.moves.empty();
+}
@@ -0,0 +1,1250 @@
+#include "position.hpp"
+#include "piece.hpp"
+#include "move.hpp"
+#include "evaluation.hpp"
+#include "attack_tables.hpp"
+#include "trace.hpp"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <cctype>
+#include <cstdlib>
+#include <exception>
+#include <algorithm>
+
+namespace {
+    // Zobrist keys are generated at compile time with splitmix64 so that hashes
+    // are identical across runs and builds
+    constexpr std::uint64_t splitmix64(std::uint64_t& state) {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // 12 piece kinds * 64 squares, 4 castling rights, 8 en passant files and the side to move
+    constexpr int castling_key_offset = 12 * 64;
+    constexpr int en_passant_key_offset = castling_key_offset + 4;
+    constexpr int side_key_offset = en_passant_key_offset + 8;
+
+    constexpr std::array<std::uint64_t, side_key_offset + 1> zobrist_keys = [] {
+        std::array<std::uint64_t, side_key_offset + 1> keys{};
+        std::uint64_t state = 0x2545F4914F6CDD1DULL;
+        for (auto& key : keys) {
+            key = splitmix64(state);
+        }
+        return keys;
+    }();
+
+    inline std::uint64_t pieceKey(const Piece& piece, int file, int rank) {
+        int kind = (piece.type - 1) * 2 + (piece.color == Piece::Color::Black);
+        return zobrist_keys[kind * 64 + file * 8 + rank];
+    }
+
+    inline std::uint64_t castlingKey(bool white_king_side, bool white_queen_side,
+                                     bool black_king_side, bool black_queen_side) {
+        std::uint64_t key = 0;
+        if (white_king_side) key ^= zobrist_keys[castling_key_offset];
+        if (white_queen_side) key ^= zobrist_keys[castling_key_offset + 1];
+        if (black_king_side) key ^= zobrist_keys[castling_key_offset + 2];
+        if (black_queen_side) key ^= zobrist_keys[castling_key_offset + 3];
+        return key;
+    }
+
+    inline std::uint64_t enPassantKey(int file) {
+        return zobrist_keys[en_passant_key_offset + file];
+    }
+
+    inline std::uint64_t sideKey() {
+        return zobrist_keys[side_key_offset];
+    }
+
+    // Constants of a side used by the color specialized methods
+    template <Piece::Color Us>
+    struct ColorTraits {
+        static constexpr bool white = Us == Piece::Color::White;
+        static constexpr Piece::Color them = white ? Piece::Color::Black : Piece::Color::White;
+        // White pawns move towards rank index 0
+        static constexpr int pawn_direction = white ? -1 : 1;
+        static constexpr int pawn_start_rank = white ? 6 : 1;
+        static constexpr int promotion_rank = white ? 0 : 7;
+        static constexpr int back_rank = white ? 7 : 0;
+    };
+}
+
+Position::Position() {
+    loadPositionFromFEN(start_fen);
+}
+
+bool Position::loadPositionFromFEN(const std::string& fen) {
+    std::unordered_map<char, Piece::Type> charToPieceType = {
+        {'k', Piece::Type::King},
+        {'p', Piece::Type::Pawn},
+        {'n', Piece::Type::Knight},
+        {'b', Piece::Type::Bishop},
+        {'r', Piece::Type::Rook},
+        {'q', Piece::Type::Queen}
+    };
+    changed_squares = ~0ULL;
+    // Reset position
+    for (auto& file : square) {
+        for (Piece& piece : file) {
+            piece = Piece();
+        }
+    }
+    active_color = Piece::Color::White;
+    white_king_side_castle = white_queen_side_castle = false;
+    black_king_side_castle = black_queen_side_castle = false;
+    en_passant = {{-1, -1}};
+    halfmove_clock = 0;
+    fullmove_number = 1;
+
+    bool valid = true;
+    std::size_t i = 0;
+    // Parse piece positions
+    for (int file = 0, rank = 0; i < fen.length() && fen[i] != ' '; i++) {
+        if (std::isdigit(static_cast<unsigned char>(fen[i]))) {
+            file += fen[i] - '0';
+            if (file > 8) {
+                std::cerr << "Invalid FEN string." << std::endl;
+                valid = false;
+            }
+        }
+        else if (fen[i] == '/') {
+            rank++;
+            file = 0;
+        }
+        else if (file > 7 || rank > 7) {
+            std::cerr << "Invalid FEN string." << std::endl;
+            valid = false;
+        }
+        else {
+            try {
+                square[file][rank].type = charToPieceType.at(std::tolower(static_cast<unsigned char>(fen[i])));
+                if (std::islower(static_cast<unsigned char>(fen[i]))) {
+                    square[file][rank].color = Piece::Color::Black;
+                }
+                else {
+                    square[file][rank].color = Piece::Color::White;
+                }
+                file++;
+            } catch (std::out_of_range& e) {
+                std::cerr << "Invalid symbol." << std::endl;
+                valid = false;
+            }
+        }
+    }
+
+    std::istringstream fields(fen.substr(i));
+    std::string color, castling, target;
+    fields >> color >> castling >> target >> halfmove_clock >> fullmove_number;
+    // Parse active color
+    if (color == "w" || color.empty()) {
+        active_color = Piece::Color::White;
+    }
+    else if (color == "b") {
+        active_color = Piece::Color::Black;
+    }
+    else {
+        std::cerr << "Invalid active color." << std::endl;
+        valid = false;
+    }
+    // Parse castling availability
+    for (char c : castling) {
+        if (c == 'K') {
+            white_king_side_castle = true;
+        }
+        else if (c == 'Q') {
+            white_queen_side_castle = true;
+        }
+        else if (c == 'k') {
+            black_king_side_castle = true;
+        }
+        else if (c == 'q') {
+            black_queen_side_castle = true;
+        }
+        else if (c != '-') {
+            std::cerr << "Invalid symbol." << std::endl;
+            valid = false;
+        }
+    }
+    // Parse en passant target square
+    if (target.length() == 2) {
+        int file = target[0] - 'a';
+        int rank = 7 - (target[1] - '1');
+        if (file < 0 || file > 7 || rank < 0 || rank > 7) {
+            std::cerr << "Invalid en passant target square." << std::endl;
+            valid = false;
+        } else {
+            en_passant = {{file, rank}};
+        }
+    }
+
+    zobrist_hash = computeHash();
+    hash_history.clear();
+    hash_history.reserve(512);
+    hash_history.push_back(zobrist_hash);
+    return valid;
+}
+
+std::string Position::toFEN() const {
+    const char piece_chars[] = {' ', 'k', 'p', 'n', 'b', 'r', 'q'};
+    std::string fen;
+    for (int rank = 0; rank < 8; rank++) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            const Piece& piece = square[file][rank];
+            if (piece.type == Piece::Type::None) {
+                empty++;
+                continue;
+            }
+            if (empty > 0) {
+                fen += static_cast<char>('0' + empty);
+                empty = 0;
+            }
+            char c = piece_chars[piece.type];
+            fen += (piece.color == Piece::Color::White) ? static_cast<char>(std::toupper(c)) : c;
+        }
+        if (empty > 0) {
+            fen += static_cast<char>('0' + empty);
+        }
+        if (rank < 7) {
+            fen += '/';
+        }
+    }
+    fen += (active_color == Piece::Color::White) ? " w " : " b ";
+    std::string castling;
+    if (white_king_side_castle) castling += 'K';
+    if (white_queen_side_castle) castling += 'Q';
+    if (black_king_side_castle) castling += 'k';
+    if (black_queen_side_castle) castling += 'q';
+    fen += castling.empty() ? "-" : castling;
+    fen += ' ';
+    if (en_passant[0] != -1) {
+        fen += static_cast<char>('a' + en_passant[0]);
+        fen += static_cast<char>('8' - en_passant[1]);
+    } else {
+        fen += '-';
+    }
+    fen += ' ' + std::to_string(halfmove_clock) + ' ' + std::to_string(fullmove_number);
+    return fen;
+}
+
+bool Position::loadPackedPosition(const PackedPosition& packed) {
+    changed_squares = ~0ULL;
+    const std::uint8_t* bytes = packed.bytes.data();
+    std::uint64_t occupancy = 0;
+    for (int i = 0; i < 8; i++) {
+        occupancy |= static_cast<std::uint64_t>(bytes[i]) << (8 * i);
+    }
+    bool valid = true;
+    int piece_index = 0;
+    for (int index = 0; index < 64; index++) {
+        Piece& piece = square[index / 8][index % 8];
+        piece = Piece();
+        if (!(occupancy >> index & 1)) {
+            continue;
+        }
+        if (piece_index == 32) {
+            valid = false;
+            break;
+        }
+        int nibble = (bytes[8 + piece_index / 2] >> (4 * (piece_index % 2))) & 15;
+        piece_index++;
+        int type = nibble & 7;
+        if (type == Piece::Type::None || type > Piece::Type::Queen) {
+            valid = false;
+            continue;
+        }
+        piece = Piece(static_cast<Piece::Type>(type), (nibble & 8) ? Piece::Color::Black : Piece::Color::White);
+    }
+    std::uint8_t flags = bytes[24];
+    active_color = (flags & 1) ? Piece::Color::Black : Piece::Color::White;
+    white_king_side_castle = flags & 2;
+    white_queen_side_castle = flags & 4;
+    black_king_side_castle = flags & 8;
+    black_queen_side_castle = flags & 16;
+    // The en passant target square is behind the pawn that just moved
+    en_passant = {{-1, -1}};
+    if (bytes[25] > 8) {
+        valid = false;
+    }
+    else if (bytes[25] != 0) {
+        en_passant = {{bytes[25] - 1, (active_color == Piece::Color::White) ? 2 : 5}};
+    }
+    halfmove_clock = bytes[26];
+    fullmove_number = bytes[27] | bytes[28] << 8;
+
+    zobrist_hash = computeHash();
+    hash_history.clear();
+    hash_history.reserve(512);
+    hash_history.push_back(zobrist_hash);
+    if (!valid) {
+        std::cerr << "Invalid packed position." << std::endl;
+    }
+    return valid;
+}
+
+bool Position::pack(PackedPosition& packed) const {
+    packed = PackedPosition();
+    std::uint8_t* bytes = packed.bytes.data();
+    std::uint64_t occupancy = 0;
+    int piece_index = 0;
+    for (int index = 0; index < 64; index++) {
+        const Piece& piece = square[index / 8][index % 8];
+        if (piece.type == Piece::Type::None) {
+            continue;
+        }
+        if (piece_index == 32) {
+            return false;
+        }
+        occupancy |= 1ULL << index;
+        int nibble = piece.type | ((piece.color == Piece::Color::Black) ? 8 : 0);
+        bytes[8 + piece_index / 2] |= static_cast<std::uint8_t>(nibble << (4 * (piece_index % 2)));
+        piece_index++;
+    }
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = static_cast<std::uint8_t>(occupancy >> (8 * i));
+    }
+    bytes[24] = static_cast<std::uint8_t>((active_color == Piece::Color::Black)
+                                          | white_king_side_castle << 1 | white_queen_side_castle << 2
+                                          | black_king_side_castle << 3 | black_queen_side_castle << 4);
+    bytes[25] = static_cast<std::uint8_t>(en_passant[0] + 1);
+    bytes[26] = static_cast<std::uint8_t>(std::clamp(halfmove_clock, 0, 255));
+    int fullmove = std::clamp(fullmove_number, 0, 65535);
+    bytes[27] = static_cast<std::uint8_t>(fullmove);
+    bytes[28] = static_cast<std::uint8_t>(fullmove >> 8);
+    return true;
+}
+
+std::uint64_t Position::computeHash() const {
+    std::uint64_t hash = 0;
+    for (int file = 0; file < 8; file++) {
+        for (int rank = 0; rank < 8; rank++) {
+            if (square[file][rank].type != Piece::Type::None) {
+                hash ^= pieceKey(square[file][rank], file, rank);
+            }
+        }
+    }
+    hash ^= castlingKey(white_king_side_castle, white_queen_side_castle,
+                        black_king_side_castle, black_queen_side_castle);
+    if (hashesEnPassant(active_color)) {
+        hash ^= enPassantKey(en_passant[0]);
+    }
+    if (active_color == Piece::Color::Black) {
+        hash ^= sideKey();
+    }
+    return hash;
+}
+
+bool Position::hashesEnPassant(Piece::Color capturer) const {
+    if (en_passant[0] == -1) {
+        return false;
+    }
+    // The pawn that moved two squares is one rank past the target square for the capturing side
+    int pawn_rank = (capturer == Piece::Color::White) ? en_passant[1] + 1 : en_passant[1] - 1;
+    if (pawn_rank < 0 || pawn_rank > 7) {
+        return false;
+    }
+    for (int file : {en_passant[0] - 1, en_passant[0] + 1}) {
+        if (file >= 0 && file < 8 && square[file][pawn_rank].type == Piece::Type::Pawn
+            && square[file][pawn_rank].color == capturer) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Position::canCastle(Piece::Color color, bool king_side) const {
+    if (color == Piece::Color::White) {
+        return king_side ? white_king_side_castle : white_queen_side_castle;
+    }
+    return king_side ? black_king_side_castle : black_queen_side_castle;
+}
+
+void Position::generateMoves(Piece::Color color, MoveList& moves, MoveFilter filter) {
+    CHESS_TRACE_COUNT(GenerateMoves);
+    moves.clear();
+    move_filter = filter;
+    if (color == Piece::Color::White) {
+        generateMovesFor<Piece::Color::White>(moves);
+    } else {
+        generateMovesFor<Piece::Color::Black>(moves);
+    }
+    move_filter = MoveFilter::All;
+}
+
+template <Piece::Color Us>
+void Position::generateMovesFor(MoveList& moves) {
+    for (int file = 0; file < board_width; file++) {
+        for (int rank = 0; rank < board_width; rank++) {
+            if (square[file][rank].color != Us) {
+                continue;
+            }
+            switch (square[file][rank].type) {
+                case Piece::Type::Pawn:   generatePawnMovesFor<Us>(file, rank, moves); break;
+                case Piece::Type::Bishop: generateBishopMoves(file, rank, moves); break;
+                case Piece::Type::Rook:   generateRookMoves(file, rank, moves); break;
+                case Piece::Type::Queen:
+                    generateBishopMoves(file, rank, moves);
+                    generateRookMoves(file, rank, moves);
+                    break;
+                case Piece::Type::Knight: generateKnightMoves(file, rank, moves); break;
+                case Piece::Type::King:   generateKingMovesFor<Us>(file, rank, moves); break;
+                default: break;
+            }
+        }
+    }
+}
+
+void Position::generatePieceMoves(int file, int rank, MoveList& moves) {
+    if (square[file][rank].type == Piece::Type::Pawn) {
+        generatePawnMoves(file, rank, moves);
+    }
+    else if (square[file][rank].type == Piece::Type::Bishop) {
+        generateBishopMoves(file, rank, moves);
+    }
+    else if (square[file][rank].type == Piece::Type::Rook) {
+        generateRookMoves(file, rank, moves);
+    }
+    else if (square[file][rank].type == Piece::Type::Queen) {
+        generateBishopMoves(file, rank, moves);
+        generateRookMoves(file, rank, moves);
+    }
+    else if (square[file][rank].type == Piece::Type::Knight) {
+        generateKnightMoves(file, rank, moves);
+    }
+    else if (square[file][rank].type == Piece::Type::King) {
+        generateKingMoves(file, rank, moves);
+    }
+}
+
+void Position::generatePawnMoves(int file, int rank, MoveList& moves) {
+    if (square[file][rank].color == Piece::Color::White) {
+        generatePawnMovesFor<Piece::Color::White>(file, rank, moves);
+    } else {
+        generatePawnMovesFor<Piece::Color::Black>(file, rank, moves);
+    }
+}
+
+template <Piece::Color Us>
+void Position::generatePawnMovesFor(int file, int rank, MoveList& moves) {
+    constexpr int direction = ColorTraits<Us>::pawn_direction;
+    constexpr int start_rank = ColorTraits<Us>::pawn_start_rank;
+    constexpr int promotion_rank = ColorTraits<Us>::promotion_rank;
+    int target_rank = rank + direction;
+    if (target_rank < 0 || target_rank > 7) {
+        return;
+    }
+    // Single and double pushes
+    if (square[file][target_rank].type == Piece::Type::None) {
+        if (target_rank == promotion_rank) {
+            addPromotionMoves(file, rank, file, target_rank, moves);
+        } else {
+            addMove(file, rank, file, target_rank, moves);
+        }
+        if (rank == start_rank
+            && square[file][target_rank + direction].type == Piece::Type::None) {
+            addMove(file, rank, file, target_rank + direction, moves);
+        }
+    }
+    // Captures including en passant
+    for (int target : pawnAttacks(Us, squareIndex(file, rank))) {
+        int target_file = squareFile(target);
+        if ((square[target_file][target_rank].type != Piece::Type::None
+             && square[target_file][target_rank].color != Us)
+            || (target_file == en_passant[0] && target_rank == en_passant[1])) {
+            if (target_rank == promotion_rank) {
+                addPromotionMoves(file, rank, target_file, target_rank, moves);
+            } else {
+                addMove(file, rank, target_file, target_rank, moves);
+            }
+        }
+    }
+}
+
+void Position::generateRookMoves(int start_file, int start_rank, MoveList& moves) {
+    // Right
+    for (int file = start_file + 1; file < board_width; file++) {
+        if (square[file][start_rank].type == Piece::Type::None) {
+            addMove(start_file, start_rank, file, start_rank, moves);
+        }
+        else if (square[file][start_rank].color != square[start_file][start_rank].color) {
+            addMove(start_file, start_rank, file, start_rank, moves);
+            break;
+        }
+        else {
+            break;
+        }
+    }
+    // Left
+    for (int file = start_file - 1; file >= 0; file--) {
+        if (square[file][start_rank].type == Piece::Type::None) {
+            addMove(start_file, start_rank, file, start_rank, moves);
+        }
+        else if (square[file][start_rank].color != square[start_file][start_rank].color) {
+            addMove(start_file, start_rank, file, start_rank, moves);
+            break;
+        }
+        else {
+            break;
+        }
+    }
+    // Down
+    for (int rank = start_rank + 1; rank < board_width; rank++) {
+        if (square[start_file][rank].type == Piece::Type::None) {
+            addMove(start_file, start_rank, start_file, rank, moves);
+        }
+        else if (square[start_file][rank].color != square[start_file][start_rank].color) {
+            addMove(start_file, start_rank, start_file, rank, moves);
+            break;
+        }
+        else {
+            break;
+        }
+    }
+    // Up
+    for (int rank = start_rank - 1; rank >= 0; rank--) {
+        if (square[start_file][rank].type == Piece::Type::None) {
+            addMove(start_file, start_rank, start_file, rank, moves);
+        }
+        else if (square[start_file][rank].color != square[start_file][start_rank].color) {
+            addMove(start_file, start_rank, start_file, rank, moves);
+            break;
+        }
+        else {
+            break;
+        }
+    }
+}
+
+void Position::generateBishopMoves(int start_file, int start_rank, MoveList& moves) {
+    // Right & Down
+    for (int file = start_file + 1, rank = start_rank + 1; file < board_width && rank < board_width; file++, rank++) {
+        if (square[file][rank].type == Piece::Type::None) {
+            addMove(start_file, start_rank, file, rank, moves);
+        }
+        else if (square[file][rank].color != square[start_file][start_rank].color) {
+            addMove(start_file, start_rank, file, rank, moves);
+            break;
+        }
+        else {
+            break;
+        }
+    }
+    // Left & Up
+    for (int file = start_file - 1, rank = start_rank - 1; file >= 0 && rank >= 0; file--, rank--) {
+        if (square[file][rank].type == Piece::Type::None) {
+            addMove(start_file, start_rank, file, rank, moves);
+        }
+        else if (square[file][rank].color != square[start_file][start_rank].color) {
+            addMove(start_file, start_rank, file, rank, moves);
+            break;
+        }
+        else {
+            break;
+        }
+    }
+    // Right & Up
+    for (int file = start_file + 1, rank = start_rank - 1; file < board_width && rank >= 0; file++, rank--) {
+        if (square[file][rank].type == Piece::Type::None) {
+            addMove(start_file, start_rank, file, rank, moves);
+        }
+        else if (square[file][rank].color != square[start_file][start_rank].color) {
+            addMove(start_file, start_rank, file, rank, moves);
+            break;
+        }
+        else {
+            break;
+        }
+    }
+    // Left & Down
+    for (int file = start_file - 1, rank = start_rank + 1; file >= 0 && rank < board_width; file--, rank++) {
+        if (square[file][rank].type == Piece::Type::None) {
+            addMove(start_file, start_rank, file, rank, moves);
+        }
+        else if (square[file][rank].color != square[start_file][start_rank].color) {
+            addMove(start_file, start_rank, file, rank, moves);
+            break;
+        }
+        else {
+            break;
+        }
+    }
+}
+
+void Position::generateKnightMoves(int start_file, int start_rank, MoveList& moves) {
+    for (int target : knight_attacks[squareIndex(start_file, start_rank)]) {
+        int file = squareFile(target);
+        int rank = squareRank(target);
+        if (square[file][rank].type == Piece::Type::None
+            || square[file][rank].color != square[start_file][start_rank].color) {
+            addMove(start_file, start_rank, file, rank, moves);
+        }
+    }
+}
+
+void Position::generateKingMoves(int start_file, int start_rank, MoveList& moves) {
+    if (square[start_file][start_rank].color == Piece::Color::White) {
+        generateKingMovesFor<Piece::Color::White>(start_file, start_rank, moves);
+    } else {
+        generateKingMovesFor<Piece::Color::Black>(start_file, start_rank, moves);
+    }
+}
+
+template <Piece::Color Us>
+void Position::generateKingMovesFor(int start_file, int start_rank, MoveList& moves) {
+    for (int target : king_attacks[squareIndex(start_file, start_rank)]) {
+        int file = squareFile(target);
+        int rank = squareRank(target);
+        if (square[file][rank].type == Piece::Type::None || square[file][rank].color != Us) {
+            addMove(start_file, start_rank, file, rank, moves);
+        }
+    }
+    constexpr bool white = ColorTraits<Us>::white;
+    const bool king_side_castle = white ? white_king_side_castle : black_king_side_castle;
+    const bool queen_side_castle = white ? white_queen_side_castle : black_queen_side_castle;
+    // Exclude castling moves if not on the initial square, without rights or in check
+    if (start_file != 4 || start_rank != ColorTraits<Us>::back_rank
+        || !(king_side_castle || queen_side_castle) || inCheckFor<Us>()) {
+        return;
+    }
+    // Kingside castling, the king may not pass through an attacked square
+    if (king_side_castle) {
+        if (square[5][start_rank].type == Piece::Type::None
+            && square[6][start_rank].type == Piece::Type::None
+            && square[7][start_rank].type == Piece::Type::Rook
+            && square[7][start_rank].color == Us
+            && isValidLegalMoveFor<Us>(start_file, start_rank, 5, start_rank)) {
+            addMove(start_file, start_rank, start_file + 2, start_rank, moves);
+        }
+    }
+    // Queenside castling
+    if (queen_side_castle) {
+        if (square[1][start_rank].type == Piece::Type::None
+            && square[2][start_rank].type == Piece::Type::None
+            && square[3][start_rank].type == Piece::Type::None
+            && square[0][start_rank].type == Piece::Type::Rook
+            && square[0][start_rank].color == Us
+            && isValidLegalMoveFor<Us>(start_file, start_rank, 3, start_rank)) {
+            addMove(start_file, start_rank, start_file - 2, start_rank, moves);
+        }
+    }
+}
+
+void Position::addMove(int start_file, int start_rank, int target_file, int target_rank, MoveList& moves) {
+    if (move_filter != MoveFilter::All) {
+        // Moves only ever target empty squares or enemy pieces, a pawn moving diagonally
+        // to an empty square captures en passant
+        bool noisy = square[target_file][target_rank].type != Piece::Type::None
+                     || (square[start_file][start_rank].type == Piece::Type::Pawn && target_file != start_file);
+        if (noisy != (move_filter == MoveFilter::Noisy)) {
+            return;
+        }
+    }
+    if (isValidLegalMove(start_file, start_rank, target_file, target_rank)) {
+        moves.push_back(Move(start_file, start_rank, target_file, target_rank));
+    }
+}
+
+void Position::addPromotionMoves(int start_file, int start_rank, int target_file, int target_rank, MoveList& moves) {
+    if (move_filter == MoveFilter::Quiet) {
+        return;
+    }
+    if (isValidLegalMove(start_file, start_rank, target_file, target_rank)) {
+        moves.push_back(Move(start_file, start_rank, target_file, target_rank, Piece::Type::Queen));
+        moves.push_back(Move(start_file, start_rank, target_file, target_rank, Piece::Type::Knight));
+        moves.push_back(Move(start_file, start_rank, target_file, target_rank, Piece::Type::Rook));
+        moves.push_back(Move(start_file, start_rank, target_file, target_rank, Piece::Type::Bishop));
+    }
+}
+
+bool Position::isValidLegalMove(int start_file, int start_rank, int target_file, int target_rank) {
+    CHESS_TRACE_COUNT(IsValidLegalMove);
+    if (square[start_file][start_rank].color == Piece::Color::White) {
+        return isValidLegalMoveFor<Piece::Color::White>(start_file, start_rank, target_file, target_rank);
+    }
+    return isValidLegalMoveFor<Piece::Color::Black>(start_file, start_rank, target_file, target_rank);
+}
+
+template <Piece::Color Us>
+bool Position::isValidLegalMoveFor(int start_file, int start_rank, int target_file, int target_rank) {
+    bool is_valid = true;
+    Piece target_square = square[target_file][target_rank];
+    // An en passant capture also removes the pawn beside the capturing pawn
+    bool en_passant_capture = square[start_file][start_rank].type == Piece::Type::Pawn
+                              && target_file != start_file
+                              && target_file == en_passant[0] && target_rank == en_passant[1];
+    Piece captured_pawn = square[target_file][start_rank];
+    if (en_passant_capture) {
+        square[target_file][start_rank].type = Piece::Type::None;
+    }
+    // Make move
+    square[target_file][target_rank] = square[start_file][start_rank];
+    square[start_file][start_rank].type = Piece::Type::None;
+    // Validate
+    is_valid = !inCheckFor<Us>();
+    // Undo move
+    square[start_file][start_rank] = square[target_file][target_rank];
+    square[target_file][target_rank] = target_square;
+    if (en_passant_capture) {
+        square[target_file][start_rank] = captured_pawn;
+    }
+
+    return is_valid;
+}
+
+bool Position::inCheck(Piece::Color color) const {
+    CHESS_TRACE_COUNT(InCheck);
+    return (color == Piece::Color::White) ? inCheckFor<Piece::Color::White>() : inCheckFor<Piece::Color::Black>();
+}
+
+template <Piece::Color Us>
+bool Position::inCheckFor() const {
+    // file and rank of king
+    int file = 0;
+    int rank = 0;
+    for ( ; file < board_width; file++) {
+        for (rank = 0 ; rank < board_width; rank++) {
+            if (square[file][rank].color == Us
+                && square[file][rank].type == Piece::Type::King) {
+                break;
+            }
+        }
+        if (rank < board_width) {
+            break;
+        }
+    }
+    // No king on the board
+    if (file == board_width) {
+        return false;
+    }
+    return isAttacked(file, rank, ColorTraits<Us>::them);
+}
+
+bool Position::isAttacked(int file, int rank, Piece::Color color) const {
+    int attacker_file, attacker_rank;
+    return leastValuableAttacker(file, rank, color, 0, attacker_file, attacker_rank) != Piece::Type::None;
+}
+
+Piece::Type Position::leastValuableAttacker(int file, int rank, Piece::Color color, std::uint64_t removed,
+                                            int& attacker_file, int& attacker_rank) const {
+    // Returns true if there is a piece of the attacking color and type on the square
+    auto isAttacker = [&](int f, int r, Piece::Type type) {
+        const Piece& piece = square[f][r];
+        return piece.type == type && piece.color == color
+               && !(removed >> (f * 8 + r) & 1);
+    };
+    auto found = [&](int f, int r) {
+        attacker_file = f;
+        attacker_rank = r;
+        return square[f][r].type;
+    };
+
+    // Attacking pawns stand on the squares a pawn of the other color would attack
+    Piece::Color other = (color == Piece::Color::White) ? Piece::Color::Black : Piece::Color::White;
+    const int target = squareIndex(file, rank);
+    for (int from : pawnAttacks(other, target)) {
+        if (isAttacker(squareFile(from), squareRank(from), Piece::Type::Pawn)) {
+            return found(squareFile(from), squareRank(from));
+        }
+    }
+    // Attacking Knights
+    for (int from : knight_attacks[target]) {
+        if (isAttacker(squareFile(from), squareRank(from), Piece::Type::Knight)) {
+            return found(squareFile(from), squareRank(from));
+        }
+    }
+    // Attacking sliders, the first piece on every ray that was not removed. Diagonals are
+    // scanned first so that bishops come before rooks, queens come after both
+    static constexpr std::array<std::array<int, 2>, 8> directions = {{
+        {{1, 1}}, {{-1, -1}}, {{1, -1}}, {{-1, 1}}, {{1, 0}}, {{-1, 0}}, {{0, 1}}, {{0, -1}}
+    }};
+    int queen_file = -1;
+    int queen_rank = -1;
+    for (int d = 0; d < 8; d++) {
+        // The first four directions are diagonals
+        Piece::Type slider = (d < 4) ? Piece::Type::Bishop : Piece::Type::Rook;
+        for (int f = file + directions[d][0], r = rank + directions[d][1];
+             f >= 0 && f < 8 && r >= 0 && r < 8;
+             f += directions[d][0], r += directions[d][1]) {
+            if (square[f][r].type == Piece::Type::None || (removed >> (f * 8 + r) & 1)) {
+                continue;
+            }
+            if (isAttacker(f, r, slider)) {
+                return found(f, r);
+            }
+            if (isAttacker(f, r, Piece::Type::Queen)) {
+                queen_file = f;
+                queen_rank = r;
+            }
+            break;
+        }
+    }
+    if (queen_file != -1) {
+        return found(queen_file, queen_rank);
+    }
+    // Attacking King
+    for (int from : king_attacks[target]) {
+        if (isAttacker(squareFile(from), squareRank(from), Piece::Type::King)) {
+            return found(squareFile(from), squareRank(from));
+        }
+    }
+    return Piece::Type::None;
+}
+
+int Position::see(const Move& move) const {
+    const int king_value = 20000;
+    auto value = [&](Piece::Type type) {
+        return (type == Piece::Type::King) ? king_value : piece_values[type];
+    };
+    const int target_file = move.target_file;
+    const int target_rank = move.target_rank;
+    const Piece& mover = square[move.start_file][move.start_rank];
+    std::uint64_t removed = std::uint64_t{1} << (move.start_file * 8 + move.start_rank);
+
+    // Material won by every capture in the exchange, from the side making that capture
+    std::array<int, 32> gain;
+    gain[0] = value(square[target_file][target_rank].type);
+    // En passant
+    if (mover.type == Piece::Type::Pawn && square[target_file][target_rank].type == Piece::Type::None
+        && move.start_file != target_file) {
+        gain[0] = value(Piece::Type::Pawn);
+        removed |= std::uint64_t{1} << (target_file * 8 + move.start_rank);
+    }
+    // Value of the piece standing on the target square, which the next capture wins
+    int on_square = value(mover.type);
+    if (move.promotion != Piece::Type::None) {
+        gain[0] += value(move.promotion) - value(Piece::Type::Pawn);
+        on_square = value(move.promotion);
+    }
+
+    Piece::Color side = (mover.color == Piece::Color::White) ? Piece::Color::Black : Piece::Color::White;
+    int depth = 0;
+    while (depth + 1 < static_cast<int>(gain.size())) {
+        int attacker_file, attacker_rank;
+        Piece::Type attacker = leastValuableAttacker(target_file, target_rank, side, removed,
+                                                     attacker_file, attacker_rank);
+        if (attacker == Piece::Type::None) {
+            break;
+        }
+        // A king can only recapture if the square is no longer defended
+        if (attacker == Piece::Type::King) {
+            Piece::Color other = (side == Piece::Color::White) ? Piece::Color::Black : Piece::Color::White;
+            std::uint64_t without_king = removed | (std::uint64_t{1} << (attacker_file * 8 + attacker_rank));
+            int defender_file, defender_rank;
+            if (leastValuableAttacker(target_file, target_rank, other, without_king,
+                                      defender_file, defender_rank) != Piece::Type::None) {
+                break;
+            }
+        }
+        depth++;
+        gain[depth] = on_square - gain[depth - 1];
+        on_square = value(attacker);
+        // Removing the attacker uncovers any slider behind it (x-ray)
+        removed |= std::uint64_t{1} << (attacker_file * 8 + attacker_rank);
+        side = (side == Piece::Color::White) ? Piece::Color::Black : Piece::Color::White;
+    }
+    // Either side may stop capturing when continuing would lose material
+    while (depth > 0) {
+        gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+        depth--;
+    }
+    return gain[0];
+}
+
+void Position::makeMove(const Move& move, UndoInfo& undo) {
+    if (active_color == Piece::Color::White) {
+        makeMoveFor<Piece::Color::White>(move, undo);
+    } else {
+        makeMoveFor<Piece::Color::Black>(move, undo);
+    }
+}
+
+template <Piece::Color Us>
+void Position::makeMoveFor(const Move& move, UndoInfo& undo) {
+    const int start_file = move.start_file;
+    const int start_rank = move.start_rank;
+    const int target_file = move.target_file;
+    const int target_rank = move.target_rank;
+    const Piece piece = square[start_file][start_rank];
+
+    undo.captured = square[target_file][target_rank];
+    undo.white_king_side_castle = white_king_side_castle;
+    undo.white_queen_side_castle = white_queen_side_castle;
+    undo.black_king_side_castle = black_king_side_castle;
+    undo.black_queen_side_castle = black_queen_side_castle;
+    undo.en_passant = en_passant;
+    undo.halfmove_clock = halfmove_clock;
+    undo.hash = zobrist_hash;
+
+    std::uint64_t changed = squareBit(start_file, start_rank) | squareBit(target_file, target_rank);
+    std::uint64_t hash = zobrist_hash;
+    hash ^= castlingKey(white_king_side_castle, white_queen_side_castle,
+                        black_king_side_castle, black_queen_side_castle);
+    if (hashesEnPassant(Us)) {
+        hash ^= enPassantKey(en_passant[0]);
+    }
+
+    bool capture = false;
+    // Capture
+    if (square[target_file][target_rank].type != Piece::Type::None) {
+        hash ^= pieceKey(square[target_file][target_rank], target_file, target_rank);
+        capture = true;
+    }
+    // En passant capture
+    else if (piece.type == Piece::Type::Pawn && target_file != start_file) {
+        hash ^= pieceKey(square[target_file][start_rank], target_file, start_rank);
+        square[target_file][start_rank].type = Piece::Type::None;
+        changed |= squareBit(target_file, start_rank);
+        capture = true;
+    }
+    // Move piece, replacing it with the promotion piece if there is one
+    Piece placed = piece;
+    if (move.promotion != Piece::Type::None) {
+        placed.type = move.promotion;
+    }
+    hash ^= pieceKey(piece, start_file, start_rank);
+    hash ^= pieceKey(placed, target_file, target_rank);
+    square[target_file][target_rank] = placed;
+    square[start_file][start_rank].type = Piece::Type::None;
+    // Castling also moves the rook to the other side of the king
+    constexpr int back_rank = ColorTraits<Us>::back_rank;
+    if (piece.type == Piece::Type::King && std::abs(target_file - start_file) == 2) {
+        int rook_file = (target_file > start_file) ? 7 : 0;
+        int new_rook_file = (target_file > start_file) ? 5 : 3;
+        Piece rook = square[rook_file][back_rank];
+        hash ^= pieceKey(rook, rook_file, back_rank);
+        hash ^= pieceKey(rook, new_rook_file, back_rank);
+        square[new_rook_file][back_rank] = rook;
+        square[rook_file][back_rank].type = Piece::Type::None;
+        changed |= squareBit(rook_file, back_rank) | squareBit(new_rook_file, back_rank);
+    }
+    // Update castling availability for king moves and moves from or to a corner
+    if (piece.type == Piece::Type::King) {
+        if constexpr (ColorTraits<Us>::white) {
+            white_king_side_castle = white_queen_side_castle = false;
+        } else {
+            black_king_side_castle = black_queen_side_castle = false;
+        }
+    }
+    for (const auto& corner : {std::array<int, 2>{{start_file, start_rank}},
+                               std::array<int, 2>{{target_file, target_rank}}}) {
+        if (corner[0] == 7 && corner[1] == 7) white_king_side_castle = false;
+        else if (corner[0] == 0 && corner[1] == 7) white_queen_side_castle = false;
+        else if (corner[0] == 7 && corner[1] == 0) black_king_side_castle = false;
+        else if (corner[0] == 0 && corner[1] == 0) black_queen_side_castle = false;
+    }
+    hash ^= castlingKey(white_king_side_castle, white_queen_side_castle,
+                        black_king_side_castle, black_queen_side_castle);
+    // New en passant target square, the old and new ones count as changed as en passant
+    // captures appear and disappear without a piece changing on them
+    if (en_passant[0] != -1) {
+        changed |= squareBit(en_passant[0], en_passant[1]);
+    }
+    en_passant = {{-1, -1}};
+    if (piece.type == Piece::Type::Pawn && std::abs(target_rank - start_rank) == 2) {
+        en_passant = {{start_file, (start_rank + target_rank) / 2}};
+        changed |= squareBit(en_passant[0], en_passant[1]);
+        if (hashesEnPassant(ColorTraits<Us>::them)) {
+            hash ^= enPassantKey(start_file);
+        }
+    }
+    changed_squares |= changed;
+
+    if (piece.type == Piece::Type::Pawn || capture) {
+        halfmove_clock = 0;
+    } else {
+        halfmove_clock++;
+    }
+    if constexpr (!ColorTraits<Us>::white) {
+        fullmove_number++;
+    }
+    active_color = ColorTraits<Us>::them;
+    hash ^= sideKey();
+
+    zobrist_hash = hash;
+    hash_history.push_back(hash);
+}
+
+void Position::undoMove(const Move& move, const UndoInfo& undo) {
+    // The side that made the move is the one not to move
+    if (active_color == Piece::Color::White) {
+        undoMoveFor<Piece::Color::Black>(move, undo);
+    } else {
+        undoMoveFor<Piece::Color::White>(move, undo);
+    }
+}
+
+template <Piece::Color Us>
+void Position::undoMoveFor(const Move& move, const UndoInfo& undo) {
+    const int start_file = move.start_file;
+    const int start_rank = move.start_rank;
+    const int target_file = move.target_file;
+    const int target_rank = move.target_rank;
+
+    active_color = Us;
+    if constexpr (!ColorTraits<Us>::white) {
+        fullmove_number--;
+    }
+    Piece piece = square[target_file][target_rank];
+    if (move.promotion != Piece::Type::None) {
+        piece.type = Piece::Type::Pawn;
+    }
+    square[start_file][start_rank] = piece;
+    square[target_file][target_rank] = undo.captured;
+    std::uint64_t changed = squareBit(start_file, start_rank) | squareBit(target_file, target_rank);
+    // Restore pawn captured en passant
+    if (piece.type == Piece::Type::Pawn
+        && target_file == undo.en_passant[0] && target_rank == undo.en_passant[1]) {
+        square[target_file][start_rank] = Piece(Piece::Type::Pawn, ColorTraits<Us>::them);
+        changed |= squareBit(target_file, start_rank);
+    }
+    // Move castled rook back
+    constexpr int back_rank = ColorTraits<Us>::back_rank;
+    if (piece.type == Piece::Type::King && std::abs(target_file - start_file) == 2) {
+        int rook_file = (target_file > start_file) ? 7 : 0;
+        int new_rook_file = (target_file > start_file) ? 5 : 3;
+        square[rook_file][back_rank] = square[new_rook_file][back_rank];
+        square[new_rook_file][back_rank].type = Piece::Type::None;
+        changed |= squareBit(rook_file, back_rank) | squareBit(new_rook_file, back_rank);
+    }
+    for (const std::array<int, 2>& target : {en_passant, undo.en_passant}) {
+        if (target[0] != -1) {
+            changed |= squareBit(target[0], target[1]);
+        }
+    }
+    changed_squares |= changed;
+
+    white_king_side_castle = undo.white_king_side_castle;
+    white_queen_side_castle = undo.white_queen_side_castle;
+    black_king_side_castle = undo.black_king_side_castle;
+    black_queen_side_castle = undo.black_queen_side_castle;
+    en_passant = undo.en_passant;
+    halfmove_clock = undo.halfmove_clock;
+    zobrist_hash = undo.hash;
+    hash_history.pop_back();
+}
+
+Move Position::parseMove(const std::string& uci) {
+    MoveList moves;
+    generateMoves(active_color, moves);
+    for (const Move& move : moves) {
+        if (move.toString() == uci) {
+            return move;
+        }
+    }
+    return Move();
+}
+
+Move Position::parseSAN(const std::string& san) {
+    std::string text = san;
+    while (!text.empty() && std::string("+#!?").find(text.back()) != std::string::npos) {
+        text.pop_back();
+    }
+    const std::string piece_letters = " K NBRQ";
+    Piece::Type type = Piece::Type::Pawn;
+    Piece::Type promotion = Piece::Type::None;
+    int start_file = -1, start_rank = -1;
+    int target_file = -1, target_rank = -1;
+    if (text == "O-O" || text == "0-0" || text == "O-O-O" || text == "0-0-0") {
+        type = Piece::Type::King;
+        start_file = 4;
+        target_file = (text.size() == 3) ? 6 : 2;
+        target_rank = start_rank = (active_color == Piece::Color::White) ? 7 : 0;
+    } else {
+        std::size_t begin = 0;
+        std::size_t letter = text.empty() ? std::string::npos : piece_letters.find(text[0]);
+        if (letter != std::string::npos && letter != 0 && letter != Piece::Type::Pawn) {
+            type = static_cast<Piece::Type>(letter);
+            begin = 1;
+        }
+        // Promotions are written "e8=Q" or "e8Q"
+        letter = text.empty() ? std::string::npos : piece_letters.find(text.back());
+        if (type == Piece::Type::Pawn && letter != std::string::npos && letter >= Piece::Type::Knight) {
+            promotion = static_cast<Piece::Type>(letter);
+            text.pop_back();
+            if (!text.empty() && text.back() == '=') {
+                text.pop_back();
+            }
+        }
+        // What is left is the optional origin file and rank, an optional capture and the target square
+        std::string squares;
+        for (std::size_t i = begin; i < text.size(); i++) {
+            if (text[i] != 'x' && text[i] != '-' && text[i] != ':') {
+                squares += text[i];
+            }
+        }
+        if (squares.size() < 2 || squares.size() > 4) {
+            return Move();
+        }
+        target_file = squares[squares.size() - 2] - 'a';
+        target_rank = '8' - squares.back();
+        for (std::size_t i = 0; i + 2 < squares.size(); i++) {
+            if (squares[i] >= 'a' && squares[i] <= 'h') {
+                start_file = squares[i] - 'a';
+            } else if (squares[i] >= '1' && squares[i] <= '8') {
+                start_rank = '8' - squares[i];
+            } else {
+                return Move();
+            }
+        }
+    }
+    if (target_file < 0 || target_file > 7 || target_rank < 0 || target_rank > 7) {
+        return Move();
+    }
+
+    // Only the moves of the pieces which can be the moving piece are generated
+    Move found;
+    MoveList moves;
+    for (int file = 0; file < 8; file++) {
+        for (int rank = 0; rank < 8; rank++) {
+            const Piece& piece = square[file][rank];
+            if (piece.type != type || piece.color != active_color
+                || (start_file != -1 && file != start_file) || (start_rank != -1 && rank != start_rank)) {
+                continue;
+            }
+            moves.clear();
+            generatePieceMoves(file, rank, moves);
+            for (const Move& move : moves) {
+                if (move.target_file != target_file || move.target_rank != target_rank
+                    || move.promotion != promotion) {
+                    continue;
+                }
+                // Notation matching more than one move is ambiguous
+                if (found.isValid()) {
+                    return Move();
+                }
+                found = move;
+            }
+        }
+    }
+    return found;
+}
+
+bool Position::isLegal(const Move& move) {
+    if (!move.isValid()) {
+        return false;
+    }
+    const Piece& piece = square[move.start_file][move.start_rank];
+    if (piece.type == Piece::Type::None || piece.color != active_color) {
+        return false;
+    }
+    // Only the moves of the moving piece have to be generated
+    MoveList moves;
+    generatePieceMoves(move.start_file, move.start_rank, moves);
+    return std::find(moves.begin(), moves.end(), move) != moves.end();
+}
+
+std::string Position::toSAN(const Move& move) {
+    const char piece_letters[] = {' ', 'K', ' ', 'N', 'B', 'R', 'Q'};
+    const Piece& piece = square[move.start_file][move.start_rank];
+    std::string target{static_cast<char>('a' + move.target_file),
+                       static_cast<char>('8' - move.target_rank)};
+    std::string san;
+
+    if (piece.type == Piece::Type::King && std::abs(move.target_file - move.start_file) == 2) {
+        san = (move.target_file > move.start_file) ? "O-O" : "O-O-O";
+    }
+    else if (piece.type == Piece::Type::Pawn) {
+        if (isCapture(move)) {
+            san += static_cast<char>('a' + move.start_file);
+            san += 'x';
+        }
+        san += target;
+        if (move.promotion != Piece::Type::None) {
+            san += '=';
+            san += piece_letters[move.promotion];
+        }
+    }
+    else {
+        san += piece_letters[piece.type];
+        // Disambiguate between pieces of the same type that can move to the same square
+        MoveList moves;
+        generateMoves(active_color, moves);
+        bool ambiguous = false, same_file = false, same_rank = false;
+        for (const Move& other : moves) {
+            if (other.target_file != move.target_file || other.target_rank != move.target_rank
+                || (other.start_file == move.start_file && other.start_rank == move.start_rank)
+                || square[other.start_file][other.start_rank].type != piece.type) {
+                continue;
+            }
+            ambiguous = true;
+            same_file |= other.start_file == move.start_file;
+            same_rank |= other.start_rank == move.start_rank;
+        }
+        if (ambiguous) {
+            if (!same_file) {
+                san += static_cast<char>('a' + move.start_file);
+            }
+            else if (!same_rank) {
+                san += static_cast<char>('8' - move.start_rank);
+            }
+            else {
+                san += static_cast<char>('a' + move.start_file);
+                san += static_cast<char>('8' - move.start_rank);
+            }
+        }
+        if (isCapture(move)) {
+            san += 'x';
+        }
+        san += target;
+    }
+    // Check and checkmate
+    UndoInfo undo;
+    makeMove(move, undo);
+    if (inCheck(active_color)) {
+        MoveList replies;
+        generateMoves(active_color, replies);
+        san += replies.empty() ? '#' : '+';
+    }
+    undoMove(move, undo);
+    return san;
+}
+
+bool Position::isCapture(const Move& move) const {
+    if (square[move.target_file][move.target_rank].type != Piece::Type::None) {
+        return true;
+    }
+    return square[move.start_file][move.start_rank].type == Piece::Type::Pawn
+           && move.target_file != move.start_file;
+}
+
+bool Position::isRepetition() const {
+    return repetitionCount() > 0;
+}
+
+bool Position::isInsufficientMaterial() const {
+    int minor_pieces = 0;
+    for (int file = 0; file < 8; file++) {
+        for (int rank = 0; rank < 8; rank++) {
+            switch (square[file][rank].type) {
+                case Piece::Type::None:
+                case Piece::Type::King:
+                    break;
+                case Piece::Type::Knight:
+                case Piece::Type::Bishop:
+                    minor_pieces++;
+                    break;
+                default:
+                    return false;
+            }
+        }
+    }
+    // King against king, or king and a single minor piece against king
+    return minor_pieces <= 1;
+}
+
+int Position::repetitionCount() const {
+    int count = 0;
+    // Only positions with the same side to move since the last irreversible move can repeat
+    int last = static_cast<int>(hash_history.size()) - 1;
+    int first = std::max(0, last - halfmove_clock);
+    for (int i = last - 2; i >= first; i -= 2) {
+        if (hash_history[i] == zobrist_hash) {
+            count++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,381 @@
+#include "search.hpp"
+#include "evaluation.hpp"
+#include "position.hpp"
+#include "move.hpp"
+#include "transposition_table.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace {
+    // Mate scores are stored relative to the node instead of the root so that
+    // they stay correct when the position is reached at a different ply
+    int scoreToTT(int score, int ply) {
+        if (score > mate_bound) {
+            return score + ply;
+        }
+        if (score < -mate_bound) {
+            return score - ply;
+        }
+        return score;
+    }
+
+    int scoreFromTT(int score, int ply) {
+        if (score > mate_bound) {
+            return score - ply;
+        }
+        if (score < -mate_bound) {
+            return score + ply;
+        }
+        return score;
+    }
+}
+
+Search::Search(TranspositionTable& tt, std::atomic<bool>& stop_flag, const std::atomic<bool>* ponder_flag) :
+    tt(tt),
+    stop_flag(stop_flag),
+    ponder_flag(ponder_flag)
+{
+}
+
+const SearchInfo& Search::run(const Position& root, const SearchLimits& limits, const InfoCallback& on_info) {
+    position = root;
+    node_count.store(0, std::memory_order_relaxed);
+    node_limit = limits.nodes;
+    start_time = limit_start = Clock::now();
+    was_pondering = limits.ponder;
+    allocateTime(limits);
+
+    for (KillerMoves& ply_killers : killers) {
+        ply_killers.fill(Move());
+    }
+    for (auto& color_history : history) {
+        for (auto& from_history : color_history) {
+            from_history.fill(0);
+        }
+    }
+
+    result.depth = 0;
+    result.score = 0;
+    result.pv.clear();
+    MoveList root_moves;
+    position.generateMoves(position.activeColor(), root_moves);
+    // Fall back to the first legal move if stopped before the first iteration completes
+    if (!root_moves.empty()) {
+        result.pv.push_back(root_moves[0]);
+    }
+
+    int max_depth = (limits.depth > 0) ? std::min(limits.depth, max_ply - 1) : max_ply - 1;
+    int lines = std::clamp(limits.multipv, 1, std::max(1, static_cast<int>(root_moves.size())));
+    bool stopped = false;
+    for (int depth = 1; depth <= max_depth && !stopped; depth++) {
+        // Every line is searched without the root moves of the better lines
+        excluded_root_moves.clear();
+        for (int line = 1; line <= lines; line++) {
+            CHESS_TRACE_SCOPE("search iteration");
+            int score = alphaBeta(depth, 0, -infinite_score, infinite_score);
+            // Results of an interrupted iteration are not reliable
+            if (stop_flag.load(std::memory_order_relaxed)) {
+                stopped = true;
+                break;
+            }
+            SearchInfo& info = (line == 1) ? result : line_result;
+            info.depth = depth;
+            info.score = score;
+            info.nodes = nodes();
+            info.time_ms = elapsed();
+            info.pv.assign(pv_table[0].begin(), pv_table[0].begin() + pv_length[0]);
+            info.multipv = line;
+            if (on_info) {
+                on_info(info);
+            }
+            if (!info.pv.empty()) {
+                excluded_root_moves.push_back(info.pv.front());
+            }
+        }
+        // Nothing to search in checkmate or stalemate
+        if (root_moves.empty()) {
+            break;
+        }
+        if (soft_limit > 0 && !pondering() && limitElapsed() >= soft_limit) {
+            break;
+        }
+    }
+    result.nodes = nodes();
+    result.time_ms = elapsed();
+    return result;
+}
+
+int Search::alphaBeta(int depth, int ply, int alpha, int beta) {
+    pv_length[ply] = ply;
+    if (visitNode()) {
+        return 0;
+    }
+    // Draw by fifty-move rule or repetition
+    if (ply > 0 && (position.isFiftyMoveDraw() || position.isRepetition())) {
+        history_draws++;
+        return 0;
+    }
+    std::uint64_t draws_before = history_draws;
+    if (ply >= max_ply - 1) {
+        return evaluate(position);
+    }
+
+    bool in_check = position.inCheck(position.activeColor());
+    // Check extension
+    if (in_check) {
+        depth++;
+    }
+    if (depth <= 0) {
+        return quiescence(ply, alpha, beta);
+    }
+
+    // Transposition table cutoff
+    Move tt_move;
+    TTEntry entry;
+    bool found = tt.probe(position.hash(), entry);
+    // Deeper results than the table's may be known from an earlier session
+    TTEntry cached;
+    if (cache != nullptr && depth >= cache->minDepth() && (!found || entry.depth < depth)
+        && cache->probe(position.hash(), cached) && (!found || cached.depth > entry.depth)) {
+        entry = cached;
+        found = true;
+        tt.store(position.hash(), cached.depth, cached.score, cached.bound, cached.move);
+    }
+    if (found) {
+        tt_move = entry.move;
+        if (ply > 0 && entry.depth >= depth) {
+            int score = scoreFromTT(entry.score, ply);
+            if (entry.bound == Bound::Exact) {
+                // Without a search below the node its line is taken from the stored best moves
+                storedPv(ply, entry.move, entry.depth);
+                return score;
+            }
+            if ((entry.bound == Bound::Lower && score >= beta)
+                || (entry.bound == Bound::Upper && score <= alpha)) {
+                return score;
+            }
+        }
+    }
+
+    int original_alpha = alpha;
+    int best_score = -infinite_score;
+    Move best_move;
+    int move_count = 0;
+    MovePicker picker(position, tt_move, killers[ply], history);
+    for (Move move = picker.next(); move.isValid(); move = picker.next()) {
+        if (ply == 0 && !excluded_root_moves.empty()
+            && std::find(excluded_root_moves.begin(), excluded_root_moves.end(), move) != excluded_root_moves.end()) {
+            continue;
+        }
+        move_count++;
+        bool quiet = !position.isNoisy(move);
+        Position::UndoInfo undo;
+        position.makeMove(move, undo);
+        int score = -alphaBeta(depth - 1, ply + 1, -beta, -alpha);
+        position.undoMove(move, undo);
+
+        if (stop_flag.load(std::memory_order_relaxed)) {
+            return 0;
+        }
+        if (score > best_score) {
+            best_score = score;
+            best_move = move;
+            if (score > alpha) {
+                alpha = score;
+                // Update principal variation
+                pv_table[ply][ply] = move;
+                for (int i = ply + 1; i < pv_length[ply + 1]; i++) {
+                    pv_table[ply][i] = pv_table[ply + 1][i];
+                }
+                pv_length[ply] = pv_length[ply + 1];
+                if (alpha >= beta) {
+                    if (quiet) {
+                        updateQuietStats(move, depth, ply);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    // Checkmate and stalemate
+    if (move_count == 0) {
+        return in_check ? -mate_score + ply : 0;
+    }
+
+    // The score of a root searched without some of its moves is not the score of the position
+    if (ply == 0 && !excluded_root_moves.empty()) {
+        return best_score;
+    }
+    Bound bound = (best_score >= beta) ? Bound::Lower
+                : (best_score > original_alpha) ? Bound::Exact : Bound::Upper;
+    tt.store(position.hash(), depth, scoreToTT(best_score, ply), bound, best_move);
+    // Scores of lines ending in a draw by repetition or the fifty-move rule depend on how the
+    // position was reached, they are not kept beyond this search
+    if (cache != nullptr && depth >= cache->minDepth() && history_draws == draws_before) {
+        cache->store(position.hash(), depth, scoreToTT(best_score, ply), bound, best_move);
+    }
+    return best_score;
+}
+
+int Search::quiescence(int ply, int alpha, int beta) {
+    // Margin for positional gains when pruning captures that cannot raise alpha
+    const int delta_margin = 200;
+    pv_length[ply] = ply;
+    if (visitNode()) {
+        return 0;
+    }
+    // Stand pat, the side to move is assumed to have a quiet move at least as good as the evaluation
+    int stand_pat = evaluate(position);
+    if (ply >= max_ply - 1 || stand_pat >= beta) {
+        return stand_pat;
+    }
+    // Delta pruning, not even winning a queen raises alpha. The score fails soft with the
+    // most a capture could reach, as an upper bound stored from it must not be too low
+    int best_possible = stand_pat + piece_values[Piece::Type::Queen] + delta_margin;
+    if (best_possible < alpha) {
+        return best_possible;
+    }
+    alpha = std::max(alpha, stand_pat);
+
+    int best_score = stand_pat;
+    MovePicker picker(position);
+    for (Move move = picker.next(); move.isValid(); move = picker.next()) {
+        // Skip captures that cannot raise alpha even with the margin, except promotions
+        Piece::Type victim = position.pieceAt(move.target_file, move.target_rank).type;
+        // En passant
+        if (victim == Piece::Type::None && move.promotion == Piece::Type::None) {
+            victim = Piece::Type::Pawn;
+        }
+        if (move.promotion == Piece::Type::None && stand_pat + piece_values[victim] + delta_margin <= alpha) {
+            continue;
+        }
+        // Skip captures losing material in the exchange
+        if (position.see(move) < 0) {
+            continue;
+        }
+        Position::UndoInfo undo;
+        position.makeMove(move, undo);
+        int score = -quiescence(ply + 1, -beta, -alpha);
+        position.undoMove(move, undo);
+
+        if (stop_flag.load(std::memory_order_relaxed)) {
+            return 0;
+        }
+        if (score > best_score) {
+            best_score = score;
+            if (score > alpha) {
+                alpha = score;
+                pv_table[ply][ply] = move;
+                for (int i = ply + 1; i < pv_length[ply + 1]; i++) {
+                    pv_table[ply][i] = pv_table[ply + 1][i];
+                }
+                pv_length[ply] = pv_length[ply + 1];
+                if (alpha >= beta) {
+                    break;
+                }
+            }
+        }
+    }
+    return best_score;
+}
+
+void Search::storedPv(int ply, Move move, int depth) {
+    int length = ply;
+    int end = std::min(ply + depth, max_ply - 1);
+    // Hash collisions may store moves that are not legal here, and a line may run into a cycle
+    while (length < end && move.isValid() && position.isLegal(move)) {
+        pv_table[ply][length] = move;
+        position.makeMove(move, pv_undo[length]);
+        length++;
+        TTEntry entry;
+        bool found = tt.probe(position.hash(), entry) || (cache != nullptr && cache->probe(position.hash(), entry));
+        move = (found && !position.isRepetition()) ? entry.move : Move();
+    }
+    for (int i = length - 1; i >= ply; i--) {
+        position.undoMove(pv_table[ply][i], pv_undo[i]);
+    }
+    pv_length[ply] = length;
+}
+
+bool Search::visitNode() {
+    std::uint64_t nodes = node_count.load(std::memory_order_relaxed) + 1;
+    node_count.store(nodes, std::memory_order_relaxed);
+    if ((node_limit > 0 && nodes >= node_limit) || (nodes & 1023) == 0) {
+        checkLimits();
+    }
+    return stop_flag.load(std::memory_order_relaxed);
+}
+
+void Search::updateQuietStats(const Move& move, int depth, int ply) {
+    KillerMoves& ply_killers = killers[ply];
+    if (ply_killers[0] != move) {
+        ply_killers[1] = ply_killers[0];
+        ply_killers[0] = move;
+    }
+    auto& color_history = history[position.activeColor() == Piece::Color::White];
+    int& score = color_history[move.start_file * 8 + move.start_rank][move.target_file * 8 + move.target_rank];
+    score += depth * depth;
+    // Age the table before scores grow large enough to drown out newer cutoffs
+    if (score > (1 << 20)) {
+        for (auto& from_history : color_history) {
+            for (int& entry : from_history) {
+                entry /= 2;
+            }
+        }
+    }
+}
+
+void Search::checkLimits() {
+    if (node_limit > 0 && nodes() >= node_limit) {
+        stop_flag.store(true, std::memory_order_relaxed);
+    }
+    if (hard_limit > 0 && !pondering() && limitElapsed() >= hard_limit) {
+        stop_flag.store(true, std::memory_order_relaxed);
+    }
+}
+
+void Search::allocateTime(const SearchLimits& limits) {
+    // Time reserved for communication overhead
+    const int overhead = 50;
+    hard_limit = soft_limit = 0;
+    if (limits.infinite) {
+        return;
+    }
+    if (limits.movetime > 0) {
+        hard_limit = soft_limit = limits.movetime;
+        return;
+    }
+    bool white = position.activeColor() == Piece::Color::White;
+    int time = white ? limits.wtime : limits.btime;
+    int increment = white ? limits.winc : limits.binc;
+    if (time < 0) {
+        return;
+    }
+    int moves_to_go = (limits.movestogo > 0) ? limits.movestogo : 30;
+    std::int64_t budget = time / moves_to_go + increment * 3 / 4;
+    std::int64_t maximum = std::max<std::int64_t>(1, time - overhead);
+    soft_limit = std::clamp<std::int64_t>(budget / 2, 1, maximum);
+    hard_limit = std::clamp<std::int64_t>(budget * 2, 1, maximum);
+}
+
+std::int64_t Search::elapsed() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_time).count();
+}
+
+std::int64_t Search::limitElapsed() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - limit_start).count();
+}
+
+bool Search::pondering() {
+    if (!was_pondering) {
+        return false;
+    }
+    if (ponder_flag != nullptr && ponder_flag->load(std::memory_order_relaxed)) {
+        return true;
+    }
+    // Ponderhit, the time limits count from now on
+    was_pondering = false;
+    limit_start = Clock::now();
+    return false;
+}
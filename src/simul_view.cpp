@@ -0,0 +1,108 @@
+#include "simul_view.hpp"
+#include "chess_board.hpp"
+#include "board_assets.hpp"
+#include "trace.hpp"
+#include "frame_profiler.hpp"
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+
+namespace {
+    // Function used to append a quad to a vertex array of quads
+    void appendQuad(sf::VertexArray& vertices, const sf::FloatRect& area, const sf::Color& color,
+                    const sf::IntRect& texture_rect = sf::IntRect()) {
+        float left = static_cast<float>(texture_rect.left);
+        float top = static_cast<float>(texture_rect.top);
+        float right = left + texture_rect.width;
+        float bottom = top + texture_rect.height;
+        vertices.append(sf::Vertex(sf::Vector2f(area.left, area.top), color, sf::Vector2f(left, top)));
+        vertices.append(sf::Vertex(sf::Vector2f(area.left + area.width, area.top), color, sf::Vector2f(right, top)));
+        vertices.append(sf::Vertex(sf::Vector2f(area.left + area.width, area.top + area.height), color,
+                                   sf::Vector2f(right, bottom)));
+        vertices.append(sf::Vertex(sf::Vector2f(area.left, area.top + area.height), color, sf::Vector2f(left, bottom)));
+    }
+}
+
+SimulView::SimulView(std::size_t board_count, const sf::Vector2f& size) :
+    assets(BoardAssets::shared()),
+    boards(std::max<std::size_t>(1, board_count)),
+    view_size(size),
+    squares(sf::Quads),
+    pieces(sf::Quads)
+{
+    // Choose the number of columns that gives the largest boards
+    columns = 1;
+    board_size = 0;
+    for (std::size_t candidate = 1; candidate <= boards.size(); candidate++) {
+        std::size_t candidate_rows = (boards.size() + candidate - 1) / candidate;
+        float candidate_size = std::min(view_size.x / candidate, view_size.y / candidate_rows);
+        if (candidate_size > board_size) {
+            board_size = candidate_size;
+            columns = candidate;
+        }
+    }
+    rows = (boards.size() + columns - 1) / columns;
+    margin = board_size * 0.03f;
+    for (Board& board : boards) {
+        board.position.loadPositionFromFEN(Position::start_fen);
+    }
+}
+
+void SimulView::setPosition(std::size_t index, const Position& position, const Move& last_move) {
+    if (index >= boards.size()) {
+        return;
+    }
+    boards[index].position = position;
+    boards[index].last_move = last_move;
+    dirty = true;
+}
+
+sf::Vector2f SimulView::boardOrigin(std::size_t index) const {
+    // Center the grid in the view
+    float offset_x = (view_size.x - board_size * columns) / 2;
+    float offset_y = (view_size.y - board_size * rows) / 2;
+    return sf::Vector2f(offset_x + board_size * (index % columns) + margin,
+                        offset_y + board_size * (index / columns) + margin);
+}
+
+void SimulView::rebuild() const {
+    squares.clear();
+    pieces.clear();
+    float square_size = (board_size - 2 * margin) / 8;
+    for (std::size_t i = 0; i < boards.size(); i++) {
+        const Board& board = boards[i];
+        sf::Vector2f origin = boardOrigin(i);
+        for (int file = 0; file < 8; file++) {
+            for (int rank = 0; rank < 8; rank++) {
+                sf::FloatRect area(origin.x + square_size * file, origin.y + square_size * rank,
+                                   square_size, square_size);
+                bool is_light_square = (file + rank) % 2 == 0;
+                appendQuad(squares, area, is_light_square ? ChessBoard::light : ChessBoard::dark);
+                // Last move highlight is blended over the square
+                const Move& last_move = board.last_move;
+                if (last_move.isValid()
+                    && ((file == last_move.start_file && rank == last_move.start_rank)
+                        || (file == last_move.target_file && rank == last_move.target_rank))) {
+                    appendQuad(squares, area, ChessBoard::highlight);
+                }
+                const Piece& piece = board.position.pieceAt(file, rank);
+                if (piece.type != Piece::Type::None) {
+                    appendQuad(pieces, area, sf::Color::White, BoardAssets::pieceRect(piece));
+                }
+            }
+        }
+    }
+    dirty = false;
+}
+
+void SimulView::draw(sf::RenderTarget& renderTarget, sf::RenderStates renderStates) const {
+    CHESS_TRACE_COUNT(Draw);
+    CHESS_TRACE_SCOPE("SimulView::draw");
+    if (dirty) {
+        rebuild();
+    }
+    // Two draw calls no matter how many boards there are
+    renderTarget.draw(squares, renderStates);
+    renderStates.texture = &assets->pieceTexture();
+    renderTarget.draw(pieces, renderStates);
+    FrameProfiler::countDrawCalls(2);
+}
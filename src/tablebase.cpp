@@ -0,0 +1,755 @@
+#include "tablebase.hpp"
+#include "attack_tables.hpp"
+#include "binary_file.hpp"
+#include "packed_position.hpp"
+#include "move.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace {
+    constexpr std::array<char, 8> tablebase_magic = {{'C', 'H', 'E', 'S', 'S', 'T', 'B', '\0'}};
+    constexpr std::uint16_t tablebase_version = 1;
+    constexpr std::size_t tablebase_header_size = 64;
+    constexpr int max_pieces = 5;
+    // Longest mate which fits in an 8 bit code
+    constexpr int max_plies = 253;
+
+    // Entry codes, the other codes are the half-moves until mate plus 2
+    constexpr std::uint8_t draw_code = 0;
+    constexpr std::uint8_t invalid_code = 1;
+    // Capture code of a position with a capture which does not lose, otherwise the capture
+    // code is the best result of the captures or 0 if there are none
+    constexpr std::uint8_t safe_capture_code = 1;
+
+    std::uint8_t pliesCode(int plies) { return static_cast<std::uint8_t>(plies + 2); }
+    int codePlies(std::uint8_t code) { return code - 2; }
+    bool isWinCode(std::uint8_t code) { return code >= 2 && codePlies(code) % 2 == 1; }
+    bool isLossCode(std::uint8_t code) { return code >= 2 && codePlies(code) % 2 == 0; }
+
+    using Squares = std::array<int, max_pieces>;
+
+    // Pieces of a material in index order: both kings, the other pieces of the first
+    // side and then those of the second side. The first side is white in the table.
+    struct Layout {
+        int count = 0;
+        std::array<Piece::Type, max_pieces> types{};
+        std::array<Piece::Color, max_pieces> colors{};
+        std::uint64_t entries = 0;
+    };
+
+    // Pieces in material order, strongest first
+    const std::string piece_letters = "KQRBN";
+
+    Piece::Type letterType(char letter) {
+        switch (letter) {
+            case 'K': return Piece::Type::King;
+            case 'Q': return Piece::Type::Queen;
+            case 'R': return Piece::Type::Rook;
+            case 'B': return Piece::Type::Bishop;
+            case 'N': return Piece::Type::Knight;
+            default: return Piece::Type::None;
+        }
+    }
+
+    char typeLetter(Piece::Type type) {
+        switch (type) {
+            case Piece::Type::King: return 'K';
+            case Piece::Type::Queen: return 'Q';
+            case Piece::Type::Rook: return 'R';
+            case Piece::Type::Bishop: return 'B';
+            case Piece::Type::Knight: return 'N';
+            default: return '?';
+        }
+    }
+
+    // Function used to sort the pieces of a side in material order
+    std::string sortSide(std::string side) {
+        std::sort(side.begin(), side.end(), [](char a, char b) {
+            return piece_letters.find(a) < piece_letters.find(b);
+        });
+        return side;
+    }
+
+    // Returns true if side a is stronger than side b: more pieces, then stronger pieces first
+    bool strongerSide(const std::string& a, const std::string& b) {
+        if (a.size() != b.size()) {
+            return a.size() > b.size();
+        }
+        for (std::size_t i = 0; i < a.size(); i++) {
+            if (a[i] != b[i]) {
+                return piece_letters.find(a[i]) < piece_letters.find(b[i]);
+            }
+        }
+        return false;
+    }
+
+    Layout makeLayout(const std::string& material) {
+        Layout layout;
+        std::size_t separator = material.find('v');
+        std::string sides[2] = {material.substr(0, separator), material.substr(separator + 1)};
+        layout.types[0] = layout.types[1] = Piece::Type::King;
+        layout.colors[0] = Piece::Color::White;
+        layout.colors[1] = Piece::Color::Black;
+        layout.count = 2;
+        for (int side = 0; side < 2; side++) {
+            for (std::size_t i = 1; i < sides[side].size(); i++) {
+                layout.types[layout.count] = letterType(sides[side][i]);
+                layout.colors[layout.count] = (side == 0) ? Piece::Color::White : Piece::Color::Black;
+                layout.count++;
+            }
+        }
+        // The first king is in one of 10 squares, every other piece on any of 64
+        layout.entries = 10;
+        for (int i = 1; i < layout.count; i++) {
+            layout.entries *= 64;
+        }
+        return layout;
+    }
+
+    // Squares of the a8-d8-d5 triangle (file 0-3, rank index at most the file) and their numbers
+    struct Triangle {
+        std::array<int, 64> number{};
+        std::array<int, 10> squares{};
+
+        Triangle() {
+            int count = 0;
+            for (int square = 0; square < 64; square++) {
+                bool inside = squareFile(square) < 4 && squareRank(square) <= squareFile(square);
+                number[square] = inside ? count : -1;
+                if (inside) {
+                    squares[count++] = square;
+                }
+            }
+        }
+    };
+
+    const Triangle triangle;
+
+    // Transformations of the board: bit 0 mirrors the files, bit 1 the ranks and bit 2
+    // swaps files and ranks after the mirroring. They are all symmetries of a pawnless
+    // position without castling rights.
+    int transformSquare(int square, int transform) {
+        int file = squareFile(square);
+        int rank = squareRank(square);
+        if (transform & 1) file = 7 - file;
+        if (transform & 2) rank = 7 - rank;
+        if (transform & 4) std::swap(file, rank);
+        return squareIndex(file, rank);
+    }
+
+    std::uint64_t indexWith(const Layout& layout, Squares squares, int transform) {
+        for (int i = 0; i < layout.count; i++) {
+            squares[i] = transformSquare(squares[i], transform);
+        }
+        // Identical pieces are interchangeable, so they are indexed in square order
+        for (int i = 3; i < layout.count; i++) {
+            for (int j = i; j > 2 && layout.types[j] == layout.types[j - 1] && layout.colors[j] == layout.colors[j - 1]
+                            && squares[j] < squares[j - 1]; j--) {
+                std::swap(squares[j], squares[j - 1]);
+            }
+        }
+        std::uint64_t index = static_cast<std::uint64_t>(triangle.number[squares[0]]);
+        for (int i = 1; i < layout.count; i++) {
+            index = index * 64 + static_cast<std::uint64_t>(squares[i]);
+        }
+        return index;
+    }
+
+    // Function used to get the canonical index of the pieces on the given squares
+    std::uint64_t indexOf(const Layout& layout, const Squares& squares) {
+        int transform = (squareFile(squares[0]) > 3 ? 1 : 0) | (squareRank(squares[0]) > 3 ? 2 : 0);
+        int king = transformSquare(squares[0], transform);
+        if (squareRank(king) > squareFile(king)) {
+            transform |= 4;
+        }
+        std::uint64_t index = indexWith(layout, squares, transform);
+        // A king on the diagonal stays there when swapping files and ranks, either board is the same position
+        if (squareRank(king) == squareFile(king)) {
+            index = std::min(index, indexWith(layout, squares, transform ^ 4));
+        }
+        return index;
+    }
+
+    Squares decodeIndex(const Layout& layout, std::uint64_t index) {
+        Squares squares{};
+        for (int i = layout.count - 1; i >= 1; i--) {
+            squares[i] = static_cast<int>(index % 64);
+            index /= 64;
+        }
+        squares[0] = triangle.squares[index];
+        return squares;
+    }
+
+    std::uint64_t occupancy(const Layout& layout, const Squares& squares) {
+        std::uint64_t occupied = 0;
+        for (int i = 0; i < layout.count; i++) {
+            occupied |= std::uint64_t(1) << squares[i];
+        }
+        return occupied;
+    }
+
+    bool distinctSquares(const Layout& layout, const Squares& squares) {
+        for (int i = 0; i < layout.count; i++) {
+            for (int j = i + 1; j < layout.count; j++) {
+                if (squares[i] == squares[j]) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Function used to call callback with every empty square a piece of the given type
+    // reaches from square. Without pawns the moves are their own reverse, so this
+    // gives the moves of a piece as well as the squares it can have come from.
+    template <typename Callback>
+    void forEachQuietTarget(Piece::Type type, int square, std::uint64_t occupied, Callback callback) {
+        if (type == Piece::Type::King || type == Piece::Type::Knight) {
+            const AttackSet& targets = (type == Piece::Type::King) ? king_attacks[square] : knight_attacks[square];
+            for (int target : targets) {
+                if (!(occupied >> target & 1)) {
+                    callback(target);
+                }
+            }
+            return;
+        }
+        static constexpr int directions[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+        int first = (type == Piece::Type::Bishop) ? 4 : 0;
+        int last = (type == Piece::Type::Rook) ? 4 : 8;
+        for (int direction = first; direction < last; direction++) {
+            int file = squareFile(square) + directions[direction][0];
+            int rank = squareRank(square) + directions[direction][1];
+            while (file >= 0 && file < 8 && rank >= 0 && rank < 8 && !(occupied >> squareIndex(file, rank) & 1)) {
+                callback(squareIndex(file, rank));
+                file += directions[direction][0];
+                rank += directions[direction][1];
+            }
+        }
+    }
+
+    // Function used to set up a position of the table through the packed format
+    void loadTablePosition(const Layout& layout, const Squares& squares, Piece::Color side, Position& position) {
+        // The pieces of a packed position are stored in square order
+        std::array<int, max_pieces> order{};
+        for (int i = 0; i < layout.count; i++) {
+            int j = i;
+            for (; j > 0 && squares[order[j - 1]] > squares[i]; j--) {
+                order[j] = order[j - 1];
+            }
+            order[j] = i;
+        }
+        PackedPosition packed;
+        std::uint64_t occupied = occupancy(layout, squares);
+        for (int i = 0; i < 8; i++) {
+            packed.bytes[i] = static_cast<std::uint8_t>(occupied >> (8 * i));
+        }
+        for (int i = 0; i < layout.count; i++) {
+            int piece = order[i];
+            int nibble = static_cast<int>(layout.types[piece]) | (layout.colors[piece] == Piece::Color::Black ? 8 : 0);
+            packed.bytes[8 + i / 2] |= static_cast<std::uint8_t>(nibble << (4 * (i % 2)));
+        }
+        packed.bytes[24] = (side == Piece::Color::Black) ? 1 : 0;
+        packed.bytes[27] = 1;
+        position.loadPackedPosition(packed);
+    }
+
+    // Function used to run function(begin, end) over chunks of [0, count) on a pool of threads
+    template <typename Function>
+    void parallelFor(int threads, std::uint64_t count, Function function) {
+        const std::uint64_t chunk = 4096;
+        std::atomic<std::uint64_t> next{0};
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; i++) {
+            workers.emplace_back([&] {
+                for (std::uint64_t begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk)) {
+                    function(begin, std::min(begin + chunk, count));
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void updateMaximum(std::atomic<int>& maximum, int value) {
+        int current = maximum.load(std::memory_order_relaxed);
+        while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+
+    // Function used to get the peak resident memory of the process in bytes, 0 if unknown
+    std::size_t peakMemory() {
+#if defined(__unix__) || defined(__APPLE__)
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+            return static_cast<std::size_t>(usage.ru_maxrss);
+#else
+            return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+        }
+#endif
+        return 0;
+    }
+
+    std::size_t packedSize(std::uint64_t entries, unsigned int bits) {
+        // One padding byte so that an entry can always be read as two bytes
+        return static_cast<std::size_t>((2 * entries * bits + 7) / 8 + 1);
+    }
+}
+
+bool Tablebase::load(const std::string& path) {
+    auto table = std::make_unique<Table>();
+    // Probes jump all over the table
+    if (!table->file.open(path, MappedFile::Access::Random)) {
+        return false;
+    }
+    const std::uint8_t* contents = table->file.data();
+    std::size_t file_size = table->file.size();
+
+    bool valid = file_size >= tablebase_header_size
+                 && std::equal(tablebase_magic.begin(), tablebase_magic.end(), contents)
+                 && readLittleEndian(contents + 8, 2) == tablebase_version;
+    if (valid) {
+        table->bits = contents[10];
+        const char* name = reinterpret_cast<const char*>(contents + 16);
+        table->material = normalizeMaterial(std::string(name, std::find(name, name + 16, '\0')));
+        table->entries = readLittleEndian(contents + 32, 8);
+        valid = table->bits >= 1 && table->bits <= 8 && !table->material.empty()
+                && contents[11] == makeLayout(table->material).count
+                && table->entries == makeLayout(table->material).entries
+                && file_size >= tablebase_header_size + packedSize(table->entries, table->bits);
+    }
+    if (!valid) {
+        std::cerr << path << " is not a tablebase file" << std::endl;
+        return false;
+    }
+    table->data = contents + tablebase_header_size;
+    std::string material = table->material;
+    tables[material] = std::move(table);
+    return true;
+}
+
+int Tablebase::loadDirectory(const std::string& directory) {
+    int count = 0;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (entry.path().extension() == ".ctb" && load(entry.path().string())) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool Tablebase::has(const std::string& material) const {
+    return tables.count(normalizeMaterial(material)) > 0;
+}
+
+bool Tablebase::probe(const Position& position, TablebaseResult& result) const {
+    if (position.canCastle(Piece::Color::White, true) || position.canCastle(Piece::Color::White, false)
+        || position.canCastle(Piece::Color::Black, true) || position.canCastle(Piece::Color::Black, false)) {
+        return false;
+    }
+    std::string sides[2];
+    int count = 0;
+    for (int file = 0; file < 8; file++) {
+        for (int rank = 0; rank < 8; rank++) {
+            const Piece& piece = position.pieceAt(file, rank);
+            if (piece.type == Piece::Type::None) {
+                continue;
+            }
+            if (piece.type == Piece::Type::Pawn || ++count > max_pieces) {
+                return false;
+            }
+            sides[piece.color == Piece::Color::White ? 0 : 1] += typeLetter(piece.type);
+        }
+    }
+    if (count == 2) {
+        result = TablebaseResult();
+        return true;
+    }
+    sides[0] = sortSide(sides[0]);
+    sides[1] = sortSide(sides[1]);
+    std::string material = normalizeMaterial(sides[0] + "v" + sides[1]);
+    auto table = tables.find(material);
+    if (table == tables.end()) {
+        return false;
+    }
+    // The first side of the material is white in the table, colors are swapped if black has it
+    bool swapped = sides[0] != material.substr(0, material.find('v'));
+    Layout layout = makeLayout(material);
+    Squares squares{};
+    std::uint64_t used = 0;
+    for (int i = 0; i < layout.count; i++) {
+        Piece::Color color = (layout.colors[i] == Piece::Color::White) != swapped ? Piece::Color::White
+                                                                                   : Piece::Color::Black;
+        for (int square = 0; square < 64; square++) {
+            const Piece& piece = position.pieceAt(squareFile(square), squareRank(square));
+            if (!(used >> square & 1) && piece.type == layout.types[i] && piece.color == color) {
+                squares[i] = square;
+                used |= std::uint64_t(1) << square;
+                break;
+            }
+        }
+    }
+    int side = ((position.activeColor() == Piece::Color::Black) != swapped) ? 1 : 0;
+    const Table& entries = *table->second;
+    std::uint64_t bit = (side * entries.entries + indexOf(layout, squares)) * entries.bits;
+    std::uint8_t code = static_cast<std::uint8_t>((readLittleEndian(entries.data + bit / 8, 2) >> (bit % 8))
+                                                  & ((1u << entries.bits) - 1));
+    if (code == invalid_code) {
+        return false;
+    }
+    result.plies = (code == draw_code) ? 0 : codePlies(code);
+    result.outcome = (code == draw_code) ? TablebaseOutcome::Draw
+                     : isWinCode(code) ? TablebaseOutcome::Win : TablebaseOutcome::Loss;
+    return true;
+}
+
+std::string Tablebase::normalizeMaterial(const std::string& material) {
+    std::string letters;
+    for (char c : material) {
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        if (c != 'V') {
+            letters += c;
+        }
+    }
+    std::size_t second_king = letters.find('K', 1);
+    if (letters.empty() || letters[0] != 'K' || second_king == std::string::npos
+        || letters.find('K', second_king + 1) != std::string::npos) {
+        return "";
+    }
+    std::string sides[2] = {sortSide(letters.substr(0, second_king)), sortSide(letters.substr(second_king))};
+    for (const std::string& side : sides) {
+        for (char c : side) {
+            if (letterType(c) == Piece::Type::None) {
+                return "";
+            }
+        }
+    }
+    // Bare kings are always a draw and need no table
+    if (letters.size() > max_pieces || letters.size() == 2) {
+        return "";
+    }
+    if (strongerSide(sides[1], sides[0])) {
+        std::swap(sides[0], sides[1]);
+    }
+    return sides[0] + "v" + sides[1];
+}
+
+std::vector<std::string> Tablebase::subMaterials(const std::string& material) {
+    std::vector<std::string> materials;
+    std::string normalized = normalizeMaterial(material);
+    for (std::size_t i = 0; i < normalized.size(); i++) {
+        if (normalized[i] == 'K' || normalized[i] == 'v') {
+            continue;
+        }
+        std::string sub = normalizeMaterial(normalized.substr(0, i) + normalized.substr(i + 1));
+        if (!sub.empty() && std::find(materials.begin(), materials.end(), sub) == materials.end()) {
+            materials.push_back(sub);
+        }
+    }
+    return materials;
+}
+
+TablebaseGenerator::TablebaseGenerator(Tablebase& tablebase, int threads) :
+    tablebase(tablebase),
+    threads(std::max(1, threads))
+{
+}
+
+bool TablebaseGenerator::generate(const std::string& material, const std::string& path, TablebaseStats& stats) {
+    stats = TablebaseStats();
+    stats.material = Tablebase::normalizeMaterial(material);
+    if (stats.material.empty()) {
+        std::cerr << "No table can be generated for " << material
+                  << " (pawnless materials of 3 to " << max_pieces << " pieces only)" << std::endl;
+        return false;
+    }
+    for (const std::string& sub : Tablebase::subMaterials(stats.material)) {
+        if (!tablebase.has(sub)) {
+            std::cerr << "The table of " << sub << " is needed to generate " << stats.material << std::endl;
+            return false;
+        }
+    }
+    auto start = std::chrono::steady_clock::now();
+    const Layout layout = makeLayout(stats.material);
+    const std::uint64_t entries = layout.entries;
+    // Codes with white (index 0) and black to move, and the capture codes
+    std::unique_ptr<std::atomic<std::uint8_t>[]> values[2];
+    std::unique_ptr<std::uint8_t[]> captures[2];
+    for (int side = 0; side < 2; side++) {
+        values[side].reset(new std::atomic<std::uint8_t>[entries]());
+        captures[side].reset(new std::uint8_t[entries]());
+    }
+    stats.working_memory = static_cast<std::size_t>(entries) * 2 * (sizeof(std::atomic<std::uint8_t>) + 1);
+
+    // Longest mate set so far and longest win through a capture still to be set
+    std::atomic<int> longest{0};
+    std::atomic<int> longest_capture_win{0};
+    std::atomic<bool> missing_table{false};
+
+    // Scoring of the captures, mates and stalemates
+    parallelFor(threads, entries, [&](std::uint64_t begin, std::uint64_t end) {
+        Position position;
+        MoveList moves;
+        for (std::uint64_t index = begin; index < end; index++) {
+            Squares squares = decodeIndex(layout, index);
+            bool valid = distinctSquares(layout, squares)
+                         && std::find(king_attacks[squares[0]].begin(), king_attacks[squares[0]].end(), squares[1])
+                            == king_attacks[squares[0]].end()
+                         && indexOf(layout, squares) == index;
+            for (int side = 0; side < 2; side++) {
+                Piece::Color color = (side == 0) ? Piece::Color::White : Piece::Color::Black;
+                Piece::Color other = (side == 0) ? Piece::Color::Black : Piece::Color::White;
+                if (!valid) {
+                    values[side][index].store(invalid_code, std::memory_order_relaxed);
+                    continue;
+                }
+                loadTablePosition(layout, squares, color, position);
+                if (position.inCheck(other)) {
+                    values[side][index].store(invalid_code, std::memory_order_relaxed);
+                    continue;
+                }
+                position.generateMoves(color, moves);
+                if (moves.empty()) {
+                    bool mated = position.inCheck(color);
+                    values[side][index].store(mated ? pliesCode(0) : draw_code, std::memory_order_relaxed);
+                    captures[side][index] = safe_capture_code;
+                    continue;
+                }
+                // Best win and longest loss through a capture, from the side to move's perspective
+                int capture_win = -1;
+                int capture_loss = -1;
+                bool safe_capture = false;
+                bool quiet_move = false;
+                for (const Move& move : moves) {
+                    if (!position.isCapture(move)) {
+                        quiet_move = true;
+                        continue;
+                    }
+                    Position::UndoInfo undo;
+                    position.makeMove(move, undo);
+                    TablebaseResult child;
+                    if (!tablebase.probe(position, child)) {
+                        missing_table.store(true);
+                    }
+                    position.undoMove(move, undo);
+                    if (child.outcome == TablebaseOutcome::Loss) {
+                        capture_win = (capture_win < 0) ? child.plies + 1 : std::min(capture_win, child.plies + 1);
+                    } else if (child.outcome == TablebaseOutcome::Win) {
+                        capture_loss = std::max(capture_loss, child.plies + 1);
+                    } else {
+                        safe_capture = true;
+                    }
+                }
+                std::uint8_t code = capture_win >= 0 ? pliesCode(capture_win)
+                                    : safe_capture ? safe_capture_code
+                                    : capture_loss >= 0 ? pliesCode(capture_loss) : 0;
+                captures[side][index] = code;
+                // Without a quiet move the captures decide the position
+                if (!quiet_move) {
+                    values[side][index].store(code == safe_capture_code ? draw_code : code, std::memory_order_relaxed);
+                    updateMaximum(longest, codePlies(code));
+                } else if (capture_win >= 0) {
+                    updateMaximum(longest_capture_win, capture_win);
+                }
+            }
+        }
+    });
+    if (missing_table.load()) {
+        std::cerr << "A capture in " << stats.material << " led to a position missing from the sub-tables" << std::endl;
+        return false;
+    }
+
+    // Retrograde iterations, losses in plies half-moves then wins in plies + 1
+    std::atomic<bool> changed{false};
+    for (int plies = 0; plies + 1 <= max_plies; plies += 2) {
+        changed.store(false);
+        parallelFor(threads, entries, [&](std::uint64_t begin, std::uint64_t end) {
+            for (std::uint64_t index = begin; index < end; index++) {
+                for (int side = 0; side < 2; side++) {
+                    std::uint8_t code = values[side][index].load(std::memory_order_relaxed);
+                    if (code == draw_code && captures[side][index] == pliesCode(plies + 1)) {
+                        // A win through a capture, unless a quiet move already won faster
+                        std::uint8_t expected = draw_code;
+                        if (values[side][index].compare_exchange_strong(expected, pliesCode(plies + 1))) {
+                            changed.store(true, std::memory_order_relaxed);
+                        }
+                        continue;
+                    }
+                    if (code != pliesCode(plies)) {
+                        continue;
+                    }
+                    // Every position leading here by a quiet move of the other side is won by it
+                    Squares squares = decodeIndex(layout, index);
+                    std::uint64_t occupied = occupancy(layout, squares);
+                    Piece::Color mover = (side == 0) ? Piece::Color::Black : Piece::Color::White;
+                    for (int piece = 0; piece < layout.count; piece++) {
+                        if (layout.colors[piece] != mover) {
+                            continue;
+                        }
+                        forEachQuietTarget(layout.types[piece], squares[piece], occupied, [&](int from) {
+                            Squares previous = squares;
+                            previous[piece] = from;
+                            std::uint8_t expected = draw_code;
+                            if (values[1 - side][indexOf(layout, previous)].compare_exchange_strong(expected, pliesCode(plies + 1))) {
+                                changed.store(true, std::memory_order_relaxed);
+                            }
+                        });
+                    }
+                }
+            }
+        });
+        updateMaximum(longest, plies + 1);
+
+        parallelFor(threads, entries, [&](std::uint64_t begin, std::uint64_t end) {
+            for (std::uint64_t index = begin; index < end; index++) {
+                for (int side = 0; side < 2; side++) {
+                    if (values[side][index].load(std::memory_order_relaxed) != pliesCode(plies + 1)) {
+                        continue;
+                    }
+                    // Positions leading here are lost once every one of their moves loses
+                    Squares squares = decodeIndex(layout, index);
+                    std::uint64_t occupied = occupancy(layout, squares);
+                    int previous_side = 1 - side;
+                    Piece::Color mover = (side == 0) ? Piece::Color::Black : Piece::Color::White;
+                    for (int piece = 0; piece < layout.count; piece++) {
+                        if (layout.colors[piece] != mover) {
+                            continue;
+                        }
+                        forEachQuietTarget(layout.types[piece], squares[piece], occupied, [&](int from) {
+                            Squares previous = squares;
+                            previous[piece] = from;
+                            std::uint64_t previous_index = indexOf(layout, previous);
+                            std::uint8_t capture = captures[previous_side][previous_index];
+                            if (values[previous_side][previous_index].load(std::memory_order_relaxed) != draw_code
+                                || capture == safe_capture_code || isWinCode(capture)) {
+                                return;
+                            }
+                            int loss = isLossCode(capture) ? codePlies(capture) : 0;
+                            bool lost = true;
+                            std::uint64_t previous_occupied = occupancy(layout, previous);
+                            for (int moved = 0; moved < layout.count && lost; moved++) {
+                                if (layout.colors[moved] != mover) {
+                                    continue;
+                                }
+                                forEachQuietTarget(layout.types[moved], previous[moved], previous_occupied, [&](int to) {
+                                    if (!lost) {
+                                        return;
+                                    }
+                                    Squares next = previous;
+                                    next[moved] = to;
+                                    std::uint8_t reply = values[side][indexOf(layout, next)].load(std::memory_order_relaxed);
+                                    // Illegal moves lead to invalid entries
+                                    if (reply == invalid_code) {
+                                        return;
+                                    }
+                                    if (!isWinCode(reply)) {
+                                        lost = false;
+                                        return;
+                                    }
+                                    loss = std::max(loss, codePlies(reply) + 1);
+                                });
+                            }
+                            std::uint8_t expected = draw_code;
+                            if (lost && values[previous_side][previous_index].compare_exchange_strong(expected, pliesCode(loss))) {
+                                changed.store(true, std::memory_order_relaxed);
+                                updateMaximum(longest, loss);
+                            }
+                        });
+                    }
+                }
+            }
+        });
+        stats.iterations++;
+        if (!changed.load() && plies + 2 >= std::max(longest.load(), longest_capture_win.load())) {
+            break;
+        }
+    }
+
+    // Bits per entry from the largest code
+    std::uint8_t largest = 0;
+    for (int side = 0; side < 2; side++) {
+        for (std::uint64_t index = 0; index < entries; index++) {
+            std::uint8_t code = values[side][index].load(std::memory_order_relaxed);
+            largest = std::max(largest, code);
+            if (code == invalid_code) {
+                continue;
+            }
+            stats.positions++;
+            if (code == draw_code) {
+                stats.draws++;
+            } else if (isWinCode(code)) {
+                stats.wins++;
+            } else {
+                stats.losses++;
+            }
+            if (code >= 2) {
+                stats.longest_mate = std::max(stats.longest_mate, codePlies(code));
+            }
+        }
+    }
+    if (largest > pliesCode(max_plies)) {
+        std::cerr << "Mates in " << stats.material << " are too long for the table format" << std::endl;
+        return false;
+    }
+    unsigned int bits = 1;
+    while ((1u << bits) <= largest) {
+        bits++;
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    std::uint8_t header[tablebase_header_size] = {};
+    std::copy(tablebase_magic.begin(), tablebase_magic.end(), header);
+    writeLittleEndian(header + 8, tablebase_version, 2);
+    header[10] = static_cast<std::uint8_t>(bits);
+    header[11] = static_cast<std::uint8_t>(layout.count);
+    std::memcpy(header + 16, stats.material.data(), std::min<std::size_t>(stats.material.size(), 16));
+    writeLittleEndian(header + 32, entries, 8);
+    file.write(reinterpret_cast<const char*>(header), tablebase_header_size);
+    // Entries are appended to a bit buffer, whose full bytes are written in blocks
+    std::vector<char> bytes;
+    std::uint64_t buffer = 0;
+    unsigned int buffered = 0;
+    for (int side = 0; side < 2; side++) {
+        for (std::uint64_t index = 0; index < entries; index++) {
+            buffer |= static_cast<std::uint64_t>(values[side][index].load(std::memory_order_relaxed)) << buffered;
+            buffered += bits;
+            while (buffered >= 8) {
+                bytes.push_back(static_cast<char>(buffer));
+                buffer >>= 8;
+                buffered -= 8;
+            }
+            if (bytes.size() >= (1 << 20)) {
+                file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+                bytes.clear();
+            }
+        }
+    }
+    // The last partial byte and the padding byte
+    bytes.push_back(static_cast<char>(buffer));
+    if (buffered > 0) {
+        bytes.push_back(0);
+    }
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    file.close();
+    if (!file) {
+        std::cerr << "Could not write " << path << std::endl;
+        return false;
+    }
+    stats.file_size = tablebase_header_size + packedSize(entries, bits);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.peak_memory = peakMemory();
+    return tablebase.load(path);
+}
@@ -0,0 +1,231 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef CHESS_TRACE
+
+namespace {
+    using trace::detail::Counters;
+    using trace::detail::Event;
+    using trace::detail::ThreadBuffer;
+    using trace::detail::counter_count;
+    using trace::detail::ring_size;
+
+    const char* const counter_names[] = {"generateMoves", "isValidLegalMove", "inCheck", "findPieceSprite", "draw"};
+    static_assert(sizeof(counter_names) / sizeof(counter_names[0]) == counter_count, "a counter has no name");
+
+    // Buffers of all threads, never freed so that a dump can read them while threads record
+    std::mutex registry_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::uint32_t thread_count = 0;
+
+    // Gives the buffer of a thread back when the thread exits, with the thread's counts
+    struct ThreadExit {
+        ~ThreadExit() {
+            ThreadBuffer* buffer = trace::detail::current;
+            if (buffer == nullptr) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            for (std::size_t i = 0; i < counter_count; i++) {
+                std::uint64_t value = trace::detail::counters[i].load(std::memory_order_relaxed);
+                buffer->counters[i].store(buffer->counters[i].load(std::memory_order_relaxed) + value,
+                                          std::memory_order_relaxed);
+            }
+            buffer->thread_counters = nullptr;
+            buffer->in_use.store(false, std::memory_order_release);
+            trace::detail::current = nullptr;
+        }
+    };
+    thread_local ThreadExit thread_exit;
+
+    // Function used to get a count of a buffer, with the count of the thread using it
+    std::uint64_t counterValue(const ThreadBuffer& buffer, std::size_t counter) {
+        std::uint64_t value = buffer.counters[counter].load(std::memory_order_relaxed);
+        if (buffer.thread_counters != nullptr) {
+            value += (*buffer.thread_counters)[counter].load(std::memory_order_relaxed);
+        }
+        return value;
+    }
+
+    // Function used to copy the events kept in a buffer, oldest first
+    std::vector<Event> keptEvents(const ThreadBuffer& buffer) {
+        std::uint64_t count = buffer.event_count.load(std::memory_order_acquire);
+        std::uint64_t first = (count > ring_size) ? count - ring_size : 0;
+        std::vector<Event> events;
+        events.reserve(static_cast<std::size_t>(count - first));
+        for (std::uint64_t i = first; i < count; i++) {
+            events.push_back(buffer.events[i % ring_size]);
+        }
+        return events;
+    }
+}
+
+trace::detail::ThreadBuffer& trace::detail::attach() {
+    // Constructs the thread's ThreadExit so that its destructor runs when the thread exits
+    static_cast<void>(&thread_exit);
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    ThreadBuffer* buffer = nullptr;
+    for (const auto& candidate : buffers) {
+        if (!candidate->in_use.load(std::memory_order_acquire)) {
+            buffer = candidate.get();
+            break;
+        }
+    }
+    if (buffer == nullptr) {
+        buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = buffers.back().get();
+    }
+    buffer->in_use.store(true, std::memory_order_relaxed);
+    buffer->thread = ++thread_count;
+    buffer->thread_counters = &counters;
+    current = buffer;
+    return *buffer;
+}
+
+bool trace::enabled() {
+    return true;
+}
+
+bool trace::writeChromeTrace(const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Could not create " << path << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::vector<std::vector<Event>> thread_events;
+    std::uint64_t origin = ~0ULL;
+    std::uint64_t end = 0;
+    for (const auto& buffer : buffers) {
+        thread_events.push_back(keptEvents(*buffer));
+        for (const Event& event : thread_events.back()) {
+            origin = std::min(origin, event.start_ns);
+            end = std::max(end, event.start_ns + event.duration_ns);
+        }
+    }
+    if (origin > end) {
+        origin = end;
+    }
+    // Timestamps are in microseconds, with the nanoseconds as decimals
+    auto microseconds = [](std::uint64_t nanoseconds) {
+        return std::to_string(nanoseconds / 1000) + '.' + std::to_string(1000 + nanoseconds % 1000).substr(1);
+    };
+    file << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+    bool first = true;
+    for (const std::vector<Event>& events : thread_events) {
+        for (const Event& event : events) {
+            file << (first ? "" : ",\n") << "{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                 << event.thread << ", \"ts\": " << microseconds(event.start_ns - origin)
+                 << ", \"dur\": " << microseconds(event.duration_ns) << "}";
+            first = false;
+        }
+    }
+    // The counters of every buffer as they are at the end of the trace
+    for (const auto& buffer : buffers) {
+        file << (first ? "" : ",\n") << "{\"name\": \"thread " << buffer->thread
+             << " counters\", \"ph\": \"C\", \"pid\": 1, \"tid\": " << buffer->thread
+             << ", \"ts\": " << microseconds(end - origin) << ", \"args\": {";
+        for (std::size_t i = 0; i < counter_count; i++) {
+            file << (i ? ", " : "") << '"' << counter_names[i] << "\": "
+                 << counterValue(*buffer, i);
+        }
+        file << "}}";
+        first = false;
+    }
+    file << "\n]}\n";
+    if (!file) {
+        std::cerr << "Could not write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void trace::printSummary(std::ostream& output) {
+    struct ScopeStats {
+        std::uint64_t count = 0;
+        std::uint64_t total_ns = 0;
+        std::uint64_t max_ns = 0;
+    };
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::ios_base::fmtflags flags = output.flags();
+    output << std::left << std::setw(20) << "Counters" << std::right;
+    for (const char* name : counter_names) {
+        output << std::setw(18) << name;
+    }
+    output << '\n';
+    std::array<std::uint64_t, counter_count> totals{};
+    std::map<std::string, ScopeStats> scopes;
+    for (const auto& buffer : buffers) {
+        // A buffer taken over from an exited thread also holds that thread's counts
+        output << std::left << std::setw(20) << ("thread " + std::to_string(buffer->thread)) << std::right;
+        for (std::size_t i = 0; i < counter_count; i++) {
+            std::uint64_t value = counterValue(*buffer, i);
+            totals[i] += value;
+            output << std::setw(18) << value;
+        }
+        output << '\n';
+        for (const Event& event : keptEvents(*buffer)) {
+            ScopeStats& stats = scopes[event.name];
+            stats.count++;
+            stats.total_ns += event.duration_ns;
+            stats.max_ns = std::max(stats.max_ns, event.duration_ns);
+        }
+    }
+    output << std::left << std::setw(20) << "total" << std::right;
+    for (std::uint64_t total : totals) {
+        output << std::setw(18) << total;
+    }
+    output << "\n\n" << std::left << std::setw(28) << "Scope" << std::right << std::setw(10) << "count"
+           << std::setw(14) << "total ms" << std::setw(14) << "mean us" << std::setw(14) << "max us" << '\n';
+    output << std::fixed << std::setprecision(3);
+    for (const auto& [name, stats] : scopes) {
+        output << std::left << std::setw(28) << name << std::right << std::setw(10) << stats.count
+               << std::setw(14) << stats.total_ns / 1e6
+               << std::setw(14) << stats.total_ns / 1e3 / static_cast<double>(stats.count)
+               << std::setw(14) << stats.max_ns / 1e3 << '\n';
+    }
+    output.flags(flags);
+}
+
+void trace::reset() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const auto& buffer : buffers) {
+        for (auto& counter : buffer->counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        if (buffer->thread_counters != nullptr) {
+            for (auto& counter : *buffer->thread_counters) {
+                counter.store(0, std::memory_order_relaxed);
+            }
+        }
+        buffer->event_count.store(0, std::memory_order_release);
+    }
+}
+
+#else
+
+bool trace::enabled() {
+    return false;
+}
+
+bool trace::writeChromeTrace(const std::string& path) {
+    std::cerr << "Built without CHESS_TRACE, nothing was recorded for " << path << std::endl;
+    return false;
+}
+
+void trace::printSummary(std::ostream& output) {
+    output << "Built without CHESS_TRACE, nothing was recorded\n";
+}
+
+void trace::reset() {
+}
+
+#endif
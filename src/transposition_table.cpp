@@ -0,0 +1,97 @@
+#include "transposition_table.hpp"
+#include "move.hpp"
+#include <algorithm>
+
+// Layout of the 64 bit data word:
+//      bits  0-15 : packed move
+//      bits 16-31 : score
+//      bits 32-39 : depth
+//      bits 40-41 : bound
+
+TranspositionTable::TranspositionTable(std::size_t megabytes) {
+    resize(megabytes);
+}
+
+void TranspositionTable::resize(std::size_t megabytes) {
+    std::size_t count = std::max<std::size_t>(1, megabytes) * 1024 * 1024 / sizeof(Slot);
+    // Round down to a power of two so that the index is a mask of the key
+    std::size_t power = 1;
+    while (power * 2 <= count) {
+        power *= 2;
+    }
+    slots.reset(new Slot[power]);
+    slot_count = power;
+}
+
+void TranspositionTable::clear() {
+    for (std::size_t i = 0; i < slot_count; i++) {
+        slots[i].key.store(0, std::memory_order_relaxed);
+        slots[i].data.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool TranspositionTable::probe(std::uint64_t key, TTEntry& entry) const {
+    const Slot& slot = slots[key & (slot_count - 1)];
+    std::uint64_t data = slot.data.load(std::memory_order_relaxed);
+    if ((slot.key.load(std::memory_order_relaxed) ^ data) != key || data == 0) {
+        return false;
+    }
+    entry.move = unpackMove(static_cast<std::uint16_t>(data));
+    entry.score = static_cast<std::int16_t>(data >> 16);
+    entry.depth = static_cast<std::uint8_t>(data >> 32);
+    entry.bound = static_cast<Bound>((data >> 40) & 3);
+    return true;
+}
+
+void TranspositionTable::store(std::uint64_t key, int depth, int score, Bound bound, const Move& move) {
+    Slot& slot = slots[key & (slot_count - 1)];
+    std::uint64_t old_data = slot.data.load(std::memory_order_relaxed);
+    bool same_key = (slot.key.load(std::memory_order_relaxed) ^ old_data) == key;
+    // Keep deeper results for the same position unless the new one is exact
+    if (same_key && bound != Bound::Exact
+        && depth < static_cast<int>(static_cast<std::uint8_t>(old_data >> 32))) {
+        return;
+    }
+    std::uint16_t packed = packMove(move);
+    // Keep the old best move if the new result has none
+    if (same_key && packed == 0) {
+        packed = static_cast<std::uint16_t>(old_data);
+    }
+    std::uint64_t data = packed
+                         | static_cast<std::uint64_t>(static_cast<std::uint16_t>(score)) << 16
+                         | static_cast<std::uint64_t>(std::clamp(depth, 0, 255)) << 32
+                         | static_cast<std::uint64_t>(bound) << 40;
+    slot.key.store(key ^ data, std::memory_order_relaxed);
+    slot.data.store(data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const {
+    std::size_t sample = std::min<std::size_t>(1000, slot_count);
+    int used = 0;
+    for (std::size_t i = 0; i < sample; i++) {
+        if (slots[i].data.load(std::memory_order_relaxed) != 0) {
+            used++;
+        }
+    }
+    return static_cast<int>(used * 1000 / sample);
+}
+
+std::uint16_t TranspositionTable::packMove(const Move& move) {
+    if (!move.isValid()) {
+        return 0;
+    }
+    return static_cast<std::uint16_t>(move.start_file
+                                      | move.start_rank << 3
+                                      | move.target_file << 6
+                                      | move.target_rank << 9
+                                      | move.promotion << 12);
+}
+
+Move TranspositionTable::unpackMove(std::uint16_t packed) {
+    // a8a8 is never a legal move so 0 is used for the null move
+    if (packed == 0) {
+        return Move();
+    }
+    return Move(packed & 7, (packed >> 3) & 7, (packed >> 6) & 7, (packed >> 9) & 7,
+                static_cast<Piece::Type>((packed >> 12) & 7));
+}
@@ -0,0 +1,259 @@
+#include "analysis_cache.hpp"
+#include "epd.hpp"
+#include "position.hpp"
+#include "search.hpp"
+#include "transposition_table.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Batch analysis of FEN/EPD positions. Every line is searched to a fixed depth,
+// node or time budget on a pool of worker threads which share a transposition
+// table. Results are written to stdout as JSON lines in input order. With --cache the
+// deep results are kept in an analysis cache file, so analyzing the same positions
+// again reaches the earlier depth without searching it again.
+//
+// Usage: chess_analyze [--depth N] [--nodes N] [--movetime MS] [--threads N] [--hash MB]
+//                      [--cache FILE] [--cache-size MB] [FILE]
+
+namespace {
+    struct Options {
+        SearchLimits limits;
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+        std::size_t hash = 64;
+        // Analysis cache file, empty for none
+        std::string cache;
+        std::size_t cache_size = 64;
+        std::string input = "-";
+    };
+
+    struct Job {
+        std::size_t index;
+        std::string line;
+    };
+
+    // Queue of lines to analyze and results waiting to be written in order
+    class Pipeline {
+        public:
+            explicit Pipeline(std::size_t window) : window(window) {}
+
+            // Method used by the reader to add a line, blocks while too many results are pending
+            void push(const std::string& line) {
+                std::unique_lock<std::mutex> lock(mutex);
+                space_available.wait(lock, [this] { return jobs_read - next_output < window; });
+                jobs.push_back(Job{jobs_read++, line});
+                job_available.notify_one();
+            }
+
+            // Method used by the reader to signal that there are no more lines
+            void close() {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+                job_available.notify_all();
+            }
+
+            // Method used by the workers to take the next line, returns false once closed and empty
+            bool pop(Job& job) {
+                std::unique_lock<std::mutex> lock(mutex);
+                job_available.wait(lock, [this] { return closed || !jobs.empty(); });
+                if (jobs.empty()) {
+                    return false;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+                return true;
+            }
+
+            // Method used by the workers to hand in a result, writing every result that is next in order
+            void finish(std::size_t index, std::string result) {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending[index] = std::move(result);
+                while (!pending.empty() && pending.begin()->first == next_output) {
+                    std::cout << pending.begin()->second << '\n';
+                    pending.erase(pending.begin());
+                    next_output++;
+                }
+                space_available.notify_one();
+            }
+
+        private:
+            std::mutex mutex;
+            std::condition_variable job_available;
+            std::condition_variable space_available;
+            std::deque<Job> jobs;
+            std::map<std::size_t, std::string> pending;
+            std::size_t window;
+            std::size_t jobs_read = 0;
+            std::size_t next_output = 0;
+            bool closed = false;
+    };
+
+    std::string jsonEscape(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            if (static_cast<unsigned char>(c) >= 0x20) {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    std::string formatResult(const EpdRecord& record, const SearchInfo& info) {
+        std::ostringstream json;
+        json << "{\"fen\":\"" << jsonEscape(record.fen) << '"';
+        auto id = record.operations.find("id");
+        if (id != record.operations.end()) {
+            json << ",\"id\":\"" << jsonEscape(id->second) << '"';
+        }
+        json << ",\"bestmove\":\"" << info.bestMove().toString() << '"';
+        if (isMateScore(info.score)) {
+            json << ",\"score\":{\"mate\":" << mateInMoves(info.score) << '}';
+        } else {
+            json << ",\"score\":{\"cp\":" << info.score << '}';
+        }
+        json << ",\"depth\":" << info.depth
+             << ",\"nodes\":" << info.nodes
+             << ",\"time_ms\":" << info.time_ms
+             << ",\"pv\":[";
+        for (std::size_t i = 0; i < info.pv.size(); i++) {
+            json << (i > 0 ? "," : "") << '"' << info.pv[i].toString() << '"';
+        }
+        json << "]}";
+        return json.str();
+    }
+
+    std::string formatError(const std::string& line, const std::string& error) {
+        return "{\"input\":\"" + jsonEscape(line) + "\",\"error\":\"" + error + "\"}";
+    }
+
+    void printUsage() {
+        std::cerr << "Usage: chess_analyze [--depth N] [--nodes N] [--movetime MS] "
+                     "[--threads N] [--hash MB] [--cache FILE] [--cache-size MB] [FILE]\n"
+                     "Reads FEN or EPD lines from FILE (or stdin) and writes one JSON result per line.\n";
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            try {
+                if (arg == "--depth" && has_value) options.limits.depth = std::stoi(argv[++i]);
+                else if (arg == "--nodes" && has_value) options.limits.nodes = std::stoull(argv[++i]);
+                else if (arg == "--movetime" && has_value) options.limits.movetime = std::stoi(argv[++i]);
+                else if (arg == "--threads" && has_value) options.threads = std::max(1, std::stoi(argv[++i]));
+                else if (arg == "--hash" && has_value) options.hash = std::stoul(argv[++i]);
+                else if (arg == "--cache" && has_value) options.cache = argv[++i];
+                else if (arg == "--cache-size" && has_value) options.cache_size = std::stoul(argv[++i]);
+                else if (arg.size() > 1 && arg[0] == '-') return false;
+                else options.input = arg;
+            } catch (std::exception& e) {
+                return false;
+            }
+        }
+        // Default to a fixed depth so that results do not depend on machine load
+        if (options.limits.depth == 0 && options.limits.nodes == 0 && options.limits.movetime == 0) {
+            options.limits.depth = 6;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    std::ifstream file;
+    if (options.input != "-") {
+        file.open(options.input);
+        if (!file) {
+            std::cerr << "Could not open " << options.input << std::endl;
+            return 1;
+        }
+    }
+    std::istream& input = (options.input == "-") ? std::cin : file;
+    std::ios::sync_with_stdio(false);
+
+    TranspositionTable tt(options.hash);
+    AnalysisCache cache;
+    if (!options.cache.empty() && !cache.open(options.cache, options.cache_size)) {
+        return 1;
+    }
+    Pipeline pipeline(static_cast<std::size_t>(options.threads) * 16);
+    std::atomic<std::uint64_t> total_nodes{0};
+    std::atomic<std::size_t> positions{0};
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.threads; i++) {
+        workers.emplace_back([&] {
+            // Every worker owns its search state and only shares the transposition table
+            std::atomic<bool> stop_flag{false};
+            Search search(tt, stop_flag);
+            search.setAnalysisCache(cache.isOpen() ? &cache : nullptr);
+            Position position;
+            EpdRecord record;
+            Job job;
+            while (pipeline.pop(job)) {
+                parseEpdLine(job.line, record);
+                if (!position.loadPositionFromFEN(record.fen)) {
+                    pipeline.finish(job.index, formatError(job.line, "invalid FEN"));
+                    continue;
+                }
+                if (position.inCheck(position.activeColor() == Piece::Color::White ? Piece::Color::Black
+                                                                                    : Piece::Color::White)) {
+                    pipeline.finish(job.index, formatError(job.line, "side not to move is in check"));
+                    continue;
+                }
+                stop_flag.store(false);
+                const SearchInfo& info = search.run(position, options.limits);
+                total_nodes += info.nodes;
+                positions++;
+                pipeline.finish(job.index, formatResult(record, info));
+            }
+        });
+    }
+
+    std::string line;
+    EpdRecord record;
+    while (std::getline(input, line)) {
+        if (parseEpdLine(line, record)) {
+            pipeline.push(line);
+        }
+    }
+    pipeline.close();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    std::cout.flush();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    elapsed = std::max<std::int64_t>(elapsed, 1);
+    // Deep analyses take longer than a second per position, so the rate keeps its fraction
+    double seconds = elapsed / 1000.0;
+    std::cerr << "Analyzed " << positions << " positions, " << total_nodes << " nodes in "
+              << elapsed << " ms (" << std::fixed << std::setprecision(2) << positions / seconds << " positions/s, "
+              << static_cast<std::uint64_t>(total_nodes / seconds) << " nps) on " << options.threads << " threads"
+              << std::endl;
+    if (cache.isOpen()) {
+        std::cerr << "Analysis cache holds " << cache.size() << " of " << cache.capacity() << " entries" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,336 @@
+#include "position.hpp"
+#include "move.hpp"
+#include "legal_move_cache.hpp"
+#include "move_counter.hpp"
+#include "packed_position.hpp"
+#ifdef CHESS_BENCH_GUI
+#include "chess_board.hpp"
+#include <SFML/Graphics.hpp>
+#endif
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Microbenchmarks for the hot paths of the rules and the GUI. Every benchmark
+// is timed over several samples and the median time per operation is reported,
+// optionally exported as JSON to compare runs across commits.
+//
+// Usage: chess_bench [--filter TEXT] [--min-time MS] [--samples N] [--json FILE]
+
+namespace {
+    struct Options {
+        std::string filter;
+        std::string json;
+        // Minimum duration of one sample in milliseconds
+        int min_time = 100;
+        int samples = 5;
+    };
+
+    struct BenchmarkResult {
+        std::string name;
+        std::uint64_t iterations;
+        double median_ns;
+        double min_ns;
+        double max_ns;
+    };
+
+    // Results are accumulated here so the compiler cannot drop the benchmarked work
+    volatile std::uint64_t sink = 0;
+
+    // Positions by game phase
+    const std::vector<std::string> opening_positions = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "rnbqkbnr/pppp1ppp/8/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R b KQkq - 1 2",
+        "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+        "rnbqkb1r/pp2pppp/3p1n2/8/3NP3/8/PPP2PPP/RNBQKB1R w KQkq - 1 5"
+    };
+    const std::vector<std::string> middlegame_positions = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 3 8",
+        "2rq1rk1/pb1nbppp/1p2pn2/2pp4/2PP4/1PN1PN2/PB2BPPP/2RQ1RK1 w - - 0 11"
+    };
+    const std::vector<std::string> endgame_positions = {
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1",
+        "6k1/5pp1/7p/8/8/2R4P/5PP1/6K1 w - - 0 1",
+        "8/5pk1/6p1/3B4/8/6P1/5PK1/8 w - - 0 1"
+    };
+
+    // Function used to time body (which performs `operations` operations per call)
+    BenchmarkResult runBenchmark(const std::string& name, int operations, const std::function<void()>& body,
+                                 const Options& options) {
+        using Clock = std::chrono::steady_clock;
+        // Calibrate the number of calls so that a sample takes at least min_time
+        std::uint64_t calls = 1;
+        while (true) {
+            Clock::time_point start = Clock::now();
+            for (std::uint64_t i = 0; i < calls; i++) {
+                body();
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+            if (elapsed >= options.min_time || calls >= (1ULL << 40)) {
+                break;
+            }
+            calls *= (elapsed < options.min_time / 10) ? 10 : 2;
+        }
+        std::vector<double> samples;
+        for (int sample = 0; sample < options.samples; sample++) {
+            Clock::time_point start = Clock::now();
+            for (std::uint64_t i = 0; i < calls; i++) {
+                body();
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            samples.push_back(static_cast<double>(elapsed) / (calls * operations));
+        }
+        std::sort(samples.begin(), samples.end());
+        return BenchmarkResult{name, calls * operations * options.samples,
+                               samples[samples.size() / 2], samples.front(), samples.back()};
+    }
+
+    std::vector<Position> loadPositions(const std::vector<std::string>& fens) {
+        std::vector<Position> positions(fens.size());
+        for (std::size_t i = 0; i < fens.size(); i++) {
+            positions[i].loadPositionFromFEN(fens[i]);
+        }
+        return positions;
+    }
+
+    void writeJson(const std::string& path, const std::vector<BenchmarkResult>& results, const Options& options) {
+        std::ofstream json(path);
+        char date[32];
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+        json << "{\n  \"date\": \"" << date << "\",\n"
+             << "  \"samples\": " << options.samples << ",\n"
+             << "  \"benchmarks\": [\n";
+        for (std::size_t i = 0; i < results.size(); i++) {
+            const BenchmarkResult& result = results[i];
+            json << "    {\"name\": \"" << result.name << "\", \"iterations\": " << result.iterations
+                 << ", \"ns_per_op\": " << result.median_ns
+                 << ", \"min_ns\": " << result.min_ns
+                 << ", \"max_ns\": " << result.max_ns << "}"
+                 << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        json << "  ]\n}\n";
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                return false;
+            }
+            try {
+                if (arg == "--filter") options.filter = argv[++i];
+                else if (arg == "--json") options.json = argv[++i];
+                else if (arg == "--min-time") options.min_time = std::max(1, std::stoi(argv[++i]));
+                else if (arg == "--samples") options.samples = std::max(1, std::stoi(argv[++i]));
+                else return false;
+            } catch (std::exception& e) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: chess_bench [--filter TEXT] [--min-time MS] [--samples N] [--json FILE]\n";
+        return 1;
+    }
+
+    std::vector<BenchmarkResult> results;
+    auto benchmark = [&](const std::string& name, int operations, const std::function<void()>& body) {
+        if (name.find(options.filter) == std::string::npos) {
+            return;
+        }
+        results.push_back(runBenchmark(name, operations, body, options));
+        const BenchmarkResult& result = results.back();
+        std::cout << std::left << std::setw(36) << result.name << std::right
+                  << std::fixed << std::setprecision(1) << std::setw(12) << result.median_ns << " ns/op"
+                  << "   (min " << result.min_ns << ", max " << result.max_ns << ")" << std::endl;
+    };
+
+    const std::vector<std::pair<std::string, const std::vector<std::string>*>> phases = {
+        {"opening", &opening_positions},
+        {"middlegame", &middlegame_positions},
+        {"endgame", &endgame_positions}
+    };
+
+    // Move generation
+    for (const auto& phase : phases) {
+        std::vector<Position> positions = loadPositions(*phase.second);
+        MoveList moves;
+        benchmark("generateMoves/" + phase.first, static_cast<int>(positions.size()), [&] {
+            for (Position& position : positions) {
+                position.generateMoves(position.activeColor(), moves);
+                sink = sink + moves.size();
+            }
+        });
+    }
+
+    // Batched legal move counting of the same positions, without and with SIMD
+    for (const auto& phase : phases) {
+        PositionBatch batch;
+        for (const Position& position : loadPositions(*phase.second)) {
+            batch.add(position);
+        }
+        MoveCounts counts;
+        for (bool use_simd : {false, true}) {
+            if (use_simd && !simdMoveCountingAvailable()) {
+                continue;
+            }
+            benchmark(std::string(use_simd ? "countMoves/simd/" : "countMoves/scalar/") + phase.first,
+                      static_cast<int>(batch.size()), [&] {
+                countMoves(batch, counts, use_simd);
+                sink = sink + counts.legal_moves[0];
+            });
+        }
+    }
+
+    // Check detection
+    for (const auto& phase : phases) {
+        std::vector<Position> positions = loadPositions(*phase.second);
+        benchmark("inCheck/" + phase.first, static_cast<int>(positions.size()) * 2, [&] {
+            for (const Position& position : positions) {
+                sink = sink + position.inCheck(Piece::Color::White) + position.inCheck(Piece::Color::Black);
+            }
+        });
+    }
+
+    // Legality check of every legal move, the inner loop of move generation
+    {
+        std::vector<Position> positions = loadPositions(middlegame_positions);
+        std::vector<MoveList> moves(positions.size());
+        int operations = 0;
+        for (std::size_t i = 0; i < positions.size(); i++) {
+            positions[i].generateMoves(positions[i].activeColor(), moves[i]);
+            operations += static_cast<int>(moves[i].size());
+        }
+        benchmark("isValidLegalMove/middlegame", operations, [&] {
+            for (std::size_t i = 0; i < positions.size(); i++) {
+                for (const Move& move : moves[i]) {
+                    sink = sink + positions[i].isValidLegalMove(move.start_file, move.start_rank,
+                                                                move.target_file, move.target_rank);
+                }
+            }
+        });
+    }
+
+    // Legal moves after every move of a game, regenerated from scratch and maintained incrementally
+    {
+        Position game;
+        game.loadPositionFromFEN(middlegame_positions[0]);
+        std::vector<Move> line;
+        MoveList moves;
+        // Deterministic game, always playing the middle legal move
+        for (int ply = 0; ply < 40; ply++) {
+            game.generateMoves(game.activeColor(), moves);
+            if (moves.size() == 0) {
+                break;
+            }
+            line.push_back(moves[moves.size() / 2]);
+            Position::UndoInfo undo;
+            game.makeMove(line.back(), undo);
+        }
+        const int plies = std::max(1, static_cast<int>(line.size()));
+        auto replay = [&](const std::function<std::size_t(Position&)>& legal_moves) {
+            Position position;
+            position.loadPositionFromFEN(middlegame_positions[0]);
+            sink = sink + legal_moves(position);
+            for (const Move& move : line) {
+                Position::UndoInfo undo;
+                position.makeMove(move, undo);
+                sink = sink + legal_moves(position);
+            }
+        };
+        benchmark("legalMoves/full", plies, [&] {
+            replay([&](Position& position) {
+                position.generateMoves(position.activeColor(), moves);
+                return moves.size();
+            });
+        });
+        LegalMoveCache cache;
+        benchmark("legalMoves/incremental", plies, [&] {
+            cache.clear();
+            replay([&](Position& position) {
+                cache.update(position);
+                return cache.moves().size();
+            });
+        });
+    }
+
+    // FEN parsing
+    {
+        std::vector<std::string> fens = opening_positions;
+        fens.insert(fens.end(), middlegame_positions.begin(), middlegame_positions.end());
+        fens.insert(fens.end(), endgame_positions.begin(), endgame_positions.end());
+        Position position;
+        benchmark("loadPositionFromFEN", static_cast<int>(fens.size()), [&] {
+            for (const std::string& fen : fens) {
+                position.loadPositionFromFEN(fen);
+                sink = sink + position.hash();
+            }
+        });
+
+        std::vector<PackedPosition> packed(fens.size());
+        for (std::size_t i = 0; i < fens.size(); i++) {
+            position.loadPositionFromFEN(fens[i]);
+            position.pack(packed[i]);
+        }
+        benchmark("loadPackedPosition", static_cast<int>(packed.size()), [&] {
+            for (const PackedPosition& record : packed) {
+                position.loadPackedPosition(record);
+                sink = sink + position.hash();
+            }
+        });
+    }
+
+#ifdef CHESS_BENCH_GUI
+    // GUI, ChessBoard loads its resources relative to the working directory like the chess executable
+    {
+        ChessBoard board(800);
+        std::vector<std::array<int, 2>> occupied;
+        for (int file = 0; file < 8; file++) {
+            for (int rank = 0; rank < 8; rank++) {
+                if (board.pieceAt(file, rank).type != Piece::Type::None) {
+                    occupied.push_back({{file, rank}});
+                }
+            }
+        }
+        benchmark("findPieceSprite", static_cast<int>(occupied.size()), [&] {
+            for (const auto& square : occupied) {
+                sink = sink + board.findPieceSprite(square[0], square[1]).y;
+            }
+        });
+
+        sf::RenderTexture texture;
+        if (texture.create(800, 800)) {
+            benchmark("ChessBoard::draw", 1, [&] {
+                texture.clear();
+                texture.draw(board);
+                texture.display();
+            });
+        } else {
+            std::cerr << "Could not create a render texture, skipping draw benchmark" << std::endl;
+        }
+    }
+#endif
+
+    if (!options.json.empty()) {
+        writeJson(options.json, results, options);
+    }
+    return 0;
+}
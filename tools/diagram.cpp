@@ -0,0 +1,233 @@
+#include "board_diagram.hpp"
+#include "epd.hpp"
+#include "position.hpp"
+#include "move.hpp"
+#ifdef CHESS_DIAGRAM_PNG
+#include "diagram_renderer.hpp"
+#include <SFML/Graphics.hpp>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Bulk export of board diagrams. Every FEN/EPD line is written to its own file, named
+// after the "id" operation or the line number, with the move of the "lm" operation
+// (UCI notation) highlighted as the last move. SVG diagrams are written by a pool of
+// threads and need no graphics context. PNG diagrams (only built with SFML) are rendered
+// offscreen through one reused render texture and encoded on a pool of threads.
+//
+// Usage: chess_diagram [--format svg|png] [--size N] [--flip] [--no-check] [--atlas PATH]
+//                      [--embed-atlas] [--threads N] [--output DIR] [FILE]
+
+namespace {
+    struct Options {
+        DiagramOptions diagram;
+        std::string format = "svg";
+        std::string atlas = "../res/pieces/maestro/maestro_pieces.png";
+        bool embed_atlas = false;
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+        std::string output = ".";
+        std::string input = "-";
+    };
+
+    struct Diagram {
+        Position position;
+        Move last_move;
+        std::string path;
+    };
+
+    // Lines are read and exported in batches so that the input can be streamed
+    const std::size_t batch_size = 4096;
+
+    void printUsage() {
+        std::cerr << "Usage: chess_diagram [--format svg|png] [--size N] [--flip] [--no-check] [--atlas PATH]\n"
+                     "                     [--embed-atlas] [--threads N] [--output DIR] [FILE]\n"
+                     "Writes a diagram of every FEN/EPD line of FILE (or stdin) to DIR.\n";
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            try {
+                if (arg == "--format" && has_value) options.format = argv[++i];
+                else if (arg == "--size" && has_value) options.diagram.size = std::clamp(std::stoi(argv[++i]), 8, 4096);
+                else if (arg == "--flip") options.diagram.flipped = true;
+                else if (arg == "--no-check") options.diagram.show_check = false;
+                else if (arg == "--atlas" && has_value) options.atlas = argv[++i];
+                else if (arg == "--embed-atlas") options.embed_atlas = true;
+                else if (arg == "--threads" && has_value) options.threads = std::max(1, std::stoi(argv[++i]));
+                else if (arg == "--output" && has_value) options.output = argv[++i];
+                else if (arg.size() > 1 && arg[0] == '-') return false;
+                else options.input = arg;
+            } catch (std::exception& e) {
+                return false;
+            }
+        }
+#ifdef CHESS_DIAGRAM_PNG
+        return options.format == "svg" || options.format == "png";
+#else
+        if (options.format == "png") {
+            std::cerr << "PNG export needs SFML, this build only writes SVG" << std::endl;
+        }
+        return options.format == "svg";
+#endif
+    }
+
+    // Function used to parse a move in UCI notation without checking that it is legal
+    Move parseSquares(const std::string& uci) {
+        if (uci.size() < 4 || uci[0] < 'a' || uci[0] > 'h' || uci[1] < '1' || uci[1] > '8'
+            || uci[2] < 'a' || uci[2] > 'h' || uci[3] < '1' || uci[3] > '8') {
+            return Move();
+        }
+        return Move(uci[0] - 'a', '8' - uci[1], uci[2] - 'a', '8' - uci[3]);
+    }
+
+    // Function used to turn an id into a safe file name
+    std::string fileName(const std::string& id) {
+        std::string name;
+        for (char c : id) {
+            bool safe = std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.';
+            name += safe ? c : '_';
+        }
+        return name;
+    }
+
+    // Function used to read the next batch of diagrams, returns false at the end of the input
+    bool readBatch(std::istream& input, const Options& options, std::size_t& line_number,
+                   std::vector<Diagram>& batch) {
+        batch.clear();
+        EpdRecord record;
+        std::string line;
+        while (batch.size() < batch_size && std::getline(input, line)) {
+            line_number++;
+            if (!parseEpdLine(line, record)) {
+                continue;
+            }
+            Diagram diagram;
+            if (!diagram.position.loadPositionFromFEN(record.fen)) {
+                std::cerr << "Skipping line " << line_number << ": " << line << std::endl;
+                continue;
+            }
+            auto operation = record.operations.find("lm");
+            if (operation != record.operations.end()) {
+                diagram.last_move = parseSquares(operation->second);
+            }
+            operation = record.operations.find("id");
+            std::string name = (operation != record.operations.end()) ? fileName(operation->second) : "";
+            if (name.empty()) {
+                char number[16];
+                std::snprintf(number, sizeof(number), "%06zu", line_number);
+                name = number;
+            }
+            diagram.path = options.output + "/" + name + "." + options.format;
+            batch.push_back(std::move(diagram));
+        }
+        return !batch.empty();
+    }
+
+    // Function used to write the SVG diagrams of a batch on a pool of threads, returns the number of failures
+    std::size_t writeSvgBatch(const std::vector<Diagram>& batch, const Options& options) {
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::size_t> failures{0};
+        std::vector<std::thread> workers;
+        for (int i = 0; i < options.threads; i++) {
+            workers.emplace_back([&] {
+                DiagramOptions diagram_options = options.diagram;
+                for (std::size_t j = next++; j < batch.size(); j = next++) {
+                    diagram_options.last_move = batch[j].last_move;
+                    std::ofstream file(batch[j].path, std::ios::binary);
+                    file << renderSvg(batch[j].position, diagram_options);
+                    if (!file) {
+                        failures++;
+                    }
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        return failures;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    std::ifstream file;
+    if (options.input != "-") {
+        file.open(options.input);
+        if (!file) {
+            std::cerr << "Could not open " << options.input << std::endl;
+            return 1;
+        }
+    }
+    std::istream& input = (options.input == "-") ? std::cin : file;
+    std::error_code error;
+    std::filesystem::create_directories(options.output, error);
+
+    if (options.format == "svg") {
+        if (options.embed_atlas) {
+            options.diagram.piece_atlas = fileDataUri(options.atlas);
+            if (options.diagram.piece_atlas.empty()) {
+                std::cerr << "Could not read " << options.atlas << std::endl;
+                return 1;
+            }
+        } else {
+            // The diagrams are written elsewhere, so a relative path would not resolve
+            options.diagram.piece_atlas = "file://" + std::filesystem::absolute(options.atlas, error).lexically_normal().generic_string();
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::size_t written = 0;
+    std::size_t failures = 0;
+    std::size_t line_number = 0;
+    std::vector<Diagram> batch;
+#ifdef CHESS_DIAGRAM_PNG
+    if (options.format == "png") {
+        // Rendering stays on this thread, which owns the graphics context
+        DiagramRenderer renderer;
+        DiagramEncoder encoder(options.threads);
+        DiagramOptions diagram_options = options.diagram;
+        sf::Image image;
+        while (readBatch(input, options, line_number, batch)) {
+            for (Diagram& diagram : batch) {
+                diagram_options.last_move = diagram.last_move;
+                if (!renderer.render(diagram.position, diagram_options, image)) {
+                    return 1;
+                }
+                encoder.save(image, std::move(diagram.path));
+                written++;
+            }
+        }
+        failures = encoder.finish();
+    }
+#endif
+    if (options.format == "svg") {
+        while (readBatch(input, options, line_number, batch)) {
+            failures += writeSvgBatch(batch, options);
+            written += batch.size();
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Wrote " << written - failures << " diagrams in " << seconds << " s ("
+              << static_cast<std::size_t>((written - failures) / std::max(seconds, 1e-9)) << " per second)";
+    if (failures > 0) {
+        std::cerr << ", " << failures << " could not be written";
+    }
+    std::cerr << std::endl;
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,271 @@
+#include "epd.hpp"
+#include "opening_explorer.hpp"
+#include "pgn.hpp"
+#include "position.hpp"
+#include "move.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Opening explorer built from PGN games. "build" counts the moves of the first plies
+// of every game as a map-reduce: each thread replays games into its own hash map of
+// (position, move) statistics, the maps are merged pairwise in parallel and the
+// result is written sorted as an explorer file. "query" maps the file and lists the
+// moves played from the position of every FEN/EPD line with their statistics.
+//
+// Usage: chess_explorer build [--threads N] [--plies N] [--min-games N] [--output FILE] PGN...
+//        chess_explorer query [--book FILE] [FILE]
+
+namespace {
+    struct Options {
+        std::string command;
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+        int plies = 30;
+        std::uint32_t min_games = 1;
+        std::string book = "openings.cexp";
+        std::vector<std::string> arguments;
+    };
+
+    // Queue of game texts read from the PGN files, bounded so that reading does not run ahead of replaying
+    class GameQueue {
+        public:
+            explicit GameQueue(std::size_t capacity) : capacity(capacity) {}
+
+            void push(std::vector<std::string>&& batch) {
+                std::unique_lock<std::mutex> lock(mutex);
+                space_available.wait(lock, [this] { return batches.size() < capacity; });
+                batches.push_back(std::move(batch));
+                batch_available.notify_one();
+            }
+
+            void close() {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+                batch_available.notify_all();
+            }
+
+            bool pop(std::vector<std::string>& batch) {
+                std::unique_lock<std::mutex> lock(mutex);
+                batch_available.wait(lock, [this] { return closed || !batches.empty(); });
+                if (batches.empty()) {
+                    return false;
+                }
+                batch = std::move(batches.front());
+                batches.pop_front();
+                space_available.notify_one();
+                return true;
+            }
+
+        private:
+            std::mutex mutex;
+            std::condition_variable batch_available;
+            std::condition_variable space_available;
+            std::deque<std::vector<std::string>> batches;
+            std::size_t capacity;
+            bool closed = false;
+    };
+
+    void printUsage() {
+        std::cerr << "Usage: chess_explorer build [--threads N] [--plies N] [--min-games N] [--output FILE] PGN...\n"
+                     "       chess_explorer query [--book FILE] [FILE]\n"
+                     "Builds an opening tree from PGN games and lists the moves played from FEN/EPD positions.\n";
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        if (argc < 2) {
+            return false;
+        }
+        options.command = argv[1];
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            try {
+                if (arg == "--threads" && has_value) options.threads = std::max(1, std::stoi(argv[++i]));
+                else if (arg == "--plies" && has_value) options.plies = std::max(1, std::stoi(argv[++i]));
+                else if (arg == "--min-games" && has_value) options.min_games = std::stoul(argv[++i]);
+                else if ((arg == "--output" || arg == "--book") && has_value) options.book = argv[++i];
+                else if (arg.size() > 1 && arg[0] == '-') return false;
+                else options.arguments.push_back(arg);
+            } catch (std::exception& e) {
+                return false;
+            }
+        }
+        return (options.command == "build" && !options.arguments.empty())
+               || (options.command == "query" && options.arguments.size() <= 1);
+    }
+
+    int build(const Options& options) {
+        auto start = std::chrono::steady_clock::now();
+        auto seconds = [](std::chrono::steady_clock::time_point since) {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+        };
+        const std::size_t batch_size = 256;
+        GameQueue queue(static_cast<std::size_t>(options.threads) * 4);
+        std::vector<std::unique_ptr<OpeningExplorerBuilder>> builders;
+        for (int i = 0; i < options.threads; i++) {
+            builders.push_back(std::make_unique<OpeningExplorerBuilder>(options.plies));
+        }
+        std::atomic<std::uint64_t> failed_games{0};
+
+        // Map: every worker counts its games in its own builder
+        std::vector<std::thread> workers;
+        for (int i = 0; i < options.threads; i++) {
+            workers.emplace_back([&, i] {
+                PgnGame game;
+                Position position;
+                std::vector<std::string> batch;
+                while (queue.pop(batch)) {
+                    for (const std::string& text : batch) {
+                        parsePgnGame(text, game);
+                        if (!builders[i]->addGame(game, position)) {
+                            failed_games++;
+                        }
+                    }
+                }
+            });
+        }
+
+        bool read_all = true;
+        std::vector<std::string> batch;
+        for (const std::string& path : options.arguments) {
+            std::ifstream file(path);
+            if (!file) {
+                std::cerr << "Could not open " << path << std::endl;
+                read_all = false;
+                break;
+            }
+            PgnReader reader(file);
+            std::string text;
+            while (reader.next(text)) {
+                batch.push_back(std::move(text));
+                if (batch.size() == batch_size) {
+                    queue.push(std::move(batch));
+                    batch.clear();
+                }
+            }
+        }
+        if (!batch.empty()) {
+            queue.push(std::move(batch));
+        }
+        queue.close();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        if (!read_all) {
+            return 1;
+        }
+        double replay_time = seconds(start);
+
+        // Reduce: builders are merged in pairs, the pairs of a round in parallel
+        auto merge_start = std::chrono::steady_clock::now();
+        for (std::size_t step = 1; step < builders.size(); step *= 2) {
+            std::vector<std::thread> mergers;
+            for (std::size_t i = 0; i + step < builders.size(); i += 2 * step) {
+                mergers.emplace_back([&builders, i, step] { builders[i]->merge(*builders[i + step]); });
+            }
+            for (std::thread& merger : mergers) {
+                merger.join();
+            }
+        }
+        const OpeningExplorerBuilder& tree = *builders[0];
+        double merge_time = seconds(merge_start);
+        auto write_start = std::chrono::steady_clock::now();
+        if (!tree.write(options.book, options.min_games)) {
+            return 1;
+        }
+        OpeningExplorer explorer;
+        if (!explorer.open(options.book)) {
+            return 1;
+        }
+        std::cout << std::fixed << std::setprecision(2)
+                  << "Counted " << tree.games() << " games (" << failed_games << " with errors), "
+                  << tree.size() << " position moves, " << explorer.size() << " written\n"
+                  << "Replay " << replay_time << " s (" << static_cast<std::uint64_t>(tree.games() / std::max(replay_time, 1e-9))
+                  << " games/s), merge " << merge_time << " s, write " << seconds(write_start) << " s on "
+                  << options.threads << " threads\n";
+        return 0;
+    }
+
+    int query(const Options& options) {
+        OpeningExplorer explorer;
+        if (!explorer.open(options.book)) {
+            return 1;
+        }
+        std::ifstream file;
+        if (!options.arguments.empty()) {
+            file.open(options.arguments[0]);
+            if (!file) {
+                std::cerr << "Could not open " << options.arguments[0] << std::endl;
+                return 1;
+            }
+        }
+        std::istream& input = options.arguments.empty() ? std::cin : file;
+        Position position;
+        EpdRecord record;
+        std::vector<ExplorerMove> moves;
+        std::string line;
+        std::uint64_t queries = 0;
+        std::chrono::steady_clock::duration lookup_time{};
+        std::cout << std::fixed << std::setprecision(1);
+        while (std::getline(input, line)) {
+            if (!parseEpdLine(line, record)) {
+                continue;
+            }
+            if (!position.loadPositionFromFEN(record.fen)) {
+                std::cout << record.fen << " : invalid" << std::endl;
+                continue;
+            }
+            auto lookup_start = std::chrono::steady_clock::now();
+            explorer.lookup(position.hash(), moves);
+            lookup_time += std::chrono::steady_clock::now() - lookup_start;
+            queries++;
+            std::uint64_t total = 0;
+            for (const ExplorerMove& move : moves) {
+                total += move.games;
+            }
+            std::cout << record.fen << " : " << total << " games\n";
+            for (const ExplorerMove& move : moves) {
+                // A colliding key could bring moves of another position
+                if (!position.isLegal(move.move)) {
+                    continue;
+                }
+                double games = std::max<std::uint32_t>(1, move.games);
+                std::cout << "    " << std::left << std::setw(8) << position.toSAN(move.move) << std::right
+                          << std::setw(10) << move.games << std::setw(7) << 100.0 * move.games / total << "%"
+                          << "  +" << 100.0 * move.white_wins / games << "% =" << 100.0 * move.draws / games
+                          << "% -" << 100.0 * move.black_wins / games << "%";
+                if (move.average_rating > 0) {
+                    std::cout << "  rating " << move.average_rating;
+                }
+                std::cout << '\n';
+            }
+        }
+        std::cout.flush();
+        if (queries > 0) {
+            std::cerr << queries << " queries on " << explorer.games() << " games, "
+                      << std::setprecision(3) << std::chrono::duration<double, std::micro>(lookup_time).count() / queries
+                      << " us per lookup" << std::endl;
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    return options.command == "build" ? build(options) : query(options);
+}
@@ -0,0 +1,288 @@
+#include "epd.hpp"
+#include "game_index.hpp"
+#include "pgn.hpp"
+#include "position.hpp"
+#include "move.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Index of the positions reached in PGN games. "build" replays every game through
+// the move generator on a pool of threads, collecting the Zobrist key of every
+// position with the game number and ply, and writes them sorted as an index file.
+// "query" maps the index and lists the games which reached the position of every
+// FEN/EPD line. Games are numbered from 1 in input order across the PGN files.
+//
+// Usage: chess_index build [--threads N] [--output FILE] PGN...
+//        chess_index query [--index FILE] [--limit N] [FILE]
+
+namespace {
+    struct Options {
+        std::string command;
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+        std::string index = "games.cidx";
+        // Games listed per query, all of them are counted
+        std::size_t limit = 10;
+        std::vector<std::string> arguments;
+    };
+
+    struct Job {
+        std::uint32_t game;
+        std::string text;
+    };
+
+    // Queue of game texts read from the PGN files, bounded so that reading does not run ahead of replaying
+    class GameQueue {
+        public:
+            explicit GameQueue(std::size_t capacity) : capacity(capacity) {}
+
+            void push(std::vector<Job>&& batch) {
+                std::unique_lock<std::mutex> lock(mutex);
+                space_available.wait(lock, [this] { return batches.size() < capacity; });
+                batches.push_back(std::move(batch));
+                batch_available.notify_one();
+            }
+
+            void close() {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+                batch_available.notify_all();
+            }
+
+            bool pop(std::vector<Job>& batch) {
+                std::unique_lock<std::mutex> lock(mutex);
+                batch_available.wait(lock, [this] { return closed || !batches.empty(); });
+                if (batches.empty()) {
+                    return false;
+                }
+                batch = std::move(batches.front());
+                batches.pop_front();
+                space_available.notify_one();
+                return true;
+            }
+
+        private:
+            std::mutex mutex;
+            std::condition_variable batch_available;
+            std::condition_variable space_available;
+            std::deque<std::vector<Job>> batches;
+            std::size_t capacity;
+            bool closed = false;
+    };
+
+    void printUsage() {
+        std::cerr << "Usage: chess_index build [--threads N] [--output FILE] PGN...\n"
+                     "       chess_index query [--index FILE] [--limit N] [FILE]\n"
+                     "Indexes the positions of PGN games and finds the games which reached FEN/EPD positions.\n";
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        if (argc < 2) {
+            return false;
+        }
+        options.command = argv[1];
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            try {
+                if (arg == "--threads" && has_value) options.threads = std::max(1, std::stoi(argv[++i]));
+                else if ((arg == "--output" || arg == "--index") && has_value) options.index = argv[++i];
+                else if (arg == "--limit" && has_value) options.limit = std::stoul(argv[++i]);
+                else if (arg.size() > 1 && arg[0] == '-') return false;
+                else options.arguments.push_back(arg);
+            } catch (std::exception& e) {
+                return false;
+            }
+        }
+        return (options.command == "build" && !options.arguments.empty())
+               || (options.command == "query" && options.arguments.size() <= 1);
+    }
+
+    // Function used to replay a game and append the key of every position it reaches,
+    // returns false if it has an illegal move or start position, the moves before it are kept
+    bool replayGame(const Job& job, PgnGame& game, Position& position, std::vector<GameIndexEntry>& run,
+                    std::string& error) {
+        parsePgnGame(job.text, game);
+        auto fen = game.tags.find("FEN");
+        if (!position.loadPositionFromFEN(fen != game.tags.end() ? fen->second : Position::start_fen)) {
+            error = "invalid FEN";
+            return false;
+        }
+        GameIndexEntry entry;
+        entry.game = job.game;
+        entry.key = position.hash();
+        run.push_back(entry);
+        for (std::size_t ply = 0; ply < game.moves.size(); ply++) {
+            Move move = position.parseSAN(game.moves[ply]);
+            if (!move.isValid()) {
+                error = "illegal move " + game.moves[ply];
+                return false;
+            }
+            Position::UndoInfo undo;
+            position.makeMove(move, undo);
+            entry.key = position.hash();
+            entry.ply = static_cast<std::uint16_t>(std::min<std::size_t>(ply + 1, UINT16_MAX));
+            run.push_back(entry);
+        }
+        return true;
+    }
+
+    int build(const Options& options) {
+        auto start = std::chrono::steady_clock::now();
+        auto seconds = [](std::chrono::steady_clock::time_point since) {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+        };
+        const std::size_t batch_size = 256;
+        GameQueue queue(static_cast<std::size_t>(options.threads) * 4);
+        // Every worker collects its positions in its own run
+        std::vector<std::vector<GameIndexEntry>> runs(options.threads);
+        std::atomic<std::uint64_t> failed_games{0};
+        std::mutex error_mutex;
+
+        std::vector<std::thread> workers;
+        for (int i = 0; i < options.threads; i++) {
+            workers.emplace_back([&, i] {
+                PgnGame game;
+                Position position;
+                std::vector<Job> batch;
+                std::string error;
+                while (queue.pop(batch)) {
+                    for (const Job& job : batch) {
+                        if (!replayGame(job, game, position, runs[i], error)) {
+                            // Only the first errors are worth reading
+                            if (failed_games++ < 10) {
+                                std::lock_guard<std::mutex> lock(error_mutex);
+                                std::cerr << "Game " << job.game + 1 << ": " << error << std::endl;
+                            }
+                        }
+                    }
+                }
+            });
+        }
+
+        std::uint64_t games = 0;
+        bool read_all = true;
+        std::vector<Job> batch;
+        for (const std::string& path : options.arguments) {
+            std::ifstream file(path);
+            if (!file) {
+                std::cerr << "Could not open " << path << std::endl;
+                read_all = false;
+                break;
+            }
+            PgnReader reader(file);
+            std::string text;
+            while (reader.next(text)) {
+                if (games >= UINT32_MAX) {
+                    std::cerr << "Too many games, the rest are not indexed" << std::endl;
+                    break;
+                }
+                batch.push_back(Job{static_cast<std::uint32_t>(games++), std::move(text)});
+                if (batch.size() == batch_size) {
+                    queue.push(std::move(batch));
+                    batch.clear();
+                }
+            }
+        }
+        if (!batch.empty()) {
+            queue.push(std::move(batch));
+        }
+        queue.close();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        if (!read_all) {
+            return 1;
+        }
+        std::uint64_t positions = 0;
+        for (const auto& run : runs) {
+            positions += run.size();
+        }
+        double replay_time = seconds(start);
+
+        auto write_start = std::chrono::steady_clock::now();
+        if (!GameIndex::write(options.index, runs, games, options.threads)) {
+            return 1;
+        }
+        GameIndex index;
+        if (!index.open(options.index)) {
+            return 1;
+        }
+        std::cout << std::fixed << std::setprecision(2)
+                  << "Indexed " << games << " games (" << failed_games << " with errors), "
+                  << positions << " positions, " << index.size() << " entries without repeats within a game\n"
+                  << "Replay " << replay_time << " s (" << static_cast<std::uint64_t>(games / std::max(replay_time, 1e-9))
+                  << " games/s), sort and write " << seconds(write_start) << " s on " << options.threads
+                  << " threads\n";
+        return 0;
+    }
+
+    int query(const Options& options) {
+        GameIndex index;
+        if (!index.open(options.index)) {
+            return 1;
+        }
+        std::ifstream file;
+        if (!options.arguments.empty()) {
+            file.open(options.arguments[0]);
+            if (!file) {
+                std::cerr << "Could not open " << options.arguments[0] << std::endl;
+                return 1;
+            }
+        }
+        std::istream& input = options.arguments.empty() ? std::cin : file;
+        Position position;
+        EpdRecord record;
+        std::string line;
+        std::uint64_t queries = 0;
+        std::chrono::steady_clock::duration search_time{};
+        while (std::getline(input, line)) {
+            if (!parseEpdLine(line, record)) {
+                continue;
+            }
+            if (!position.loadPositionFromFEN(record.fen)) {
+                std::cout << record.fen << " : invalid" << std::endl;
+                continue;
+            }
+            auto search_start = std::chrono::steady_clock::now();
+            GameIndex::Range games = index.find(position.hash());
+            search_time += std::chrono::steady_clock::now() - search_start;
+            queries++;
+            std::cout << record.fen << " : " << games.size() << " games\n";
+            std::size_t listed = 0;
+            for (const GameIndexEntry& entry : games) {
+                if (listed++ == options.limit) {
+                    std::cout << "    ...\n";
+                    break;
+                }
+                std::cout << "    game " << entry.game + 1 << " ply " << entry.ply << '\n';
+            }
+        }
+        std::cout.flush();
+        if (queries > 0) {
+            std::cerr << queries << " queries on " << index.games() << " games, "
+                      << std::chrono::duration<double, std::micro>(search_time).count() / queries
+                      << " us per search" << std::endl;
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    return options.command == "build" ? build(options) : query(options);
+}
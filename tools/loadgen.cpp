@@ -0,0 +1,256 @@
+#include "position.hpp"
+#include "move.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Load generator for chess_server. Every connection runs on its own thread, keeps
+// several games going and plays random legal moves in them, choosing the moves
+// from its own copy of each position so that only "move" requests are timed.
+// Reports the moves per second and the latency percentiles of the move requests.
+//
+// Usage: chess_loadgen [--host ADDRESS] [--port N] [--unix PATH] [--connections N]
+//                      [--games N] [--duration SECONDS] [--seed N]
+
+namespace {
+    struct Options {
+        std::string host = "127.0.0.1";
+        int port = 7878;
+        std::string unix_path;
+        int connections = 64;
+        // Games played at the same time by every connection
+        int games = 4;
+        double duration = 10;
+        unsigned int seed = 1;
+    };
+
+    // Blocking line-based client connection
+    class Client {
+        public:
+            ~Client() {
+                if (fd != -1) {
+                    close(fd);
+                }
+            }
+
+            bool connect(const Options& options) {
+                if (!options.unix_path.empty()) {
+                    sockaddr_un address{};
+                    address.sun_family = AF_UNIX;
+                    std::strncpy(address.sun_path, options.unix_path.c_str(), sizeof(address.sun_path) - 1);
+                    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                    return fd != -1 && ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+                }
+                sockaddr_in address{};
+                address.sin_family = AF_INET;
+                address.sin_port = htons(static_cast<std::uint16_t>(options.port));
+                if (inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1) {
+                    return false;
+                }
+                fd = socket(AF_INET, SOCK_STREAM, 0);
+                int no_delay = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+                return fd != -1 && ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+            }
+
+            // Method used to send a request and wait for its reply, returns false if the connection failed
+            bool request(const std::string& line, std::string& reply) {
+                std::string message = line + '\n';
+                for (std::size_t sent = 0; sent < message.size(); ) {
+                    ssize_t count = send(fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+                    if (count <= 0) {
+                        return false;
+                    }
+                    sent += static_cast<std::size_t>(count);
+                }
+                std::size_t end;
+                while ((end = input.find('\n')) == std::string::npos) {
+                    char buffer[4096];
+                    ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+                    if (count <= 0) {
+                        return false;
+                    }
+                    input.append(buffer, static_cast<std::size_t>(count));
+                }
+                reply = input.substr(0, end);
+                input.erase(0, end + 1);
+                return true;
+            }
+
+        private:
+            int fd = -1;
+            std::string input;
+    };
+
+    struct LocalGame {
+        std::string id;
+        Position position;
+    };
+
+    struct WorkerResult {
+        std::uint64_t moves = 0;
+        std::uint64_t games = 0;
+        std::uint64_t errors = 0;
+        // Latency of every move request in microseconds
+        std::vector<std::uint32_t> latencies;
+    };
+
+    // Function used to start a new game on the server, returns false if the connection failed
+    bool newGame(Client& client, LocalGame& game, WorkerResult& result) {
+        std::string reply;
+        if (!client.request("new", reply)) {
+            return false;
+        }
+        if (reply.rfind("ok new ", 0) != 0) {
+            result.errors++;
+            return false;
+        }
+        std::string id = reply.substr(7);
+        // The finished game is closed so that the server does not keep it
+        if (!game.id.empty() && !client.request("close " + game.id, reply)) {
+            return false;
+        }
+        game.id = id;
+        game.position.loadPositionFromFEN(Position::start_fen);
+        result.games++;
+        return true;
+    }
+
+    void runConnection(const Options& options, int index, std::chrono::steady_clock::time_point end,
+                       WorkerResult& result) {
+        using Clock = std::chrono::steady_clock;
+        Client client;
+        if (!client.connect(options)) {
+            std::cerr << "Connection " << index << " failed: " << std::strerror(errno) << std::endl;
+            result.errors++;
+            return;
+        }
+        std::mt19937 random(options.seed + index);
+        std::vector<LocalGame> games(std::max(1, options.games));
+        for (LocalGame& game : games) {
+            if (!newGame(client, game, result)) {
+                return;
+            }
+        }
+        MoveList moves;
+        std::string reply;
+        for (std::size_t turn = 0; Clock::now() < end; turn++) {
+            LocalGame& game = games[turn % games.size()];
+            game.position.generateMoves(game.position.activeColor(), moves);
+            // Games are restarted once over or long, so that the positions stay varied
+            if (moves.size() == 0 || game.position.fullmoveNumber() > 100) {
+                if (!newGame(client, game, result)) {
+                    return;
+                }
+                continue;
+            }
+            Move move = moves[random() % moves.size()];
+            Clock::time_point start = Clock::now();
+            if (!client.request("move " + game.id + " " + move.toString(), reply)) {
+                result.errors++;
+                return;
+            }
+            auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+            result.latencies.push_back(static_cast<std::uint32_t>(latency));
+            if (reply.rfind("ok move ", 0) != 0) {
+                result.errors++;
+                continue;
+            }
+            Position::UndoInfo undo;
+            game.position.makeMove(move, undo);
+            result.moves++;
+            // Finished games are started over
+            if (reply.find(" checkmate") != std::string::npos || reply.find(" stalemate") != std::string::npos
+                || reply.find(" draw") != std::string::npos) {
+                if (!newGame(client, game, result)) {
+                    return;
+                }
+            }
+        }
+        for (LocalGame& game : games) {
+            client.request("close " + game.id, reply);
+        }
+        client.request("quit", reply);
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            try {
+                if (arg == "--host" && has_value) options.host = argv[++i];
+                else if (arg == "--port" && has_value) options.port = std::stoi(argv[++i]);
+                else if (arg == "--unix" && has_value) options.unix_path = argv[++i];
+                else if (arg == "--connections" && has_value) options.connections = std::max(1, std::stoi(argv[++i]));
+                else if (arg == "--games" && has_value) options.games = std::max(1, std::stoi(argv[++i]));
+                else if (arg == "--duration" && has_value) options.duration = std::max(0.1, std::stod(argv[++i]));
+                else if (arg == "--seed" && has_value) options.seed = static_cast<unsigned int>(std::stoul(argv[++i]));
+                else return false;
+            } catch (std::exception& e) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: chess_loadgen [--host ADDRESS] [--port N] [--unix PATH] [--connections N]\n"
+                     "                     [--games N] [--duration SECONDS] [--seed N]\n";
+        return 1;
+    }
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(
+                                        std::chrono::duration<double>(options.duration));
+    std::vector<WorkerResult> results(options.connections);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < options.connections; i++) {
+        threads.emplace_back(runConnection, std::cref(options), i, end, std::ref(results[i]));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    WorkerResult total;
+    for (WorkerResult& result : results) {
+        total.moves += result.moves;
+        total.games += result.games;
+        total.errors += result.errors;
+        total.latencies.insert(total.latencies.end(), result.latencies.begin(), result.latencies.end());
+    }
+    std::sort(total.latencies.begin(), total.latencies.end());
+    auto percentile = [&](double fraction) -> std::uint32_t {
+        if (total.latencies.empty()) {
+            return 0;
+        }
+        std::size_t index = static_cast<std::size_t>(fraction * (total.latencies.size() - 1));
+        return total.latencies[index];
+    };
+    std::cout << "Connections     : " << options.connections << '\n'
+              << "Games started   : " << total.games << '\n'
+              << "Moves played    : " << total.moves << '\n'
+              << "Errors          : " << total.errors << '\n'
+              << "Moves/second    : " << static_cast<std::uint64_t>(total.moves / seconds) << '\n'
+              << "Latency p50     : " << percentile(0.50) << " us\n"
+              << "Latency p99     : " << percentile(0.99) << " us\n"
+              << "Latency max     : " << percentile(1.0) << " us" << std::endl;
+    return total.errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,481 @@
+#include "epd.hpp"
+#include "position.hpp"
+#include "search.hpp"
+#include "tablebase.hpp"
+#include "transposition_table.hpp"
+#include "move.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Self-play match between two engine configurations. Games are played
+// concurrently, each worker thread owning the search state of both players,
+// from an opening suite with colors reversed on every second game. Keeps a
+// running Elo estimate and optionally stops early once an SPRT is decided.
+// With tablebases, a game ends as soon as its material is in a table.
+//
+// Usage: chess_match [--games N] [--concurrency N] [--tc SECONDS+INC] [--openings FILE]
+//                    [--pgn FILE] [--sprt ELO0 ELO1 ALPHA BETA] [--tablebases DIR]
+//                    [--engine1 KEY=VALUE,...] [--engine2 KEY=VALUE,...]
+// Engine keys: name, hash, depth, nodes, movetime
+
+namespace {
+    struct EngineConfig {
+        std::string name;
+        std::size_t hash = 16;
+        // Limits for every move, combined with the clock when there is a time control
+        SearchLimits limits;
+    };
+
+    struct Options {
+        std::array<EngineConfig, 2> engines;
+        // Time control in milliseconds, disabled if the base time is 0
+        std::int64_t base_time = 0;
+        std::int64_t increment = 0;
+        int games = 100;
+        int concurrency = std::max(1u, std::thread::hardware_concurrency());
+        std::string openings;
+        std::string pgn;
+        std::string tablebases;
+        bool sprt = false;
+        double elo0 = 0;
+        double elo1 = 5;
+        double alpha = 0.05;
+        double beta = 0.05;
+    };
+
+    enum class GameResult {
+        WhiteWins, BlackWins, Draw
+    };
+
+    struct Game {
+        int number = 0;
+        // Index of the engine playing white
+        int white = 0;
+        std::string opening;
+        std::vector<Move> moves;
+        GameResult result = GameResult::Draw;
+        const char* termination = "";
+    };
+
+    // Search state of one engine, owned by a single worker thread
+    struct Player {
+        explicit Player(const EngineConfig& config) :
+            config(config),
+            tt(config.hash),
+            search(tt, stop_flag)
+        {}
+
+        const EngineConfig& config;
+        TranspositionTable tt;
+        std::atomic<bool> stop_flag{false};
+        Search search;
+    };
+
+    // Win/draw/loss statistics from the point of view of the first engine
+    class MatchStatistics {
+        public:
+            void add(double score) {
+                if (score == 1) wins++;
+                else if (score == 0) losses++;
+                else draws++;
+            }
+
+            int games() const { return wins + draws + losses; }
+
+            double score() const {
+                return games() ? (wins + draws * 0.5) / games() : 0.5;
+            }
+
+            double elo() const {
+                return scoreToElo(score());
+            }
+
+            // Half width of the 95% confidence interval of the Elo estimate
+            double eloMargin() const {
+                if (games() < 2) {
+                    return 0;
+                }
+                double deviation = std::sqrt(variance() / games());
+                return (scoreToElo(score() + 1.96 * deviation) - scoreToElo(score() - 1.96 * deviation)) / 2;
+            }
+
+            // Log likelihood ratio of H1 (elo1) against H0 (elo0) using the
+            // normal approximation of the trinomial score distribution
+            double llr(double elo0, double elo1) const {
+                double var = variance();
+                if (games() == 0 || var <= 0) {
+                    return 0;
+                }
+                double s0 = eloToScore(elo0);
+                double s1 = eloToScore(elo1);
+                return (s1 - s0) * (2 * score() - s0 - s1) / (2 * var / games());
+            }
+
+            int wins = 0;
+            int draws = 0;
+            int losses = 0;
+
+        private:
+            double variance() const {
+                double x = score();
+                return (wins * (1 - x) * (1 - x) + draws * (0.5 - x) * (0.5 - x) + losses * x * x) / games();
+            }
+
+            static double eloToScore(double elo) {
+                return 1 / (1 + std::pow(10.0, -elo / 400));
+            }
+
+            static double scoreToElo(double score) {
+                score = std::clamp(score, 1e-6, 1 - 1e-6);
+                return -400 * std::log10(1 / score - 1);
+            }
+    };
+
+    Piece::Color opposite(Piece::Color color) {
+        return (color == Piece::Color::White) ? Piece::Color::Black : Piece::Color::White;
+    }
+
+    GameResult winner(Piece::Color color) {
+        return (color == Piece::Color::White) ? GameResult::WhiteWins : GameResult::BlackWins;
+    }
+
+    // Function used to play one game. Everything it uses is owned by the worker
+    // and reused from game to game, so it does not allocate per move. The tablebase
+    // is shared by the workers and may be null
+    void playGame(Game& game, Position& position, std::array<std::unique_ptr<Player>, 2>& players,
+                  const Tablebase* tablebase, const Options& options) {
+        using Clock = std::chrono::steady_clock;
+        position.loadPositionFromFEN(game.opening);
+        game.moves.clear();
+        // Remaining time of each side in microseconds, indexed by Piece::Color
+        std::array<std::int64_t, 2> clocks = {options.base_time * 1000, options.base_time * 1000};
+        MoveList moves;
+        TablebaseResult probed;
+
+        while (true) {
+            Piece::Color color = position.activeColor();
+            // Checkmate and stalemate, the same rules as ChessBoard::nextMove
+            position.generateMoves(color, moves);
+            if (moves.empty()) {
+                if (position.inCheck(color)) {
+                    game.result = winner(opposite(color));
+                    game.termination = "checkmate";
+                } else {
+                    game.result = GameResult::Draw;
+                    game.termination = "stalemate";
+                }
+                return;
+            }
+            if (position.repetitionCount() >= 2) {
+                game.result = GameResult::Draw;
+                game.termination = "threefold repetition";
+                return;
+            }
+            if (position.isFiftyMoveDraw()) {
+                game.result = GameResult::Draw;
+                game.termination = "fifty-move rule";
+                return;
+            }
+            if (position.isInsufficientMaterial()) {
+                game.result = GameResult::Draw;
+                game.termination = "insufficient material";
+                return;
+            }
+            if (tablebase != nullptr && tablebase->probe(position, probed)) {
+                game.result = (probed.outcome == TablebaseOutcome::Draw) ? GameResult::Draw
+                            : (probed.outcome == TablebaseOutcome::Win) ? winner(color) : winner(opposite(color));
+                game.termination = "tablebase adjudication";
+                return;
+            }
+
+            int engine = (color == Piece::Color::White) ? game.white : 1 - game.white;
+            Player& player = *players[engine];
+            SearchLimits limits = player.config.limits;
+            if (options.base_time > 0) {
+                limits.wtime = static_cast<int>(clocks[Piece::Color::White] / 1000);
+                limits.btime = static_cast<int>(clocks[Piece::Color::Black] / 1000);
+                limits.winc = limits.binc = static_cast<int>(options.increment);
+            }
+            player.stop_flag.store(false);
+            Clock::time_point start = Clock::now();
+            const SearchInfo& info = player.search.run(position, limits);
+            std::int64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+            if (options.base_time > 0) {
+                clocks[color] -= elapsed;
+                if (clocks[color] < 0) {
+                    game.result = winner(opposite(color));
+                    game.termination = "time forfeit";
+                    return;
+                }
+                clocks[color] += options.increment * 1000;
+            }
+
+            Move move = info.bestMove();
+            Position::UndoInfo undo;
+            position.makeMove(move, undo);
+            game.moves.push_back(move);
+        }
+    }
+
+    std::string resultString(GameResult result) {
+        switch (result) {
+            case GameResult::WhiteWins: return "1-0";
+            case GameResult::BlackWins: return "0-1";
+            default: return "1/2-1/2";
+        }
+    }
+
+    std::string formatPGN(const Game& game, const Options& options) {
+        char date[11];
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y.%m.%d", std::localtime(&now));
+
+        std::ostringstream pgn;
+        pgn << "[Event \"chess_match\"]\n"
+            << "[Site \"?\"]\n"
+            << "[Date \"" << date << "\"]\n"
+            << "[Round \"" << game.number << "\"]\n"
+            << "[White \"" << options.engines[game.white].name << "\"]\n"
+            << "[Black \"" << options.engines[1 - game.white].name << "\"]\n"
+            << "[Result \"" << resultString(game.result) << "\"]\n";
+        Position position;
+        position.loadPositionFromFEN(game.opening);
+        if (position.toFEN() != Position::start_fen) {
+            pgn << "[SetUp \"1\"]\n"
+                << "[FEN \"" << game.opening << "\"]\n";
+        }
+        pgn << "[Termination \"" << game.termination << "\"]\n\n";
+
+        std::string movetext;
+        std::size_t line_length = 0;
+        auto append = [&](const std::string& token) {
+            if (line_length + token.size() + 1 > 80) {
+                movetext += '\n';
+                line_length = 0;
+            } else if (line_length > 0) {
+                movetext += ' ';
+                line_length++;
+            }
+            movetext += token;
+            line_length += token.size();
+        };
+        for (std::size_t i = 0; i < game.moves.size(); i++) {
+            if (position.activeColor() == Piece::Color::White) {
+                append(std::to_string(position.fullmoveNumber()) + ".");
+            } else if (i == 0) {
+                append(std::to_string(position.fullmoveNumber()) + "...");
+            }
+            append(position.toSAN(game.moves[i]));
+            Position::UndoInfo undo;
+            position.makeMove(game.moves[i], undo);
+        }
+        append(resultString(game.result));
+        pgn << movetext << "\n\n";
+        return pgn.str();
+    }
+
+    // Function used to parse "name=new,hash=16,depth=6"
+    bool parseEngineConfig(const std::string& text, EngineConfig& config) {
+        std::istringstream input(text);
+        std::string pair;
+        while (std::getline(input, pair, ',')) {
+            std::size_t separator = pair.find('=');
+            if (separator == std::string::npos) {
+                return false;
+            }
+            std::string key = pair.substr(0, separator);
+            std::string value = pair.substr(separator + 1);
+            if (key == "name") config.name = value;
+            else if (key == "hash") config.hash = std::stoul(value);
+            else if (key == "depth") config.limits.depth = std::stoi(value);
+            else if (key == "nodes") config.limits.nodes = std::stoull(value);
+            else if (key == "movetime") config.limits.movetime = std::stoi(value);
+            else return false;
+        }
+        return true;
+    }
+
+    void printUsage() {
+        std::cerr << "Usage: chess_match [--games N] [--concurrency N] [--tc SECONDS+INC] [--openings FILE]\n"
+                     "                   [--pgn FILE] [--sprt ELO0 ELO1 ALPHA BETA] [--tablebases DIR]\n"
+                     "                   [--engine1 KEY=VALUE,...] [--engine2 KEY=VALUE,...]\n"
+                     "Engine keys: name, hash, depth, nodes, movetime\n";
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        options.engines[0].name = "engine1";
+        options.engines[1].name = "engine2";
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument(arg);
+                }
+                return argv[++i];
+            };
+            try {
+                if (arg == "--games") options.games = std::stoi(value());
+                else if (arg == "--concurrency") options.concurrency = std::max(1, std::stoi(value()));
+                else if (arg == "--openings") options.openings = value();
+                else if (arg == "--pgn") options.pgn = value();
+                else if (arg == "--tablebases") options.tablebases = value();
+                else if (arg == "--engine1" && !parseEngineConfig(value(), options.engines[0])) return false;
+                else if (arg == "--engine2" && !parseEngineConfig(value(), options.engines[1])) return false;
+                else if (arg == "--tc") {
+                    std::string tc = value();
+                    std::size_t plus = tc.find('+');
+                    options.base_time = static_cast<std::int64_t>(std::stod(tc.substr(0, plus)) * 1000);
+                    if (plus != std::string::npos) {
+                        options.increment = static_cast<std::int64_t>(std::stod(tc.substr(plus + 1)) * 1000);
+                    }
+                }
+                else if (arg == "--sprt") {
+                    options.sprt = true;
+                    options.elo0 = std::stod(value());
+                    options.elo1 = std::stod(value());
+                    options.alpha = std::stod(value());
+                    options.beta = std::stod(value());
+                }
+                else if (arg != "--engine1" && arg != "--engine2") return false;
+            } catch (std::exception& e) {
+                return false;
+            }
+        }
+        // Without a clock every move needs a limit of its own
+        for (EngineConfig& config : options.engines) {
+            if (options.base_time == 0 && config.limits.depth == 0
+                && config.limits.nodes == 0 && config.limits.movetime == 0) {
+                config.limits.depth = 4;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<std::string> openings;
+    if (!options.openings.empty()) {
+        std::ifstream file(options.openings);
+        if (!file) {
+            std::cerr << "Could not open " << options.openings << std::endl;
+            return 1;
+        }
+        std::string line;
+        EpdRecord record;
+        Position position;
+        while (std::getline(file, line)) {
+            if (parseEpdLine(line, record) && position.loadPositionFromFEN(record.fen)) {
+                openings.push_back(record.fen);
+            }
+        }
+    }
+    if (openings.empty()) {
+        openings.push_back(Position::start_fen);
+    }
+
+    Tablebase tablebase;
+    if (!options.tablebases.empty() && tablebase.loadDirectory(options.tablebases) == 0) {
+        std::cerr << "No tables found in " << options.tablebases << std::endl;
+        return 1;
+    }
+
+    std::ofstream pgn;
+    if (!options.pgn.empty()) {
+        pgn.open(options.pgn);
+        if (!pgn) {
+            std::cerr << "Could not open " << options.pgn << std::endl;
+            return 1;
+        }
+    }
+
+    const double lower_bound = std::log(options.beta / (1 - options.alpha));
+    const double upper_bound = std::log((1 - options.beta) / options.alpha);
+    std::atomic<int> next_game{0};
+    std::atomic<bool> finished{false};
+    std::mutex results_mutex;
+    MatchStatistics statistics;
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.concurrency; i++) {
+        workers.emplace_back([&] {
+            // Everything a game needs is created once per worker
+            std::array<std::unique_ptr<Player>, 2> players = {
+                std::make_unique<Player>(options.engines[0]),
+                std::make_unique<Player>(options.engines[1])
+            };
+            Position position;
+            Game game;
+            game.moves.reserve(1024);
+
+            while (!finished.load()) {
+                int number = next_game++;
+                if (number >= options.games) {
+                    break;
+                }
+                // Both engines play every opening once with each color
+                game.number = number + 1;
+                game.white = number % 2;
+                game.opening = openings[(number / 2) % openings.size()];
+                for (auto& player : players) {
+                    player->tt.clear();
+                }
+                playGame(game, position, players, options.tablebases.empty() ? nullptr : &tablebase, options);
+
+                double score = (game.result == GameResult::Draw) ? 0.5
+                             : ((game.result == GameResult::WhiteWins) == (game.white == 0)) ? 1 : 0;
+                std::string record = pgn.is_open() ? formatPGN(game, options) : "";
+
+                std::lock_guard<std::mutex> lock(results_mutex);
+                statistics.add(score);
+                if (pgn.is_open()) {
+                    pgn << record << std::flush;
+                }
+                std::cout << "Game " << game.number << ": " << options.engines[game.white].name << " vs "
+                          << options.engines[1 - game.white].name << " " << resultString(game.result)
+                          << " {" << game.termination << "}\n"
+                          << "Score of " << options.engines[0].name << " vs " << options.engines[1].name << ": "
+                          << statistics.wins << " - " << statistics.losses << " - " << statistics.draws
+                          << " [" << std::fixed << std::setprecision(3) << statistics.score() << "] "
+                          << statistics.games() << "\n"
+                          << "Elo difference: " << std::setprecision(1) << statistics.elo()
+                          << " +/- " << statistics.eloMargin() << "\n";
+                if (options.sprt) {
+                    double llr = statistics.llr(options.elo0, options.elo1);
+                    std::cout << "SPRT: llr " << std::setprecision(2) << llr
+                              << " (" << lower_bound << ", " << upper_bound << ") ["
+                              << options.elo0 << ", " << options.elo1 << "]\n";
+                    if ((llr >= upper_bound || llr <= lower_bound) && !finished.load()) {
+                        std::cout << "SPRT: " << (llr >= upper_bound ? "H1" : "H0") << " accepted\n";
+                        finished.store(true);
+                    }
+                }
+                std::cout << std::flush;
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return 0;
+}
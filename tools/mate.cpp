@@ -0,0 +1,278 @@
+#include "epd.hpp"
+#include "mate_solver.hpp"
+#include "position.hpp"
+#include "move.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Verification of mate puzzles with the proof-number mate solver. Every FEN/EPD line
+// is solved on a pool of threads, each owning its solver and hash table. The EPD
+// "dm" operation gives the expected mate length (and the move limit of that line)
+// and "bm" the expected key move in SAN or UCI notation. Results are written to
+// stdout as JSON lines in input order; a puzzle is verified when a mate is proven,
+// its key move is unique and both match the expectations that are given.
+//
+// Usage: chess_mate [--moves N] [--nodes N] [--threads N] [--hash MB] [FILE]
+
+namespace {
+    struct Options {
+        MateLimits limits;
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+        // Table size of every thread
+        std::size_t hash = 16;
+        std::string input = "-";
+    };
+
+    struct Job {
+        std::size_t index;
+        std::string line;
+    };
+
+    // Queue of lines to solve and results waiting to be written in order
+    class Pipeline {
+        public:
+            explicit Pipeline(std::size_t window) : window(window) {}
+
+            // Method used by the reader to add a line, blocks while too many results are pending
+            void push(const std::string& line) {
+                std::unique_lock<std::mutex> lock(mutex);
+                space_available.wait(lock, [this] { return jobs_read - next_output < window; });
+                jobs.push_back(Job{jobs_read++, line});
+                job_available.notify_one();
+            }
+
+            // Method used by the reader to signal that there are no more lines
+            void close() {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+                job_available.notify_all();
+            }
+
+            // Method used by the workers to take the next line, returns false once closed and empty
+            bool pop(Job& job) {
+                std::unique_lock<std::mutex> lock(mutex);
+                job_available.wait(lock, [this] { return closed || !jobs.empty(); });
+                if (jobs.empty()) {
+                    return false;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+                return true;
+            }
+
+            // Method used by the workers to hand in a result, writing every result that is next in order
+            void finish(std::size_t index, std::string result) {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending[index] = std::move(result);
+                while (!pending.empty() && pending.begin()->first == next_output) {
+                    std::cout << pending.begin()->second << '\n';
+                    pending.erase(pending.begin());
+                    next_output++;
+                }
+                space_available.notify_one();
+            }
+
+        private:
+            std::mutex mutex;
+            std::condition_variable job_available;
+            std::condition_variable space_available;
+            std::deque<Job> jobs;
+            std::map<std::size_t, std::string> pending;
+            std::size_t window;
+            std::size_t jobs_read = 0;
+            std::size_t next_output = 0;
+            bool closed = false;
+    };
+
+    std::string jsonEscape(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            if (static_cast<unsigned char>(c) >= 0x20) {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    // Function used to find the legal move written in SAN or UCI notation, check and
+    // annotation symbols are ignored. Returns a null move if there is none
+    Move findMove(Position& position, const std::string& text) {
+        Move move = position.parseMove(text);
+        return move.isValid() ? move : position.parseSAN(text);
+    }
+
+    std::string formatMoves(const std::vector<Move>& moves) {
+        std::string json = "[";
+        for (std::size_t i = 0; i < moves.size(); i++) {
+            json += (i > 0 ? ",\"" : "\"") + moves[i].toString() + '"';
+        }
+        return json + "]";
+    }
+
+    // Function used to solve a puzzle and format its result, returns true in verified if it checks out
+    std::string solvePuzzle(MateSolver& solver, Position& position, const EpdRecord& record,
+                            const Options& options, bool& verified) {
+        MateLimits limits = options.limits;
+        int expected_moves = 0;
+        auto operation = record.operations.find("dm");
+        if (operation != record.operations.end()) {
+            try {
+                expected_moves = std::stoi(operation->second);
+                limits.moves = std::max(1, expected_moves);
+            } catch (std::exception& e) {
+                std::cerr << "Invalid mate length " << operation->second << std::endl;
+            }
+        }
+        Move expected_key;
+        operation = record.operations.find("bm");
+        if (operation != record.operations.end()) {
+            expected_key = findMove(position, operation->second.substr(0, operation->second.find(' ')));
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        MateResult result = solver.solve(position, limits);
+        auto time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        verified = result.unique()
+                   && (expected_moves == 0 || result.moves == expected_moves)
+                   && (!expected_key.isValid() || result.keyMove() == expected_key);
+        std::ostringstream json;
+        json << "{\"fen\":\"" << jsonEscape(record.fen) << '"';
+        auto id = record.operations.find("id");
+        if (id != record.operations.end()) {
+            json << ",\"id\":\"" << jsonEscape(id->second) << '"';
+        }
+        switch (result.status) {
+            case MateStatus::Mate:   json << ",\"status\":\"mate\""; break;
+            case MateStatus::NoMate: json << ",\"status\":\"nomate\""; break;
+            case MateStatus::Unknown: json << ",\"status\":\"unknown\""; break;
+        }
+        if (result.status == MateStatus::Mate) {
+            json << ",\"mate\":" << result.moves
+                 << ",\"key\":\"" << result.keyMove().toString() << '"'
+                 << ",\"line\":" << formatMoves(result.line)
+                 << ",\"alternatives\":" << formatMoves(result.alternatives)
+                 << ",\"unique\":" << (result.unique() ? "true" : "false");
+        }
+        json << ",\"verified\":" << (verified ? "true" : "false")
+             << ",\"nodes\":" << result.nodes
+             << ",\"time_ms\":" << time_ms << '}';
+        return json.str();
+    }
+
+    std::string formatError(const std::string& line, const std::string& error) {
+        return "{\"input\":\"" + jsonEscape(line) + "\",\"error\":\"" + error + "\"}";
+    }
+
+    void printUsage() {
+        std::cerr << "Usage: chess_mate [--moves N] [--nodes N] [--threads N] [--hash MB] [FILE]\n"
+                     "Proves the shortest mate of every FEN/EPD line of FILE (or stdin) and writes one JSON result per line.\n";
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            try {
+                if (arg == "--moves" && has_value) options.limits.moves = std::max(1, std::stoi(argv[++i]));
+                else if (arg == "--nodes" && has_value) options.limits.nodes = std::stoull(argv[++i]);
+                else if (arg == "--threads" && has_value) options.threads = std::max(1, std::stoi(argv[++i]));
+                else if (arg == "--hash" && has_value) options.hash = std::stoul(argv[++i]);
+                else if (arg.size() > 1 && arg[0] == '-') return false;
+                else options.input = arg;
+            } catch (std::exception& e) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    std::ifstream file;
+    if (options.input != "-") {
+        file.open(options.input);
+        if (!file) {
+            std::cerr << "Could not open " << options.input << std::endl;
+            return 1;
+        }
+    }
+    std::istream& input = (options.input == "-") ? std::cin : file;
+    std::ios::sync_with_stdio(false);
+
+    Pipeline pipeline(static_cast<std::size_t>(options.threads) * 16);
+    std::atomic<std::size_t> puzzles{0};
+    std::atomic<std::size_t> verified_puzzles{0};
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.threads; i++) {
+        workers.emplace_back([&] {
+            // Puzzles are independent, so every worker owns its solver and table
+            MateSolver solver(options.hash);
+            Position position;
+            EpdRecord record;
+            Job job;
+            while (pipeline.pop(job)) {
+                parseEpdLine(job.line, record);
+                if (!position.loadPositionFromFEN(record.fen)) {
+                    pipeline.finish(job.index, formatError(job.line, "invalid FEN"));
+                    continue;
+                }
+                if (position.inCheck(position.activeColor() == Piece::Color::White ? Piece::Color::Black
+                                                                                    : Piece::Color::White)) {
+                    pipeline.finish(job.index, formatError(job.line, "side not to move is in check"));
+                    continue;
+                }
+                bool verified = false;
+                std::string result = solvePuzzle(solver, position, record, options, verified);
+                puzzles++;
+                if (verified) {
+                    verified_puzzles++;
+                }
+                pipeline.finish(job.index, std::move(result));
+            }
+        });
+    }
+
+    std::string line;
+    EpdRecord record;
+    while (std::getline(input, line)) {
+        if (parseEpdLine(line, record)) {
+            pipeline.push(line);
+        }
+    }
+    pipeline.close();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    std::cout.flush();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    elapsed = std::max<std::int64_t>(elapsed, 1);
+    std::cerr << "Verified " << verified_puzzles << " of " << puzzles << " puzzles in " << elapsed << " ms ("
+              << puzzles * 3600000 / elapsed << " puzzles/hour) on " << options.threads << " threads" << std::endl;
+    return 0;
+}
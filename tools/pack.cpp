@@ -0,0 +1,290 @@
+#include "epd.hpp"
+#include "move_counter.hpp"
+#include "packed_position.hpp"
+#include "position.hpp"
+#include "move.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Conversion between FEN/EPD text and the packed binary position format.
+//
+// "pack" reads FEN or EPD lines and writes 32 byte positions, or 40 byte records
+// with --annotated where the score is taken from the "ce" operation, the best move
+// from "bm" (SAN or UCI) and the result ("1-0", "0-1" or "1/2-1/2") from "c9".
+// "unpack" writes the records back as FEN lines followed by the same operations.
+// "count" counts the legal moves of every position in batches and prints statistics,
+// with --verify the counts are compared with the move generator.
+//
+// Usage: chess_pack pack [--annotated] [INPUT] OUTPUT
+//        chess_pack unpack INPUT [OUTPUT]
+//        chess_pack count [--scalar] [--verify] INPUT
+
+namespace {
+    void printUsage() {
+        std::cerr << "Usage: chess_pack pack [--annotated] [INPUT] OUTPUT\n"
+                     "       chess_pack unpack INPUT [OUTPUT]\n"
+                     "       chess_pack count [--scalar] [--verify] INPUT\n"
+                     "Converts FEN/EPD lines (stdin/stdout for a missing file) to and from packed positions,\n"
+                     "or counts the legal moves of packed positions (--scalar: without SIMD, --verify: compare\n"
+                     "with the move generator).\n";
+    }
+
+    // Function used to find the legal move written in SAN or UCI notation, check and
+    // annotation symbols are ignored. Returns a null move if there is none
+    Move findMove(Position& position, const std::string& text) {
+        Move move = position.parseMove(text);
+        return move.isValid() ? move : position.parseSAN(text);
+    }
+
+    void annotate(Position& position, const EpdRecord& epd, PackedRecord& record) {
+        auto operation = epd.operations.find("ce");
+        if (operation != epd.operations.end()) {
+            try {
+                record.score = static_cast<std::int16_t>(std::stoi(operation->second));
+            } catch (std::exception& e) {
+                std::cerr << "Invalid score " << operation->second << std::endl;
+            }
+        }
+        operation = epd.operations.find("bm");
+        if (operation != epd.operations.end()) {
+            // Only the first of several best moves is kept
+            record.best_move = findMove(position, operation->second.substr(0, operation->second.find(' ')));
+        }
+        operation = epd.operations.find("c9");
+        if (operation != epd.operations.end()) {
+            if (operation->second == "1-0") record.result = 1;
+            else if (operation->second == "0-1") record.result = -1;
+            else if (operation->second == "1/2-1/2") record.result = 0;
+        }
+    }
+
+    int pack(std::istream& input, const std::string& output_path, bool annotated) {
+        PackedPositionWriter writer(output_path, annotated);
+        if (!writer.isOpen()) {
+            return 1;
+        }
+        Position position;
+        EpdRecord epd;
+        std::string line;
+        std::size_t line_number = 0;
+        while (std::getline(input, line)) {
+            line_number++;
+            if (!parseEpdLine(line, epd)) {
+                continue;
+            }
+            PackedRecord record;
+            if (!position.loadPositionFromFEN(epd.fen) || !position.pack(record.position)) {
+                std::cerr << "Skipping line " << line_number << ": " << line << std::endl;
+                continue;
+            }
+            if (annotated) {
+                annotate(position, epd, record);
+            }
+            if (!writer.write(record)) {
+                std::cerr << "Could not write " << output_path << std::endl;
+                return 1;
+            }
+        }
+        std::size_t count = writer.count();
+        if (!writer.close()) {
+            std::cerr << "Could not write " << output_path << std::endl;
+            return 1;
+        }
+        std::cerr << "Packed " << count << " positions" << std::endl;
+        return 0;
+    }
+
+    int unpack(const std::string& input_path, std::ostream& output) {
+        PackedPositionReader reader(input_path);
+        if (!reader.isOpen()) {
+            return 1;
+        }
+        Position position;
+        PackedRecord record;
+        while (reader.next(record)) {
+            if (!position.loadPackedPosition(record.position)) {
+                continue;
+            }
+            output << position.toFEN();
+            if (reader.annotated()) {
+                if (record.score != PackedRecord::no_score) {
+                    output << " ce " << record.score << ';';
+                }
+                if (record.best_move.isValid() && position.isLegal(record.best_move)) {
+                    output << " bm " << position.toSAN(record.best_move) << ';';
+                }
+                if (record.result != PackedRecord::no_result) {
+                    output << " c9 \"" << (record.result > 0 ? "1-0" : record.result < 0 ? "0-1" : "1/2-1/2") << "\";";
+                }
+            }
+            output << '\n';
+        }
+        return output ? 0 : 1;
+    }
+
+    // Function used to count the legal moves of all the positions of a packed file, batch_size
+    // at a time. With verify every position is also loaded and its moves generated one by one,
+    // to compare the results and the time taken
+    int count(const std::string& input_path, bool use_simd, bool verify) {
+        PackedPositionReader reader(input_path);
+        if (!reader.isOpen()) {
+            return 1;
+        }
+        constexpr std::size_t batch_size = 4096;
+        PositionBatch batch;
+        batch.reserve(batch_size);
+        MoveCounts counts;
+        std::vector<PackedPosition> packed;
+        Position position;
+        MoveList moves;
+        std::size_t positions = 0, invalid = 0, checks = 0, checkmates = 0, stalemates = 0, mismatches = 0;
+        std::uint64_t total_moves = 0;
+        int most_moves = 0;
+        std::chrono::steady_clock::duration batch_time{}, generator_time{};
+        PackedRecord record;
+        bool more = true;
+        while (more) {
+            // Records are read before timing, the batch time includes unpacking into bitboards
+            packed.clear();
+            while (packed.size() < batch_size && (more = reader.next(record))) {
+                packed.push_back(record.position);
+            }
+            auto start = std::chrono::steady_clock::now();
+            batch.clear();
+            std::vector<std::size_t> skipped;
+            for (std::size_t i = 0; i < packed.size(); i++) {
+                if (!batch.add(packed[i])) {
+                    skipped.push_back(i);
+                }
+            }
+            countMoves(batch, counts, use_simd);
+            batch_time += std::chrono::steady_clock::now() - start;
+            for (auto it = skipped.rbegin(); it != skipped.rend(); ++it) {
+                packed.erase(packed.begin() + static_cast<std::ptrdiff_t>(*it));
+            }
+            invalid += skipped.size();
+
+            for (std::size_t i = 0; i < batch.size(); i++) {
+                int legal_moves = counts.legal_moves[i];
+                checks += counts.in_check[i];
+                checkmates += (legal_moves == 0 && counts.in_check[i]);
+                stalemates += (legal_moves == 0 && !counts.in_check[i]);
+                total_moves += legal_moves;
+                most_moves = std::max(most_moves, legal_moves);
+            }
+            positions += batch.size();
+            if (!verify) {
+                continue;
+            }
+            start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < packed.size(); i++) {
+                if (!position.loadPackedPosition(packed[i])) {
+                    continue;
+                }
+                position.generateMoves(position.activeColor(), moves);
+                bool check = position.inCheck(position.activeColor());
+                if (moves.size() != counts.legal_moves[i] || check != (counts.in_check[i] != 0)) {
+                    if (mismatches++ < 10) {
+                        std::cerr << "Mismatch: " << position.toFEN() << " has " << moves.size() << " moves"
+                                  << (check ? " in check" : "") << ", counted " << counts.legal_moves[i]
+                                  << (counts.in_check[i] ? " in check" : "") << std::endl;
+                    }
+                }
+            }
+            generator_time += std::chrono::steady_clock::now() - start;
+        }
+
+        auto microseconds = [](std::chrono::steady_clock::duration time) {
+            return std::max<long long>(1, std::chrono::duration_cast<std::chrono::microseconds>(time).count());
+        };
+        std::cout << "Positions: " << positions << " (" << invalid << " invalid)\n"
+                  << "In check: " << checks << ", checkmates: " << checkmates << ", stalemates: " << stalemates << "\n"
+                  << "Legal moves: " << total_moves << " (average "
+                  << (positions ? static_cast<double>(total_moves) / static_cast<double>(positions) : 0.0)
+                  << ", most " << most_moves << ")\n"
+                  << "Counted with " << ((use_simd && simdMoveCountingAvailable()) ? "AVX2" : "scalar code") << " in "
+                  << microseconds(batch_time) / 1000.0 << " ms, "
+                  << positions * 1000000ULL / static_cast<unsigned long long>(microseconds(batch_time)) << " positions/s\n";
+        if (verify) {
+            std::cout << "Move generator: " << microseconds(generator_time) / 1000.0 << " ms, "
+                      << positions * 1000000ULL / static_cast<unsigned long long>(microseconds(generator_time))
+                      << " positions/s\n"
+                      << "Mismatches: " << mismatches << "\n";
+        }
+        return mismatches ? 1 : 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string command = (argc > 1) ? argv[1] : "";
+    std::ios::sync_with_stdio(false);
+    if (command == "pack") {
+        bool annotated = false;
+        std::string files[2];
+        int file_count = 0;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--annotated") {
+                annotated = true;
+            } else if (file_count < 2 && (arg == "-" || arg[0] != '-')) {
+                files[file_count++] = arg;
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+        if (file_count == 0) {
+            printUsage();
+            return 1;
+        }
+        std::string input_path = (file_count == 2) ? files[0] : "-";
+        std::ifstream file;
+        if (input_path != "-") {
+            file.open(input_path);
+            if (!file) {
+                std::cerr << "Could not open " << input_path << std::endl;
+                return 1;
+            }
+        }
+        return pack((input_path == "-") ? std::cin : file, files[file_count - 1], annotated);
+    }
+    if (command == "unpack" && (argc == 3 || argc == 4)) {
+        if (argc == 3 || std::string(argv[3]) == "-") {
+            return unpack(argv[2], std::cout);
+        }
+        std::ofstream file(argv[3]);
+        if (!file) {
+            std::cerr << "Could not create " << argv[3] << std::endl;
+            return 1;
+        }
+        return unpack(argv[2], file);
+    }
+    if (command == "count") {
+        bool use_simd = true, verify = false;
+        std::string input_path;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--scalar") {
+                use_simd = false;
+            } else if (arg == "--verify") {
+                verify = true;
+            } else if (input_path.empty() && arg[0] != '-') {
+                input_path = arg;
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+        if (input_path.empty()) {
+            printUsage();
+            return 1;
+        }
+        return count(input_path, use_simd, verify);
+    }
+    printUsage();
+    return 1;
+}
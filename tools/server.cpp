@@ -0,0 +1,583 @@
+#include "position.hpp"
+#include "move.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sstream>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// Server hosting many concurrent games in memory over a line-based protocol on TCP
+// and/or Unix sockets. A single thread multiplexes every connection with epoll and
+// hands complete request lines to a pool of workers, which validate and play the
+// moves. Replies are sent in request order, a connection's next request is only
+// started once the previous one is answered.
+//
+// Requests and replies:
+//     new [FEN]          -> ok new ID
+//     move ID MOVE       -> ok move ID MOVE [checkmate|stalemate|draw]
+//     fen ID             -> ok fen ID FEN
+//     moves ID           -> ok moves ID MOVE...
+//     close ID           -> ok close ID
+//     stats              -> ok stats games N moves N connections N
+//     quit               -> closes the connection
+// Failed requests are answered with "error MESSAGE". Moves use UCI notation. A client
+// sending a line over 64 KiB or pipelining over 1024 unanswered requests is disconnected.
+//
+// Usage: chess_server [--bind ADDRESS] [--port N] [--unix PATH] [--threads N]
+
+namespace {
+    struct Options {
+        std::string bind = "127.0.0.1";
+        int port = 7878;
+        std::string unix_path;
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+    };
+
+    // A game is only a position, guarded by its own mutex as several connections may play it
+    struct Game {
+        std::mutex mutex;
+        Position position;
+    };
+
+    // Games by id, split into shards so that workers rarely contend on the same lock
+    class GameTable {
+        public:
+            std::uint64_t create(std::unique_ptr<Game> game) {
+                std::uint64_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+                Shard& shard = shards[id % shard_count];
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.games.emplace(id, std::move(game));
+                return id;
+            }
+
+            std::shared_ptr<Game> find(std::uint64_t id) {
+                Shard& shard = shards[id % shard_count];
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                auto game = shard.games.find(id);
+                return (game != shard.games.end()) ? game->second : nullptr;
+            }
+
+            bool erase(std::uint64_t id) {
+                Shard& shard = shards[id % shard_count];
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                return shard.games.erase(id) > 0;
+            }
+
+            std::size_t size() {
+                std::size_t games = 0;
+                for (Shard& shard : shards) {
+                    std::lock_guard<std::mutex> lock(shard.mutex);
+                    games += shard.games.size();
+                }
+                return games;
+            }
+
+        private:
+            static constexpr std::size_t shard_count = 64;
+            struct Shard {
+                std::mutex mutex;
+                std::unordered_map<std::uint64_t, std::shared_ptr<Game>> games;
+            };
+            std::array<Shard, shard_count> shards;
+            std::atomic<std::uint64_t> next_id{1};
+    };
+
+    struct Job {
+        std::uint64_t connection;
+        std::string line;
+    };
+
+    struct Reply {
+        std::uint64_t connection;
+        std::string text;
+        bool close;
+    };
+
+    // Limits on what a client can make the server hold for it, a client exceeding the line
+    // length or the pending requests is disconnected
+    constexpr std::size_t max_line_length = 1 << 16;
+    constexpr std::size_t max_pending_requests = 1024;
+    constexpr std::size_t max_pending_output = 1 << 20;
+
+    struct Connection {
+        int fd = -1;
+        std::string input;
+        std::string output;
+        // Complete request lines waiting for the previous request to be answered
+        std::deque<std::string> requests;
+        bool busy = false;
+        bool closing = false;
+        bool writable_registered = false;
+    };
+
+    std::atomic<bool> stop_requested{false};
+
+    void onSignal(int) {
+        stop_requested.store(true);
+    }
+
+    bool setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+    }
+
+    class Server {
+        public:
+            explicit Server(const Options& options) : options(options) {}
+
+            ~Server() {
+                for (int fd : listeners) {
+                    close(fd);
+                }
+                for (auto& connection : connections) {
+                    close(connection.second.fd);
+                }
+                if (wake_fd != -1) close(wake_fd);
+                if (epoll_fd != -1) close(epoll_fd);
+                if (!options.unix_path.empty()) {
+                    unlink(options.unix_path.c_str());
+                }
+            }
+
+            // Method used to open the sockets, errors are printed
+            bool start() {
+                epoll_fd = epoll_create1(0);
+                wake_fd = eventfd(0, EFD_NONBLOCK);
+                if (epoll_fd == -1 || wake_fd == -1) {
+                    std::cerr << "Could not create the event loop: " << std::strerror(errno) << std::endl;
+                    return false;
+                }
+                watch(wake_fd, EPOLLIN);
+                if (options.port > 0 && !listenTcp()) {
+                    return false;
+                }
+                if (!options.unix_path.empty() && !listenUnix()) {
+                    return false;
+                }
+                return !listeners.empty();
+            }
+
+            // Method used to run the event loop until a signal is received
+            void run() {
+                std::vector<std::thread> workers;
+                for (int i = 0; i < options.threads; i++) {
+                    workers.emplace_back(&Server::work, this);
+                }
+                std::vector<epoll_event> events(256);
+                while (!stop_requested.load()) {
+                    int count = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), 500);
+                    for (int i = 0; i < count; i++) {
+                        int fd = events[i].data.fd;
+                        if (fd == wake_fd) {
+                            std::uint64_t value;
+                            while (read(wake_fd, &value, sizeof(value)) > 0) {}
+                            deliverReplies();
+                        }
+                        else if (std::find(listeners.begin(), listeners.end(), fd) != listeners.end()) {
+                            accept(fd);
+                        }
+                        else {
+                            handle(fd, events[i].events);
+                        }
+                    }
+                }
+                {
+                    std::lock_guard<std::mutex> lock(job_mutex);
+                    jobs_closed = true;
+                }
+                job_available.notify_all();
+                for (std::thread& worker : workers) {
+                    worker.join();
+                }
+            }
+
+        private:
+            void watch(int fd, std::uint32_t events, int operation = EPOLL_CTL_ADD) {
+                epoll_event event{};
+                event.events = events;
+                event.data.fd = fd;
+                epoll_ctl(epoll_fd, operation, fd, &event);
+            }
+
+            bool listenOn(int fd, const sockaddr* address, socklen_t length, const std::string& name) {
+                if (fd == -1 || bind(fd, address, length) == -1 || listen(fd, SOMAXCONN) == -1
+                    || !setNonBlocking(fd)) {
+                    std::cerr << "Could not listen on " << name << ": " << std::strerror(errno) << std::endl;
+                    if (fd != -1) {
+                        close(fd);
+                    }
+                    return false;
+                }
+                listeners.push_back(fd);
+                watch(fd, EPOLLIN);
+                std::cerr << "Listening on " << name << std::endl;
+                return true;
+            }
+
+            bool listenTcp() {
+                sockaddr_in address{};
+                address.sin_family = AF_INET;
+                address.sin_port = htons(static_cast<std::uint16_t>(options.port));
+                if (inet_pton(AF_INET, options.bind.c_str(), &address.sin_addr) != 1) {
+                    std::cerr << "Invalid address " << options.bind << std::endl;
+                    return false;
+                }
+                int fd = socket(AF_INET, SOCK_STREAM, 0);
+                int reuse = 1;
+                if (fd != -1) {
+                    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+                }
+                return listenOn(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address),
+                                options.bind + ":" + std::to_string(options.port));
+            }
+
+            bool listenUnix() {
+                sockaddr_un address{};
+                address.sun_family = AF_UNIX;
+                if (options.unix_path.size() >= sizeof(address.sun_path)) {
+                    std::cerr << "Socket path too long: " << options.unix_path << std::endl;
+                    return false;
+                }
+                std::strcpy(address.sun_path, options.unix_path.c_str());
+                unlink(options.unix_path.c_str());
+                return listenOn(socket(AF_UNIX, SOCK_STREAM, 0), reinterpret_cast<sockaddr*>(&address),
+                                sizeof(address), options.unix_path);
+            }
+
+            void accept(int listener) {
+                while (true) {
+                    int fd = ::accept(listener, nullptr, nullptr);
+                    if (fd == -1) {
+                        return;
+                    }
+                    setNonBlocking(fd);
+                    int no_delay = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+                    std::uint64_t id = next_connection++;
+                    Connection connection;
+                    connection.fd = fd;
+                    connections.emplace(id, std::move(connection));
+                    connection_ids[fd] = id;
+                    open_connections.fetch_add(1, std::memory_order_relaxed);
+                    watch(fd, EPOLLIN | EPOLLRDHUP);
+                }
+            }
+
+            // Method used to read from a connection and start its next request
+            void handle(int fd, std::uint32_t events) {
+                auto found = connection_ids.find(fd);
+                if (found == connection_ids.end()) {
+                    return;
+                }
+                // Copied as flushing or reading may drop the connection and its entry
+                std::uint64_t id = found->second;
+                if (events & EPOLLOUT) {
+                    flush(id);
+                    if (connections.count(id) == 0) {
+                        return;
+                    }
+                }
+                Connection& connection = connections.at(id);
+                if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    char buffer[4096];
+                    while (true) {
+                        ssize_t received = read(fd, buffer, sizeof(buffer));
+                        if (received > 0) {
+                            connection.input.append(buffer, static_cast<std::size_t>(received));
+                            if (!splitRequests(connection)) {
+                                drop(id);
+                                return;
+                            }
+                            continue;
+                        }
+                        if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                            connection.closing = true;
+                        }
+                        break;
+                    }
+                }
+                dispatch(id);
+            }
+
+            // Method used to move the complete lines of a connection's input to its requests,
+            // returns false if the client exceeds the line length or the pending requests
+            bool splitRequests(Connection& connection) {
+                std::size_t start = 0;
+                std::size_t end;
+                while ((end = connection.input.find('\n', start)) != std::string::npos) {
+                    std::string line = connection.input.substr(start, end - start);
+                    if (!line.empty() && line.back() == '\r') {
+                        line.pop_back();
+                    }
+                    start = end + 1;
+                    connection.requests.push_back(std::move(line));
+                }
+                connection.input.erase(0, start);
+                return connection.input.size() <= max_line_length && connection.requests.size() <= max_pending_requests;
+            }
+
+            // Method used to hand the next request of a connection to the workers
+            void dispatch(std::uint64_t id) {
+                Connection& connection = connections.at(id);
+                // A client not reading its replies gets no new ones until it catches up
+                if (connection.busy || connection.output.size() > max_pending_output) {
+                    return;
+                }
+                if (connection.requests.empty()) {
+                    if (connection.closing && connection.output.empty()) {
+                        drop(id);
+                    }
+                    return;
+                }
+                connection.busy = true;
+                {
+                    std::lock_guard<std::mutex> lock(job_mutex);
+                    jobs.push_back(Job{id, std::move(connection.requests.front())});
+                }
+                connection.requests.pop_front();
+                job_available.notify_one();
+            }
+
+            void deliverReplies() {
+                std::deque<Reply> ready;
+                {
+                    std::lock_guard<std::mutex> lock(reply_mutex);
+                    ready.swap(replies);
+                }
+                for (Reply& reply : ready) {
+                    auto connection = connections.find(reply.connection);
+                    if (connection == connections.end()) {
+                        continue;
+                    }
+                    connection->second.busy = false;
+                    connection->second.output += reply.text;
+                    if (reply.close) {
+                        connection->second.closing = true;
+                        connection->second.requests.clear();
+                    }
+                    flush(reply.connection);
+                    if (connections.count(reply.connection) > 0) {
+                        dispatch(reply.connection);
+                    }
+                }
+            }
+
+            // Method used to write as much pending output as the socket takes
+            void flush(std::uint64_t id) {
+                Connection& connection = connections.at(id);
+                while (!connection.output.empty()) {
+                    ssize_t sent = send(connection.fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL);
+                    if (sent <= 0) {
+                        if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                            break;
+                        }
+                        drop(id);
+                        return;
+                    }
+                    connection.output.erase(0, static_cast<std::size_t>(sent));
+                }
+                // Only wait for the socket to become writable while output is pending
+                bool pending = !connection.output.empty();
+                if (pending != connection.writable_registered) {
+                    watch(connection.fd, EPOLLIN | EPOLLRDHUP | (pending ? static_cast<std::uint32_t>(EPOLLOUT) : 0u), EPOLL_CTL_MOD);
+                    connection.writable_registered = pending;
+                }
+                if (!pending && connection.closing && !connection.busy && connection.requests.empty()) {
+                    drop(id);
+                }
+            }
+
+            void drop(std::uint64_t id) {
+                auto connection = connections.find(id);
+                if (connection == connections.end()) {
+                    return;
+                }
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection->second.fd, nullptr);
+                close(connection->second.fd);
+                connection_ids.erase(connection->second.fd);
+                open_connections.fetch_sub(1, std::memory_order_relaxed);
+                // A reply still being computed is discarded once it arrives
+                connections.erase(connection);
+            }
+
+            void work() {
+                std::vector<Reply> done;
+                while (true) {
+                    Job job;
+                    {
+                        std::unique_lock<std::mutex> lock(job_mutex);
+                        job_available.wait(lock, [this] { return jobs_closed || !jobs.empty(); });
+                        if (jobs.empty()) {
+                            return;
+                        }
+                        job = std::move(jobs.front());
+                        jobs.pop_front();
+                    }
+                    bool close_connection = false;
+                    std::string reply = execute(job.line, close_connection);
+                    {
+                        std::lock_guard<std::mutex> lock(reply_mutex);
+                        replies.push_back(Reply{job.connection, reply.empty() ? reply : reply + '\n', close_connection});
+                    }
+                    std::uint64_t one = 1;
+                    if (write(wake_fd, &one, sizeof(one)) == -1) {
+                        std::cerr << "Could not wake the event loop" << std::endl;
+                    }
+                }
+            }
+
+            // Function used to answer a request line
+            std::string execute(const std::string& line, bool& close_connection) {
+                std::istringstream input(line);
+                std::string command;
+                input >> command;
+                if (command == "quit") {
+                    close_connection = true;
+                    return "";
+                }
+                if (command == "stats") {
+                    return "ok stats games " + std::to_string(games.size())
+                           + " moves " + std::to_string(moves_played.load(std::memory_order_relaxed))
+                           + " connections " + std::to_string(connection_count());
+                }
+                if (command == "new") {
+                    std::string fen;
+                    std::getline(input >> std::ws, fen);
+                    auto game = std::make_unique<Game>();
+                    if (!game->position.loadPositionFromFEN(fen.empty() ? Position::start_fen : fen)) {
+                        return "error invalid fen";
+                    }
+                    return "ok new " + std::to_string(games.create(std::move(game)));
+                }
+                std::uint64_t id = 0;
+                if (!(input >> id)) {
+                    return command.empty() ? "error empty request" : "error unknown command " + command;
+                }
+                if (command == "close") {
+                    return games.erase(id) ? "ok close " + std::to_string(id) : "error unknown game";
+                }
+                std::shared_ptr<Game> game = games.find(id);
+                if (!game) {
+                    return "error unknown game";
+                }
+                std::lock_guard<std::mutex> lock(game->mutex);
+                Position& position = game->position;
+                if (command == "fen") {
+                    return "ok fen " + std::to_string(id) + " " + position.toFEN();
+                }
+                if (command == "moves") {
+                    MoveList moves;
+                    position.generateMoves(position.activeColor(), moves);
+                    std::string reply = "ok moves " + std::to_string(id);
+                    for (const Move& move : moves) {
+                        reply += ' ' + move.toString();
+                    }
+                    return reply;
+                }
+                if (command == "move") {
+                    std::string text;
+                    input >> text;
+                    Move move = position.parseMove(text);
+                    if (!move.isValid()) {
+                        return "error illegal move " + text;
+                    }
+                    Position::UndoInfo undo;
+                    position.makeMove(move, undo);
+                    moves_played.fetch_add(1, std::memory_order_relaxed);
+                    return "ok move " + std::to_string(id) + " " + text + gameStatus(position);
+                }
+                return "error unknown command " + command;
+            }
+
+            // Function used to describe a finished game, empty while the game goes on
+            static std::string gameStatus(Position& position) {
+                MoveList moves;
+                position.generateMoves(position.activeColor(), moves);
+                if (moves.size() == 0) {
+                    return position.inCheck(position.activeColor()) ? " checkmate" : " stalemate";
+                }
+                if (position.isFiftyMoveDraw() || position.repetitionCount() >= 2
+                    || position.isInsufficientMaterial()) {
+                    return " draw";
+                }
+                return "";
+            }
+
+            std::size_t connection_count() const {
+                return open_connections.load(std::memory_order_relaxed);
+            }
+
+            Options options;
+            int epoll_fd = -1;
+            int wake_fd = -1;
+            std::vector<int> listeners;
+            // Connections are only touched by the event loop thread
+            std::unordered_map<std::uint64_t, Connection> connections;
+            std::unordered_map<int, std::uint64_t> connection_ids;
+            std::uint64_t next_connection = 1;
+            std::atomic<std::size_t> open_connections{0};
+            GameTable games;
+            std::atomic<std::uint64_t> moves_played{0};
+            std::mutex job_mutex;
+            std::condition_variable job_available;
+            std::deque<Job> jobs;
+            bool jobs_closed = false;
+            std::mutex reply_mutex;
+            std::deque<Reply> replies;
+    };
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            try {
+                if (arg == "--bind" && has_value) options.bind = argv[++i];
+                else if (arg == "--port" && has_value) options.port = std::stoi(argv[++i]);
+                else if (arg == "--unix" && has_value) options.unix_path = argv[++i];
+                else if (arg == "--threads" && has_value) options.threads = std::max(1, std::stoi(argv[++i]));
+                else return false;
+            } catch (std::exception& e) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: chess_server [--bind ADDRESS] [--port N] [--unix PATH] [--threads N]\n"
+                     "A port of 0 disables TCP.\n";
+        return 1;
+    }
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    Server server(options);
+    if (!server.start()) {
+        return 1;
+    }
+    server.run();
+    return 0;
+}
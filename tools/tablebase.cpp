@@ -0,0 +1,146 @@
+#include "epd.hpp"
+#include "position.hpp"
+#include "tablebase.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Generation and probing of endgame tables. Generating a table first generates the
+// tables reached from it by captures which are not in the output directory yet.
+//
+// Usage: chess_tablebase generate [--threads N] [--output DIR] MATERIAL...
+//        chess_tablebase probe [--tables DIR] [FILE]
+
+namespace {
+    struct Options {
+        std::string command;
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+        std::string directory = ".";
+        std::vector<std::string> arguments;
+    };
+
+    void printUsage() {
+        std::cerr << "Usage: chess_tablebase generate [--threads N] [--output DIR] MATERIAL...\n"
+                     "       chess_tablebase probe [--tables DIR] [FILE]\n"
+                     "Materials are pawnless with up to 5 pieces, e.g. KQvK, KRvKB or KQRvKQ.\n";
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        if (argc < 2) {
+            return false;
+        }
+        options.command = argv[1];
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            try {
+                if (arg == "--threads" && has_value) options.threads = std::max(1, std::stoi(argv[++i]));
+                else if ((arg == "--output" || arg == "--tables") && has_value) options.directory = argv[++i];
+                else if (arg.size() > 1 && arg[0] == '-') return false;
+                else options.arguments.push_back(arg);
+            } catch (std::exception& e) {
+                return false;
+            }
+        }
+        return (options.command == "generate" && !options.arguments.empty())
+               || (options.command == "probe" && options.arguments.size() <= 1);
+    }
+
+    // Function used to generate a table after the missing tables it depends on, returns false on failure
+    bool generateTable(TablebaseGenerator& generator, Tablebase& tablebase, const std::string& material,
+                       const std::string& directory) {
+        if (tablebase.has(material)) {
+            return true;
+        }
+        for (const std::string& sub : Tablebase::subMaterials(material)) {
+            if (!generateTable(generator, tablebase, sub, directory)) {
+                return false;
+            }
+        }
+        std::string path = directory + "/" + Tablebase::fileName(Tablebase::normalizeMaterial(material));
+        TablebaseStats stats;
+        if (!generator.generate(material, path, stats)) {
+            return false;
+        }
+        std::cout << std::left << std::setw(8) << stats.material
+                  << " positions " << stats.positions
+                  << " wins " << stats.wins << " losses " << stats.losses << " draws " << stats.draws
+                  << " longest mate " << (stats.longest_mate + 1) / 2 << " moves"
+                  << " iterations " << stats.iterations
+                  << std::fixed << std::setprecision(2)
+                  << " time " << stats.seconds << " s"
+                  << " memory " << stats.working_memory / (1024.0 * 1024.0) << " MB"
+                  << " peak " << stats.peak_memory / (1024.0 * 1024.0) << " MB"
+                  << " file " << stats.file_size / 1024.0 << " KB" << std::endl;
+        return true;
+    }
+
+    int probe(Tablebase& tablebase, const Options& options) {
+        std::ifstream file;
+        if (!options.arguments.empty()) {
+            file.open(options.arguments[0]);
+            if (!file) {
+                std::cerr << "Could not open " << options.arguments[0] << std::endl;
+                return 1;
+            }
+        }
+        std::istream& input = options.arguments.empty() ? std::cin : file;
+        Position position;
+        EpdRecord record;
+        std::string line;
+        while (std::getline(input, line)) {
+            if (!parseEpdLine(line, record)) {
+                continue;
+            }
+            std::cout << record.fen << " : ";
+            TablebaseResult result;
+            if (!position.loadPositionFromFEN(record.fen)) {
+                std::cout << "invalid" << std::endl;
+            } else if (!tablebase.probe(position, result)) {
+                std::cout << "not found" << std::endl;
+            } else if (result.outcome == TablebaseOutcome::Draw) {
+                std::cout << "draw" << std::endl;
+            } else {
+                std::cout << (result.outcome == TablebaseOutcome::Win ? "win" : "loss")
+                          << " mate in " << result.plies << " plies" << std::endl;
+            }
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    Tablebase tablebase;
+    if (options.command == "probe") {
+        if (tablebase.loadDirectory(options.directory) == 0) {
+            std::cerr << "No tables found in " << options.directory << std::endl;
+            return 1;
+        }
+        return probe(tablebase, options);
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(options.directory, error);
+    tablebase.loadDirectory(options.directory);
+    TablebaseGenerator generator(tablebase, options.threads);
+    for (const std::string& material : options.arguments) {
+        if (Tablebase::normalizeMaterial(material).empty()) {
+            std::cerr << "No table can be generated for " << material << std::endl;
+            return 1;
+        }
+        if (!generateTable(generator, tablebase, material, options.directory)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,502 @@
+#include "epd.hpp"
+#include "evaluation.hpp"
+#include "packed_position.hpp"
+#include "position.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Texel-style tuning of the evaluation weights (material and piece-square tables)
+// on positions labeled with the result of their game. The evaluation of a position
+// is mapped to an expected score with 1 / (1 + 10^(-K * eval / 400)) and the weights
+// are fitted with Adam to minimize the logistic (cross-entropy) loss against the
+// results. K is first fitted to the current weights unless it is given.
+//
+// Inputs are FEN/EPD lines with the result in a "c9" operation or written after the
+// FEN as 1-0, 0-1, 1/2-1/2, [1.0], [0.5] or [0.0], or annotated packed files from
+// chess_pack. Every position is parsed once into a list of its pieces, which is all
+// the features of a linear evaluation need, so the epochs only read these lists.
+// The gradient of each mini-batch is computed in slices on all threads and summed.
+// The tuned weights are written as C++ tables in the layout of evaluation.cpp.
+//
+// Usage: chess_tune [--epochs N] [--batch N] [--rate R] [--k K] [--threads N] [--seed N]
+//                   [--output FILE] INPUT...
+
+namespace {
+    struct Options {
+        int epochs = 50;
+        std::size_t batch = 16384;
+        double rate = 1.0;
+        // Scaling constant of the sigmoid, 0 to fit it
+        double k = 0;
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+        std::uint64_t seed = 1;
+        std::string output;
+        std::vector<std::string> inputs;
+    };
+
+    // Labeled positions in a compact sparse format. The features of position i are
+    // the entries offsets[i] to offsets[i + 1], one per piece: the index of its
+    // piece-square weight with bit 15 set for black pieces. The material weight of
+    // the piece is implied by the index. Results are in half points for White.
+    struct Dataset {
+        std::vector<std::uint64_t> offsets{0};
+        std::vector<std::uint16_t> features;
+        std::vector<std::uint8_t> results;
+
+        std::size_t size() const { return results.size(); }
+
+        // Method used to append the positions of another dataset
+        void append(const Dataset& other) {
+            std::uint64_t base = offsets.back();
+            for (std::size_t i = 1; i < other.offsets.size(); i++) {
+                offsets.push_back(base + other.offsets[i]);
+            }
+            features.insert(features.end(), other.features.begin(), other.features.end());
+            results.insert(results.end(), other.results.begin(), other.results.end());
+        }
+
+        // Method used to append a position, returns false if its evaluation does not match the features
+        bool add(const Position& position, std::uint8_t result, const std::array<int, evaluation_weight_count>& weights) {
+            int score = 0;
+            for (int file = 0; file < 8; file++) {
+                for (int rank = 0; rank < 8; rank++) {
+                    const Piece& piece = position.pieceAt(file, rank);
+                    if (piece.type == Piece::Type::None) {
+                        continue;
+                    }
+                    int index = pieceSquareWeight(piece, file, rank);
+                    int value = weights[piece.type] + weights[index];
+                    bool white = piece.color == Piece::Color::White;
+                    score += white ? value : -value;
+                    features.push_back(static_cast<std::uint16_t>(white ? index : index | 0x8000));
+                }
+            }
+            offsets.push_back(features.size());
+            results.push_back(result);
+            int expected = evaluate(position);
+            return score == (position.activeColor() == Piece::Color::White ? expected : -expected);
+        }
+    };
+
+    // Material weight of every weight index, the piece type of a piece-square weight
+    std::array<int, evaluation_weight_count> material_weight;
+
+    // Function used to run body(thread, begin, end) on slices of [0, count) on the given
+    // number of threads, the calling thread takes the first slice
+    template <typename Body>
+    void parallelFor(int threads, std::size_t count, Body body) {
+        std::vector<std::thread> workers;
+        std::size_t slice = (count + threads - 1) / threads;
+        for (int thread = 1; thread < threads && slice * thread < count; thread++) {
+            workers.emplace_back([&, thread] {
+                body(thread, slice * thread, std::min(count, slice * (thread + 1)));
+            });
+        }
+        body(0, 0, std::min(count, slice));
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Function used to read the result of a text line in half points for White, returns false if there is none
+    bool parseResult(const std::string& line, const EpdRecord& record, std::uint8_t& result) {
+        std::string text = line;
+        auto operation = record.operations.find("c9");
+        if (operation != record.operations.end()) {
+            text = operation->second;
+        }
+        if (text.find("1/2-1/2") != std::string::npos || text.find("[0.5]") != std::string::npos) {
+            result = 1;
+        } else if (text.find("1-0") != std::string::npos || text.find("[1.0]") != std::string::npos) {
+            result = 2;
+        } else if (text.find("0-1") != std::string::npos || text.find("[0.0]") != std::string::npos) {
+            result = 0;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Function used to strip a trailing result which is not an EPD operation, so that the FEN parses
+    std::string stripResult(const std::string& line) {
+        std::size_t end = line.find_first_of("[\"");
+        std::string fen = line.substr(0, end);
+        for (const char* result : {"1/2-1/2", "1-0", "0-1"}) {
+            std::size_t position = fen.find(result);
+            if (position != std::string::npos) {
+                fen.erase(position);
+            }
+        }
+        return fen;
+    }
+
+    // Function used to parse text lines in parallel and append them, returns false on a mismatch with evaluate
+    bool addLines(const std::vector<std::string>& lines, int threads, Dataset& dataset, std::size_t& skipped) {
+        std::vector<Dataset> parts(threads);
+        std::vector<std::size_t> part_skipped(threads, 0);
+        std::vector<char> part_valid(threads, 1);
+        auto weights = evaluationWeights();
+        parallelFor(threads, lines.size(), [&](int thread, std::size_t begin, std::size_t end) {
+            Position position;
+            EpdRecord record;
+            for (std::size_t i = begin; i < end; i++) {
+                std::uint8_t result;
+                // Lines with an operation keep them, plain lines lose the result first
+                bool parsed = lines[i].find(';') != std::string::npos ? parseEpdLine(lines[i], record)
+                                                                      : parseEpdLine(stripResult(lines[i]), record);
+                if (!parsed || !parseResult(lines[i], record, result) || !position.loadPositionFromFEN(record.fen)) {
+                    part_skipped[thread]++;
+                    continue;
+                }
+                if (!parts[thread].add(position, result, weights)) {
+                    part_valid[thread] = 0;
+                }
+            }
+        });
+        for (int thread = 0; thread < threads; thread++) {
+            dataset.append(parts[thread]);
+            skipped += part_skipped[thread];
+            if (!part_valid[thread]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Function used to load a text or packed file into the dataset, errors are printed
+    bool loadFile(const std::string& path, int threads, Dataset& dataset) {
+        const std::size_t block_size = 1 << 16;
+        std::size_t skipped = 0;
+        bool valid = true;
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Could not open " << path << std::endl;
+            return false;
+        }
+        std::array<char, 8> magic{};
+        file.read(magic.data(), magic.size());
+        if (file && magic == packed_file_magic) {
+            file.close();
+            PackedPositionReader reader(path);
+            if (!reader.isOpen()) {
+                return false;
+            }
+            if (!reader.annotated()) {
+                std::cerr << path << " has no results" << std::endl;
+                return false;
+            }
+            // Records are read in order and unpacked in parallel
+            std::vector<PackedRecord> records;
+            auto weights = evaluationWeights();
+            PackedRecord record;
+            bool more = true;
+            while (more && valid) {
+                records.clear();
+                while (records.size() < block_size && (more = reader.next(record))) {
+                    records.push_back(record);
+                }
+                std::vector<Dataset> parts(threads);
+                std::vector<std::size_t> part_skipped(threads, 0);
+                std::vector<char> part_valid(threads, 1);
+                parallelFor(threads, records.size(), [&](int thread, std::size_t begin, std::size_t end) {
+                    Position position;
+                    for (std::size_t i = begin; i < end; i++) {
+                        if (records[i].result == PackedRecord::no_result
+                            || !position.loadPackedPosition(records[i].position)) {
+                            part_skipped[thread]++;
+                            continue;
+                        }
+                        auto result = static_cast<std::uint8_t>(records[i].result + 1);
+                        if (!parts[thread].add(position, result, weights)) {
+                            part_valid[thread] = 0;
+                        }
+                    }
+                });
+                for (int thread = 0; thread < threads; thread++) {
+                    dataset.append(parts[thread]);
+                    skipped += part_skipped[thread];
+                    valid = valid && part_valid[thread];
+                }
+            }
+        } else {
+            file.clear();
+            file.seekg(0);
+            std::vector<std::string> lines;
+            std::string line;
+            while (valid && std::getline(file, line)) {
+                if (line.empty() || line[0] == '#') {
+                    continue;
+                }
+                lines.push_back(line);
+                if (lines.size() == block_size) {
+                    valid = addLines(lines, threads, dataset, skipped);
+                    lines.clear();
+                }
+            }
+            valid = valid && addLines(lines, threads, dataset, skipped);
+        }
+        if (!valid) {
+            std::cerr << "The evaluation does not match the tuner features" << std::endl;
+            return false;
+        }
+        if (skipped > 0) {
+            std::cerr << "Skipped " << skipped << " positions without a result or with an invalid position in "
+                      << path << std::endl;
+        }
+        return true;
+    }
+
+    // Function used to shuffle the positions once, so that contiguous batches mix games
+    void shuffle(Dataset& dataset, std::uint64_t seed) {
+        std::vector<std::uint32_t> order(dataset.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), std::mt19937_64(seed));
+        Dataset shuffled;
+        shuffled.offsets.reserve(dataset.offsets.size());
+        shuffled.features.reserve(dataset.features.size());
+        shuffled.results.reserve(dataset.results.size());
+        for (std::uint32_t i : order) {
+            shuffled.features.insert(shuffled.features.end(), dataset.features.begin() + dataset.offsets[i],
+                                     dataset.features.begin() + dataset.offsets[i + 1]);
+            shuffled.offsets.push_back(shuffled.features.size());
+            shuffled.results.push_back(dataset.results[i]);
+        }
+        dataset = std::move(shuffled);
+    }
+
+    double sigmoid(double k, double score) {
+        return 1.0 / (1.0 + std::pow(10.0, -k * score / 400.0));
+    }
+
+    // Function used to compute the loss summed over the positions [begin, end) and add the
+    // gradient of that sum to gradient, which may be null
+    double accumulate(const Dataset& dataset, const std::vector<double>& weights, double k,
+                      std::size_t begin, std::size_t end, double* gradient) {
+        const double epsilon = 1e-12;
+        double loss = 0;
+        for (std::size_t i = begin; i < end; i++) {
+            std::uint64_t first = dataset.offsets[i];
+            std::uint64_t last = dataset.offsets[i + 1];
+            double score = 0;
+            for (std::uint64_t j = first; j < last; j++) {
+                std::uint16_t feature = dataset.features[j];
+                int index = feature & 0x7fff;
+                double value = weights[material_weight[index]] + weights[index];
+                score += (feature & 0x8000) ? -value : value;
+            }
+            double expected = sigmoid(k, score);
+            double result = dataset.results[i] * 0.5;
+            loss -= result * std::log(expected + epsilon) + (1 - result) * std::log(1 - expected + epsilon);
+            if (gradient == nullptr) {
+                continue;
+            }
+            // The derivative of the cross-entropy of a sigmoid is the error times the slope of its argument
+            double error = (expected - result) * k * std::log(10.0) / 400.0;
+            for (std::uint64_t j = first; j < last; j++) {
+                std::uint16_t feature = dataset.features[j];
+                int index = feature & 0x7fff;
+                double delta = (feature & 0x8000) ? -error : error;
+                gradient[material_weight[index]] += delta;
+                gradient[index] += delta;
+            }
+        }
+        return loss;
+    }
+
+    // Function used to compute the mean loss of the whole dataset in parallel
+    double meanLoss(const Dataset& dataset, const std::vector<double>& weights, double k, int threads) {
+        std::vector<double> losses(threads, 0);
+        parallelFor(threads, dataset.size(), [&](int thread, std::size_t begin, std::size_t end) {
+            losses[thread] = accumulate(dataset, weights, k, begin, end, nullptr);
+        });
+        return std::accumulate(losses.begin(), losses.end(), 0.0) / std::max<std::size_t>(1, dataset.size());
+    }
+
+    // Function used to fit K to the weights with a golden-section search of the loss
+    double fitK(const Dataset& dataset, const std::vector<double>& weights, int threads) {
+        const double ratio = (std::sqrt(5.0) - 1) / 2;
+        double low = 0.05;
+        double high = 5.0;
+        for (int i = 0; i < 40; i++) {
+            double left = high - ratio * (high - low);
+            double right = low + ratio * (high - low);
+            if (meanLoss(dataset, weights, left, threads) < meanLoss(dataset, weights, right, threads)) {
+                high = right;
+            } else {
+                low = left;
+            }
+        }
+        return (low + high) / 2;
+    }
+
+    // Function used to write the weights as the tables of evaluation.cpp
+    void writeWeights(std::ostream& output, const std::vector<double>& weights, std::size_t positions, double loss) {
+        const std::array<std::pair<int, const char*>, 6> tables = {{
+            {Piece::Type::Pawn, "pawn_table"}, {Piece::Type::Knight, "knight_table"},
+            {Piece::Type::Bishop, "bishop_table"}, {Piece::Type::Rook, "rook_table"},
+            {Piece::Type::Queen, "queen_table"}, {Piece::Type::King, "king_table"}
+        }};
+        auto round = [&](int index) { return static_cast<int>(std::lround(weights[index])); };
+        output << "// Tuned on " << positions << " positions, loss " << std::setprecision(6) << loss << "\n\n";
+        output << "inline constexpr std::array<int, 7> piece_values = {";
+        for (int type = 0; type < 7; type++) {
+            output << (type > 0 ? ", " : "") << round(type);
+        }
+        output << "};\n";
+        for (const auto& [type, name] : tables) {
+            output << "\nconstexpr Table " << name << " = {{\n";
+            for (int rank = 0; rank < 8; rank++) {
+                output << "    {{";
+                for (int file = 0; file < 8; file++) {
+                    output << std::setw(4) << round(piece_square_weights_offset + type * 64 + rank * 8 + file)
+                           << (file < 7 ? "," : "");
+                }
+                output << "}}" << (rank < 7 ? "," : "") << '\n';
+            }
+            output << "}};\n";
+        }
+    }
+
+    void printUsage() {
+        std::cerr << "Usage: chess_tune [--epochs N] [--batch N] [--rate R] [--k K] [--threads N] [--seed N]\n"
+                     "                  [--output FILE] INPUT...\n"
+                     "Tunes the evaluation weights on FEN/EPD lines with game results or annotated packed files.\n";
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            try {
+                if (arg == "--epochs" && has_value) options.epochs = std::max(0, std::stoi(argv[++i]));
+                else if (arg == "--batch" && has_value) options.batch = std::max<std::size_t>(1, std::stoul(argv[++i]));
+                else if (arg == "--rate" && has_value) options.rate = std::stod(argv[++i]);
+                else if (arg == "--k" && has_value) options.k = std::stod(argv[++i]);
+                else if (arg == "--threads" && has_value) options.threads = std::max(1, std::stoi(argv[++i]));
+                else if (arg == "--seed" && has_value) options.seed = std::stoull(argv[++i]);
+                else if (arg == "--output" && has_value) options.output = argv[++i];
+                else if (arg.size() > 1 && arg[0] == '-') return false;
+                else options.inputs.push_back(arg);
+            } catch (std::exception& e) {
+                return false;
+            }
+        }
+        return !options.inputs.empty();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    for (int index = 0; index < evaluation_weight_count; index++) {
+        material_weight[index] = index < piece_square_weights_offset ? 0
+                                                                     : (index - piece_square_weights_offset) / 64;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Dataset dataset;
+    for (const std::string& input : options.inputs) {
+        if (!loadFile(input, options.threads, dataset)) {
+            return 1;
+        }
+    }
+    if (dataset.size() == 0) {
+        std::cerr << "No labeled positions" << std::endl;
+        return 1;
+    }
+    shuffle(dataset, options.seed);
+    auto seconds = [](std::chrono::steady_clock::time_point since) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+    };
+    std::cerr << std::fixed << std::setprecision(2)
+              << "Loaded " << dataset.size() << " positions in " << seconds(start) << " s, "
+              << (dataset.features.size() * sizeof(std::uint16_t) + dataset.offsets.size() * sizeof(std::uint64_t)
+                  + dataset.results.size()) / (1024.0 * 1024.0) << " MB of features" << std::endl;
+
+    auto initial = evaluationWeights();
+    std::vector<double> weights(initial.begin(), initial.end());
+    double k = options.k > 0 ? options.k : fitK(dataset, weights, options.threads);
+    std::cerr << std::setprecision(6) << "K " << k << " initial loss " << meanLoss(dataset, weights, k, options.threads)
+              << std::endl;
+
+    // Adam keeps running averages of the gradient and of its square for every weight
+    const double beta1 = 0.9;
+    const double beta2 = 0.999;
+    const double epsilon = 1e-8;
+    std::vector<double> momentum(evaluation_weight_count, 0);
+    std::vector<double> velocity(evaluation_weight_count, 0);
+    std::vector<std::vector<double>> gradients(options.threads, std::vector<double>(evaluation_weight_count));
+    std::vector<double> losses(options.threads);
+    std::vector<std::size_t> batches((dataset.size() + options.batch - 1) / options.batch);
+    std::iota(batches.begin(), batches.end(), 0);
+    std::mt19937_64 random(options.seed);
+    std::uint64_t step = 0;
+
+    for (int epoch = 1; epoch <= options.epochs; epoch++) {
+        auto epoch_start = std::chrono::steady_clock::now();
+        std::shuffle(batches.begin(), batches.end(), random);
+        double epoch_loss = 0;
+        for (std::size_t batch : batches) {
+            std::size_t begin = batch * options.batch;
+            std::size_t count = std::min(options.batch, dataset.size() - begin);
+            // Small batches may use fewer threads, so every slot is cleared first
+            for (std::vector<double>& gradient : gradients) {
+                std::fill(gradient.begin(), gradient.end(), 0.0);
+            }
+            std::fill(losses.begin(), losses.end(), 0.0);
+            parallelFor(options.threads, count, [&](int thread, std::size_t first, std::size_t last) {
+                losses[thread] = accumulate(dataset, weights, k, begin + first, begin + last, gradients[thread].data());
+            });
+            step++;
+            double correction1 = 1 - std::pow(beta1, static_cast<double>(step));
+            double correction2 = 1 - std::pow(beta2, static_cast<double>(step));
+            for (int index = 0; index < evaluation_weight_count; index++) {
+                double gradient = 0;
+                for (const std::vector<double>& thread_gradient : gradients) {
+                    gradient += thread_gradient[index];
+                }
+                gradient /= static_cast<double>(count);
+                momentum[index] = beta1 * momentum[index] + (1 - beta1) * gradient;
+                velocity[index] = beta2 * velocity[index] + (1 - beta2) * gradient * gradient;
+                weights[index] -= options.rate * (momentum[index] / correction1)
+                                  / (std::sqrt(velocity[index] / correction2) + epsilon);
+            }
+            epoch_loss += std::accumulate(losses.begin(), losses.end(), 0.0);
+        }
+        double elapsed = seconds(epoch_start);
+        std::cerr << "Epoch " << epoch << " loss " << std::setprecision(6) << epoch_loss / dataset.size()
+                  << std::setprecision(2) << " time " << elapsed << " s ("
+                  << static_cast<std::uint64_t>(dataset.size() / std::max(elapsed, 1e-9)) << " positions/s)"
+                  << std::endl;
+    }
+
+    double loss = meanLoss(dataset, weights, k, options.threads);
+    std::cerr << "Final loss " << std::setprecision(6) << loss << " in " << std::setprecision(2) << seconds(start)
+              << " s" << std::endl;
+    if (options.output.empty()) {
+        writeWeights(std::cout, weights, dataset.size(), loss);
+        return 0;
+    }
+    std::ofstream output(options.output);
+    writeWeights(output, weights, dataset.size(), loss);
+    if (!output) {
+        std::cerr << "Could not write " << options.output << std::endl;
+        return 1;
+    }
+    return 0;
+}
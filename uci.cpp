@@ -0,0 +1,251 @@
+#include "engine.hpp"
+#include "position.hpp"
+#include "search.hpp"
+#include "search_bench.hpp"
+#include "move.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+// Headless front end speaking the Universal Chess Interface protocol over
+// stdin/stdout. Commands are read on the main thread while searches run on the
+// engine's thread, so "stop" and "isready" are answered during a search.
+//
+// "chess_uci bench [depth]" runs the deterministic search benchmark and exits.
+// In a build with CHESS_TRACE, "trace [file]" prints the counters and timed scopes
+// recorded so far and writes them to file as Chrome trace JSON.
+
+namespace {
+    std::mutex output_mutex;
+    // Analysis cache file, kept so that the file is reopened when its size changes
+    std::string cache_path;
+    std::size_t cache_megabytes = 64;
+    // Number of lines searched by "go", set with the MultiPV option
+    int multipv = 1;
+
+    // Function used to write a line to stdout from any thread
+    void send(const std::string& line) {
+        std::lock_guard<std::mutex> lock(output_mutex);
+        std::cout << line << std::endl;
+    }
+
+    // Function used to format a score as "cp <x>" or "mate <moves>"
+    std::string formatScore(int score) {
+        if (isMateScore(score)) {
+            return "mate " + std::to_string(mateInMoves(score));
+        }
+        return "cp " + std::to_string(score);
+    }
+
+    void sendInfo(const SearchInfo& info) {
+        std::ostringstream line;
+        std::int64_t nps = (info.time_ms > 0) ? static_cast<std::int64_t>(info.nodes * 1000 / info.time_ms) : 0;
+        line << "info depth " << info.depth;
+        if (multipv > 1) {
+            line << " multipv " << info.multipv;
+        }
+        line << " score " << formatScore(info.score)
+             << " nodes " << info.nodes
+             << " nps " << nps
+             << " time " << info.time_ms
+             << " pv";
+        for (const Move& move : info.pv) {
+            line << ' ' << move.toString();
+        }
+        send(line.str());
+    }
+
+    // Function used to handle "position [startpos | fen <fen>] [moves <move>...]"
+    void setPosition(Position& position, std::istringstream& input) {
+        std::string token;
+        input >> token;
+        if (token == "startpos") {
+            position.loadPositionFromFEN(Position::start_fen);
+            input >> token;
+        }
+        else if (token == "fen") {
+            std::string fen;
+            while (input >> token && token != "moves") {
+                fen += token + ' ';
+            }
+            position.loadPositionFromFEN(fen);
+        }
+        else {
+            return;
+        }
+        if (token != "moves") {
+            return;
+        }
+        while (input >> token) {
+            Move move = position.parseMove(token);
+            if (!move.isValid()) {
+                send("info string illegal move " + token);
+                return;
+            }
+            Position::UndoInfo undo;
+            position.makeMove(move, undo);
+        }
+    }
+
+    // Function used to handle "go" and its search limits
+    SearchLimits parseLimits(std::istringstream& input) {
+        SearchLimits limits;
+        std::string token;
+        while (input >> token) {
+            if (token == "depth") input >> limits.depth;
+            else if (token == "nodes") input >> limits.nodes;
+            else if (token == "movetime") input >> limits.movetime;
+            else if (token == "wtime") input >> limits.wtime;
+            else if (token == "btime") input >> limits.btime;
+            else if (token == "winc") input >> limits.winc;
+            else if (token == "binc") input >> limits.binc;
+            else if (token == "movestogo") input >> limits.movestogo;
+            else if (token == "infinite") limits.infinite = true;
+            else if (token == "ponder") limits.ponder = true;
+        }
+        return limits;
+    }
+
+    // Function used to handle "bench [depth]"
+    void bench(std::istringstream& input) {
+        int depth = bench_default_depth;
+        input >> depth;
+        std::ostringstream output;
+        runSearchBench(std::max(1, depth), output);
+        send(output.str());
+    }
+
+    // Function used to handle "setoption name <name> value <value>"
+    void setOption(Engine& engine, std::istringstream& input) {
+        std::string token, name, value;
+        input >> token;
+        while (input >> token && token != "value") {
+            name += (name.empty() ? "" : " ") + token;
+        }
+        // The value is the rest of the line, file names may contain spaces
+        std::getline(input >> std::ws, value);
+        try {
+            if (name == "Hash") {
+                engine.setHashSize(std::stoul(value));
+            }
+            else if (name == "Threads") {
+                engine.setThreads(std::stoi(value));
+            }
+            else if (name == "MultiPV") {
+                multipv = std::clamp(std::stoi(value), 1, 256);
+            }
+            else if (name == "AnalysisCache" || name == "AnalysisCacheSize") {
+                if (name == "AnalysisCache") {
+                    cache_path = (value == "<empty>") ? "" : value;
+                }
+                else {
+                    cache_megabytes = std::stoul(value);
+                }
+                if (!engine.openAnalysisCache(cache_path, cache_megabytes)) {
+                    send("info string could not open analysis cache " + cache_path);
+                }
+            }
+            else if (name == "Ponder") {
+                // Pondering is driven by "go ponder" and "ponderhit", nothing to configure
+            }
+            else {
+                send("info string unknown option " + name);
+            }
+        } catch (std::exception& e) {
+            send("info string invalid value " + value + " for option " + name);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        std::istringstream input(argc > 2 ? argv[2] : "");
+        bench(input);
+        return 0;
+    }
+
+    Engine engine;
+    Position position;
+    std::string line;
+
+    while (std::getline(std::cin, line)) {
+        std::istringstream input(line);
+        std::string command;
+        input >> command;
+
+        if (command == "uci") {
+            send("id name chess");
+            send("id author HueFlux");
+            send("option name Hash type spin default 16 min 1 max 65536");
+            send("option name Threads type spin default 1 min 1 max 256");
+            send("option name MultiPV type spin default 1 min 1 max 256");
+            send("option name Ponder type check default false");
+            send("option name AnalysisCache type string default <empty>");
+            send("option name AnalysisCacheSize type spin default 64 min 1 max 65536");
+            send("uciok");
+        }
+        else if (command == "isready") {
+            send("readyok");
+        }
+        else if (command == "setoption") {
+            engine.stop();
+            setOption(engine, input);
+        }
+        else if (command == "ucinewgame") {
+            engine.stop();
+            engine.clear();
+        }
+        else if (command == "position") {
+            engine.stop();
+            engine.wait();
+            setPosition(position, input);
+        }
+        else if (command == "go") {
+            engine.stop();
+            SearchLimits limits = parseLimits(input);
+            limits.multipv = multipv;
+            engine.go(position, limits, sendInfo, [](const SearchInfo& result) {
+                std::string reply = "bestmove " + result.bestMove().toString();
+                if (result.ponderMove().isValid()) {
+                    reply += " ponder " + result.ponderMove().toString();
+                }
+                send(reply);
+            });
+        }
+        else if (command == "stop") {
+            engine.stop();
+        }
+        else if (command == "ponderhit") {
+            engine.ponderHit();
+        }
+        else if (command == "quit") {
+            break;
+        }
+        else if (command == "bench") {
+            engine.stop();
+            engine.wait();
+            bench(input);
+        }
+        else if (command == "d") {
+            send(position.toFEN());
+        }
+        else if (command == "trace") {
+            std::ostringstream summary;
+            trace::printSummary(summary);
+            send(summary.str());
+            std::string path;
+            if (input >> path && !trace::writeChromeTrace(path)) {
+                send("info string could not write trace " + path);
+            }
+        }
+        else if (!command.empty()) {
+            send("info string unknown command " + command);
+        }
+    }
+    engine.stop();
+    engine.wait();
+    return 0;
+}